@@ -0,0 +1,377 @@
+/**
+ * @file
+ * @brief Load generator for epoll_server.c: many concurrent connections,
+ * reporting requests per second and latency percentiles
+ * @see epoll_server.c
+ *
+ * @details
+ * Each connection sends length-prefixed messages and waits for their echo,
+ * keeping up to `depth` requests in flight (pipelining), for a given
+ * duration. All the connections are driven by one epoll loop, like the
+ * server, so that a single process can open thousands of them. The latency
+ * of a request is the time from queuing it to receiving the end of its echo,
+ * measured with `CLOCK_MONOTONIC`.
+ *
+ * `epoll_load_client [-h host] [-p port] [-c connections] [-d seconds]
+ * [-s message bytes] [-q depth]`
+ */
+#define _GNU_SOURCE  /// for the POSIX and socket functions under -std=c11
+#include <stdio.h>   /// for printf() and perror()
+#include <stdlib.h>  /// for malloc(), qsort() and strtol()
+#include <string.h>  /// for memset() and strcmp()
+
+#ifdef __linux__
+#include <arpa/inet.h>     /// for htonl() and inet_pton()
+#include <errno.h>         /// for errno
+#include <fcntl.h>         /// for fcntl()
+#include <netinet/in.h>    /// for sockaddr_in
+#include <netinet/tcp.h>   /// for TCP_NODELAY
+#include <signal.h>        /// for signal()
+#include <stdint.h>        /// for uint32_t and uint64_t
+#include <sys/epoll.h>     /// for epoll_create1(), epoll_ctl(), epoll_wait()
+#include <sys/resource.h>  /// for setrlimit()
+#include <sys/socket.h>    /// for socket() and connect()
+#include <time.h>          /// for clock_gettime()
+#include <unistd.h>        /// for read(), write() and close()
+
+#define PORT 8080         ///< default port of epoll_server.c
+#define MAX_MESSAGE 8192  ///< largest message epoll_server.c accepts
+#define MAX_DEPTH 64      ///< most requests in flight per connection
+#define MAX_EVENTS 256    ///< events handled per call to epoll_wait()
+
+/** @brief A connection and its requests in flight */
+struct connection
+{
+    int fd;                    ///< its socket
+    int queued;                ///< requests not completely sent
+    size_t sent;               ///< bytes sent of the first of them
+    size_t received;           ///< bytes received of the current reply
+    uint64_t start[MAX_DEPTH]; ///< when the requests in flight were queued
+    int first, inflight;       ///< oldest request in `start`, and count
+    uint32_t events;           ///< events it waits for
+};
+
+/** @brief Latencies in nanoseconds */
+static struct
+{
+    uint64_t *ns;
+    size_t count, capacity;
+} samples;
+
+/**
+ * @brief Current time
+ * @returns nanoseconds of CLOCK_MONOTONIC
+ */
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * @brief Records a latency
+ * @param ns the latency in nanoseconds
+ * @returns void
+ */
+static void record(uint64_t ns)
+{
+    if (samples.count == samples.capacity)
+    {
+        size_t capacity = samples.capacity ? 2 * samples.capacity : 65536;
+        uint64_t *grown = realloc(samples.ns, capacity * sizeof(uint64_t));
+        if (grown == NULL)
+        {
+            return;
+        }
+        samples.ns = grown;
+        samples.capacity = capacity;
+    }
+    samples.ns[samples.count++] = ns;
+}
+
+/**
+ * @brief Order of latencies for qsort()
+ */
+static int compare_ns(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Latency below which a fraction of the requests completed
+ * @param q the fraction
+ * @returns the latency in microseconds
+ */
+static double percentile(double q)
+{
+    size_t i = (size_t)(q * (samples.count - 1) + 0.5);
+    return samples.ns[i] / 1e3;
+}
+
+/**
+ * @brief Queues a request
+ * @param c the connection
+ * @returns void
+ */
+static void issue(struct connection *c)
+{
+    c->start[(c->first + c->inflight) % MAX_DEPTH] = now_ns();
+    c->inflight++;
+    c->queued++;
+}
+
+/**
+ * @brief Sends, receives and accounts what a connection allows without
+ * blocking
+ * @param epfd the epoll instance
+ * @param c the connection
+ * @param frame one request: its length then its bytes
+ * @param size number of bytes of `frame`
+ * @param deadline time when no new requests are queued
+ * @returns 0, or -1 if the connection failed
+ */
+static int drive(int epfd, struct connection *c, const char *frame,
+                 size_t size, uint64_t deadline)
+{
+    char buffer[65536];
+    ssize_t n;
+    int issued = 1, blocked = 0;
+
+    // replies may allow new requests, which may be sent at once
+    while (issued && !blocked)
+    {
+        issued = 0;
+        while (c->queued)
+        {
+            n = write(c->fd, frame + c->sent, size - c->sent);
+            if (n < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    return -1;
+                }
+                blocked = 1;
+                break;
+            }
+            c->sent += n;
+            if (c->sent == size)
+            {
+                c->sent = 0;
+                c->queued--;
+            }
+        }
+        while ((n = read(c->fd, buffer, sizeof(buffer))) > 0)
+        {
+            c->received += n;
+            while (c->received >= size && c->inflight)
+            {
+                uint64_t t = now_ns();
+                record(t - c->start[c->first]);
+                c->first = (c->first + 1) % MAX_DEPTH;
+                c->inflight--;
+                c->received -= size;
+                if (t < deadline)
+                {
+                    issue(c);
+                    issued = 1;
+                }
+            }
+        }
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            return -1;
+        }
+    }
+
+    uint32_t events = EPOLLIN | (c->queued ? EPOLLOUT : 0);
+    if (events != c->events)
+    {
+        struct epoll_event ev = {.events = events, .data.ptr = c};
+        c->events = events;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    }
+    return 0;
+}
+
+/**
+ * @brief Main function
+ * @returns 0 on exit
+ */
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    int port = PORT, connections = 100, depth = 1, seconds = 5;
+    size_t message = 64;
+    struct rlimit rl;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        long v = strtol(argv[i + 1], NULL, 10);
+        if (strcmp(argv[i], "-h") == 0)
+            host = argv[i + 1];
+        else if (strcmp(argv[i], "-p") == 0)
+            port = (int)v;
+        else if (strcmp(argv[i], "-c") == 0)
+            connections = (int)v;
+        else if (strcmp(argv[i], "-d") == 0)
+            seconds = (int)v;
+        else if (strcmp(argv[i], "-s") == 0)
+            message = (size_t)v;
+        else if (strcmp(argv[i], "-q") == 0)
+            depth = (int)v;
+    }
+    if (connections < 1 || depth < 1 || depth > MAX_DEPTH ||
+        message > MAX_MESSAGE || seconds < 1)
+    {
+        fprintf(stderr, "usage: %s [-h host] [-p port] [-c connections] "
+                        "[-d seconds] [-s bytes <= %d] [-q depth <= %d]\n",
+                argv[0], MAX_MESSAGE, MAX_DEPTH);
+        return 1;
+    }
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+    {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    size_t size = 4 + message;
+    char *frame = malloc(size);
+    uint32_t header = htonl((uint32_t)message);
+    memcpy(frame, &header, 4);
+    for (size_t i = 0; i < message; i++)
+    {
+        frame[4 + i] = (char)('a' + i % 26);
+    }
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "%s: not an IPv4 address\n", host);
+        return 1;
+    }
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC), failed = 0;
+    struct connection *conns = calloc(connections, sizeof(*conns));
+    struct epoll_event events[MAX_EVENTS];
+    for (int i = 0; i < connections; i++)
+    {
+        struct connection *c = &conns[i];
+        int one = 1;
+        c->fd = socket(AF_INET, SOCK_STREAM, 0);
+        // connect blocking: simpler, and fast on loopback
+        if (c->fd < 0 ||
+            connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            if (failed == 0)
+            {
+                perror("connect");
+            }
+            if (c->fd >= 0)
+            {
+                close(c->fd);
+            }
+            c->fd = -1;
+            failed++;
+            continue;
+        }
+        setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) | O_NONBLOCK);
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+        c->events = EPOLLIN;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+    }
+
+    uint64_t begin = now_ns(), deadline = begin + seconds * 1000000000ull;
+    for (int i = 0; i < connections; i++)
+    {
+        if (conns[i].fd < 0)
+        {
+            continue;
+        }
+        for (int k = 0; k < depth; k++)
+        {
+            issue(&conns[i]);
+        }
+        if (drive(epfd, &conns[i], frame, size, deadline) != 0)
+        {
+            close(conns[i].fd);
+            conns[i].fd = -1;
+            failed++;
+        }
+    }
+
+    int active = connections - failed;
+    while (active > 0)
+    {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 1000);
+        for (int i = 0; i < n; i++)
+        {
+            struct connection *c = events[i].data.ptr;
+            if (drive(epfd, c, frame, size, deadline) != 0)
+            {
+                close(c->fd);
+                c->fd = -1;
+                failed++;
+            }
+        }
+        // connections done once their last request came back
+        active = 0;
+        for (int i = 0; i < connections; i++)
+        {
+            active += conns[i].fd >= 0 && conns[i].inflight > 0;
+        }
+        if (now_ns() > deadline + 10000000000ull)
+        {
+            break;  // the server stopped answering
+        }
+    }
+    double elapsed = (now_ns() - begin) / 1e9;
+
+    printf("%d connections (%d failed), %zu-byte messages, depth %d\n",
+           connections, failed, message, depth);
+    if (samples.count)
+    {
+        double sum = 0;
+        qsort(samples.ns, samples.count, sizeof(uint64_t), compare_ns);
+        for (size_t i = 0; i < samples.count; i++)
+        {
+            sum += samples.ns[i];
+        }
+        printf("%zu requests in %.2f s: %.0f requests/s\n", samples.count,
+               elapsed, samples.count / elapsed);
+        printf("latency (us): mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, "
+               "p99.9 %.1f, max %.1f\n",
+               sum / samples.count / 1e3, percentile(0.5), percentile(0.9),
+               percentile(0.99), percentile(0.999), percentile(1));
+    }
+
+    for (int i = 0; i < connections; i++)
+    {
+        if (conns[i].fd >= 0)
+        {
+            close(conns[i].fd);
+        }
+    }
+    free(conns);
+    free(frame);
+    free(samples.ns);
+    close(epfd);
+    return failed == connections;
+}
+
+#else
+/**
+ * @brief Main function
+ * @returns 1: epoll is only available on Linux
+ */
+int main()
+{
+    fprintf(stderr, "epoll_load_client needs Linux\n");
+    return 1;
+}
+#endif
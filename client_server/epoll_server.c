@@ -0,0 +1,511 @@
+/**
+ * @file
+ * @brief Event-driven TCP echo server handling thousands of clients in one
+ * process with [epoll](https://man7.org/linux/man-pages/man7/epoll.7.html)
+ * @see epoll_load_client.c, server.c
+ *
+ * @details
+ * server.c and tcp_full_duplex_server.c serve a single client with
+ * blocking reads and writes. Here every socket is non-blocking, and a single
+ * loop (a reactor) waits for all of them with `epoll_wait`, and only reads
+ * or writes the sockets that are ready.
+ *
+ * Messages are framed by their length, 4 bytes in network byte order, so
+ * that they can arrive in any number of pieces. Each connection owns an
+ * input and an output ring buffer: bytes read go to the first, complete
+ * messages are echoed into the second, which is written when the socket
+ * accepts it. A client which does not read its replies fills its output
+ * ring; the server then stops echoing its messages, its input ring fills
+ * and the server stops reading it, until the replies drain. TCP flow control
+ * then slows down the client: this is back-pressure, and the memory of a
+ * connection stays bounded whatever its peer does.
+ *
+ * epoll is specific to Linux; elsewhere the program only says so.
+ */
+#define _GNU_SOURCE  /// for accept4()
+#include <stdio.h>   /// for printf() and perror()
+#include <stdlib.h>  /// for malloc(), free() and strtol()
+#include <string.h>  /// for memcpy() and strcmp()
+
+#ifdef __linux__
+#include <arpa/inet.h>     /// for htonl() and ntohl()
+#include <assert.h>        /// for assert
+#include <errno.h>         /// for errno
+#include <netinet/in.h>    /// for sockaddr_in
+#include <netinet/tcp.h>   /// for TCP_NODELAY
+#include <signal.h>        /// for sigaction()
+#include <stdint.h>        /// for uint32_t
+#include <sys/epoll.h>     /// for epoll_create1(), epoll_ctl(), epoll_wait()
+#include <sys/resource.h>  /// for setrlimit()
+#include <sys/socket.h>    /// for socket(), bind(), listen(), accept4()
+#include <sys/uio.h>       /// for readv() and writev()
+#include <unistd.h>        /// for close()
+
+#define PORT 8080           ///< default port
+#define RING_SIZE 16384     ///< bytes of each ring buffer, a power of 2
+#define MAX_MESSAGE 8192    ///< largest message, without its length
+#define MAX_EVENTS 256      ///< events handled per call to epoll_wait()
+
+/**
+ * @brief Ring buffer: the bytes from `head` to `tail`, modulo RING_SIZE,
+ * are used. Both only grow, their difference being the number of bytes.
+ */
+struct ring
+{
+    char *data;   ///< RING_SIZE bytes
+    size_t head;  ///< position of the first byte
+    size_t tail;  ///< position after the last byte
+};
+
+/** @brief A client connection */
+struct connection
+{
+    int fd;              ///< its socket
+    uint32_t events;     ///< events it waits for
+    int closing;         ///< set when the client has closed its side
+    struct ring in;      ///< bytes read but not yet handled
+    struct ring out;     ///< replies not yet written
+};
+
+/** @brief Counters printed when the server stops */
+static struct
+{
+    unsigned long accepted, open, messages, rejected;
+    unsigned long long bytes_in, bytes_out;
+} stats;
+
+static volatile sig_atomic_t stop = 0;  ///< set by SIGINT and SIGTERM
+
+/**
+ * @brief Number of bytes used in a ring
+ * @param r the ring
+ * @returns the number of bytes
+ */
+static size_t ring_used(const struct ring *r) { return r->tail - r->head; }
+
+/**
+ * @brief Describes the free space of a ring, which may wrap around the end
+ * of its array, as up to two pieces for readv()
+ * @param r the ring
+ * @param iov receives the pieces
+ * @returns the number of pieces, 0 if the ring is full
+ */
+static int ring_free_iov(struct ring *r, struct iovec iov[2])
+{
+    size_t free = RING_SIZE - ring_used(r), at = r->tail % RING_SIZE;
+    size_t first = RING_SIZE - at < free ? RING_SIZE - at : free;
+    iov[0].iov_base = r->data + at;
+    iov[0].iov_len = first;
+    iov[1].iov_base = r->data;
+    iov[1].iov_len = free - first;
+    return free == 0 ? 0 : free > first ? 2 : 1;
+}
+
+/**
+ * @brief Describes the used bytes of a ring as up to two pieces for
+ * writev()
+ * @param r the ring
+ * @param iov receives the pieces
+ * @returns the number of pieces, 0 if the ring is empty
+ */
+static int ring_used_iov(struct ring *r, struct iovec iov[2])
+{
+    size_t used = ring_used(r), at = r->head % RING_SIZE;
+    size_t first = RING_SIZE - at < used ? RING_SIZE - at : used;
+    iov[0].iov_base = r->data + at;
+    iov[0].iov_len = first;
+    iov[1].iov_base = r->data;
+    iov[1].iov_len = used - first;
+    return used == 0 ? 0 : used > first ? 2 : 1;
+}
+
+/**
+ * @brief Copies bytes from the start of a ring without removing them
+ * @param r the ring
+ * @param dst where to copy
+ * @param n number of bytes, at most ring_used()
+ * @returns void
+ */
+static void ring_peek(const struct ring *r, void *dst, size_t n)
+{
+    size_t at = r->head % RING_SIZE;
+    size_t first = RING_SIZE - at < n ? RING_SIZE - at : n;
+    memcpy(dst, r->data + at, first);
+    memcpy((char *)dst + first, r->data, n - first);
+}
+
+/**
+ * @brief Appends bytes to a ring
+ * @param r the ring
+ * @param src bytes to append
+ * @param n number of bytes, at most the free space
+ * @returns void
+ */
+static void ring_put(struct ring *r, const void *src, size_t n)
+{
+    size_t at = r->tail % RING_SIZE;
+    size_t first = RING_SIZE - at < n ? RING_SIZE - at : n;
+    memcpy(r->data + at, src, first);
+    memcpy(r->data, (const char *)src + first, n - first);
+    r->tail += n;
+}
+
+/**
+ * @brief Moves bytes from the start of a ring to the end of another,
+ * without an intermediate copy
+ * @param dst the ring receiving the bytes
+ * @param src the ring giving them
+ * @param n number of bytes
+ * @returns void
+ */
+static void ring_move(struct ring *dst, struct ring *src, size_t n)
+{
+    struct iovec iov[2];
+    ring_used_iov(src, iov);
+    if (iov[0].iov_len >= n)
+    {
+        ring_put(dst, iov[0].iov_base, n);
+    }
+    else
+    {
+        ring_put(dst, iov[0].iov_base, iov[0].iov_len);
+        ring_put(dst, iov[1].iov_base, n - iov[0].iov_len);
+    }
+    src->head += n;
+}
+
+/**
+ * @brief Echoes the complete messages of the input ring while the output
+ * ring has room for them
+ * @param c the connection
+ * @returns 0, or -1 if a message is longer than MAX_MESSAGE
+ */
+static int handle_messages(struct connection *c)
+{
+    uint32_t header;
+    while (ring_used(&c->in) >= sizeof(header))
+    {
+        ring_peek(&c->in, &header, sizeof(header));
+        size_t length = ntohl(header);
+        if (length > MAX_MESSAGE)
+        {
+            return -1;
+        }
+        if (ring_used(&c->in) < sizeof(header) + length ||
+            RING_SIZE - ring_used(&c->out) < sizeof(header) + length)
+        {
+            break;  // incomplete, or no room for the reply yet
+        }
+        ring_move(&c->out, &c->in, sizeof(header) + length);
+        stats.messages++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Closes a connection and frees it
+ * @param c the connection
+ * @returns void
+ */
+static void close_connection(struct connection *c)
+{
+    close(c->fd);  // also removes it from the epoll set
+    free(c->in.data);
+    free(c);
+    stats.open--;
+}
+
+/**
+ * @brief Reads, echoes and writes what a connection allows without
+ * blocking, then updates the events it waits for
+ * @param epfd the epoll instance
+ * @param c the connection
+ * @returns 0, or -1 if the connection was closed
+ */
+static int serve(int epfd, struct connection *c)
+{
+    struct iovec iov[2];
+    int progress = 1, pieces;
+
+    while (progress)
+    {
+        progress = 0;
+        // read while there is room: a full ring is back-pressure
+        while (!c->closing && (pieces = ring_free_iov(&c->in, iov)) > 0)
+        {
+            ssize_t n = readv(c->fd, iov, pieces);
+            if (n > 0)
+            {
+                c->in.tail += n;
+                stats.bytes_in += n;
+                progress = 1;
+            }
+            else if (n == 0)
+            {
+                c->closing = 1;
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            else if (errno != EINTR)
+            {
+                close_connection(c);
+                return -1;
+            }
+        }
+        if (handle_messages(c) != 0)
+        {
+            stats.rejected++;
+            close_connection(c);
+            return -1;
+        }
+        while ((pieces = ring_used_iov(&c->out, iov)) > 0)
+        {
+            ssize_t n = writev(c->fd, iov, pieces);
+            if (n > 0)
+            {
+                c->out.head += n;
+                stats.bytes_out += n;
+                progress = 1;  // room for more replies
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            else if (errno != EINTR)
+            {
+                close_connection(c);
+                return -1;
+            }
+        }
+    }
+
+    if (c->closing && ring_used(&c->out) == 0)
+    {
+        close_connection(c);  // what is left in `in` cannot be answered
+        return -1;
+    }
+    uint32_t events = (!c->closing && ring_used(&c->in) < RING_SIZE
+                           ? EPOLLIN
+                           : 0) |
+                      (ring_used(&c->out) ? EPOLLOUT : 0);
+    if (events != c->events)
+    {
+        struct epoll_event ev = {.events = events, .data.ptr = c};
+        c->events = events;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    }
+    return 0;
+}
+
+/**
+ * @brief Accepts all the pending connections
+ * @param epfd the epoll instance
+ * @param listenfd the listening socket
+ * @returns void
+ */
+static void accept_all(int epfd, int listenfd)
+{
+    for (;;)
+    {
+        int fd = accept4(listenfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EMFILE || errno == ENFILE)
+            {
+                perror("accept");  // try again at the next event
+            }
+            return;
+        }
+        struct connection *c = calloc(1, sizeof(*c));
+        char *data = malloc(2 * RING_SIZE);
+        if (c == NULL || data == NULL)
+        {
+            free(c);
+            free(data);
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        c->fd = fd;
+        c->in.data = data;
+        c->out.data = data + RING_SIZE;
+        c->events = EPOLLIN;
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            close(fd);
+            free(data);
+            free(c);
+            continue;
+        }
+        stats.accepted++;
+        stats.open++;
+    }
+}
+
+/**
+ * @brief Signal handler asking the event loop to stop
+ * @param signum ignored
+ * @returns void
+ */
+static void on_signal(int signum)
+{
+    (void)signum;
+    stop = 1;
+}
+
+/**
+ * @brief Self-test of the ring buffers and the framing
+ * @returns void
+ */
+static void test()
+{
+    struct connection c = {0};
+    char *data = malloc(2 * RING_SIZE), message[MAX_MESSAGE + 4];
+    struct iovec iov[2];
+    uint32_t header = htonl(MAX_MESSAGE);
+
+    c.in.data = data;
+    c.out.data = data + RING_SIZE;
+    // a message wrapping around the end of both rings
+    c.in.head = c.in.tail = c.out.head = c.out.tail = RING_SIZE - 5;
+    memcpy(message, &header, 4);
+    for (int i = 0; i < MAX_MESSAGE; i++)
+    {
+        message[4 + i] = (char)(i * 7);
+    }
+    ring_put(&c.in, message, 3);  // the header arrives in two pieces
+    assert(handle_messages(&c) == 0 && ring_used(&c.out) == 0);
+    assert(ring_free_iov(&c.in, iov) == 2);
+    ring_put(&c.in, message + 3, sizeof(message) - 3);
+    assert(handle_messages(&c) == 0);
+    assert(ring_used(&c.in) == 0 && ring_used(&c.out) == sizeof(message));
+    assert(ring_used_iov(&c.out, iov) == 2 && iov[0].iov_len == 5);
+    char copy[sizeof(message)];
+    ring_peek(&c.out, copy, sizeof(copy));
+    assert(memcmp(copy, message, sizeof(message)) == 0);
+
+    // no room for a second reply: it waits in the input ring
+    ring_put(&c.in, message, sizeof(message));
+    assert(handle_messages(&c) == 0 && ring_used(&c.in) == sizeof(message));
+    c.out.head = c.out.tail;
+    assert(handle_messages(&c) == 0 && ring_used(&c.in) == 0);
+
+    // messages too long are refused
+    header = htonl(MAX_MESSAGE + 1);
+    ring_put(&c.in, &header, 4);
+    assert(handle_messages(&c) == -1);
+    free(data);
+    stats.messages = 0;
+}
+
+/**
+ * @brief Main function: `epoll_server [port]`
+ * @returns 0 on exit
+ */
+int main(int argc, char **argv)
+{
+    int port = argc > 1 ? (int)strtol(argv[1], NULL, 10) : PORT;
+    struct sigaction sa;
+    struct rlimit rl;
+
+    test();  // run self-test implementations
+
+    // one descriptor per client: allow as many as the hard limit
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+    {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);  // errors come from writev() instead
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    int listenfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0), one = 1;
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (listenfd < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(listenfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listenfd, SOMAXCONN) != 0)
+    {
+        perror("listen");
+        return 1;
+    }
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    struct epoll_event events[MAX_EVENTS];
+    if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, listenfd, &ev) != 0)
+    {
+        perror("epoll");
+        return 1;
+    }
+    // the limit in force, whether or not raising it worked
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0)
+    {
+        printf("Echo server listening on port %d (max file descriptors %lu)\n",
+               port, (unsigned long)rl.rlim_cur);
+    }
+    else
+    {
+        printf("Echo server listening on port %d\n", port);
+    }
+
+    while (!stop)
+    {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n < 0 && errno != EINTR)
+        {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            struct connection *c = events[i].data.ptr;
+            if (c == NULL)
+            {
+                accept_all(epfd, listenfd);
+            }
+            else
+            {
+                // EPOLLERR and EPOLLHUP too: serve() still sends the replies
+                // it can and closes the connection when readv() or writev()
+                // report the error
+                serve(epfd, c);
+            }
+        }
+    }
+
+    printf("\n%lu connections (%lu open), %lu messages, %llu bytes in, "
+           "%llu bytes out, %lu protocol errors\n",
+           stats.accepted, stats.open, stats.messages, stats.bytes_in,
+           stats.bytes_out, stats.rejected);
+    close(epfd);
+    close(listenfd);
+    return 0;
+}
+
+#else
+/**
+ * @brief Main function
+ * @returns 1: epoll is only available on Linux
+ */
+int main()
+{
+    fprintf(stderr, "epoll_server needs Linux\n");
+    return 1;
+}
+#endif
@@ -0,0 +1,255 @@
+/**
+ * @file
+ * @brief Protocol shared by file_transfer_client.c and
+ * file_transfer_server.c: message layout, chunk checksums, and complete
+ * reads and writes on sockets
+ *
+ * @details
+ * A transfer is a conversation on one TCP connection:
+ *
+ * 1. the client sends a header: `FXF1`, the receive mode, the chunk size,
+ * the file size and the length of the name, then the name;
+ * 2. the server answers with the number of whole chunks it already has of
+ * that file, from an interrupted transfer, followed by their checksums;
+ * 3. the client compares them with its own, and sends the offset from which
+ * it sends, the first chunk which differs, then the rest of the file;
+ * 4. the client sends the checksums of all the chunks, and the server
+ * answers with the number of bytes it verified. When that is the file size
+ * the file is complete, otherwise the server keeps the verified prefix, and
+ * sending again resumes there.
+ *
+ * Integers are 64-bit big-endian. The checksum of a chunk is XXH64 with
+ * seed 0, which reads 32 bytes per round, so it costs little next to the
+ * transfer, and chunks are independent so that they can be checked in
+ * parallel.
+ */
+#ifndef FILE_TRANSFER_H
+#define FILE_TRANSFER_H
+
+#include <errno.h>   /// for errno
+#include <stdint.h>  /// for uint64_t
+#include <string.h>  /// for memcpy()
+#include <unistd.h>  /// for read() and write()
+
+#define FT_PORT 8081                ///< default port
+#define FT_MAGIC "FXF1"             ///< first bytes of a header
+#define FT_CHUNK (4u << 20)         ///< default chunk size
+#define FT_MIN_CHUNK (64u << 10)    ///< smallest chunk size
+#define FT_MAX_CHUNK (64u << 20)    ///< largest chunk size
+#define FT_MAX_NAME 255             ///< longest file name
+#define FT_RECEIVE_READ 0    ///< receiver reads into an aligned buffer
+#define FT_RECEIVE_SPLICE 1  ///< receiver splices the socket into the file
+#define FT_DISCARD 0x100     ///< receiver deletes the file once verified
+
+/** @brief Header of a transfer, as sent after FT_MAGIC */
+struct ft_header
+{
+    uint64_t mode;   ///< FT_RECEIVE_READ or FT_RECEIVE_SPLICE, | FT_DISCARD
+    uint64_t chunk;  ///< chunk size, a power of 2
+    uint64_t size;   ///< file size
+    uint64_t name;   ///< length of the name which follows
+};
+
+/**
+ * @brief Byte order of the host
+ * @returns 1 if little-endian
+ */
+static inline int ft_little_endian()
+{
+    const uint16_t probe = 1;
+    return *(const uint8_t *)&probe;
+}
+
+/**
+ * @brief Converts between host and network order
+ * @param x a 64-bit integer
+ * @returns `x` with its bytes reversed on little-endian hosts
+ */
+static inline uint64_t ft_swap(uint64_t x)
+{
+    return ft_little_endian() ? __builtin_bswap64(x) : x;
+}
+
+/**
+ * @brief Writes all of a buffer, despite short writes and signals
+ * @param fd a socket or a file
+ * @param data the bytes
+ * @param n number of bytes
+ * @returns 0, or -1 on error
+ */
+static inline int ft_write_all(int fd, const void *data, size_t n)
+{
+    const char *p = data;
+    while (n > 0)
+    {
+        ssize_t k = write(fd, p, n);
+        if (k < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (k <= 0)
+        {
+            return -1;
+        }
+        p += k;
+        n -= k;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads exactly `n` bytes, despite short reads and signals
+ * @param fd a socket or a file
+ * @param data receives the bytes
+ * @param n number of bytes
+ * @returns 0, or -1 on error or end of file
+ */
+static inline int ft_read_all(int fd, void *data, size_t n)
+{
+    char *p = data;
+    while (n > 0)
+    {
+        ssize_t k = read(fd, p, n);
+        if (k < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (k <= 0)
+        {
+            return -1;
+        }
+        p += k;
+        n -= k;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sends 64-bit integers in network order
+ * @param fd the socket
+ * @param values the integers
+ * @param count how many
+ * @returns 0, or -1 on error
+ */
+static inline int ft_send_u64(int fd, const uint64_t *values, size_t count)
+{
+    uint64_t buffer[512];
+    while (count > 0)
+    {
+        size_t k = count < 512 ? count : 512;
+        for (size_t i = 0; i < k; i++)
+        {
+            buffer[i] = ft_swap(values[i]);
+        }
+        if (ft_write_all(fd, buffer, k * sizeof(uint64_t)) != 0)
+        {
+            return -1;
+        }
+        values += k;
+        count -= k;
+    }
+    return 0;
+}
+
+/**
+ * @brief Receives 64-bit integers in network order
+ * @param fd the socket
+ * @param values receives the integers
+ * @param count how many
+ * @returns 0, or -1 on error
+ */
+static inline int ft_receive_u64(int fd, uint64_t *values, size_t count)
+{
+    if (ft_read_all(fd, values, count * sizeof(uint64_t)) != 0)
+    {
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        values[i] = ft_swap(values[i]);
+    }
+    return 0;
+}
+
+#define FT_P1 11400714785074694791ULL  ///< primes of XXH64
+#define FT_P2 14029467366897019727ULL
+#define FT_P3 1609587929392839161ULL
+#define FT_P4 9650029242287828579ULL
+#define FT_P5 2870177450012600261ULL
+
+/** @brief Rotates left */
+static inline uint64_t ft_rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/** @brief Little-endian 64-bit word at `p` */
+static inline uint64_t ft_read64(const unsigned char *p)
+{
+    uint64_t x;
+    memcpy(&x, p, 8);
+    return ft_little_endian() ? x : __builtin_bswap64(x);
+}
+
+/** @brief One round of XXH64 on a lane */
+static inline uint64_t ft_round(uint64_t acc, uint64_t input)
+{
+    return ft_rotl(acc + input * FT_P2, 31) * FT_P1;
+}
+
+/**
+ * @brief XXH64 checksum with seed 0
+ * @param data the bytes
+ * @param n number of bytes
+ * @returns the checksum
+ */
+static inline uint64_t ft_checksum(const void *data, size_t n)
+{
+    const unsigned char *p = data, *end = p + n;
+    uint64_t h;
+
+    if (n >= 32)
+    {
+        uint64_t v1 = FT_P1 + FT_P2, v2 = FT_P2, v3 = 0, v4 = -FT_P1;
+        for (; end - p >= 32; p += 32)
+        {
+            v1 = ft_round(v1, ft_read64(p));
+            v2 = ft_round(v2, ft_read64(p + 8));
+            v3 = ft_round(v3, ft_read64(p + 16));
+            v4 = ft_round(v4, ft_read64(p + 24));
+        }
+        h = ft_rotl(v1, 1) + ft_rotl(v2, 7) + ft_rotl(v3, 12) +
+            ft_rotl(v4, 18);
+        h = (h ^ ft_round(0, v1)) * FT_P1 + FT_P4;
+        h = (h ^ ft_round(0, v2)) * FT_P1 + FT_P4;
+        h = (h ^ ft_round(0, v3)) * FT_P1 + FT_P4;
+        h = (h ^ ft_round(0, v4)) * FT_P1 + FT_P4;
+    }
+    else
+    {
+        h = FT_P5;
+    }
+    h += n;
+    for (; end - p >= 8; p += 8)
+    {
+        h = ft_rotl(h ^ ft_round(0, ft_read64(p)), 27) * FT_P1 + FT_P4;
+    }
+    if (end - p >= 4)
+    {
+        uint64_t w = p[0] | p[1] << 8 | p[2] << 16 | (uint64_t)p[3] << 24;
+        h = ft_rotl(h ^ w * FT_P1, 23) * FT_P2 + FT_P3;
+        p += 4;
+    }
+    for (; p < end; p++)
+    {
+        h = ft_rotl(h ^ *p * FT_P5, 11) * FT_P1;
+    }
+    h ^= h >> 33;
+    h *= FT_P2;
+    h ^= h >> 29;
+    h *= FT_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+#endif /* FILE_TRANSFER_H */
@@ -0,0 +1,466 @@
+/**
+ * @file
+ * @brief Sending side of a resumable file transfer over TCP, with
+ * `read`/`write`, `mmap` or `sendfile`, and a loopback benchmark of these
+ * against the two receive modes of file_transfer_server.c
+ * @see file_transfer_server.c, file_transfer.h, client.c
+ *
+ * @details
+ * client.c sends lines typed by the user; this client sends a file, with
+ * the protocol of file_transfer.h, and resumes an interrupted transfer from
+ * the first chunk the server does not have. The bytes go from the file to
+ * the socket by one of:
+ * - `read`: `pread()` into a 1 MiB page-aligned buffer, then `write()`;
+ * - `mmap`: `write()` straight from a mapping of the file, one copy fewer;
+ * - `sendfile`: the kernel moves the pages from the page cache to the
+ * socket, and the data never reaches user space.
+ *
+ * The checksums of the chunks are computed beforehand on a mapping of the
+ * file, in parallel when OpenMP is available, which also brings the file
+ * into the page cache; the throughput reported is that of the transfer
+ * itself, from the resume offset to the server's verdict.
+ *
+ * `file_transfer_client [-h host] [-p port] [-m read|mmap|sendfile]
+ * [-r read|splice] [-c chunk bytes] [-k stop after bytes] file` sends a
+ * file; `-k` interrupts the transfer, to try resuming it.
+ *
+ * `file_transfer_client [-h host] [-p port] -b GiB [-t directory]` writes a
+ * file of that size in the directory, /tmp by default, and sends it with
+ * each pair of modes; the server deletes its copies once verified.
+ */
+#define _GNU_SOURCE  /// for sendfile() and the POSIX functions under -std=c11
+#include <stdio.h>   /// for printf() and perror()
+#include <stdlib.h>  /// for malloc() and strtod()
+#include <string.h>  /// for strcmp() and strrchr()
+
+#ifdef __linux__
+#include <arpa/inet.h>     /// for htons() and inet_pton()
+#include <assert.h>        /// for assert()
+#include <fcntl.h>         /// for open()
+#include <netinet/in.h>    /// for sockaddr_in
+#include <signal.h>        /// for signal()
+#include <sys/mman.h>      /// for mmap() and madvise()
+#include <sys/sendfile.h>  /// for sendfile()
+#include <sys/socket.h>    /// for socket() and connect()
+#include <sys/stat.h>      /// for fstat()
+#include <time.h>          /// for clock_gettime()
+
+#include "file_transfer.h"
+
+#define BUFFER (1u << 20)  ///< bytes per read() in `read` mode
+
+/** @brief How the client sends */
+enum send_mode
+{
+    SEND_READ,     ///< pread() and write()
+    SEND_MMAP,     ///< write() from a mapping
+    SEND_SENDFILE  ///< sendfile()
+};
+
+static const char *const send_names[] = {"read", "mmap", "sendfile"};
+static const char *const receive_names[] = {"read", "splice"};
+
+/** @brief Outcome of a transfer */
+struct result
+{
+    uint64_t offset;     ///< where the transfer resumed
+    uint64_t verified;   ///< bytes the server verified
+    double checksum;     ///< seconds computing the checksums
+    double transfer;     ///< seconds of the transfer
+};
+
+/**
+ * @brief Current time
+ * @returns seconds of CLOCK_MONOTONIC
+ */
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Sends part of a file with the mode chosen
+ * @param sock the socket
+ * @param fd the file
+ * @param map a mapping of the whole file
+ * @param offset first byte sent
+ * @param end byte after the last one sent
+ * @param mode how to send
+ * @returns 0, or -1 on error
+ */
+static int send_range(int sock, int fd, const unsigned char *map,
+                      uint64_t offset, uint64_t end, enum send_mode mode)
+{
+    if (mode == SEND_SENDFILE)
+    {
+        off_t position = offset;
+        while ((uint64_t)position < end)
+        {
+            uint64_t left = end - position;
+            ssize_t n = sendfile(sock, fd, &position,
+                                 left < (1u << 30) ? left : (1u << 30));
+            if (n <= 0 && !(n < 0 && errno == EINTR))
+            {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    if (mode == SEND_MMAP)
+    {
+        return ft_write_all(sock, map + offset, end - offset);
+    }
+
+    void *buffer;
+    int status = 0;
+    if (posix_memalign(&buffer, 4096, BUFFER) != 0)
+    {
+        return -1;
+    }
+    while (offset < end && status == 0)
+    {
+        ssize_t n = pread(fd, buffer,
+                          end - offset < BUFFER ? end - offset : BUFFER,
+                          offset);
+        status = n <= 0 ? -1 : ft_write_all(sock, buffer, n);
+        offset += n > 0 ? n : 0;
+    }
+    free(buffer);
+    return status;
+}
+
+/**
+ * @brief Sends a file, resuming where the server stopped receiving it
+ * @param addr the server
+ * @param path the file
+ * @param name name under which the server saves it
+ * @param mode how to send
+ * @param receive FT_RECEIVE_READ or FT_RECEIVE_SPLICE, | FT_DISCARD
+ * @param chunk chunk size
+ * @param stop interrupt after sending so many bytes, 0 for never
+ * @param r receives the outcome
+ * @returns 0 if the server verified the whole file, otherwise -1
+ */
+static int send_file(const struct sockaddr_in *addr, const char *path,
+                     const char *name, enum send_mode mode, int receive,
+                     uint64_t chunk, uint64_t stop, struct result *r)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC), status = -1, sock = -1;
+    uint64_t *sums = NULL, *theirs = NULL, size = 0;
+    unsigned char *map = NULL;
+
+    memset(r, 0, sizeof(*r));
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        perror(path);
+        goto done;
+    }
+    size = st.st_size;
+    uint64_t chunks = (size + chunk - 1) / chunk;
+    if (size > 0)
+    {
+        map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            map = NULL;
+            perror("mmap");
+            goto done;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+    }
+
+    double start = now();
+    sums = malloc((chunks + 1) * sizeof(uint64_t));
+    theirs = malloc((chunks + 1) * sizeof(uint64_t));
+    if (sums == NULL || theirs == NULL)
+    {
+        goto done;
+    }
+    long long n = (long long)chunks;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (long long i = 0; i < n; i++)
+    {
+        uint64_t begin = i * chunk;
+        uint64_t length = size - begin < chunk ? size - begin : chunk;
+        sums[i] = ft_checksum(map + begin, length);
+    }
+    r->checksum = now() - start;
+
+    uint64_t header[4] = {receive, chunk, size, strlen(name)}, have;
+    sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0 ||
+        connect(sock, (const struct sockaddr *)addr, sizeof(*addr)) != 0)
+    {
+        perror("connect");
+        goto done;
+    }
+    if (ft_write_all(sock, FT_MAGIC, 4) != 0 ||
+        ft_send_u64(sock, header, 4) != 0 ||
+        ft_write_all(sock, name, header[3]) != 0 ||
+        ft_receive_u64(sock, &have, 1) != 0 || have > chunks ||
+        ft_receive_u64(sock, theirs, have) != 0)
+    {
+        fprintf(stderr, "%s: refused by the server\n", name);
+        goto done;
+    }
+
+    // resume at the first chunk which the server lacks or got wrong
+    uint64_t i = 0;
+    while (i < have && theirs[i] == sums[i])
+    {
+        i++;
+    }
+    r->offset = i * chunk < size ? i * chunk : size;
+    uint64_t end = stop && r->offset + stop < size ? r->offset + stop : size;
+
+    start = now();
+    if (ft_send_u64(sock, &r->offset, 1) != 0 ||
+        send_range(sock, fd, map, r->offset, end, mode) != 0)
+    {
+        perror("send");
+        goto done;
+    }
+    if (end < size)
+    {
+        fprintf(stderr, "%s: stopped after %llu bytes\n", name,
+                (unsigned long long)end);
+        goto done;
+    }
+    if (ft_send_u64(sock, sums, chunks) != 0 ||
+        ft_receive_u64(sock, &r->verified, 1) != 0)
+    {
+        fprintf(stderr, "%s: no verdict from the server\n", name);
+        goto done;
+    }
+    r->transfer = now() - start;
+    status = r->verified == size ? 0 : -1;
+
+done:
+    if (sock >= 0)
+    {
+        close(sock);
+    }
+    if (map != NULL)
+    {
+        munmap(map, size);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    free(sums);
+    free(theirs);
+    return status;
+}
+
+/**
+ * @brief Writes a file of pseudo-random bytes for the benchmark
+ * @param path the file
+ * @param size its size
+ * @returns 0, or -1 on error
+ */
+static int make_file(const char *path, uint64_t size)
+{
+    uint64_t *block = malloc(BUFFER), x = 88172645463325252ull;
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    int status = block != NULL && fd >= 0 ? 0 : -1;
+
+    for (uint64_t done = 0; done < size && status == 0; done += BUFFER)
+    {
+        // xorshift64, so that no two chunks are alike
+        for (size_t i = 0; i < BUFFER / sizeof(uint64_t); i++)
+        {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            block[i] = x;
+        }
+        status = ft_write_all(fd, block,
+                              size - done < BUFFER ? size - done : BUFFER);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    free(block);
+    return status;
+}
+
+/**
+ * @brief Sends a large file with each pair of send and receive modes
+ * @param addr the server
+ * @param gib size of the file in GiB
+ * @param directory where to write the file
+ * @returns 0, or 1 on error
+ */
+static int benchmark(const struct sockaddr_in *addr, double gib,
+                     const char *directory)
+{
+    char path[4096];
+    uint64_t size = (uint64_t)(gib * (1ull << 30));
+    int failed = 0;
+
+    snprintf(path, sizeof(path), "%s/file_transfer_bench.%d", directory,
+             (int)getpid());
+    printf("writing %.2f GiB to %s\n", size / (double)(1ull << 30), path);
+    fflush(stdout);
+    if (make_file(path, size) != 0)
+    {
+        perror(path);
+        unlink(path);
+        return 1;
+    }
+
+    printf("%-9s %-7s %10s %10s %12s\n", "send", "receive", "seconds",
+           "MB/s", "checksum s");
+    for (int receive = FT_RECEIVE_READ; receive <= FT_RECEIVE_SPLICE;
+         receive++)
+    {
+        for (int mode = SEND_READ; mode <= SEND_SENDFILE; mode++)
+        {
+            struct result r;
+            if (send_file(addr, path, strrchr(path, '/') + 1, mode,
+                          receive | FT_DISCARD, FT_CHUNK, 0, &r) != 0)
+            {
+                failed = 1;
+                continue;
+            }
+            printf("%-9s %-7s %10.2f %10.1f %12.2f\n", send_names[mode],
+                   receive_names[receive], r.transfer,
+                   size / 1e6 / r.transfer, r.checksum);
+            fflush(stdout);
+        }
+    }
+    unlink(path);
+    return failed;
+}
+
+/**
+ * @brief Self-test of the checksum and of the byte order
+ * @returns void
+ */
+static void test()
+{
+    unsigned char bytes[100];
+    for (int i = 0; i < 100; i++)
+    {
+        bytes[i] = (unsigned char)i;
+    }
+    // reference values of XXH64 with seed 0
+    assert(ft_checksum("", 0) == 0xef46db3751d8e999ull);
+    assert(ft_checksum("abc", 3) == 0x44bc2cf5ad770999ull);
+    assert(ft_checksum(bytes, 100) == 0x6ac1e58032166597ull);
+    assert(ft_swap(ft_swap(0x0102030405060708ull)) == 0x0102030405060708ull);
+    assert(htonl(1) != 1 || ft_swap(42) == 42);
+}
+
+/**
+ * @brief Main function
+ * @returns 0 on exit
+ */
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1", *path = NULL, *directory = "/tmp";
+    int port = FT_PORT, mode = SEND_SENDFILE, receive = FT_RECEIVE_SPLICE;
+    uint64_t chunk = FT_CHUNK, stop = 0;
+    double gib = 0;
+
+    test();
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-' || i + 1 == argc)
+        {
+            path = argv[i];
+            continue;
+        }
+        const char *value = argv[++i];
+        switch (argv[i - 1][1])
+        {
+        case 'h':
+            host = value;
+            break;
+        case 'p':
+            port = (int)strtol(value, NULL, 10);
+            break;
+        case 'm':
+            mode = strcmp(value, "read") == 0   ? SEND_READ
+                   : strcmp(value, "mmap") == 0 ? SEND_MMAP
+                                                : SEND_SENDFILE;
+            break;
+        case 'r':
+            receive = strcmp(value, "read") == 0 ? FT_RECEIVE_READ
+                                                 : FT_RECEIVE_SPLICE;
+            break;
+        case 'c':
+            chunk = strtoull(value, NULL, 10);
+            break;
+        case 'k':
+            stop = strtoull(value, NULL, 10);
+            break;
+        case 'b':
+            gib = strtod(value, NULL);
+            break;
+        case 't':
+            directory = value;
+            break;
+        }
+    }
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1 ||
+        chunk < FT_MIN_CHUNK || chunk > FT_MAX_CHUNK ||
+        (chunk & (chunk - 1)) != 0 || (path == NULL && gib <= 0))
+    {
+        fprintf(stderr,
+                "usage: %s [-h host] [-p port] [-m read|mmap|sendfile] "
+                "[-r read|splice] [-c chunk] [-k bytes] file\n"
+                "       %s [-h host] [-p port] -b GiB [-t directory]\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    if (gib > 0)
+    {
+        return benchmark(&addr, gib, directory);
+    }
+
+    struct result r;
+    const char *slash = strrchr(path, '/');
+    int status = send_file(&addr, path, slash ? slash + 1 : path, mode,
+                           receive, chunk, stop, &r);
+    if (r.offset > 0)
+    {
+        printf("resumed at byte %llu\n", (unsigned long long)r.offset);
+    }
+    if (status == 0)
+    {
+        printf("%s sent with %s, received with %s: %.2f s\n", path,
+               send_names[mode], receive_names[receive], r.transfer);
+    }
+    else if (r.transfer > 0)
+    {
+        printf("%s: the server verified %llu bytes; send it again to "
+               "resume\n",
+               path, (unsigned long long)r.verified);
+    }
+    return status == 0 ? 0 : 1;
+}
+
+#else
+/**
+ * @brief Main function
+ * @returns 1: sendfile() is only available on Linux
+ */
+int main()
+{
+    fprintf(stderr, "file_transfer_client needs Linux\n");
+    return 1;
+}
+#endif
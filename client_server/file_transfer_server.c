@@ -0,0 +1,389 @@
+/**
+ * @file
+ * @brief Receiving side of a resumable file transfer over TCP, writing
+ * either through an aligned buffer or by splicing the socket into the file
+ * @see file_transfer_client.c, file_transfer.h, server.c
+ *
+ * @details
+ * server.c exchanges short lines; this server receives whole files, with
+ * the protocol of file_transfer.h. Each connection is served by a child
+ * process. A file is received into `<name>.part` in the directory given,
+ * and renamed to `<name>` once all its chunks match the checksums of the
+ * client; an interrupted or corrupted transfer leaves the verified prefix
+ * in `<name>.part`, and sending the file again resumes from there.
+ *
+ * The client chooses how the bytes go from the socket to the file:
+ * - `read`: `read()` into a 1 MiB page-aligned buffer, then `pwrite()`;
+ * each byte is copied twice, through user space;
+ * - `splice`: `splice()` the socket into a pipe, and the pipe into the
+ * file; the pages move inside the kernel and are never copied to user
+ * space.
+ *
+ * Checksums are computed on a mapping of the file, which is still in the
+ * page cache, in parallel over the chunks when OpenMP is available.
+ *
+ * `file_transfer_server [-p port] [-d directory]`. `splice()` is specific to
+ * Linux; elsewhere the program only says so.
+ */
+#define _GNU_SOURCE  /// for splice() and F_SETPIPE_SZ
+#include <stdio.h>   /// for printf() and perror()
+#include <stdlib.h>  /// for malloc() and strtol()
+#include <string.h>  /// for strcmp() and strchr()
+
+#ifdef __linux__
+#include <arpa/inet.h>   /// for htonl()
+#include <fcntl.h>       /// for openat(), splice() and fcntl()
+#include <netinet/in.h>  /// for sockaddr_in
+#include <signal.h>      /// for signal()
+#include <sys/mman.h>    /// for mmap()
+#include <sys/socket.h>  /// for socket(), bind(), listen() and accept()
+#include <sys/stat.h>    /// for fstat()
+#include <time.h>        /// for clock_gettime()
+
+#include "file_transfer.h"
+
+#define BUFFER (1u << 20)         ///< bytes per read() in `read` mode
+#define MAX_CHUNKS (1ull << 24)   ///< most chunks per file
+
+/**
+ * @brief Current time
+ * @returns seconds of CLOCK_MONOTONIC
+ */
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Whether a name is a plain file name, so that the client can only
+ * write in the directory served
+ * @param name the name
+ * @returns 1 if it has no `/` and is neither `.` nor `..`
+ */
+static int safe_name(const char *name)
+{
+    return name[0] != '\0' && strchr(name, '/') == NULL &&
+           strcmp(name, ".") != 0 && strcmp(name, "..") != 0;
+}
+
+/**
+ * @brief Checksums of chunks of a file
+ * @param fd the file
+ * @param chunk chunk size
+ * @param size bytes of the file checked
+ * @param first index of the first chunk
+ * @param count number of chunks
+ * @param sums receives the `count` checksums
+ * @returns 0, or -1 if the file cannot be mapped
+ */
+static int checksums(int fd, uint64_t chunk, uint64_t size, uint64_t first,
+                     uint64_t count, uint64_t *sums)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    unsigned char *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+    long long n = (long long)count;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (long long i = 0; i < n; i++)
+    {
+        uint64_t start = (first + i) * chunk;
+        uint64_t length = size - start < chunk ? size - start : chunk;
+        sums[i] = ft_checksum(map + start, length);
+    }
+    munmap(map, size);
+    return 0;
+}
+
+/**
+ * @brief Receives bytes into a file through a buffer in user space
+ * @param sock the socket
+ * @param fd the file
+ * @param offset where the bytes go in the file
+ * @param left number of bytes
+ * @returns 0, or -1 on error
+ */
+static int receive_read(int sock, int fd, uint64_t offset, uint64_t left)
+{
+    void *buffer;
+    int status = 0;
+
+    // aligned to pages, so that the copies are as cheap as they can be
+    if (posix_memalign(&buffer, 4096, BUFFER) != 0)
+    {
+        return -1;
+    }
+    while (left > 0 && status == 0)
+    {
+        ssize_t n = read(sock, buffer, left < BUFFER ? left : BUFFER);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        for (ssize_t done = 0, k; n > 0 && done < n; done += k)
+        {
+            if ((k = pwrite(fd, (char *)buffer + done, n - done,
+                            offset + done)) <= 0)
+            {
+                status = -1;
+                break;
+            }
+        }
+        status = n <= 0 ? -1 : status;
+        offset += n > 0 ? n : 0;
+        left -= n > 0 ? n : 0;
+    }
+    free(buffer);
+    return status;
+}
+
+/**
+ * @brief Receives bytes into a file without copying them to user space:
+ * socket to pipe, and pipe to file, with splice()
+ * @param sock the socket
+ * @param fd the file
+ * @param offset where the bytes go in the file
+ * @param left number of bytes
+ * @returns 0, or -1 on error
+ */
+static int receive_splice(int sock, int fd, uint64_t offset, uint64_t left)
+{
+    int pipefd[2], failed = 0;
+    loff_t position = offset;
+
+    if (pipe2(pipefd, O_CLOEXEC) != 0)
+    {
+        return -1;
+    }
+    // a larger pipe moves more pages per call
+    int capacity = fcntl(pipefd[1], F_SETPIPE_SZ, BUFFER);
+    if (capacity <= 0)
+    {
+        capacity = 65536;
+    }
+    while (left > 0 && !failed)
+    {
+        ssize_t n = splice(sock, NULL, pipefd[1], NULL,
+                           left < (uint64_t)capacity ? left
+                                                     : (uint64_t)capacity,
+                           SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        left -= n;
+        while (n > 0)
+        {
+            ssize_t k = splice(pipefd[0], NULL, fd, &position, n,
+                               SPLICE_F_MOVE);
+            if (k < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (k <= 0)
+            {
+                failed = 1;
+                break;
+            }
+            n -= k;
+        }
+    }
+    close(pipefd[0]);
+    close(pipefd[1]);
+    return left == 0 && !failed ? 0 : -1;
+}
+
+/**
+ * @brief Serves one transfer
+ * @param sock the connection
+ * @param dir the directory receiving the files
+ * @returns 0 if a file was completed, otherwise -1
+ */
+static int serve(int sock, int dir)
+{
+    char magic[4], name[FT_MAX_NAME + 1], part[FT_MAX_NAME + 6];
+    struct ft_header h;
+    struct stat st;
+
+    // the four fields of the header are contiguous
+    if (ft_read_all(sock, magic, 4) != 0 || memcmp(magic, FT_MAGIC, 4) != 0 ||
+        ft_receive_u64(sock, &h.mode, 4) != 0 || h.name == 0 ||
+        h.name > FT_MAX_NAME || ft_read_all(sock, name, h.name) != 0)
+    {
+        return -1;
+    }
+    name[h.name] = '\0';
+    uint64_t chunk = h.chunk, size = h.size, chunks = 0;
+    int receive = (int)(h.mode & 0xff), discard = (h.mode & FT_DISCARD) != 0;
+    int valid = chunk >= FT_MIN_CHUNK && chunk <= FT_MAX_CHUNK &&
+                (chunk & (chunk - 1)) == 0;
+    if (valid)
+    {
+        chunks = size / chunk + (size % chunk != 0);
+    }
+    if (!valid || !safe_name(name) || strlen(name) != h.name ||
+        chunks > MAX_CHUNKS || receive > FT_RECEIVE_SPLICE)
+    {
+        fprintf(stderr, "rejected transfer of \"%s\"\n", name);
+        return -1;
+    }
+    snprintf(part, sizeof(part), "%s.part", name);
+    int fd = openat(dir, part, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    uint64_t *sums = malloc((chunks + 1) * sizeof(uint64_t));
+    if (fd < 0 || sums == NULL || fstat(fd, &st) != 0)
+    {
+        perror(part);
+        free(sums);
+        return -1;
+    }
+
+    // what an interrupted transfer left: whole chunks, or the whole file
+    uint64_t length = st.st_size, offset, good = 0;
+    uint64_t have = length >= size ? chunks : length / chunk;
+    int status = -1;
+    if (checksums(fd, chunk, length < size ? length : size, 0, have, sums) ||
+        ft_send_u64(sock, &have, 1) != 0 ||
+        ft_send_u64(sock, sums, have) != 0 ||
+        ft_receive_u64(sock, &offset, 1) != 0 || offset % chunk != 0 ||
+        offset > have * chunk || offset > size || ftruncate(fd, size) != 0)
+    {
+        goto done;
+    }
+
+    double start = now();
+    int failed = receive == FT_RECEIVE_SPLICE
+                     ? receive_splice(sock, fd, offset, size - offset)
+                     : receive_read(sock, fd, offset, size - offset);
+    double seconds = now() - start;
+    uint64_t first = offset / chunk;
+    if (failed || ft_receive_u64(sock, sums, chunks) != 0)
+    {
+        // keep what came, to be verified when the transfer resumes
+        fprintf(stderr, "%s: transfer interrupted\n", name);
+        goto done;
+    }
+
+    // the chunks before `offset` matched already
+    uint64_t *mine = malloc((chunks - first + 1) * sizeof(uint64_t));
+    if (mine != NULL &&
+        checksums(fd, chunk, size, first, chunks - first, mine) == 0)
+    {
+        uint64_t i = first;
+        while (i < chunks && mine[i - first] == sums[i])
+        {
+            i++;
+        }
+        good = i == chunks ? size : i * chunk;
+    }
+    free(mine);
+    if (ft_send_u64(sock, &good, 1) != 0 || good < size)
+    {
+        fprintf(stderr, "%s: %llu of %llu bytes verified\n", name,
+                (unsigned long long)good, (unsigned long long)size);
+        ftruncate(fd, good);
+        goto done;
+    }
+    printf("%s: %llu bytes from offset %llu, %s mode, %.2f s, %.1f MB/s\n",
+           name, (unsigned long long)size, (unsigned long long)offset,
+           receive == FT_RECEIVE_SPLICE ? "splice" : "read", seconds,
+           (size - offset) / 1e6 / (seconds > 0 ? seconds : 1e-9));
+    status = discard ? unlinkat(dir, part, 0) : renameat(dir, part, dir, name);
+
+done:
+    close(fd);
+    free(sums);
+    return status;
+}
+
+/**
+ * @brief Main function
+ * @returns 0 on exit
+ */
+int main(int argc, char **argv)
+{
+    int port = FT_PORT, one = 1;
+    const char *directory = ".";
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-p") == 0)
+            port = (int)strtol(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "-d") == 0)
+            directory = argv[i + 1];
+    }
+
+    int dir = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (dir < 0)
+    {
+        perror(directory);
+        return 1;
+    }
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (listener < 0 ||
+        bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listener, 16) != 0)
+    {
+        perror("bind");
+        return 1;
+    }
+    signal(SIGCHLD, SIG_IGN);  // children reaped by the kernel
+    signal(SIGPIPE, SIG_IGN);
+    printf("Receiving files into %s on port %d\n", directory, port);
+    fflush(stdout);
+
+    for (;;)
+    {
+        int sock = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+        if (sock < 0)
+        {
+            if (errno != EINTR)
+            {
+                perror("accept");
+            }
+            continue;
+        }
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(listener);
+            int status = serve(sock, dir);
+            fflush(stdout);
+            _exit(status == 0 ? 0 : 1);
+        }
+        if (pid < 0)
+        {
+            perror("fork");
+        }
+        close(sock);
+    }
+}
+
+#else
+/**
+ * @brief Main function
+ * @returns 1: splice() is only available on Linux
+ */
+int main()
+{
+    fprintf(stderr, "file_transfer_server needs Linux\n");
+    return 1;
+}
+#endif
@@ -12,6 +12,10 @@
  * for execution. The server receives the commands and executes them
  * until the user exits the loop. In this way, Remote Command Execution
  * using UDP is shown using the server-client model & socket programming
+ *
+ * Each command is sent as `<id> <command>`, and its output comes back in
+ * several datagrams tagged with the same ID, the last one `END` or `ERR`.
+ * Datagrams of an earlier command, which timed out here, are skipped.
  */
 
 #ifdef _WIN32
@@ -26,6 +30,7 @@
 #include <netdb.h>  /// For structures returned by the network database library - formatted internet addresses and port numbers
 #include <netinet/in.h>  /// For in_addr and sockaddr_in structures
 #include <sys/socket.h>  /// For macro definitions related to the creation of sockets
+#include <sys/time.h>  /// For struct timeval
 #include <sys/types.h>  /// For definitions to allow for the porting of BSD programs
 #include <unistd.h>
 #endif
@@ -36,6 +41,7 @@
 #include <string.h>  /// Various functions for manipulating arrays of characters
 
 #define PORT 10000  /// Define port over which communication will take place
+#define WAIT 30  /// Seconds to wait for the rest of an answer
 
 /**
  * @brief Utility function used to print an error message to `stderr`.
@@ -59,8 +65,9 @@ int main()
     uint32_t
         sockfd;  ///< socket descriptors - Like file handles but for sockets
     char send_msg[1024],
-        recv_msg[1024];  ///< character arrays to read and store string data
+        recv_msg[2048];  ///< character arrays to read and store string data
                          /// for communication
+    unsigned long id = 0;  ///< ID of the last command sent
 
     struct sockaddr_in
         server_addr;  ///< basic structures for all syscalls and functions that
@@ -121,6 +128,11 @@ int main()
      */
     connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr));
 
+    /// Do not wait forever for datagrams which may have been lost
+    struct timeval timeout = {WAIT, 0};
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout,
+               sizeof(timeout));
+
     printf("Client is Connected Successfully...\n");
 
     /**
@@ -140,13 +152,59 @@ int main()
      */
     while (1)
     {
+        char line[1000];
         printf("\nEnter Command To Be Executed Remotely: \n");
-        fgets(send_msg, sizeof(send_msg), stdin);
-        sendto(sockfd, send_msg, sizeof(send_msg), 0,
-               (struct sockaddr *)&server_addr, serverLength);
-        recvfrom(sockfd, recv_msg, sizeof(recv_msg), 0,
-                 (struct sockaddr *)&server_addr, &serverLength);
-        printf("Server Reply: %s\n", recv_msg);
+        if (fgets(line, sizeof(line), stdin) == NULL)
+        {
+            break;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0')
+        {
+            continue;
+        }
+        int length =
+            snprintf(send_msg, sizeof(send_msg), "%lu %s", ++id, line);
+        sendto(sockfd, send_msg, length, 0, (struct sockaddr *)&server_addr,
+               serverLength);
+
+        /**
+         * The output comes in datagrams `<id> <seq> OUT` followed by bytes,
+         * which UDP may deliver out of order or not at all, until `<id>
+         * <seq> END <status>` or `<id> <seq> ERR <reason>`
+         */
+        printf("Server Reply:\n");
+        for (int done = 0; !done;)
+        {
+            unsigned long reply_id;
+            unsigned seq;
+            int start = 0, header = 0;
+            char kind[4];
+            ssize_t n = recvfrom(sockfd, recv_msg, sizeof(recv_msg) - 1, 0,
+                                 NULL, NULL);
+            if (n < 0)
+            {
+                printf("(no answer)\n");
+                break;
+            }
+            recv_msg[n] = '\0';
+            if (sscanf(recv_msg, "%lu %u %n%3s%n", &reply_id, &seq, &start,
+                       kind, &header) < 3 ||
+                reply_id != id)
+            {
+                continue;  // not an answer to this command
+            }
+            if (strcmp(kind, "OUT") == 0)
+            {
+                fwrite(recv_msg + header + 1, 1, n - header - 1, stdout);
+            }
+            else
+            {
+                recv_msg[strcspn(recv_msg, "\n")] = '\0';
+                printf("[%s]\n", recv_msg + start);
+                done = 1;
+            }
+        }
     }
 
     /// Close Socket
@@ -4,16 +4,32 @@
  * @brief Server-side implementation of [Remote Command
  * Execution Using
  * UDP](https://www.imperva.com/learn/ddos/udp-user-datagram-protocol/)
- * @see remote_command_exec_udp_server.c
+ * @see remote_command_exec_udp_client.c
  *
  * @details
- * The algorithm is based on the simple UDP client and server model. It
- * runs an infinite loop which takes user input and sends it to the server
- * for execution. The server receives the commands and executes them
- * until the user exits the loop. In this way, Remote Command Execution
+ * The algorithm is based on the simple UDP client and server model. The
+ * client sends commands, the server executes them and sends their output
+ * back, until it is killed. In this way, Remote Command Execution
  * using UDP is shown using the server-client model & socket programming
+ *
+ * A request is a datagram `<id> <program> <arguments...>`. The command is
+ * not given to a shell: the program must be one of an allow-list, which is
+ * resolved to absolute paths at startup, and the words are passed as they
+ * are, so that `;`, `|` or `$(...)` mean nothing.
+ *
+ * The receive loop never runs a command itself. It hands each request to
+ * one of a pool of worker processes, forked at startup and waiting on a
+ * socket pair, or queues it while they are all busy, and keeps receiving.
+ * A worker starts the program with `posix_spawn`, reads its output through
+ * a pipe and sends it to the client as it comes, in datagrams `<id> <seq>
+ * OUT` followed by the bytes. It kills the program when it runs longer than
+ * the timeout or writes too much, and ends with `<id> <seq> END <status>`,
+ * or `<id> <seq> ERR <reason>` when the request failed.
+ *
+ * `remote_command_exec_udp_server [-p port] [-w workers] [-t seconds]`
  */
 
+#define _GNU_SOURCE  /// For pipe2() and SOCK_CLOEXEC
 #ifdef _WIN32
 #define bzero(b, len) \
     (memset((b), '\0', (len)), (void)0) /**< BSD name not in windows */
@@ -23,6 +39,13 @@
 #include <winsock2.h>  /// For the type in_addr_t and in_port_t
 #else
 #include <arpa/inet.h>  /// For the type in_addr_t and in_port_t
+#include <assert.h>     /// For the self-tests
+#include <fcntl.h>      /// For O_CLOEXEC and O_RDONLY
+#include <poll.h>       /// For poll()
+#include <signal.h>     /// For kill()
+#include <spawn.h>      /// For posix_spawn()
+#include <sys/wait.h>   /// For waitpid()
+#include <time.h>       /// For clock_gettime()
 #include <netdb.h>  /// For structures returned by the network database library - formatted internet addresses and port numbers
 #include <netinet/in.h>  /// For in_addr and sockaddr_in structures
 #include <sys/socket.h>  /// For macro definitions related to the creation of sockets
@@ -36,6 +59,12 @@
 #include <string.h>  /// Various functions for manipulating arrays of characters
 
 #define PORT 10000  /// Define port over which communication will take place
+#define WORKERS 4             /// Default number of worker processes
+#define QUEUE 64              /// Requests waiting for a worker, at most
+#define TIMEOUT 10            /// Default seconds a command may run
+#define MAX_ARGS 32           /// Words of a command, at most
+#define MAX_OUTPUT (1 << 20)  /// Bytes of output sent, at most
+#define CHUNK 1200  /// Bytes of output per datagram, below the usual MTU
 
 /**
  * @brief Utility function used to print an error message to `stderr`.
@@ -49,118 +78,478 @@ void error()
     exit(EXIT_FAILURE);
 }
 
+#ifndef _WIN32
+/**
+ * @brief Programs that may be run: names given by the clients, and the
+ * absolute paths found at startup
+ */
+static struct
+{
+    const char *name;
+    char path[32];
+} allowed[] = {{"date", ""},  {"df", ""},    {"echo", ""},
+               {"hostname", ""}, {"ls", ""}, {"sleep", ""},
+               {"uname", ""}, {"uptime", ""}, {"whoami", ""}};
+
+/** @brief A request, as handed to a worker */
+struct job
+{
+    struct sockaddr_in client;  ///< where to send the output
+    socklen_t length;           ///< size of `client`
+    unsigned long id;           ///< request ID chosen by the client
+    char line[1024];            ///< the command
+};
+
+/**
+ * @brief Looks for each allowed program in /usr/bin then /bin; those not
+ * found stay refused
+ * @returns void
+ */
+static void resolve_allowed()
+{
+    static const char *const dirs[] = {"/usr/bin/", "/bin/"};
+    for (size_t i = 0; i < sizeof(allowed) / sizeof(allowed[0]); i++)
+    {
+        for (int d = 0; d < 2 && allowed[i].path[0] == '\0'; d++)
+        {
+            snprintf(allowed[i].path, sizeof(allowed[i].path), "%s%s",
+                     dirs[d], allowed[i].name);
+            if (access(allowed[i].path, X_OK) != 0)
+            {
+                allowed[i].path[0] = '\0';
+            }
+        }
+    }
+}
+
+/**
+ * @brief Splits a request into its ID and the words of its command. The
+ * ID may be left out, and is then 0.
+ * @param line the request, modified in place
+ * @param id receives the request ID
+ * @param argv receives the words, then NULL
+ * @returns the number of words, or -1 if there are none or too many
+ */
+static int parse_request(char *line, unsigned long *id, char **argv)
+{
+    int argc = 0;
+    char *save = NULL, *word = strtok_r(line, " \t\r\n", &save);
+    char *end;
+
+    *id = 0;
+    if (word != NULL && (*id = strtoul(word, &end, 10), *end == '\0'))
+    {
+        word = strtok_r(NULL, " \t\r\n", &save);
+    }
+    for (; word != NULL; word = strtok_r(NULL, " \t\r\n", &save))
+    {
+        if (argc == MAX_ARGS)
+        {
+            return -1;
+        }
+        argv[argc++] = word;
+    }
+    argv[argc] = NULL;
+    return argc > 0 ? argc : -1;
+}
+
+/**
+ * @brief Path of an allowed program
+ * @param name the name given by the client
+ * @returns its absolute path, or NULL if it may not be run
+ */
+static const char *allowed_path(const char *name)
+{
+    for (size_t i = 0; i < sizeof(allowed) / sizeof(allowed[0]); i++)
+    {
+        if (strcmp(name, allowed[i].name) == 0 && allowed[i].path[0])
+        {
+            return allowed[i].path;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Sends a datagram `<id> <seq> <kind>` followed by data
+ * @param sockfd the UDP socket
+ * @param job the request answered
+ * @param seq number of the datagram in the answer
+ * @param kind `OUT`, `END <status>` or `ERR <reason>`
+ * @param data bytes following the header line
+ * @param n number of bytes
+ * @returns void
+ */
+static void reply(int sockfd, const struct job *job, unsigned seq,
+                  const char *kind, const char *data, size_t n)
+{
+    char datagram[64 + CHUNK];
+    int header = snprintf(datagram, 64, "%lu %u %s\n", job->id, seq, kind);
+    if (n > CHUNK)
+    {
+        n = CHUNK;
+    }
+    memcpy(datagram + header, data, n);
+    sendto(sockfd, datagram, header + n, 0,
+           (const struct sockaddr *)&job->client, job->length);
+}
+
+/**
+ * @brief Milliseconds of a monotonic clock
+ * @returns the time
+ */
+static long long now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Runs a request in a worker: spawns the program with its output in
+ * a pipe, and streams the output to the client until it ends, it runs too
+ * long or writes too much
+ * @param sockfd the UDP socket
+ * @param job the request, already checked against the allow-list
+ * @param timeout seconds the program may run
+ * @returns void
+ */
+static void run_job(int sockfd, struct job *job, int timeout)
+{
+    char *argv[MAX_ARGS + 1], buffer[CHUNK], status[64];
+    char *envp[] = {"PATH=/usr/bin:/bin", "LC_ALL=C", NULL};
+    unsigned seq = 0;
+    int out[2], wstatus = 0, killed = 0;
+    size_t total = 0;
+    pid_t pid;
+    posix_spawn_file_actions_t actions;
+
+    parse_request(job->line, &job->id, argv);
+    if (pipe2(out, O_CLOEXEC) != 0)
+    {
+        reply(sockfd, job, seq, "ERR pipe", "", 0);
+        return;
+    }
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, out[1], 2);
+    int failed = posix_spawn(&pid, allowed_path(argv[0]), &actions, NULL,
+                             argv, envp);
+    posix_spawn_file_actions_destroy(&actions);
+    close(out[1]);
+    if (failed)
+    {
+        close(out[0]);
+        reply(sockfd, job, seq, "ERR spawn", "", 0);
+        return;
+    }
+
+    long long deadline = now_ms() + timeout * 1000LL;
+    for (;;)
+    {
+        struct pollfd p = {.fd = out[0], .events = POLLIN};
+        long long left = deadline - now_ms();
+        if (left <= 0 || poll(&p, 1, (int)left) == 0)
+        {
+            kill(pid, SIGKILL);
+            killed = 1;  // timeout
+            break;
+        }
+        ssize_t n = read(out[0], buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;  // end of the output
+        }
+        reply(sockfd, job, seq++, "OUT", buffer, n);
+        if ((total += n) >= MAX_OUTPUT)
+        {
+            kill(pid, SIGKILL);
+            killed = 2;
+            break;
+        }
+    }
+    close(out[0]);
+    waitpid(pid, &wstatus, 0);
+
+    if (killed)
+    {
+        snprintf(status, sizeof(status), "ERR %s",
+                 killed == 1 ? "timeout" : "output too long");
+    }
+    else if (WIFEXITED(wstatus))
+    {
+        snprintf(status, sizeof(status), "END %d", WEXITSTATUS(wstatus));
+    }
+    else
+    {
+        snprintf(status, sizeof(status), "END signal %d", WTERMSIG(wstatus));
+    }
+    reply(sockfd, job, seq, status, "", 0);
+}
+
+/**
+ * @brief Forks a worker: it runs the requests received on its end of a
+ * socket pair, answering one byte after each, until the server goes away
+ * @param sockfd the UDP socket, inherited to send the output
+ * @param fds the UDP socket then the server's ends of the socket pairs
+ * @param w the worker: `fds[w + 1]` receives its socket pair
+ * @param workers number of workers
+ * @param timeout seconds a program may run
+ * @returns the worker's process ID, or -1 on error
+ */
+static pid_t start_worker(int sockfd, struct pollfd *fds, int w, int workers,
+                          int timeout)
+{
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) != 0)
+    {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        struct job job;
+        // only the server may hold the other workers' channels, so that
+        // they see it go away
+        for (int i = 0; i < workers; i++)
+        {
+            if (i != w && fds[i + 1].fd > 0)
+            {
+                close(fds[i + 1].fd);
+            }
+        }
+        close(pair[0]);
+        while (recv(pair[1], &job, sizeof(job), 0) == sizeof(job))
+        {
+            run_job(sockfd, &job, timeout);
+            send(pair[1], "", 1, 0);
+        }
+        _exit(0);
+    }
+    close(pair[1]);
+    if (pid < 0)
+    {
+        close(pair[0]);
+        return -1;
+    }
+    fds[w + 1].fd = pair[0];
+    return pid;
+}
+
+/**
+ * @brief Self-test of the parsing of requests and of the allow-list
+ * @returns void
+ */
+static void test()
+{
+    char *argv[MAX_ARGS + 1], line[1024];
+    unsigned long id;
+
+    strcpy(line, "42 ls -l /tmp\n");
+    assert(parse_request(line, &id, argv) == 3 && id == 42);
+    assert(strcmp(argv[0], "ls") == 0 && strcmp(argv[2], "/tmp") == 0);
+    assert(argv[3] == NULL);
+    strcpy(line, "uname -a");
+    assert(parse_request(line, &id, argv) == 2 && id == 0);
+    strcpy(line, "7 \n");
+    assert(parse_request(line, &id, argv) == -1);
+    memset(line, 0, sizeof(line));
+    for (int i = 0; i <= MAX_ARGS; i++)
+    {
+        strcat(line, "x ");
+    }
+    assert(parse_request(line, &id, argv) == -1);
+
+    // no shell: words are programs or arguments, never syntax
+    assert(allowed_path("rm") == NULL && allowed_path("/bin/ls") == NULL);
+    assert(allowed_path("ls;") == NULL && allowed_path("sh") == NULL);
+    strcpy(line, "1 echo $(id); rm -rf /");
+    assert(parse_request(line, &id, argv) == 5);
+    assert(strcmp(argv[1], "$(id);") == 0);
+}
+#endif
+
 /**
  * @brief Main function
  * @returns 0 on exit
  */
-int main()
+int main(int argc, char **argv)
 {
+#ifdef _WIN32
+    (void)argc;
+    (void)argv;
+    fprintf(stderr, "The worker pool needs posix_spawn and fork\n");
+    return 1;
+#else
     /** Variable Declarations */
-    uint32_t
-        sockfd;  ///< socket descriptors - Like file handles but for sockets
-    char recv_msg[1024],
-        success_message[] =
-            "Command Executed Successfully!\n";  ///< character arrays to read
-                                                 /// and store string data
-                                                 /// for communication & Success
-                                                 /// message
-
-    struct sockaddr_in server_addr,
-        client_addr;  ///< basic structures for all syscalls and functions that
-                      /// deal with internet addresses. Structures for handling
-                      /// internet addresses
-    socklen_t clientLength = sizeof(client_addr);  /// size of address
+    int sockfd;  ///< socket descriptor - Like file handles but for sockets
+    int port = PORT, workers = WORKERS, timeout = TIMEOUT;
+
+    struct sockaddr_in server_addr;  ///< basic structure for all syscalls and
+                                     /// functions that deal with internet
+                                     /// addresses
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        int v = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "-p") == 0)
+            port = v;
+        else if (strcmp(argv[i], "-w") == 0 && v > 0)
+            workers = v;
+        else if (strcmp(argv[i], "-t") == 0 && v > 0)
+            timeout = v;
+    }
+    test();  // run self-test implementations
+    resolve_allowed();
 
     /**
-     * The UDP socket is created using the socket function.
-     *
-     * AF_INET (Family) - it is an address family that is used to designate the
-     * type of addresses that your socket can communicate with
-     *
-     * SOCK_DGRAM (Type) - Indicates UDP Connection - UDP does not require the
-     * source and destination to establish a three-way handshake before
-     * transmission takes place. Additionally, there is no need for an
-     * end-to-end connection
-     *
-     * 0 (Protocol) - Specifies a particular protocol to be used with the
-     * socket. Specifying a protocol of 0 causes socket() to use an unspecified
-     * default protocol appropriate for the requested socket type.
+     * The UDP socket is created using the socket function, closed in the
+     * programs run thanks to SOCK_CLOEXEC.
      */
-    if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0)
+    if ((sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
     {
         error();
     }
 
     /**
-     * Server Address Information
-     *
-     * The bzero() function erases the data in the n bytes of the memory
-     * starting at the location pointed to, by writing zeros (bytes
-     * containing '\0') to that area.
-     *
-     * We bind the server_addr to the internet address and port number thus
-     * giving our socket an identity with an address and port where it can
-     * listen for connections
-     *
-     * htons - The htons() function translates a short integer from host byte
-     * order to network byte order
-     *
-     * htonl - The htonl() function translates a long integer from host byte
-     * order to network byte order
-     *
-     * These functions are necessary so that the binding of address and port
-     * takes place with data in the correct format
+     * Server Address Information: the socket listens on every address at
+     * the port
      */
     bzero(&server_addr, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(PORT);
+    server_addr.sin_port = htons(port);
     server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
 
-    /**
-     * This binds the socket descriptor to the server thus enabling the server
-     * to listen for connections and communicate with other clients
-     */
     if (bind(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
     {
         error();  /// If binding is unsuccessful
     }
 
-    printf("Server is Connected Successfully...\n");
+    /**
+     * The pool: each worker has a socket pair to the server, polled with
+     * the UDP socket, and runs one request at a time
+     */
+    struct pollfd *fds = calloc(workers + 1, sizeof(struct pollfd));
+    pid_t *pids = calloc(workers, sizeof(pid_t));
+    struct job *running = calloc(workers, sizeof(struct job));
+    struct job *queue = calloc(QUEUE, sizeof(struct job));
+    int *busy = calloc(workers, sizeof(int)), head = 0, queued = 0;
+    if (!fds || !pids || !running || !queue || !busy)
+    {
+        perror("calloc");
+        return 1;
+    }
+    fds[0].fd = sockfd;
+    fds[0].events = POLLIN;
+    for (int w = 0; w < workers; w++)
+    {
+        if ((pids[w] = start_worker(sockfd, fds, w, workers, timeout)) < 0)
+        {
+            error();
+        }
+        fds[w + 1].events = POLLIN;
+    }
+
+    printf("Server is Connected Successfully... %d workers, %d s timeout\n",
+           workers, timeout);
 
     /**
      * Communication between client and server
      *
-     * The bzero() function erases the data in the n bytes of the memory
-     * starting at the location pointed to, by writing zeros (bytes
-     * containing '\0') to that area. The variables are emptied and then
-     * ready for use
-     *
-     * The server receives data from the client which is a command. It then
-     * executes the command.
-     *
-     * The client then receives a response from the server when the
-     * command has been executed
-     *
-     * The server and client can communicate indefinitely till one of them
-     * exits the connection
-     *
-     * The client sends the server a command which it executes thus showing
-     * remote command execution using UDP
+     * The server receives commands and checks them against the allow-list.
+     * An accepted command goes to an idle worker, or waits in the queue;
+     * the worker sends the output to the client. The server keeps
+     * receiving meanwhile, and ends when it is killed.
      */
     while (1)
     {
-        bzero(recv_msg, sizeof(recv_msg));
-        recvfrom(sockfd, recv_msg, sizeof(recv_msg), 0,
-                 (struct sockaddr *)&client_addr, &clientLength);
-        printf("Command Output: \n");
-        system(recv_msg);
-        printf("Command Executed\n");
-        sendto(sockfd, success_message, sizeof(success_message), 0,
-               (struct sockaddr *)&client_addr, clientLength);
+        if (poll(fds, workers + 1, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            error();
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            struct job job;
+            char copy[sizeof(job.line)], *words[MAX_ARGS + 1];
+            job.length = sizeof(job.client);
+            ssize_t n = recvfrom(sockfd, job.line, sizeof(job.line) - 1, 0,
+                                 (struct sockaddr *)&job.client, &job.length);
+            if (n >= 0)
+            {
+                job.line[n] = '\0';
+                memcpy(copy, job.line, n + 1);
+                if (parse_request(copy, &job.id, words) < 0)
+                {
+                    reply(sockfd, &job, 0, "ERR malformed", "", 0);
+                }
+                else if (allowed_path(words[0]) == NULL)
+                {
+                    reply(sockfd, &job, 0, "ERR not allowed", "", 0);
+                }
+                else if (queued == QUEUE)
+                {
+                    reply(sockfd, &job, 0, "ERR busy", "", 0);
+                }
+                else
+                {
+                    queue[(head + queued++) % QUEUE] = job;
+                }
+            }
+        }
+
+        for (int w = 0; w < workers; w++)
+        {
+            char done;
+            if (!(fds[w + 1].revents & (POLLIN | POLLHUP)))
+            {
+                continue;
+            }
+            if (recv(fds[w + 1].fd, &done, 1, 0) == 1)
+            {
+                busy[w] = 0;
+                continue;
+            }
+            // the worker died: answer its request, and replace it
+            if (busy[w])
+            {
+                reply(sockfd, &running[w], 0, "ERR worker died", "", 0);
+            }
+            close(fds[w + 1].fd);
+            fds[w + 1].fd = -1;
+            waitpid(pids[w], NULL, 0);
+            busy[w] = 0;
+            if ((pids[w] = start_worker(sockfd, fds, w, workers, timeout)) < 0)
+            {
+                error();
+            }
+        }
+
+        for (int w = 0; w < workers && queued; w++)
+        {
+            if (!busy[w])
+            {
+                running[w] = queue[head];
+                head = (head + 1) % QUEUE;
+                queued--;
+                busy[w] = 1;
+                send(fds[w + 1].fd, &running[w], sizeof(struct job), 0);
+            }
+        }
     }
 
     /// Close socket
     close(sockfd);
     printf("Server is offline...\n");
     return 0;
+#endif
 }
@@ -0,0 +1,279 @@
+/**
+ * @file
+ * @brief Packet blaster for udp_batch_server.c: measures the datagrams per
+ * second echoed over loopback, sending one datagram per system call or
+ * batches of them with `sendmmsg`/`recvmmsg`
+ * @see udp_batch_server.c
+ *
+ * @details
+ * Each flow is a socket, so a port of its own, which `SO_REUSEPORT` on the
+ * server hashes to one of its workers. A flow keeps at most `window`
+ * datagrams in flight: more would only overflow the socket buffers and
+ * measure losses. A flow which receives nothing for 20 ms counts what it
+ * has in flight as lost, and starts again.
+ *
+ * `udp_blaster [-h host] [-p port] [-d seconds] [-s bytes] [-f flows]
+ * [-W window] [-m single|batch|both]`
+ */
+#define _GNU_SOURCE  /// for recvmmsg() and sendmmsg()
+#include <stdio.h>   /// for printf() and perror()
+#include <stdlib.h>  /// for calloc() and strtol()
+#include <string.h>  /// for memset() and strcmp()
+
+#ifdef __linux__
+#include <arpa/inet.h>   /// for htons() and inet_pton()
+#include <errno.h>       /// for errno
+#include <netinet/in.h>  /// for sockaddr_in
+#include <poll.h>        /// for poll()
+#include <sys/socket.h>  /// for socket(), recvmmsg(), sendmmsg()
+#include <time.h>        /// for clock_gettime()
+#include <unistd.h>      /// for close()
+
+#define PORT 8080      ///< default port of udp_batch_server.c
+#define BATCH 64       ///< most datagrams per system call
+#define DATAGRAM 2048  ///< largest datagram
+#define MAX_FLOWS 64   ///< most sockets
+
+/** @brief Results of a run */
+struct result
+{
+    unsigned long sent, received, lost, calls;
+    double seconds;
+};
+
+/**
+ * @brief Current time
+ * @returns seconds of CLOCK_MONOTONIC
+ */
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Sends datagrams on a connected socket
+ * @param fd the socket
+ * @param msgs BATCH messages pointing to the payload
+ * @param count number of datagrams to send
+ * @param batch whether to use sendmmsg()
+ * @param calls incremented for each system call
+ * @returns the number sent
+ */
+static int send_some(int fd, struct mmsghdr *msgs, int count, int batch,
+                     unsigned long *calls)
+{
+    int sent = 0;
+    while (sent < count)
+    {
+        int want = count - sent < BATCH ? count - sent : BATCH, k;
+        ++*calls;
+        if (batch)
+        {
+            k = sendmmsg(fd, msgs, want, MSG_DONTWAIT);
+        }
+        else
+        {
+            struct iovec *iov = msgs[0].msg_hdr.msg_iov;
+            k = send(fd, iov->iov_base, iov->iov_len, MSG_DONTWAIT) < 0 ? -1
+                                                                       : 1;
+        }
+        if (k <= 0)
+        {
+            break;  // socket buffer full
+        }
+        sent += k;
+    }
+    return sent;
+}
+
+/**
+ * @brief Receives the datagrams waiting on a socket
+ * @param fd the socket
+ * @param msgs BATCH messages pointing to buffers
+ * @param batch whether to use recvmmsg()
+ * @param calls incremented for each system call
+ * @returns the number received
+ */
+static int receive_some(int fd, struct mmsghdr *msgs, int batch,
+                        unsigned long *calls)
+{
+    int received = 0, k;
+    do
+    {
+        ++*calls;
+        if (batch)
+        {
+            k = recvmmsg(fd, msgs, BATCH, MSG_DONTWAIT, NULL);
+        }
+        else
+        {
+            struct iovec *iov = msgs[0].msg_hdr.msg_iov;
+            k = recv(fd, iov->iov_base, DATAGRAM, MSG_DONTWAIT) < 0 ? -1 : 1;
+        }
+        received += k > 0 ? k : 0;
+    } while (k > 0);
+    return received;
+}
+
+/**
+ * @brief Blasts datagrams for a while
+ * @param addr the server
+ * @param seconds duration
+ * @param size bytes per datagram
+ * @param flows number of sockets
+ * @param window most datagrams in flight per socket
+ * @param batch whether to use sendmmsg() and recvmmsg()
+ * @returns the results
+ */
+static struct result blast(const struct sockaddr_in *addr, double seconds,
+                           size_t size, int flows, int window, int batch)
+{
+    static char payload[DATAGRAM], buffers[BATCH][DATAGRAM];
+    struct mmsghdr out[BATCH], in[BATCH];
+    struct iovec outv, inv[BATCH];
+    struct pollfd fds[MAX_FLOWS];
+    int inflight[MAX_FLOWS] = {0};
+    double quiet[MAX_FLOWS];  // when each flow last received
+    struct result r = {0};
+
+    memset(payload, 'x', size);
+    outv.iov_base = payload;
+    outv.iov_len = size;
+    memset(out, 0, sizeof(out));
+    memset(in, 0, sizeof(in));
+    for (int i = 0; i < BATCH; i++)
+    {
+        out[i].msg_hdr.msg_iov = &outv;  // the same payload every time
+        out[i].msg_hdr.msg_iovlen = 1;
+        inv[i].iov_base = buffers[i];
+        inv[i].iov_len = DATAGRAM;
+        in[i].msg_hdr.msg_iov = &inv[i];
+        in[i].msg_hdr.msg_iovlen = 1;
+    }
+    for (int f = 0; f < flows; f++)
+    {
+        int buffer = 4 << 20;
+        fds[f].fd = socket(AF_INET, SOCK_DGRAM, 0);
+        fds[f].events = POLLIN;
+        setsockopt(fds[f].fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+        if (connect(fds[f].fd, (const struct sockaddr *)addr,
+                    sizeof(*addr)) != 0)
+        {
+            perror("connect");
+        }
+    }
+
+    double start = now(), t = start, end = start + seconds;
+    for (int f = 0; f < flows; f++)
+    {
+        quiet[f] = start;
+    }
+    while (t < end)
+    {
+        for (int f = 0; f < flows; f++)
+        {
+            int n = send_some(fds[f].fd, out, window - inflight[f], batch,
+                              &r.calls);
+            inflight[f] += n;
+            r.sent += n;
+        }
+        poll(fds, flows, 20);
+        t = now();
+        for (int f = 0; f < flows; f++)
+        {
+            int n = receive_some(fds[f].fd, in, batch, &r.calls);
+            if (n > 0)
+            {
+                inflight[f] -= n < inflight[f] ? n : inflight[f];
+                r.received += n;
+                quiet[f] = t;
+            }
+            else if (t - quiet[f] > 0.02)
+            {
+                r.lost += inflight[f];
+                inflight[f] = 0;
+                quiet[f] = t;
+            }
+        }
+    }
+    r.seconds = now() - start;
+    for (int f = 0; f < flows; f++)
+    {
+        close(fds[f].fd);
+    }
+    return r;
+}
+
+/**
+ * @brief Main function
+ * @returns 0 on exit
+ */
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1", *mode = "both";
+    int port = PORT, flows = 1, window = 256;
+    double seconds = 3;
+    size_t size = 64;
+    struct sockaddr_in addr = {0};
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-h") == 0)
+            host = argv[i + 1];
+        else if (strcmp(argv[i], "-p") == 0)
+            port = (int)strtol(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "-d") == 0)
+            seconds = strtod(argv[i + 1], NULL);
+        else if (strcmp(argv[i], "-s") == 0)
+            size = (size_t)strtol(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "-f") == 0)
+            flows = (int)strtol(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "-W") == 0)
+            window = (int)strtol(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "-m") == 0)
+            mode = argv[i + 1];
+    }
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1 || size > DATAGRAM ||
+        flows < 1 || flows > MAX_FLOWS || window < 1 || seconds <= 0)
+    {
+        fprintf(stderr, "usage: %s [-h host] [-p port] [-d seconds] "
+                        "[-s bytes <= %d] [-f flows <= %d] [-W window] "
+                        "[-m single|batch|both]\n",
+                argv[0], DATAGRAM, MAX_FLOWS);
+        return 1;
+    }
+
+    printf("%zu-byte datagrams, %d flow%s, window %d\n", size, flows,
+           flows > 1 ? "s" : "", window);
+    printf("%-7s %12s %12s %10s %12s\n", "mode", "sent/s", "echoed/s",
+           "lost", "syscalls/s");
+    for (int batch = 0; batch < 2; batch++)
+    {
+        if (strcmp(mode, "both") != 0 &&
+            strcmp(mode, batch ? "batch" : "single") != 0)
+        {
+            continue;
+        }
+        struct result r = blast(&addr, seconds, size, flows, window, batch);
+        printf("%-7s %12.0f %12.0f %10lu %12.0f\n",
+               batch ? "batch" : "single", r.sent / r.seconds,
+               r.received / r.seconds, r.lost, r.calls / r.seconds);
+    }
+    return 0;
+}
+
+#else
+/**
+ * @brief Main function
+ * @returns 1: recvmmsg() and sendmmsg() are only available on Linux
+ */
+int main()
+{
+    fprintf(stderr, "udp_blaster needs Linux\n");
+    return 1;
+}
+#endif
@@ -0,0 +1,1084 @@
+/**
+ * @file
+ * @brief Cache-conscious [B+ tree](https://en.wikipedia.org/wiki/B%2B_tree)
+ * index over 32-bit integer keys
+ * @details
+ * Every node stores up to ::BPT_KEYS sorted keys in one contiguous array, so
+ * a lookup touches a handful of cache lines per level instead of one cache
+ * miss per key as in the binary trees of this folder (avl_tree.c,
+ * red_black_tree.c). Unused key slots are padded with `INT32_MAX`, which lets
+ * the position inside a node be found by counting the keys smaller than the
+ * target over the whole fixed-size array: a branch free loop that is done
+ * four keys at a time with SSE2 when available.
+ *
+ * All values live in the leaves and the leaves are chained left to right, so
+ * a range scan is one descent followed by a sequential walk. A tree can also
+ * be bulk loaded from sorted keys in O(n), bottom up.
+ *
+ * Erasing removes the key from its leaf without merging under-full nodes;
+ * the separators stay valid bounds, so lookups and scans are unaffected.
+ *
+ * Run with `./b_plus_tree [number of keys]` to benchmark against an AVL and
+ * a red-black tree (10M keys takes a while for the baselines).
+ */
+
+#include <assert.h>   /* for assert */
+#include <inttypes.h> /* for int32_t, INT32_MAX */
+#include <stdio.h>    /* for printf */
+#include <stdlib.h>   /* for malloc, free */
+#include <string.h>   /* for memmove */
+#include <time.h>     /* for clock */
+#ifdef __SSE2__
+#include <emmintrin.h> /* for SSE2 intrinsics */
+#endif
+
+/**
+ * Number of keys per node. 64 keys of 4 bytes span four 64-byte cache lines
+ * that the hardware prefetcher streams in together. Must be a multiple of 4.
+ */
+#define BPT_KEYS 64
+
+/** key padding for the unused slots of a node, never smaller than a key */
+#define BPT_PAD INT32_MAX
+
+/**
+ * A node of the tree. Inner nodes hold `count` separators and `count + 1`
+ * children, child `i` holding the keys in `[keys[i - 1], keys[i])`. Leaves
+ * hold `count` key/value pairs and a link to the next leaf.
+ */
+typedef struct bpt_node
+{
+    int32_t keys[BPT_KEYS]; /**< sorted keys, padded with ::BPT_PAD */
+    int count;              /**< number of keys in use */
+    int leaf;               /**< 1 for a leaf, 0 for an inner node */
+    union
+    {
+        struct bpt_node *children[BPT_KEYS + 1]; /**< inner node children */
+        struct
+        {
+            void *values[BPT_KEYS]; /**< value of each key */
+            struct bpt_node *next;  /**< next leaf in key order */
+        } l;
+    } u;
+} bpt_node;
+
+/** The tree itself */
+typedef struct bpt_tree
+{
+    bpt_node *root; /**< root node, NULL for an empty tree */
+    size_t size;    /**< number of keys */
+    int height;     /**< number of levels */
+} bpt_tree;
+
+/** Position of a key inside a leaf, used to walk the keys in order */
+typedef struct bpt_cursor
+{
+    bpt_node *leaf; /**< current leaf, NULL past the end */
+    int pos;        /**< index in the leaf */
+} bpt_cursor;
+
+/**
+ * Counts the keys of a node that are smaller than `key`
+ * @param keys padded key array of a node
+ * @param key key to compare against
+ * @returns number of keys strictly smaller than `key`
+ */
+static inline int count_less(const int32_t *keys, int32_t key)
+{
+#ifdef __SSE2__
+    const __m128i k = _mm_set1_epi32(key);
+    __m128i acc = _mm_setzero_si128();
+    for (int i = 0; i < BPT_KEYS; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(keys + i));
+        /* lanes where v < k are -1, subtracting counts them */
+        acc = _mm_sub_epi32(acc, _mm_cmplt_epi32(v, k));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+    return _mm_cvtsi128_si32(acc);
+#else
+    int n = 0;
+    for (int i = 0; i < BPT_KEYS; i++) n += keys[i] < key;
+    return n;
+#endif
+}
+
+/**
+ * Index of the child of an inner node that may hold `key`
+ * @param node inner node
+ * @param key key to look for
+ * @returns number of separators smaller than or equal to `key`
+ */
+static inline int child_index(const bpt_node *node, int32_t key)
+{
+    if (key == INT32_MAX)
+        return node->count;
+    int i = count_less(node->keys, key + 1);
+    return i < node->count ? i : node->count;
+}
+
+/**
+ * Allocates an empty node
+ * @param leaf 1 to make a leaf
+ * @returns new node
+ */
+static bpt_node *node_new(int leaf)
+{
+    bpt_node *node = (bpt_node *)malloc(sizeof(bpt_node));
+    for (int i = 0; i < BPT_KEYS; i++) node->keys[i] = BPT_PAD;
+    node->count = 0;
+    node->leaf = leaf;
+    if (leaf)
+        node->u.l.next = NULL;
+    return node;
+}
+
+/**
+ * Initialises an empty tree
+ * @param tree tree to initialise
+ */
+void bpt_init(bpt_tree *tree)
+{
+    tree->root = NULL;
+    tree->size = 0;
+    tree->height = 0;
+}
+
+/**
+ * Frees a subtree
+ * @param node root of the subtree
+ */
+static void node_free(bpt_node *node)
+{
+    if (!node->leaf)
+        for (int i = 0; i <= node->count; i++) node_free(node->u.children[i]);
+    free(node);
+}
+
+/**
+ * Frees all the nodes of a tree
+ * @param tree tree to clear
+ */
+void bpt_destroy(bpt_tree *tree)
+{
+    if (tree->root)
+        node_free(tree->root);
+    bpt_init(tree);
+}
+
+/**
+ * Finds the leaf that may hold `key`
+ * @param tree tree to search
+ * @param key key to look for
+ * @returns the leaf or NULL for an empty tree
+ */
+static bpt_node *find_leaf(const bpt_tree *tree, int32_t key)
+{
+    bpt_node *node = tree->root;
+    while (node && !node->leaf) node = node->u.children[child_index(node, key)];
+    return node;
+}
+
+/**
+ * Looks up a key
+ * @param tree tree to search
+ * @param key key to look for
+ * @param value if not NULL, receives the value of the key
+ * @returns 1 if the key is present, 0 otherwise
+ */
+int bpt_find(const bpt_tree *tree, int32_t key, void **value)
+{
+    bpt_node *leaf = find_leaf(tree, key);
+    if (leaf == NULL)
+        return 0;
+    int i = count_less(leaf->keys, key);
+    if (i >= leaf->count || leaf->keys[i] != key)
+        return 0;
+    if (value)
+        *value = leaf->u.l.values[i];
+    return 1;
+}
+
+/**
+ * Positions a cursor on the first key not smaller than `key`
+ * @param tree tree to search
+ * @param key lower bound
+ * @returns cursor, with `leaf == NULL` if every key is smaller
+ */
+bpt_cursor bpt_lower_bound(const bpt_tree *tree, int32_t key)
+{
+    bpt_cursor c;
+    c.leaf = find_leaf(tree, key);
+    c.pos = c.leaf ? count_less(c.leaf->keys, key) : 0;
+    /* the bound may be past the end of this leaf, or the leaf may be empty
+     * after erasures */
+    while (c.leaf && c.pos >= c.leaf->count)
+    {
+        c.leaf = c.leaf->u.l.next;
+        c.pos = 0;
+    }
+    return c;
+}
+
+/**
+ * Moves a cursor to the next key
+ * @param c cursor to advance, must not be past the end
+ */
+void bpt_cursor_next(bpt_cursor *c)
+{
+    if (++c->pos < c->leaf->count)
+        return;
+    do
+    {
+        c->leaf = c->leaf->u.l.next;
+        c->pos = 0;
+    } while (c->leaf && c->leaf->count == 0);
+}
+
+/**
+ * Calls `visit` for every key in `[lo, hi)` in increasing order
+ * @param tree tree to scan
+ * @param lo first key of the range
+ * @param hi end of the range, excluded
+ * @param visit callback, returning non-zero stops the scan (may be NULL)
+ * @param ctx passed through to `visit`
+ * @returns number of keys visited
+ */
+size_t bpt_range(const bpt_tree *tree, int32_t lo, int32_t hi,
+                 int (*visit)(int32_t key, void *value, void *ctx), void *ctx)
+{
+    size_t n = 0;
+    bpt_cursor c = bpt_lower_bound(tree, lo);
+
+    while (c.leaf)
+    {
+        const bpt_node *leaf = c.leaf;
+        for (int i = c.pos; i < leaf->count; i++)
+        {
+            if (leaf->keys[i] >= hi)
+                return n;
+            n++;
+            if (visit && visit(leaf->keys[i], leaf->u.l.values[i], ctx))
+                return n;
+        }
+        c.leaf = leaf->u.l.next;
+        c.pos = 0;
+    }
+    return n;
+}
+
+/**
+ * Inserts into the subtree below `node`, splitting it if it overflows
+ * @param node subtree root
+ * @param key key to insert
+ * @param value value of the key
+ * @param up_key receives the first key of the new right sibling on a split
+ * @param up_node receives the new right sibling on a split
+ * @returns 0 if the key existed (its value is replaced), 1 if it was added,
+ * 2 if it was added and `node` was split
+ */
+static int node_insert(bpt_node *node, int32_t key, void *value,
+                       int32_t *up_key, bpt_node **up_node)
+{
+    if (node->leaf)
+    {
+        int i = count_less(node->keys, key);
+        if (i < node->count && node->keys[i] == key)
+        {
+            node->u.l.values[i] = value;
+            return 0;
+        }
+
+        if (node->count < BPT_KEYS)
+        {
+            int move = node->count - i;
+            memmove(node->keys + i + 1, node->keys + i, move * sizeof(int32_t));
+            memmove(node->u.l.values + i + 1, node->u.l.values + i,
+                    move * sizeof(void *));
+            node->keys[i] = key;
+            node->u.l.values[i] = value;
+            node->count++;
+            return 1;
+        }
+
+        /* full leaf: the upper half moves to a new right sibling */
+        bpt_node *right = node_new(1);
+        int half = (BPT_KEYS + 1) / 2;
+        int32_t keys[BPT_KEYS + 1];
+        void *values[BPT_KEYS + 1];
+        memcpy(keys, node->keys, i * sizeof(int32_t));
+        memcpy(values, node->u.l.values, i * sizeof(void *));
+        keys[i] = key;
+        values[i] = value;
+        memcpy(keys + i + 1, node->keys + i, (BPT_KEYS - i) * sizeof(int32_t));
+        memcpy(values + i + 1, node->u.l.values + i,
+               (BPT_KEYS - i) * sizeof(void *));
+
+        for (int j = 0; j < BPT_KEYS; j++)
+        {
+            node->keys[j] = j < half ? keys[j] : BPT_PAD;
+            if (j < half)
+                node->u.l.values[j] = values[j];
+        }
+        node->count = half;
+        for (int j = half; j <= BPT_KEYS; j++)
+        {
+            right->keys[j - half] = keys[j];
+            right->u.l.values[j - half] = values[j];
+        }
+        right->count = BPT_KEYS + 1 - half;
+        right->u.l.next = node->u.l.next;
+        node->u.l.next = right;
+
+        *up_key = right->keys[0];
+        *up_node = right;
+        return 2;
+    }
+
+    int i = child_index(node, key);
+    int32_t child_key;
+    bpt_node *child_node;
+    int r = node_insert(node->u.children[i], key, value, &child_key,
+                        &child_node);
+    if (r != 2)
+        return r;
+
+    if (node->count < BPT_KEYS)
+    {
+        int move = node->count - i;
+        memmove(node->keys + i + 1, node->keys + i, move * sizeof(int32_t));
+        memmove(node->u.children + i + 2, node->u.children + i + 1,
+                move * sizeof(bpt_node *));
+        node->keys[i] = child_key;
+        node->u.children[i + 1] = child_node;
+        node->count++;
+        return 1;
+    }
+
+    /* full inner node: the middle separator moves up */
+    int32_t keys[BPT_KEYS + 1];
+    bpt_node *children[BPT_KEYS + 2];
+    memcpy(keys, node->keys, i * sizeof(int32_t));
+    keys[i] = child_key;
+    memcpy(keys + i + 1, node->keys + i, (BPT_KEYS - i) * sizeof(int32_t));
+    memcpy(children, node->u.children, (i + 1) * sizeof(bpt_node *));
+    children[i + 1] = child_node;
+    memcpy(children + i + 2, node->u.children + i + 1,
+           (BPT_KEYS - i) * sizeof(bpt_node *));
+
+    int mid = BPT_KEYS / 2;
+    bpt_node *right = node_new(0);
+    for (int j = 0; j < BPT_KEYS; j++)
+        node->keys[j] = j < mid ? keys[j] : BPT_PAD;
+    memcpy(node->u.children, children, (mid + 1) * sizeof(bpt_node *));
+    node->count = mid;
+    right->count = BPT_KEYS - mid;
+    memcpy(right->keys, keys + mid + 1, right->count * sizeof(int32_t));
+    memcpy(right->u.children, children + mid + 1,
+           (right->count + 1) * sizeof(bpt_node *));
+
+    *up_key = keys[mid];
+    *up_node = right;
+    return 2;
+}
+
+/**
+ * Inserts a key or replaces its value
+ * @param tree tree to insert into
+ * @param key key to insert
+ * @param value value of the key
+ * @returns 1 if the key was added, 0 if it already existed
+ */
+int bpt_insert(bpt_tree *tree, int32_t key, void *value)
+{
+    if (tree->root == NULL)
+    {
+        tree->root = node_new(1);
+        tree->height = 1;
+    }
+
+    int32_t up_key;
+    bpt_node *up_node;
+    int r = node_insert(tree->root, key, value, &up_key, &up_node);
+    if (r == 2)
+    {
+        bpt_node *root = node_new(0);
+        root->keys[0] = up_key;
+        root->count = 1;
+        root->u.children[0] = tree->root;
+        root->u.children[1] = up_node;
+        tree->root = root;
+        tree->height++;
+    }
+    if (r != 0)
+        tree->size++;
+    return r != 0;
+}
+
+/**
+ * Removes a key from its leaf. Under-full nodes are not merged.
+ * @param tree tree to erase from
+ * @param key key to remove
+ * @returns 1 if the key was removed, 0 if it was not present
+ */
+int bpt_erase(bpt_tree *tree, int32_t key)
+{
+    bpt_node *leaf = find_leaf(tree, key);
+    if (leaf == NULL)
+        return 0;
+    int i = count_less(leaf->keys, key);
+    if (i >= leaf->count || leaf->keys[i] != key)
+        return 0;
+
+    int move = leaf->count - i - 1;
+    memmove(leaf->keys + i, leaf->keys + i + 1, move * sizeof(int32_t));
+    memmove(leaf->u.l.values + i, leaf->u.l.values + i + 1,
+            move * sizeof(void *));
+    leaf->count--;
+    leaf->keys[leaf->count] = BPT_PAD;
+    tree->size--;
+    return 1;
+}
+
+/**
+ * Builds the tree bottom up from strictly increasing keys in O(n). Nodes are
+ * filled evenly up to `fill` keys, leaving room for later inserts.
+ * @param tree empty tree to fill
+ * @param keys sorted keys
+ * @param values value of each key, or NULL
+ * @param n number of keys
+ * @param fill keys per leaf, between 1 and ::BPT_KEYS
+ * @returns 0 on success, -1 if the tree is not empty or the keys unsorted
+ */
+int bpt_bulk_load(bpt_tree *tree, const int32_t *keys, void *const *values,
+                  size_t n, int fill)
+{
+    if (tree->root != NULL || fill < 1 || fill > BPT_KEYS)
+        return -1;
+    for (size_t i = 1; i < n; i++)
+        if (keys[i - 1] >= keys[i])
+            return -1;
+    if (n == 0)
+        return 0;
+
+    /* leaves, spread evenly so that none is nearly empty */
+    size_t count = (n + fill - 1) / fill;
+    bpt_node **level = (bpt_node **)malloc(count * sizeof(bpt_node *));
+    int32_t *mins = (int32_t *)malloc(count * sizeof(int32_t));
+    size_t pos = 0;
+    for (size_t j = 0; j < count; j++)
+    {
+        size_t take = n / count + (j < n % count);
+        bpt_node *leaf = node_new(1);
+        for (size_t k = 0; k < take; k++, pos++)
+        {
+            leaf->keys[k] = keys[pos];
+            leaf->u.l.values[k] = values ? values[pos] : NULL;
+        }
+        leaf->count = (int)take;
+        if (j > 0)
+            level[j - 1]->u.l.next = leaf;
+        level[j] = leaf;
+        mins[j] = leaf->keys[0];
+    }
+    tree->height = 1;
+
+    /* inner levels until a single node is left */
+    while (count > 1)
+    {
+        size_t parents = (count + BPT_KEYS) / (BPT_KEYS + 1);
+        size_t child = 0;
+        for (size_t j = 0; j < parents; j++)
+        {
+            size_t take = count / parents + (j < count % parents);
+            bpt_node *node = node_new(0);
+            int32_t first = mins[child];
+            for (size_t k = 0; k < take; k++, child++)
+            {
+                node->u.children[k] = level[child];
+                if (k > 0)
+                    node->keys[k - 1] = mins[child];
+            }
+            node->count = (int)take - 1;
+            level[j] = node;
+            mins[j] = first;
+        }
+        count = parents;
+        tree->height++;
+    }
+
+    tree->root = level[0];
+    tree->size = n;
+    free(level);
+    free(mins);
+    return 0;
+}
+
+/**
+ * Checks the ordering and linking invariants of a subtree
+ * @param node subtree root
+ * @param lo every key must be >= lo
+ * @param hi every key must be < hi (ignored when `has_hi` is 0)
+ * @param has_hi whether `hi` applies
+ * @param depth depth of `node`
+ * @param leaf_depth depth of the leaves, set on the first leaf reached
+ * @returns number of keys in the subtree
+ */
+static size_t check_node(const bpt_node *node, int64_t lo, int64_t hi,
+                         int has_hi, int depth, int *leaf_depth)
+{
+    for (int i = node->count; i < BPT_KEYS; i++)
+        assert(node->keys[i] == BPT_PAD);
+    for (int i = 1; i < node->count; i++)
+        assert(node->keys[i - 1] < node->keys[i]);
+    for (int i = 0; i < node->count; i++)
+    {
+        assert(node->keys[i] >= lo);
+        assert(!has_hi || node->keys[i] < hi);
+    }
+    if (node->leaf)
+    {
+        if (*leaf_depth < 0)
+            *leaf_depth = depth;
+        assert(*leaf_depth == depth);
+        return (size_t)node->count;
+    }
+
+    size_t n = 0;
+    for (int i = 0; i <= node->count; i++)
+    {
+        int64_t clo = i > 0 ? node->keys[i - 1] : lo;
+        int64_t chi = i < node->count ? node->keys[i] : hi;
+        int chas = i < node->count ? 1 : has_hi;
+        n += check_node(node->u.children[i], clo, chi, chas, depth + 1,
+                        leaf_depth);
+    }
+    return n;
+}
+
+/**
+ * Checks a whole tree, including the leaf chain
+ * @param tree tree to check
+ */
+static void check_tree(const bpt_tree *tree)
+{
+    if (tree->root == NULL)
+    {
+        assert(tree->size == 0);
+        return;
+    }
+    int leaf_depth = -1;
+    assert(check_node(tree->root, INT32_MIN, 0, 0, 1, &leaf_depth) ==
+           tree->size);
+    assert(leaf_depth == tree->height);
+
+    size_t n = 0;
+    int64_t prev = (int64_t)INT32_MIN - 1;
+    for (bpt_cursor c = bpt_lower_bound(tree, INT32_MIN); c.leaf;
+         bpt_cursor_next(&c))
+    {
+        assert(c.leaf->keys[c.pos] > prev);
+        prev = c.leaf->keys[c.pos];
+        n++;
+    }
+    assert(n == tree->size);
+}
+
+/** range scan callback summing the values */
+static int sum_values(int32_t key, void *value, void *ctx)
+{
+    (void)key;
+    *(long long *)ctx += (intptr_t)value;
+    return 0;
+}
+
+/**
+ * Self-test implementations
+ * @returns void
+ */
+static void test()
+{
+    enum
+    {
+        N = 20000
+    };
+    static char present[N];
+    bpt_tree tree;
+    bpt_init(&tree);
+
+    /* random inserts and erases against a presence table */
+    srand(3);
+    for (int i = 0; i < 60000; i++)
+    {
+        int32_t k = rand() % N;
+        if (rand() % 4)
+        {
+            assert(bpt_insert(&tree, k, (void *)(intptr_t)(k * 3)) ==
+                   !present[k]);
+            present[k] = 1;
+        }
+        else
+        {
+            assert(bpt_erase(&tree, k) == present[k]);
+            present[k] = 0;
+        }
+    }
+    check_tree(&tree);
+    for (int32_t k = 0; k < N; k++)
+    {
+        void *v = NULL;
+        assert(bpt_find(&tree, k, &v) == present[k]);
+        if (present[k])
+            assert((intptr_t)v == k * 3);
+    }
+
+    /* range scans */
+    for (int t = 0; t < 200; t++)
+    {
+        int32_t lo = rand() % N - 100, hi = lo + rand() % 2000;
+        long long expected = 0, sum = 0;
+        size_t count = 0;
+        for (int32_t k = lo < 0 ? 0 : lo; k < hi && k < N; k++)
+            if (present[k])
+            {
+                expected += k * 3;
+                count++;
+            }
+        assert(bpt_range(&tree, lo, hi, sum_values, &sum) == count);
+        assert(sum == expected);
+    }
+    bpt_cursor c = bpt_lower_bound(&tree, N);
+    assert(c.leaf == NULL);
+    bpt_destroy(&tree);
+
+    /* ascending and descending inserts split at the edges */
+    for (int32_t k = 0; k < 5000; k++) bpt_insert(&tree, k, NULL);
+    for (int32_t k = -1; k > -5000; k--) bpt_insert(&tree, k, NULL);
+    check_tree(&tree);
+    assert(tree.size == 9999);
+    assert(bpt_insert(&tree, INT32_MAX, NULL) == 1);
+    assert(bpt_find(&tree, INT32_MAX, NULL) == 1);
+    assert(bpt_find(&tree, INT32_MAX - 1, NULL) == 0);
+    check_tree(&tree);
+    bpt_destroy(&tree);
+
+    /* bulk loading for many sizes and fill factors */
+    static int32_t keys[N];
+    for (int i = 0; i < N; i++) keys[i] = 2 * i;
+    size_t sizes[] = {0, 1, 2, 63, 64, 65, 4160, 4161, 19999};
+    int fills[] = {1, 32, BPT_KEYS};
+    for (int s = 0; s < 9; s++)
+        for (int f = 0; f < 3; f++)
+        {
+            if (sizes[s] > 5000 && fills[f] == 1)
+                continue;
+            assert(bpt_bulk_load(&tree, keys, NULL, sizes[s], fills[f]) == 0);
+            check_tree(&tree);
+            for (size_t i = 0; i < sizes[s]; i += 7)
+            {
+                assert(bpt_find(&tree, keys[i], NULL));
+                assert(!bpt_find(&tree, keys[i] + 1, NULL));
+            }
+            /* inserting between the loaded keys still works */
+            for (size_t i = 0; i < sizes[s]; i += 3)
+                bpt_insert(&tree, keys[i] + 1, NULL);
+            check_tree(&tree);
+            bpt_destroy(&tree);
+        }
+    int32_t unsorted[] = {1, 3, 2};
+    assert(bpt_bulk_load(&tree, unsorted, NULL, 3, BPT_KEYS) == -1);
+
+    printf("All tests have successfully passed!\n");
+}
+
+/*
+ * Baselines for the benchmark: the int-key AVL insertion of avl_tree.c and
+ * the parent-linked red-black insertion of red_black_tree.c, each node a
+ * separate malloc, plus bounded in-order walks for the range scans.
+ */
+
+/** AVL node */
+typedef struct avl_node
+{
+    int32_t key;
+    int height;
+    struct avl_node *left, *right;
+} avl_node;
+
+/** @returns height of an AVL subtree */
+static int avl_h(const avl_node *n) { return n ? n->height : 0; }
+
+/** recomputes the height of an AVL node */
+static void avl_fix(avl_node *n)
+{
+    int l = avl_h(n->left), r = avl_h(n->right);
+    n->height = (l > r ? l : r) + 1;
+}
+
+/** @returns the new subtree root after a right rotation */
+static avl_node *avl_rotr(avl_node *z)
+{
+    avl_node *y = z->left;
+    z->left = y->right;
+    y->right = z;
+    avl_fix(z);
+    avl_fix(y);
+    return y;
+}
+
+/** @returns the new subtree root after a left rotation */
+static avl_node *avl_rotl(avl_node *z)
+{
+    avl_node *y = z->right;
+    z->right = y->left;
+    y->left = z;
+    avl_fix(z);
+    avl_fix(y);
+    return y;
+}
+
+/** @returns the subtree root after inserting `key` */
+static avl_node *avl_insert(avl_node *n, int32_t key)
+{
+    if (n == NULL)
+    {
+        n = (avl_node *)malloc(sizeof(avl_node));
+        n->key = key;
+        n->height = 1;
+        n->left = n->right = NULL;
+        return n;
+    }
+    if (key < n->key)
+        n->left = avl_insert(n->left, key);
+    else if (key > n->key)
+        n->right = avl_insert(n->right, key);
+    else
+        return n;
+    avl_fix(n);
+    int b = avl_h(n->left) - avl_h(n->right);
+    if (b > 1)
+    {
+        if (key > n->left->key)
+            n->left = avl_rotl(n->left);
+        return avl_rotr(n);
+    }
+    if (b < -1)
+    {
+        if (key < n->right->key)
+            n->right = avl_rotr(n->right);
+        return avl_rotl(n);
+    }
+    return n;
+}
+
+/** @returns 1 if `key` is in the AVL tree */
+static int avl_find(const avl_node *n, int32_t key)
+{
+    while (n && n->key != key) n = key < n->key ? n->left : n->right;
+    return n != NULL;
+}
+
+/** @returns number of keys of the AVL tree in `[lo, hi)` */
+static size_t avl_range(const avl_node *n, int32_t lo, int32_t hi)
+{
+    if (n == NULL)
+        return 0;
+    if (n->key < lo)
+        return avl_range(n->right, lo, hi);
+    if (n->key >= hi)
+        return avl_range(n->left, lo, hi);
+    return 1 + avl_range(n->left, lo, hi) + avl_range(n->right, lo, hi);
+}
+
+/** @brief frees an AVL tree */
+static void avl_free(avl_node *n)
+{
+    if (n == NULL)
+        return;
+    avl_free(n->left);
+    avl_free(n->right);
+    free(n);
+}
+
+/** red-black node */
+typedef struct rb_node
+{
+    int32_t key;
+    int red;
+    struct rb_node *par, *left, *right;
+} rb_node;
+
+/** rotates `x` down to the left, keeping `*root` up to date */
+static void rb_rotl(rb_node **root, rb_node *x)
+{
+    rb_node *y = x->right;
+    x->right = y->left;
+    if (y->left)
+        y->left->par = x;
+    y->par = x->par;
+    if (!x->par)
+        *root = y;
+    else if (x == x->par->left)
+        x->par->left = y;
+    else
+        x->par->right = y;
+    y->left = x;
+    x->par = y;
+}
+
+/** rotates `x` down to the right, keeping `*root` up to date */
+static void rb_rotr(rb_node **root, rb_node *x)
+{
+    rb_node *y = x->left;
+    x->left = y->right;
+    if (y->right)
+        y->right->par = x;
+    y->par = x->par;
+    if (!x->par)
+        *root = y;
+    else if (x == x->par->right)
+        x->par->right = y;
+    else
+        x->par->left = y;
+    y->right = x;
+    x->par = y;
+}
+
+/** inserts `key` into the red-black tree rooted at `*root` */
+static void rb_insert(rb_node **root, int32_t key)
+{
+    rb_node *p = NULL, **link = root;
+    while (*link)
+    {
+        p = *link;
+        if (key == p->key)
+            return;
+        link = key < p->key ? &p->left : &p->right;
+    }
+    rb_node *z = (rb_node *)malloc(sizeof(rb_node));
+    z->key = key;
+    z->red = 1;
+    z->par = p;
+    z->left = z->right = NULL;
+    *link = z;
+
+    while (z->par && z->par->red)
+    {
+        rb_node *g = z->par->par;
+        if (z->par == g->left)
+        {
+            rb_node *u = g->right;
+            if (u && u->red)
+            {
+                z->par->red = u->red = 0;
+                g->red = 1;
+                z = g;
+                continue;
+            }
+            if (z == z->par->right)
+            {
+                z = z->par;
+                rb_rotl(root, z);
+            }
+            z->par->red = 0;
+            g->red = 1;
+            rb_rotr(root, g);
+        }
+        else
+        {
+            rb_node *u = g->left;
+            if (u && u->red)
+            {
+                z->par->red = u->red = 0;
+                g->red = 1;
+                z = g;
+                continue;
+            }
+            if (z == z->par->left)
+            {
+                z = z->par;
+                rb_rotr(root, z);
+            }
+            z->par->red = 0;
+            g->red = 1;
+            rb_rotl(root, g);
+        }
+    }
+    (*root)->red = 0;
+}
+
+/** @returns 1 if `key` is in the red-black tree */
+static int rb_find(const rb_node *n, int32_t key)
+{
+    while (n && n->key != key) n = key < n->key ? n->left : n->right;
+    return n != NULL;
+}
+
+/** @returns number of keys of the red-black tree in `[lo, hi)` */
+static size_t rb_range(const rb_node *n, int32_t lo, int32_t hi)
+{
+    /* lower bound, then in-order successors through the parent links */
+    const rb_node *best = NULL;
+    while (n)
+    {
+        if (n->key >= lo)
+        {
+            best = n;
+            n = n->left;
+        }
+        else
+            n = n->right;
+    }
+    size_t count = 0;
+    for (n = best; n && n->key < hi; count++)
+    {
+        if (n->right)
+        {
+            n = n->right;
+            while (n->left) n = n->left;
+        }
+        else
+        {
+            while (n->par && n == n->par->right) n = n->par;
+            n = n->par;
+        }
+    }
+    return count;
+}
+
+/** @brief frees a red-black tree */
+static void rb_free(rb_node *n)
+{
+    if (n == NULL)
+        return;
+    rb_free(n->left);
+    rb_free(n->right);
+    free(n);
+}
+
+/** @returns seconds elapsed since `start` */
+static double elapsed(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/**
+ * Times building, point lookups and range scans for the three trees
+ * @param n number of keys
+ */
+static void benchmark(int n)
+{
+    const int queries = 1000000, scans = 20000, width = 1000;
+    int32_t *keys = (int32_t *)malloc(n * sizeof(int32_t));
+    int32_t *probes = (int32_t *)malloc(queries * sizeof(int32_t));
+    size_t hits;
+    clock_t t;
+
+    /* distinct keys in random order, spread over the whole range */
+    srand(7);
+    for (int i = 0; i < n; i++) keys[i] = 2 * i;
+    for (int i = n - 1; i > 0; i--)
+    {
+        int j = (int)(((long long)rand() * RAND_MAX + rand()) % (i + 1));
+        int32_t tmp = keys[i];
+        keys[i] = keys[j];
+        keys[j] = tmp;
+    }
+    for (int i = 0; i < queries; i++)
+        probes[i] = (int32_t)(((long long)rand() * RAND_MAX + rand()) %
+                              (2LL * n));
+
+    printf("\n%d keys, %d lookups, %d scans of %d keys\n", n, queries, scans,
+           width / 2);
+    printf("%-20s %10s %10s %10s\n", "", "build s", "lookup s", "scan s");
+
+    bpt_tree tree;
+    bpt_init(&tree);
+    t = clock();
+    for (int i = 0; i < n; i++) bpt_insert(&tree, keys[i], NULL);
+    double build = elapsed(t);
+    t = clock();
+    hits = 0;
+    for (int i = 0; i < queries; i++) hits += bpt_find(&tree, probes[i], NULL);
+    double lookup = elapsed(t);
+    t = clock();
+    size_t scanned = 0;
+    for (int i = 0; i < scans; i++)
+        scanned += bpt_range(&tree, probes[i], probes[i] + width, NULL, NULL);
+    printf("%-20s %10.3f %10.3f %10.3f\n", "b+ tree (insert)", build, lookup,
+           elapsed(t));
+    bpt_destroy(&tree);
+    size_t expect_hits = hits, expect_scanned = scanned;
+
+    int32_t *sorted = (int32_t *)malloc(n * sizeof(int32_t));
+    for (int i = 0; i < n; i++) sorted[i] = 2 * i;
+    t = clock();
+    bpt_bulk_load(&tree, sorted, NULL, n, BPT_KEYS);
+    build = elapsed(t);
+    t = clock();
+    hits = 0;
+    for (int i = 0; i < queries; i++) hits += bpt_find(&tree, probes[i], NULL);
+    lookup = elapsed(t);
+    t = clock();
+    scanned = 0;
+    for (int i = 0; i < scans; i++)
+        scanned += bpt_range(&tree, probes[i], probes[i] + width, NULL, NULL);
+    printf("%-20s %10.3f %10.3f %10.3f\n", "b+ tree (bulk load)", build,
+           lookup, elapsed(t));
+    assert(hits == expect_hits && scanned == expect_scanned);
+    bpt_destroy(&tree);
+    free(sorted);
+
+    avl_node *avl = NULL;
+    t = clock();
+    for (int i = 0; i < n; i++) avl = avl_insert(avl, keys[i]);
+    build = elapsed(t);
+    t = clock();
+    hits = 0;
+    for (int i = 0; i < queries; i++) hits += avl_find(avl, probes[i]);
+    lookup = elapsed(t);
+    t = clock();
+    scanned = 0;
+    for (int i = 0; i < scans; i++)
+        scanned += avl_range(avl, probes[i], probes[i] + width);
+    printf("%-20s %10.3f %10.3f %10.3f\n", "avl", build, lookup, elapsed(t));
+    assert(hits == expect_hits && scanned == expect_scanned);
+    avl_free(avl);
+
+    rb_node *rb = NULL;
+    t = clock();
+    for (int i = 0; i < n; i++) rb_insert(&rb, keys[i]);
+    build = elapsed(t);
+    t = clock();
+    hits = 0;
+    for (int i = 0; i < queries; i++) hits += rb_find(rb, probes[i]);
+    lookup = elapsed(t);
+    t = clock();
+    scanned = 0;
+    for (int i = 0; i < scans; i++)
+        scanned += rb_range(rb, probes[i], probes[i] + width);
+    printf("%-20s %10.3f %10.3f %10.3f\n", "red-black", build, lookup,
+           elapsed(t));
+    assert(hits == expect_hits && scanned == expect_scanned);
+    rb_free(rb);
+
+    free(keys);
+    free(probes);
+}
+
+/**
+ * Main function
+ * @param argc number of arguments
+ * @param argv optional number of keys for the benchmark (default 1M)
+ * @returns 0 on exit
+ */
+int main(int argc, char **argv)
+{
+    test();  // run self-test implementations
+
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (n > 0)
+        benchmark(n);
+    return 0;
+}
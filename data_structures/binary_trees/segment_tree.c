@@ -1,11 +1,17 @@
 /**
  * @file segment_tree.c
- * @brief segment trees with only point updates
+ * @brief segment trees with point updates, and lazy range updates
  * @details
  * This code implements segment trees. Segment trees are general structures
  * which allow range based queries in a given array in logN time.
  * Segment tree with point updates allow update of single element in the array
  * in logN time.
+ *
+ * The generic tree works on any element type through a `combine_function`.
+ * For 64-bit integers, ::SEGMENT_TREE_LAZY_DEFINE generates specialised trees
+ * (sum, min and max below) whose combine steps are inlined, and which support
+ * adding a value to a whole range in logN time with lazy propagation. Both
+ * updates and queries run bottom-up, without recursion.
  * [Learn more about segment trees
  * here](https://codeforces.com/blog/entry/18051)
  * @author [Lakhan Nad](https://github.com/Lakhan-Nad)
@@ -16,6 +22,10 @@
 #include <stdio.h>    /* for scanf printf */
 #include <stdlib.h>   /* for malloc, free */
 #include <string.h>   /* for memcpy, memset */
+#include <time.h>     /* for clock */
+#ifdef _OPENMP
+#include <omp.h> /* for parallel batch queries */
+#endif
 
 /**
  * Function that combines two data to generate a new one
@@ -163,6 +173,7 @@ void segment_tree_dispose(segment_tree *tree)
 {
     free(tree->root);
     free(tree->identity);
+    free(tree);
 }
 
 /**
@@ -183,6 +194,217 @@ void segment_tree_print_int(segment_tree *tree)
     printf("\n");
 }
 
+/** parallel loop over the queries of a batch, when OpenMP is available */
+#ifdef _OPENMP
+#define SEGMENT_TREE_PARALLEL_FOR _Pragma("omp parallel for schedule(static)")
+#else
+#define SEGMENT_TREE_PARALLEL_FOR
+#endif
+
+/**
+ * Generates a segment tree over `int64_t` with lazy range-add updates.
+ *
+ * The tree is stored as a perfect binary tree of `2 * size` nodes (`size` the
+ * smallest power of two >= length) with the leaves at `size .. 2 * size - 1`.
+ * Every inner node keeps a pending addition `lazy[k]` that has already been
+ * applied to `data[k]` but not yet to its children; it is pushed down only
+ * when a later operation needs to look below `k`. Queries skip that walk
+ * entirely while no addition is pending.
+ *
+ * For a given `NAME` this defines the type `segment_tree_NAME` and the
+ * functions `segment_tree_NAME_init`, `_dispose`, `_add`, `_query`,
+ * `_flush` and `_query_batch`. Ranges are inclusive `[l, r]`, like
+ * segment_tree_query().
+ *
+ * @param NAME suffix of the generated names
+ * @param COMBINE function-like macro combining two node values, its arguments
+ * are always plain variables or array elements
+ * @param IDENTITY identity element of `COMBINE`
+ * @param APPLY function-like macro `(value, add, len)` giving the value of a
+ * node covering `len` elements after adding `add` to each of them
+ */
+#define SEGMENT_TREE_LAZY_DEFINE(NAME, COMBINE, IDENTITY, APPLY)              \
+    typedef struct segment_tree_##NAME                                        \
+    {                                                                         \
+        int64_t *data; /**< node values, leaves from index `size` */         \
+        int64_t *lazy; /**< pending additions of the inner nodes */          \
+        size_t length; /**< number of elements */                            \
+        size_t size;   /**< number of leaves, a power of two */              \
+        int log;       /**< log2 of `size` */                                \
+        int dirty;     /**< whether some addition may still be pending */    \
+    } segment_tree_##NAME;                                                    \
+                                                                              \
+    /** adds `add` to every element below node `k` of height `h` */         \
+    static inline void segment_tree_##NAME##_apply(segment_tree_##NAME *t,   \
+                                                   size_t k, int64_t add,     \
+                                                   int h)                     \
+    {                                                                         \
+        int64_t len = (int64_t)1 << h;                                        \
+        (void)len;                                                            \
+        t->data[k] = APPLY(t->data[k], add, len);                             \
+        if (k < t->size)                                                      \
+            t->lazy[k] += add;                                                \
+    }                                                                         \
+                                                                              \
+    /** hands the pending addition of node `k` of height `h` to its children \
+     */                                                                       \
+    static inline void segment_tree_##NAME##_push(segment_tree_##NAME *t,    \
+                                                  size_t k, int h)            \
+    {                                                                         \
+        if (t->lazy[k] != 0)                                                  \
+        {                                                                     \
+            segment_tree_##NAME##_apply(t, 2 * k, t->lazy[k], h - 1);         \
+            segment_tree_##NAME##_apply(t, 2 * k + 1, t->lazy[k], h - 1);     \
+            t->lazy[k] = 0;                                                   \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    /** recomputes node `k` from its children */                             \
+    static inline void segment_tree_##NAME##_pull(segment_tree_##NAME *t,    \
+                                                  size_t k)                   \
+    {                                                                         \
+        t->data[k] = COMBINE(t->data[2 * k], t->data[2 * k + 1]);             \
+    }                                                                         \
+                                                                              \
+    /** builds the tree over `len` elements of `arr` (NULL for all zero) */  \
+    void segment_tree_##NAME##_init(segment_tree_##NAME *t,                   \
+                                    const int64_t *arr, size_t len)           \
+    {                                                                         \
+        t->length = len;                                                      \
+        t->dirty = 0;                                                         \
+        t->log = 0;                                                           \
+        while (((size_t)1 << t->log) < len) t->log++;                         \
+        t->size = (size_t)1 << t->log;                                        \
+        t->data = malloc(2 * t->size * sizeof(int64_t));                      \
+        t->lazy = calloc(t->size, sizeof(int64_t));                           \
+        for (size_t i = 0; i < t->size; i++)                                  \
+            t->data[t->size + i] =                                            \
+                i < len ? (arr ? arr[i] : 0) : (int64_t)(IDENTITY);           \
+        for (size_t k = t->size - 1; k >= 1; k--)                             \
+            segment_tree_##NAME##_pull(t, k);                                 \
+    }                                                                         \
+                                                                              \
+    /** frees the memory of the tree */                                      \
+    void segment_tree_##NAME##_dispose(segment_tree_##NAME *t)                \
+    {                                                                         \
+        free(t->data);                                                        \
+        free(t->lazy);                                                        \
+    }                                                                         \
+                                                                              \
+    /** adds `add` to every element of `[l, r]` */                           \
+    void segment_tree_##NAME##_add(segment_tree_##NAME *t, size_t l,          \
+                                   size_t r, int64_t add)                     \
+    {                                                                         \
+        l += t->size;                                                         \
+        r += t->size + 1;                                                     \
+        t->dirty = 1;                                                         \
+        /* settle the pending additions above both ends of the range */      \
+        for (int i = t->log; i >= 1; i--)                                     \
+        {                                                                     \
+            if (((l >> i) << i) != l)                                         \
+                segment_tree_##NAME##_push(t, l >> i, i);                     \
+            if (((r >> i) << i) != r)                                         \
+                segment_tree_##NAME##_push(t, (r - 1) >> i, i);               \
+        }                                                                     \
+        size_t l2 = l, r2 = r;                                                \
+        for (int h = 0; l2 < r2; h++, l2 >>= 1, r2 >>= 1)                     \
+        {                                                                     \
+            if (l2 & 1)                                                       \
+                segment_tree_##NAME##_apply(t, l2++, add, h);                 \
+            if (r2 & 1)                                                       \
+                segment_tree_##NAME##_apply(t, --r2, add, h);                 \
+        }                                                                     \
+        /* and recompute their ancestors */                                  \
+        for (int i = 1; i <= t->log; i++)                                     \
+        {                                                                     \
+            if (((l >> i) << i) != l)                                         \
+                segment_tree_##NAME##_pull(t, l >> i);                        \
+            if (((r >> i) << i) != r)                                         \
+                segment_tree_##NAME##_pull(t, (r - 1) >> i);                  \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    /** combines the nodes covering `[l, r)`, no additions may be pending */ \
+    static inline int64_t segment_tree_##NAME##_collect(                      \
+        const segment_tree_##NAME *t, size_t l, size_t r)                     \
+    {                                                                         \
+        int64_t res = (IDENTITY);                                             \
+        for (l += t->size, r += t->size; l < r; l >>= 1, r >>= 1)             \
+        {                                                                     \
+            if (l & 1)                                                        \
+            {                                                                 \
+                int64_t v = t->data[l++];                                     \
+                res = COMBINE(res, v);                                        \
+            }                                                                 \
+            if (r & 1)                                                        \
+            {                                                                 \
+                int64_t v = t->data[--r];                                     \
+                res = COMBINE(res, v);                                        \
+            }                                                                 \
+        }                                                                     \
+        return res;                                                           \
+    }                                                                         \
+                                                                              \
+    /** @returns the combination of the elements of `[l, r]` */              \
+    int64_t segment_tree_##NAME##_query(segment_tree_##NAME *t, size_t l,     \
+                                        size_t r)                             \
+    {                                                                         \
+        size_t lo = l + t->size, hi = r + t->size + 1;                        \
+        for (int i = t->dirty ? t->log : 0; i >= 1; i--)                      \
+        {                                                                     \
+            if (((lo >> i) << i) != lo)                                       \
+                segment_tree_##NAME##_push(t, lo >> i, i);                    \
+            if (((hi >> i) << i) != hi)                                       \
+                segment_tree_##NAME##_push(t, (hi - 1) >> i, i);              \
+        }                                                                     \
+        return segment_tree_##NAME##_collect(t, l, r + 1);                    \
+    }                                                                         \
+                                                                              \
+    /** pushes every pending addition down to the leaves, in O(length) */    \
+    void segment_tree_##NAME##_flush(segment_tree_##NAME *t)                  \
+    {                                                                         \
+        if (!t->dirty)                                                        \
+            return;                                                           \
+        t->dirty = 0;                                                         \
+        for (int i = t->log; i >= 1; i--)                                     \
+            for (size_t k = (size_t)1 << (t->log - i);                        \
+                 k < ((size_t)2 << (t->log - i)); k++)                        \
+                segment_tree_##NAME##_push(t, k, i);                          \
+    }                                                                         \
+                                                                              \
+    /**                                                                       \
+     * answers `count` queries `[l[i], r[i]]` into `out[i]`. Pending         \
+     * additions are flushed once, after which the tree is read-only and     \
+     * the queries are spread over the OpenMP threads.                        \
+     */                                                                       \
+    void segment_tree_##NAME##_query_batch(segment_tree_##NAME *t,            \
+                                           const size_t *l, const size_t *r,  \
+                                           int64_t *out, size_t count)        \
+    {                                                                         \
+        segment_tree_##NAME##_flush(t);                                       \
+        long long i;                                                          \
+        SEGMENT_TREE_PARALLEL_FOR                                             \
+        for (i = 0; i < (long long)count; i++)                                \
+            out[i] = segment_tree_##NAME##_collect(t, l[i], r[i] + 1);        \
+    }
+
+/** sum of two node values */
+#define SEGMENT_TREE_OP_SUM(a, b) ((a) + (b))
+/** minimum of two node values */
+#define SEGMENT_TREE_OP_MIN(a, b) ((a) < (b) ? (a) : (b))
+/** maximum of two node values */
+#define SEGMENT_TREE_OP_MAX(a, b) ((a) > (b) ? (a) : (b))
+/** range add on a sum node grows it once per element */
+#define SEGMENT_TREE_ADD_TO_SUM(v, add, len) ((v) + (add) * (len))
+/** range add on a min / max node shifts it once */
+#define SEGMENT_TREE_ADD_TO_EXTREMUM(v, add, len) ((v) + (add))
+
+SEGMENT_TREE_LAZY_DEFINE(sum64, SEGMENT_TREE_OP_SUM, 0, SEGMENT_TREE_ADD_TO_SUM)
+SEGMENT_TREE_LAZY_DEFINE(min64, SEGMENT_TREE_OP_MIN, INT64_MAX,
+                         SEGMENT_TREE_ADD_TO_EXTREMUM)
+SEGMENT_TREE_LAZY_DEFINE(max64, SEGMENT_TREE_OP_MAX, INT64_MIN,
+                         SEGMENT_TREE_ADD_TO_EXTREMUM)
+
 /**
  * Utility for test
  * A function compare for minimum between two integers
@@ -224,12 +446,186 @@ static void test()
     segment_tree_dispose(tree);
 }
 
+/**
+ * Test the lazy trees
+ * Random range additions and queries checked against a plain array, for
+ * lengths that are and are not powers of two
+ * @returns void
+ */
+static void test_lazy()
+{
+    size_t lengths[] = {1, 2, 7, 64, 100, 1000};
+    srand(11);
+    for (int t = 0; t < 6; t++)
+    {
+        size_t n = lengths[t];
+        int64_t *ref = malloc(n * sizeof(int64_t));
+        for (size_t i = 0; i < n; i++) ref[i] = rand() % 1000 - 500;
+
+        segment_tree_sum64 sum;
+        segment_tree_min64 mn;
+        segment_tree_max64 mx;
+        segment_tree_sum64_init(&sum, ref, n);
+        segment_tree_min64_init(&mn, ref, n);
+        segment_tree_max64_init(&mx, ref, n);
+
+        for (int op = 0; op < 2000; op++)
+        {
+            size_t l = rand() % n, r = rand() % n;
+            if (l > r)
+            {
+                size_t tmp = l;
+                l = r;
+                r = tmp;
+            }
+            if (op % 2)
+            {
+                int64_t add = rand() % 200 - 100;
+                for (size_t i = l; i <= r; i++) ref[i] += add;
+                segment_tree_sum64_add(&sum, l, r, add);
+                segment_tree_min64_add(&mn, l, r, add);
+                segment_tree_max64_add(&mx, l, r, add);
+                continue;
+            }
+            int64_t s = 0, lo = INT64_MAX, hi = INT64_MIN;
+            for (size_t i = l; i <= r; i++)
+            {
+                s += ref[i];
+                lo = ref[i] < lo ? ref[i] : lo;
+                hi = ref[i] > hi ? ref[i] : hi;
+            }
+            assert(segment_tree_sum64_query(&sum, l, r) == s);
+            assert(segment_tree_min64_query(&mn, l, r) == lo);
+            assert(segment_tree_max64_query(&mx, l, r) == hi);
+        }
+
+        /* batch answers match the single queries */
+        size_t ql[50], qr[50];
+        int64_t out[50];
+        for (int q = 0; q < 50; q++)
+        {
+            ql[q] = rand() % n;
+            qr[q] = ql[q] + rand() % (n - ql[q]);
+        }
+        segment_tree_sum64_add(&sum, 0, n - 1, 3);
+        for (size_t i = 0; i < n; i++) ref[i] += 3;
+        segment_tree_sum64_query_batch(&sum, ql, qr, out, 50);
+        for (int q = 0; q < 50; q++)
+        {
+            int64_t s = 0;
+            for (size_t i = ql[q]; i <= qr[q]; i++) s += ref[i];
+            assert(out[q] == s);
+            assert(segment_tree_sum64_query(&sum, ql[q], qr[q]) == s);
+        }
+
+        segment_tree_sum64_dispose(&sum);
+        segment_tree_min64_dispose(&mn);
+        segment_tree_max64_dispose(&mx);
+        free(ref);
+    }
+}
+
+/**
+ * Utility for the benchmark
+ * Sum of two 64-bit integers, as a combine_function
+ * @param a pointer to integer a
+ * @param b pointer to integer b
+ * @param c pointer where a + b is stored
+ */
+void sum_int64(const void *a, const void *b, void *c)
+{
+    *(int64_t *)c = *(const int64_t *)a + *(const int64_t *)b;
+}
+
+/**
+ * Benchmark of range sum queries: the generic tree against the specialised
+ * one, queried one by one and in a batch
+ * @param n number of elements
+ * @param q number of queries
+ * @returns void
+ */
+static void benchmark(size_t n, size_t q)
+{
+    int64_t *arr = malloc(n * sizeof(int64_t));
+    size_t *ql = malloc(q * sizeof(size_t)), *qr = malloc(q * sizeof(size_t));
+    int64_t *out = malloc(q * sizeof(int64_t));
+    for (size_t i = 0; i < n; i++) arr[i] = rand() % 1000;
+    for (size_t i = 0; i < q; i++)
+    {
+        size_t a = ((size_t)rand() * RAND_MAX + rand()) % n;
+        size_t b = ((size_t)rand() * RAND_MAX + rand()) % n;
+        ql[i] = a < b ? a : b;
+        qr[i] = a < b ? b : a;
+    }
+    printf("%zu elements, %zu queries\n", n, q);
+
+    int64_t identity = 0, res, check = 0;
+    segment_tree *generic =
+        segment_tree_init(arr, sizeof(int64_t), n, &identity, sum_int64);
+    segment_tree_build(generic);
+    clock_t start = clock();
+    for (size_t i = 0; i < q; i++)
+    {
+        segment_tree_query(generic, ql[i], qr[i], &res);
+        check += res;
+    }
+    double t = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("generic query        %8.2f Mqueries/s\n", q / t / 1e6);
+    segment_tree_dispose(generic);
+
+    segment_tree_sum64 tree;
+    segment_tree_sum64_init(&tree, arr, n);
+    start = clock();
+    for (size_t i = 0; i < q; i++)
+        segment_tree_sum64_add(&tree, ql[i], qr[i], 1);
+    t = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("sum64 range add      %8.2f Mupdates/s\n", q / t / 1e6);
+    segment_tree_sum64_dispose(&tree);
+
+    segment_tree_sum64_init(&tree, arr, n);
+    start = clock();
+    for (size_t i = 0; i < q; i++)
+        check -= segment_tree_sum64_query(&tree, ql[i], qr[i]);
+    t = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("sum64 query          %8.2f Mqueries/s\n", q / t / 1e6);
+    assert(check == 0);
+
+#ifdef _OPENMP
+    double wall = omp_get_wtime();
+    segment_tree_sum64_query_batch(&tree, ql, qr, out, q);
+    t = omp_get_wtime() - wall;
+#else
+    start = clock();
+    segment_tree_sum64_query_batch(&tree, ql, qr, out, q);
+    t = (double)(clock() - start) / CLOCKS_PER_SEC;
+#endif
+    printf("sum64 batch query    %8.2f Mqueries/s\n", q / t / 1e6);
+    segment_tree_sum64_dispose(&tree);
+
+    free(arr);
+    free(ql);
+    free(qr);
+    free(out);
+}
+
 /**
  * @brief Main Function
+ * @param argc number of arguments
+ * @param argv optional array length and number of queries to benchmark
  * @returns 0 on exit
  */
-int main()
+int main(int argc, char **argv)
 {
     test();
+    test_lazy();
+    printf("All tests have successfully passed!\n");
+
+    if (argc > 1)
+    {
+        size_t n = strtoul(argv[1], NULL, 10);
+        size_t q = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+        if (n > 0)
+            benchmark(n, q);
+    }
     return 0;
 }
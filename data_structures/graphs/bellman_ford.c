@@ -1,7 +1,12 @@
+#include <assert.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 // Structure for storing edge
 struct Edge
@@ -14,26 +19,43 @@ struct Graph
 {
     int vertexNum;
     int edgeNum;
+    int edgeCount;  // number of edges added so far with addEdge()
     struct Edge *edges;
 };
 
+// Relaxation strategies understood by bellmanFordDistances()
+enum BellmanFordMode
+{
+    BF_SEQUENTIAL,  // classic edge-list passes, stops on a pass with no update
+    BF_SPFA,        // queue based, only relaxes out-edges of changed vertices
+    BF_PARALLEL     // edge passes partitioned by destination across threads
+};
+
 // Constructs a graph with V vertices and E edges
 void createGraph(struct Graph *G, int V, int E)
 {
     G->vertexNum = V;
     G->edgeNum = E;
+    G->edgeCount = 0;
     G->edges = (struct Edge *)malloc(E * sizeof(struct Edge));
 }
 
+// Frees the edge array of the graph
+void destroyGraph(struct Graph *G)
+{
+    free(G->edges);
+    G->edges = NULL;
+    G->edgeNum = G->edgeCount = 0;
+}
+
 // Adds the given edge to the graph
 void addEdge(struct Graph *G, int src, int dst, int weight)
 {
-    static int ind;
     struct Edge newEdge;
     newEdge.src = src;
     newEdge.dst = dst;
     newEdge.weight = weight;
-    G->edges[ind++] = newEdge;
+    G->edges[G->edgeCount++] = newEdge;
 }
 
 // Utility function to find minimum distance vertex in mdist
@@ -59,61 +81,400 @@ void print(int dist[], int V)
         if (dist[i] != INT_MAX)
             printf("%d\t%d\n", i, dist[i]);
         else
-            printf("%d\tINF", i);
+            printf("%d\tINF\n", i);
     }
 }
 
-// The main function that finds the shortest path from given source
-// to all other vertices using Bellman-Ford.It also detects negative
-// weight cycle
-void BellmanFord(struct Graph *graph, int src)
+// Relaxes the edge u -> v of weight w against dist. Returns 1 if dist[v]
+// was lowered. The sum is done in long long so that large weights cannot
+// wrap around.
+static int relax(int *dist, int u, int v, int w)
+{
+    if (dist[u] == INT_MAX)
+        return 0;
+    long long cand = (long long)dist[u] + w;
+    if (cand < dist[v])
+    {
+        dist[v] = cand < INT_MIN ? INT_MIN : (int)cand;
+        return 1;
+    }
+    return 0;
+}
+
+// Builds a compressed adjacency (CSR) view of the edge list, grouped by
+// either the source (bySource = 1) or the destination vertex. offsets must
+// hold V + 1 entries and order E entries; order[offsets[x] .. offsets[x+1])
+// are the indices of the edges leaving (or entering) vertex x.
+static void buildIndex(const struct Graph *graph, int bySource, int *offsets,
+                       int *order)
+{
+    int V = graph->vertexNum;
+    int E = graph->edgeCount;
+
+    memset(offsets, 0, (V + 1) * sizeof(int));
+    for (int j = 0; j < E; j++)
+    {
+        int key = bySource ? graph->edges[j].src : graph->edges[j].dst;
+        offsets[key + 1]++;
+    }
+    for (int i = 0; i < V; i++) offsets[i + 1] += offsets[i];
+
+    int *fill = (int *)malloc(V * sizeof(int));
+    memcpy(fill, offsets, V * sizeof(int));
+    for (int j = 0; j < E; j++)
+    {
+        int key = bySource ? graph->edges[j].src : graph->edges[j].dst;
+        order[fill[key]++] = j;
+    }
+    free(fill);
+}
+
+// Classic Bellman-Ford over the edge array. A pass that lowers no distance
+// means every later pass would be a no-op too, so we stop there; in that
+// case there can be no reachable negative cycle either.
+static int bellmanFordSequential(const struct Graph *graph, int *dist)
+{
+    int V = graph->vertexNum;
+    int E = graph->edgeCount;
+    const struct Edge *edges = graph->edges;
+
+    // A path can contain maximum (|V|-1) edges, the V-th pass is the
+    // negative cycle check
+    for (int i = 0; i < V; i++)
+    {
+        int updated = 0;
+        for (int j = 0; j < E; j++)
+            updated |= relax(dist, edges[j].src, edges[j].dst,
+                             edges[j].weight);
+
+        if (!updated)
+            return 0;
+    }
+    return -1;
+}
+
+// Shortest Path Faster Algorithm: a FIFO of vertices whose distance went
+// down, so that only their out-edges are looked at again. A shortest path
+// never has more than V - 1 edges; if the path leading to a vertex gets
+// longer than that, it goes around a negative cycle.
+static int bellmanFordSPFA(const struct Graph *graph, int src, int *dist)
+{
+    int V = graph->vertexNum;
+    int E = graph->edgeCount;
+    const struct Edge *edges = graph->edges;
+    int result = 0;
+
+    int *offsets = (int *)malloc((V + 1) * sizeof(int));
+    int *order = (int *)malloc((E > 0 ? E : 1) * sizeof(int));
+    int *queue = (int *)malloc(V * sizeof(int));
+    int *pathLen = (int *)calloc(V, sizeof(int));
+    char *inQueue = (char *)calloc(V, sizeof(char));
+    buildIndex(graph, 1, offsets, order);
+
+    // circular queue, a vertex is never in it twice so V slots are enough
+    int head = 0, count = 0;
+    queue[0] = src;
+    inQueue[src] = 1;
+    count = 1;
+
+    while (count > 0 && result == 0)
+    {
+        int u = queue[head];
+        head = (head + 1) % V;
+        count--;
+        inQueue[u] = 0;
+
+        for (int k = offsets[u]; k < offsets[u + 1]; k++)
+        {
+            const struct Edge *e = &edges[order[k]];
+            if (!relax(dist, u, e->dst, e->weight))
+                continue;
+
+            pathLen[e->dst] = pathLen[u] + 1;
+            if (pathLen[e->dst] >= V)
+            {
+                result = -1;
+                break;
+            }
+            if (!inQueue[e->dst])
+            {
+                queue[(head + count) % V] = e->dst;
+                inQueue[e->dst] = 1;
+                count++;
+            }
+        }
+    }
+
+    free(offsets);
+    free(order);
+    free(queue);
+    free(pathLen);
+    free(inQueue);
+    return result;
+}
+
+// Multithreaded Bellman-Ford. The edges are grouped by destination so that
+// each thread owns a disjoint set of vertices to write to. Every pass reads
+// the distances of the previous pass and writes the new ones to a second
+// buffer (Jacobi style), so threads never race on the same element. After
+// k passes all shortest paths of at most k edges are final, which gives the
+// same V - 1 bound and V-th pass negative cycle check as the classic form.
+static int bellmanFordParallel(const struct Graph *graph, int *dist)
+{
+    int V = graph->vertexNum;
+    int E = graph->edgeCount;
+    const struct Edge *edges = graph->edges;
+    int result = -1;
+
+    int *offsets = (int *)malloc((V + 1) * sizeof(int));
+    int *order = (int *)malloc((E > 0 ? E : 1) * sizeof(int));
+    int *next = (int *)malloc(V * sizeof(int));
+    buildIndex(graph, 0, offsets, order);
+
+    int *cur = dist;
+    for (int i = 0; i < V; i++)
+    {
+        int updated = 0;
+        int v;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256) reduction(| : updated)
+#endif
+        for (v = 0; v < V; v++)
+        {
+            long long best = cur[v];
+            for (int k = offsets[v]; k < offsets[v + 1]; k++)
+            {
+                const struct Edge *e = &edges[order[k]];
+                if (cur[e->src] == INT_MAX)
+                    continue;
+                long long cand = (long long)cur[e->src] + e->weight;
+                if (cand < best)
+                    best = cand;
+            }
+            if (best < cur[v])
+                updated = 1;
+            next[v] = best < INT_MIN ? INT_MIN : (int)best;
+        }
+
+        int *tmp = cur;
+        cur = next;
+        next = tmp;
+        if (!updated)
+        {
+            result = 0;
+            break;
+        }
+    }
+
+    // the latest distances may live in the scratch buffer
+    if (cur != dist)
+    {
+        memcpy(dist, cur, V * sizeof(int));
+        next = cur;
+    }
+    free(next);
+    free(offsets);
+    free(order);
+    return result;
+}
+
+// Computes the distances from src to every vertex into dist (V entries,
+// INT_MAX for unreachable vertices) with the requested strategy.
+// Returns 0 on success and -1 if a negative weight cycle is reachable from
+// src, in which case the content of dist is not meaningful.
+int bellmanFordDistances(const struct Graph *graph, int src, int *dist,
+                         enum BellmanFordMode mode)
 {
     int V = graph->vertexNum;
-    int E = graph->edgeNum;
-    int dist[V];
 
     // Initialize distances array as INF for all except source
     // Intialize source as zero
     for (int i = 0; i < V; i++) dist[i] = INT_MAX;
     dist[src] = 0;
 
-    // Calculate shortest path distance from source to all edges
-    // A path can contain maximum (|V|-1) edges
-    for (int i = 0; i <= V - 1; i++)
+    switch (mode)
+    {
+    case BF_SPFA:
+        return bellmanFordSPFA(graph, src, dist);
+    case BF_PARALLEL:
+        return bellmanFordParallel(graph, dist);
+    case BF_SEQUENTIAL:
+    default:
+        return bellmanFordSequential(graph, dist);
+    }
+}
+
+// The main function that finds the shortest path from given source
+// to all other vertices using Bellman-Ford.It also detects negative
+// weight cycle
+void BellmanFord(struct Graph *graph, int src)
+{
+    int V = graph->vertexNum;
+    int *dist = (int *)malloc(V * sizeof(int));
+
+    if (bellmanFordDistances(graph, src, dist, BF_SEQUENTIAL) != 0)
+        printf(
+            "Graph contains negative weight cycle. Hence, shortest "
+            "distance not guaranteed.");
+    else
+        print(dist, V);
+
+    free(dist);
+    return;
+}
+
+// Runs all three strategies on the graph and checks that they agree
+static void checkAllModes(const struct Graph *G, int src, const int *expected,
+                          int expectedResult)
+{
+    int V = G->vertexNum;
+    int *dist = (int *)malloc(V * sizeof(int));
+    enum BellmanFordMode modes[] = {BF_SEQUENTIAL, BF_SPFA, BF_PARALLEL};
+
+    for (int m = 0; m < 3; m++)
+    {
+        int r = bellmanFordDistances(G, src, dist, modes[m]);
+        assert(r == expectedResult);
+        if (r == 0 && expected)
+            for (int i = 0; i < V; i++) assert(dist[i] == expected[i]);
+    }
+    free(dist);
+}
+
+// Self-test of the different relaxation strategies
+static void test()
+{
+    struct Graph G;
+
+    // graph with negative edges but no negative cycle
+    createGraph(&G, 6, 8);
+    addEdge(&G, 0, 1, 5);
+    addEdge(&G, 0, 2, 4);
+    addEdge(&G, 1, 3, 3);
+    addEdge(&G, 2, 1, -6);
+    addEdge(&G, 3, 2, 4);
+    addEdge(&G, 3, 4, -1);
+    addEdge(&G, 4, 0, 7);
+    addEdge(&G, 1, 4, 9);
+    int expected1[] = {0, -2, 4, 1, 0, INT_MAX};
+    checkAllModes(&G, 0, expected1, 0);
+    destroyGraph(&G);
+
+    // negative cycle 1 -> 2 -> 3 -> 1 reachable from 0
+    createGraph(&G, 5, 5);
+    addEdge(&G, 0, 1, 1);
+    addEdge(&G, 1, 2, -1);
+    addEdge(&G, 2, 3, -1);
+    addEdge(&G, 3, 1, -1);
+    addEdge(&G, 3, 4, 2);
+    checkAllModes(&G, 0, NULL, -1);
+    destroyGraph(&G);
+
+    // the same cycle is harmless when unreachable from the source
+    createGraph(&G, 5, 4);
+    addEdge(&G, 1, 2, -1);
+    addEdge(&G, 2, 3, -1);
+    addEdge(&G, 3, 1, -1);
+    addEdge(&G, 0, 4, 3);
+    int expected3[] = {0, INT_MAX, INT_MAX, INT_MAX, 3};
+    checkAllModes(&G, 0, expected3, 0);
+    destroyGraph(&G);
+
+    // random graphs: all modes must agree with each other
+    srand(10);
+    for (int t = 0; t < 20; t++)
+    {
+        int V = 2 + rand() % 60;
+        int E = rand() % (4 * V);
+        createGraph(&G, V, E);
+        // weights of the form w + p[u] - p[v] with w >= 0 can be negative,
+        // but the potentials cancel out around any cycle
+        int *p = (int *)malloc(V * sizeof(int));
+        for (int i = 0; i < V; i++) p[i] = rand() % 50;
         for (int j = 0; j < E; j++)
         {
-            int u = graph->edges[j].src;
-            int v = graph->edges[j].dst;
-            int w = graph->edges[j].weight;
-
-            if (dist[u] != INT_MAX && dist[u] + w < dist[v])
-                dist[v] = dist[u] + w;
+            int u = rand() % V, v = rand() % V;
+            addEdge(&G, u, v, rand() % 20 + p[u] - p[v]);
         }
+        free(p);
+        int *ref = (int *)malloc(V * sizeof(int));
+        assert(bellmanFordDistances(&G, 0, ref, BF_SEQUENTIAL) == 0);
+        checkAllModes(&G, 0, ref, 0);
+        free(ref);
+        destroyGraph(&G);
+    }
 
-    // Iterate inner loop once more to check for negative cycle
+    printf("All tests have successfully passed!\n");
+}
+
+// Times each strategy on a random graph with V vertices and E edges
+static void benchmark(int V, int E)
+{
+    struct Graph G;
+    createGraph(&G, V, E);
+    srand(42);
+    int *p = (int *)malloc(V * sizeof(int));
+    for (int i = 0; i < V; i++) p[i] = rand() % 1000;
+    // a long chain keeps some shortest paths deep, the rest is random;
+    // potentials give negative edges without any negative cycle
     for (int j = 0; j < E; j++)
     {
-        int u = graph->edges[j].src;
-        int v = graph->edges[j].dst;
-        int w = graph->edges[j].weight;
-
-        if (dist[u] != INT_MAX && dist[u] + w < dist[v])
+        int u, v;
+        if (j < V - 1)
         {
-            printf(
-                "Graph contains negative weight cycle. Hence, shortest "
-                "distance not guaranteed.");
-            return;
+            u = j;
+            v = j + 1;
         }
+        else
+        {
+            u = rand() % V;
+            v = rand() % V;
+        }
+        addEdge(&G, u, v, rand() % 100 + p[u] - p[v]);
     }
+    free(p);
 
-    print(dist, V);
+    const char *names[] = {"sequential", "SPFA", "parallel"};
+    enum BellmanFordMode modes[] = {BF_SEQUENTIAL, BF_SPFA, BF_PARALLEL};
+    int *dist = (int *)malloc(V * sizeof(int));
 
-    return;
+#ifdef _OPENMP
+    printf("Using OpenMP with %d threads\n", omp_get_max_threads());
+#endif
+    printf("Benchmark: %d vertices, %d edges\n", V, E);
+    for (int m = 0; m < 3; m++)
+    {
+#ifdef _OPENMP
+        double t0 = omp_get_wtime();
+        int r = bellmanFordDistances(&G, 0, dist, modes[m]);
+        double t = omp_get_wtime() - t0;
+#else
+        clock_t t0 = clock();
+        int r = bellmanFordDistances(&G, 0, dist, modes[m]);
+        double t = (double)(clock() - t0) / CLOCKS_PER_SEC;
+#endif
+        printf("%-12s %.4f s%s\n", names[m], t,
+               r ? " (negative cycle)" : "");
+    }
+
+    free(dist);
+    destroyGraph(&G);
 }
 
 // Driver Function
-int main()
+// Pass "-b [V] [E]" to run the benchmark instead of the interactive prompt
+int main(int argc, char **argv)
 {
+    test();
+
+    if (argc > 1 && strcmp(argv[1], "-b") == 0)
+    {
+        int V = argc > 2 ? atoi(argv[2]) : 100000;
+        int E = argc > 3 ? atoi(argv[3]) : 1000000;
+        benchmark(V, E);
+        return 0;
+    }
+
     int V, E, gsrc;
     int src, dst, weight;
     struct Graph G;
@@ -135,6 +496,7 @@ int main()
     printf("\nEnter source:");
     scanf("%d", &gsrc);
     BellmanFord(&G, gsrc);
+    destroyGraph(&G);
 
     return 0;
 }
@@ -0,0 +1,276 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "priority_queue.h"
+
+#define ELEM(pq, i) ((pq)->data + (i) * (pq)->elem_size)
+
+/* ---------------------------------------------------------------------
+    generic heap
+   --------------------------------------------------------------------- */
+
+int pq_init(pq_t *pq, size_t elem_size, pq_cmp_t cmp, unsigned arity)
+{
+    pq->elem_size = elem_size;
+    pq->cmp = cmp;
+    pq->arity = arity ? arity : PQ_DEFAULT_ARITY;
+    pq->count = 0;
+    pq->capacity = 16;
+    pq->data = (char *)malloc(pq->capacity * elem_size);
+    pq->tmp = (char *)malloc(elem_size);
+    if (pq->data == NULL || pq->tmp == NULL || pq->arity < 2)
+    {
+        pq_destroy(pq);
+        return -1;
+    }
+    return 0;
+}
+
+void pq_destroy(pq_t *pq)
+{
+    free(pq->data);
+    free(pq->tmp);
+    pq->data = pq->tmp = NULL;
+    pq->count = pq->capacity = 0;
+}
+
+static int pq_reserve(pq_t *pq, size_t n)
+{
+    if (n <= pq->capacity)
+        return 0;
+    size_t capacity = pq->capacity ? pq->capacity : 16;
+    while (capacity < n) capacity *= 2;
+    char *data = (char *)realloc(pq->data, capacity * pq->elem_size);
+    if (data == NULL)
+        return -1;
+    pq->data = data;
+    pq->capacity = capacity;
+    return 0;
+}
+
+/* moves the element held in pq->tmp up from the hole at index i */
+static void pq_sift_up(pq_t *pq, size_t i)
+{
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / pq->arity;
+        if (pq->cmp(pq->tmp, ELEM(pq, parent)) >= 0)
+            break;
+        memcpy(ELEM(pq, i), ELEM(pq, parent), pq->elem_size);
+        i = parent;
+    }
+    memcpy(ELEM(pq, i), pq->tmp, pq->elem_size);
+}
+
+/* moves the element held in pq->tmp down from the hole at index i */
+static void pq_sift_down(pq_t *pq, size_t i)
+{
+    size_t n = pq->count;
+
+    for (;;)
+    {
+        size_t first = i * pq->arity + 1;
+        if (first >= n)
+            break;
+        size_t last = first + pq->arity < n ? first + pq->arity : n;
+
+        size_t best = first;
+        for (size_t c = first + 1; c < last; c++)
+            if (pq->cmp(ELEM(pq, c), ELEM(pq, best)) < 0)
+                best = c;
+
+        if (pq->cmp(ELEM(pq, best), pq->tmp) >= 0)
+            break;
+        memcpy(ELEM(pq, i), ELEM(pq, best), pq->elem_size);
+        i = best;
+    }
+    memcpy(ELEM(pq, i), pq->tmp, pq->elem_size);
+}
+
+int pq_push(pq_t *pq, const void *elem)
+{
+    if (pq_reserve(pq, pq->count + 1) != 0)
+        return -1;
+    memcpy(pq->tmp, elem, pq->elem_size);
+    pq_sift_up(pq, pq->count++);
+    return 0;
+}
+
+int pq_pop(pq_t *pq, void *out)
+{
+    if (pq->count == 0)
+        return -1;
+    if (out != NULL)
+        memcpy(out, ELEM(pq, 0), pq->elem_size);
+    if (--pq->count > 0)
+    {
+        memcpy(pq->tmp, ELEM(pq, pq->count), pq->elem_size);
+        pq_sift_down(pq, 0);
+    }
+    return 0;
+}
+
+void *pq_top(const pq_t *pq) { return pq->count ? pq->data : NULL; }
+
+int pq_heapify(pq_t *pq, const void *arr, size_t n)
+{
+    if (pq_reserve(pq, n) != 0)
+        return -1;
+    memcpy(pq->data, arr, n * pq->elem_size);
+    pq->count = n;
+
+    /* sift down every inner node, deepest first */
+    if (n > 1)
+        for (size_t i = (n - 2) / pq->arity + 1; i-- > 0;)
+        {
+            memcpy(pq->tmp, ELEM(pq, i), pq->elem_size);
+            pq_sift_down(pq, i);
+        }
+    return 0;
+}
+
+/* ---------------------------------------------------------------------
+    indexed heap
+   --------------------------------------------------------------------- */
+
+int ipq_init(ipq_t *pq, size_t capacity, unsigned arity)
+{
+    pq->arity = arity ? arity : PQ_DEFAULT_ARITY;
+    pq->count = 0;
+    pq->capacity = capacity;
+    pq->heap = (ipq_entry_t *)malloc(capacity * sizeof(ipq_entry_t));
+    pq->position = (int *)malloc(capacity * sizeof(int));
+    if (!pq->heap || !pq->position || pq->arity < 2)
+    {
+        ipq_destroy(pq);
+        return -1;
+    }
+    for (size_t i = 0; i < capacity; i++) pq->position[i] = -1;
+    return 0;
+}
+
+void ipq_destroy(ipq_t *pq)
+{
+    free(pq->heap);
+    free(pq->position);
+    pq->heap = NULL;
+    pq->position = NULL;
+    pq->count = pq->capacity = 0;
+}
+
+int ipq_contains(const ipq_t *pq, int id)
+{
+    return id >= 0 && (size_t)id < pq->capacity && pq->position[id] >= 0;
+}
+
+/* moves entry e up from the hole at index i */
+static void ipq_sift_up(ipq_t *pq, size_t i, ipq_entry_t e)
+{
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / pq->arity;
+        if (pq->heap[parent].priority <= e.priority)
+            break;
+        pq->heap[i] = pq->heap[parent];
+        pq->position[pq->heap[i].id] = (int)i;
+        i = parent;
+    }
+    pq->heap[i] = e;
+    pq->position[e.id] = (int)i;
+}
+
+/* moves entry e down from the hole at index i */
+static void ipq_sift_down(ipq_t *pq, size_t i, ipq_entry_t e)
+{
+    size_t n = pq->count;
+
+    for (;;)
+    {
+        size_t first = i * pq->arity + 1;
+        if (first >= n)
+            break;
+        size_t last = first + pq->arity < n ? first + pq->arity : n;
+
+        size_t best = first;
+        for (size_t c = first + 1; c < last; c++)
+            if (pq->heap[c].priority < pq->heap[best].priority)
+                best = c;
+
+        if (pq->heap[best].priority >= e.priority)
+            break;
+        pq->heap[i] = pq->heap[best];
+        pq->position[pq->heap[i].id] = (int)i;
+        i = best;
+    }
+    pq->heap[i] = e;
+    pq->position[e.id] = (int)i;
+}
+
+int ipq_push(ipq_t *pq, int id, int64_t priority)
+{
+    if (id < 0 || (size_t)id >= pq->capacity)
+        return -1;
+
+    ipq_entry_t e = {priority, id};
+    int pos = pq->position[id];
+    if (pos >= 0)
+    {
+        if (priority < pq->heap[pos].priority)
+            ipq_sift_up(pq, pos, e);
+        else
+            ipq_sift_down(pq, pos, e);
+        return 0;
+    }
+
+    ipq_sift_up(pq, pq->count++, e);
+    return 0;
+}
+
+int ipq_decrease_key(ipq_t *pq, int id, int64_t priority)
+{
+    if (!ipq_contains(pq, id))
+        return -1;
+    int pos = pq->position[id];
+    if (priority > pq->heap[pos].priority)
+        return -1;
+
+    ipq_entry_t e = {priority, id};
+    ipq_sift_up(pq, pos, e);
+    return 0;
+}
+
+int ipq_pop(ipq_t *pq, int *id, int64_t *priority)
+{
+    if (pq->count == 0)
+        return -1;
+
+    ipq_entry_t top = pq->heap[0];
+    if (id != NULL)
+        *id = top.id;
+    if (priority != NULL)
+        *priority = top.priority;
+    pq->position[top.id] = -1;
+
+    if (--pq->count > 0)
+        ipq_sift_down(pq, 0, pq->heap[pq->count]);
+    return 0;
+}
+
+int ipq_heapify(ipq_t *pq, const int64_t *priority, size_t n)
+{
+    if (n > pq->capacity)
+        return -1;
+    for (size_t i = n; i < pq->capacity; i++) pq->position[i] = -1;
+    for (size_t i = 0; i < n; i++)
+    {
+        pq->heap[i].priority = priority[i];
+        pq->heap[i].id = (int)i;
+        pq->position[i] = (int)i;
+    }
+    pq->count = n;
+
+    if (n > 1)
+        for (size_t i = (n - 2) / pq->arity + 1; i-- > 0;)
+            ipq_sift_down(pq, i, pq->heap[i]);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#ifndef __PRIORITY_QUEUE__
+#define __PRIORITY_QUEUE__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    d-ary heaps.
+
+    pq_t is a generic heap of fixed size elements ordered by a comparator;
+    the element for which cmp() says "smallest" is on top, so a max-heap is
+    a min-heap with the comparator reversed.
+
+    ipq_t is an indexed min-heap of integer ids [0, capacity) with int64_t
+    priorities. It remembers where every id sits in the heap, which gives
+    decrease_key() in O(log n) as needed by Dijkstra or Prim.
+
+    Each node has `arity` children. With 4 children the heap is half as
+    deep as a binary one and the children of a node share a cache line, so
+    pops do fewer cache misses for a few more comparisons.
+*/
+
+#define PQ_DEFAULT_ARITY 4
+
+typedef int (*pq_cmp_t)(const void *a, const void *b);
+
+typedef struct
+{
+    char *data;
+    size_t elem_size;
+    size_t count;
+    size_t capacity;
+    unsigned arity;
+    pq_cmp_t cmp;
+    char *tmp; /* one element of scratch space */
+} pq_t;
+
+/* the priority is kept next to the id so that comparing the children of a
+ * node reads one contiguous run of memory */
+typedef struct
+{
+    int64_t priority;
+    int id;
+} ipq_entry_t;
+
+typedef struct
+{
+    ipq_entry_t *heap; /* entries in heap order */
+    int *position;     /* index of every id in heap, -1 when absent */
+    size_t count;
+    size_t capacity;
+    unsigned arity;
+} ipq_t;
+
+/* an arity of 0 selects PQ_DEFAULT_ARITY; functions returning int give 0 on
+ * success and -1 on failure */
+extern int pq_init(pq_t *pq, size_t elem_size, pq_cmp_t cmp, unsigned arity);
+
+extern void pq_destroy(pq_t *pq);
+
+extern int pq_push(pq_t *pq, const void *elem);
+
+/* copies the top element into out (if not NULL) and removes it */
+extern int pq_pop(pq_t *pq, void *out);
+
+/* top element or NULL when empty, valid until the next modification */
+extern void *pq_top(const pq_t *pq);
+
+/* replaces the content with n elements of arr in O(n) */
+extern int pq_heapify(pq_t *pq, const void *arr, size_t n);
+
+extern int ipq_init(ipq_t *pq, size_t capacity, unsigned arity);
+
+extern void ipq_destroy(ipq_t *pq);
+
+extern int ipq_contains(const ipq_t *pq, int id);
+
+/* inserts id, or moves it if already present */
+extern int ipq_push(ipq_t *pq, int id, int64_t priority);
+
+/* lowers the priority of an id already in the heap */
+extern int ipq_decrease_key(ipq_t *pq, int id, int64_t priority);
+
+extern int ipq_pop(ipq_t *pq, int *id, int64_t *priority);
+
+/* fills the heap with ids 0 .. n-1 of the given priorities in O(n) */
+extern int ipq_heapify(ipq_t *pq, const int64_t *priority, size_t n);
+
+#endif
@@ -0,0 +1,387 @@
+/*
+    Tests of the d-ary priority queues and a push / pop benchmark against
+    the binary heap of min_heap.c and the sorted-on-removal linked list of
+    linked_list/ascending_priority_queue.c. Both baselines are copied in
+    below, as those files are standalone programs.
+
+    usage: ./test_priority_queue [number of elements]
+*/
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "priority_queue.h"
+
+static int cmp_int(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_int_desc(const void *a, const void *b) { return cmp_int(b, a); }
+
+typedef struct
+{
+    double cost;
+    int task;
+} job_t;
+
+static int cmp_job(const void *a, const void *b)
+{
+    double x = ((const job_t *)a)->cost, y = ((const job_t *)b)->cost;
+    return (x > y) - (x < y);
+}
+
+/* shortest distances from vertex 0 on a dense weight matrix (-1 = no edge),
+   with the indexed heap */
+static void dijkstra_heap(int n, const int *w, int64_t *dist)
+{
+    ipq_t pq;
+    ipq_init(&pq, n, 0);
+    for (int i = 0; i < n; i++) dist[i] = INT64_MAX;
+    dist[0] = 0;
+    ipq_push(&pq, 0, 0);
+
+    int u;
+    int64_t d;
+    while (ipq_pop(&pq, &u, &d) == 0)
+        for (int v = 0; v < n; v++)
+        {
+            if (w[u * n + v] < 0 || d + w[u * n + v] >= dist[v])
+                continue;
+            int first = dist[v] == INT64_MAX;
+            dist[v] = d + w[u * n + v];
+            if (first)
+                ipq_push(&pq, v, dist[v]);
+            else
+                assert(ipq_decrease_key(&pq, v, dist[v]) == 0);
+        }
+    ipq_destroy(&pq);
+}
+
+/* the same, scanning for the closest unvisited vertex every time */
+static void dijkstra_scan(int n, const int *w, int64_t *dist)
+{
+    char *done = (char *)calloc(n, 1);
+    for (int i = 0; i < n; i++) dist[i] = INT64_MAX;
+    dist[0] = 0;
+    for (;;)
+    {
+        int u = -1;
+        for (int i = 0; i < n; i++)
+            if (!done[i] && dist[i] != INT64_MAX &&
+                (u < 0 || dist[i] < dist[u]))
+                u = i;
+        if (u < 0)
+            break;
+        done[u] = 1;
+        for (int v = 0; v < n; v++)
+            if (w[u * n + v] >= 0 && dist[u] + w[u * n + v] < dist[v])
+                dist[v] = dist[u] + w[u * n + v];
+    }
+    free(done);
+}
+
+static void test()
+{
+    enum
+    {
+        N = 3000
+    };
+    static int values[N];
+    pq_t pq;
+
+    srand(2);
+    for (int i = 0; i < N; i++) values[i] = rand() % 1000;
+
+    /* pushes and heapify give the same ascending order for any arity */
+    unsigned arities[] = {2, 3, 4, 8};
+    for (int a = 0; a < 4; a++)
+    {
+        assert(pq_init(&pq, sizeof(int), cmp_int, arities[a]) == 0);
+        for (int i = 0; i < N; i++) pq_push(&pq, &values[i]);
+        int prev = INT_MIN, x;
+        for (int i = 0; i < N; i++)
+        {
+            assert(*(int *)pq_top(&pq) >= prev);
+            assert(pq_pop(&pq, &x) == 0);
+            assert(x >= prev);
+            prev = x;
+        }
+        assert(pq_top(&pq) == NULL && pq_pop(&pq, &x) == -1);
+
+        pq_heapify(&pq, values, N);
+        prev = INT_MIN;
+        while (pq_pop(&pq, &x) == 0)
+        {
+            assert(x >= prev);
+            prev = x;
+        }
+        pq_destroy(&pq);
+    }
+
+    /* reversed comparator turns it into a max-heap of structs */
+    pq_init(&pq, sizeof(int), cmp_int_desc, 0);
+    pq_heapify(&pq, values, 10);
+    int x, max = values[0];
+    for (int i = 1; i < 10; i++) max = values[i] > max ? values[i] : max;
+    pq_pop(&pq, &x);
+    assert(x == max);
+    pq_destroy(&pq);
+
+    job_t jobs[] = {{2.5, 0}, {0.5, 1}, {1.5, 2}};
+    pq_init(&pq, sizeof(job_t), cmp_job, 2);
+    for (int i = 0; i < 3; i++) pq_push(&pq, &jobs[i]);
+    job_t j;
+    pq_pop(&pq, &j);
+    assert(j.task == 1);
+    pq_pop(&pq, &j);
+    assert(j.task == 2);
+    pq_destroy(&pq);
+
+    /* indexed heap against a plain table */
+    ipq_t ipq;
+    static int64_t prio[N];
+    static char in[N];
+    assert(ipq_init(&ipq, N, 0) == 0);
+    for (int step = 0; step < 20000; step++)
+    {
+        int id = rand() % N;
+        int op = rand() % 4;
+        if (op < 2)
+        {
+            prio[id] = rand() % 100000;
+            in[id] = 1;
+            ipq_push(&ipq, id, prio[id]);
+        }
+        else if (op == 2 && in[id])
+        {
+            prio[id] -= rand() % 100;
+            assert(ipq_decrease_key(&ipq, id, prio[id]) == 0);
+        }
+        else if (ipq.count > 0)
+        {
+            int64_t best = INT64_MAX, p;
+            for (int i = 0; i < N; i++)
+                if (in[i] && prio[i] < best)
+                    best = prio[i];
+            assert(ipq_pop(&ipq, &id, &p) == 0);
+            assert(p == best && prio[id] == best && in[id]);
+            in[id] = 0;
+        }
+        assert(ipq_contains(&ipq, id) == in[id]);
+    }
+    assert(ipq_decrease_key(&ipq, N, 0) == -1);
+    for (int i = 0; i < N; i++) prio[i] = rand() % 50;
+    ipq_heapify(&ipq, prio, N);
+    int64_t prev = -1, p;
+    int id;
+    while (ipq_pop(&ipq, &id, &p) == 0)
+    {
+        assert(p >= prev && p == prio[id]);
+        prev = p;
+    }
+    ipq_destroy(&ipq);
+
+    /* decrease-key driven Dijkstra */
+    int n = 200;
+    int *w = (int *)malloc(n * n * sizeof(int));
+    int64_t *d1 = (int64_t *)malloc(n * sizeof(int64_t));
+    int64_t *d2 = (int64_t *)malloc(n * sizeof(int64_t));
+    for (int i = 0; i < n * n; i++) w[i] = rand() % 10 ? -1 : rand() % 100;
+    dijkstra_heap(n, w, d1);
+    dijkstra_scan(n, w, d2);
+    for (int i = 0; i < n; i++) assert(d1[i] == d2[i]);
+    free(w);
+    free(d1);
+    free(d2);
+
+    printf("All tests have successfully passed!\n");
+}
+
+/* ---------------------------------------------------------------------
+    baselines
+   --------------------------------------------------------------------- */
+
+/* min_heap.c: binary heap of int, recursive sifts, grows and shrinks */
+typedef struct
+{
+    int *p;
+    int size;
+    int count;
+} Heap;
+
+static void heap_down(Heap *heap, int index)
+{
+    int left = index * 2 + 1, right = index * 2 + 2, smallest = index;
+    if (left < heap->count && heap->p[left] < heap->p[smallest])
+        smallest = left;
+    if (right < heap->count && heap->p[right] < heap->p[smallest])
+        smallest = right;
+    if (smallest != index)
+    {
+        int t = heap->p[index];
+        heap->p[index] = heap->p[smallest];
+        heap->p[smallest] = t;
+        heap_down(heap, smallest);
+    }
+}
+
+static void heap_up(Heap *heap, int index)
+{
+    int parent = (index - 1) / 2;
+    if (index > 0 && heap->p[index] < heap->p[parent])
+    {
+        int t = heap->p[index];
+        heap->p[index] = heap->p[parent];
+        heap->p[parent] = t;
+        heap_up(heap, parent);
+    }
+}
+
+static void heap_push(Heap *heap, int x)
+{
+    heap->p[heap->count++] = x;
+    if (4 * heap->count >= 3 * heap->size)
+    {
+        heap->size *= 2;
+        heap->p = (int *)realloc(heap->p, heap->size * sizeof(int));
+    }
+    heap_up(heap, heap->count - 1);
+}
+
+static int heap_pop(Heap *heap)
+{
+    int top = heap->p[0];
+    heap->p[0] = heap->p[--heap->count];
+    heap_down(heap, 0);
+    if (4 * heap->count <= heap->size && heap->size > 1)
+    {
+        heap->size /= 2;
+        heap->p = (int *)realloc(heap->p, heap->size * sizeof(int));
+    }
+    return top;
+}
+
+/* ascending_priority_queue.c: unsorted list, removal scans for the minimum */
+struct node
+{
+    int data;
+    struct node *next;
+};
+
+static void list_insert(struct node **front, int x)
+{
+    struct node *n = (struct node *)malloc(sizeof(struct node));
+    n->data = x;
+    n->next = *front;
+    *front = n;
+}
+
+static int list_remove_min(struct node **front)
+{
+    struct node **min = front;
+    for (struct node **p = front; *p; p = &(*p)->next)
+        if ((*p)->data < (*min)->data)
+            min = p;
+    struct node *n = *min;
+    int x = n->data;
+    *min = n->next;
+    free(n);
+    return x;
+}
+
+/* ---------------------------------------------------------------------
+    benchmark
+   --------------------------------------------------------------------- */
+
+static double seconds(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void benchmark(int n)
+{
+    int *values = (int *)malloc(n * sizeof(int));
+    long long check = 0, sum = 0;
+    clock_t t;
+
+    for (int i = 0; i < n; i++)
+    {
+        values[i] = rand();
+        check += values[i];
+    }
+    printf("\n%d random ints, push all then pop all (seconds)\n", n);
+
+    for (unsigned arity = 2; arity <= 8; arity *= 2)
+    {
+        pq_t pq;
+        pq_init(&pq, sizeof(int), cmp_int, arity);
+        t = clock();
+        for (int i = 0; i < n; i++) pq_push(&pq, &values[i]);
+        int x;
+        sum = 0;
+        while (pq_pop(&pq, &x) == 0) sum += x;
+        printf("generic %u-ary heap      %8.3f\n", arity, seconds(t));
+        assert(sum == check);
+
+        t = clock();
+        pq_heapify(&pq, values, n);
+        sum = 0;
+        while (pq_pop(&pq, &x) == 0) sum += x;
+        printf("generic %u-ary heapify   %8.3f\n", arity, seconds(t));
+        assert(sum == check);
+        pq_destroy(&pq);
+    }
+
+    ipq_t ipq;
+    ipq_init(&ipq, n, 0);
+    t = clock();
+    for (int i = 0; i < n; i++) ipq_push(&ipq, i, values[i]);
+    int id;
+    int64_t p;
+    sum = 0;
+    while (ipq_pop(&ipq, &id, &p) == 0) sum += p;
+    printf("indexed 4-ary heap      %8.3f\n", seconds(t));
+    assert(sum == check);
+    ipq_destroy(&ipq);
+
+    Heap heap = {(int *)malloc(sizeof(int)), 1, 0};
+    t = clock();
+    for (int i = 0; i < n; i++) heap_push(&heap, values[i]);
+    sum = 0;
+    while (heap.count > 0) sum += heap_pop(&heap);
+    printf("min_heap.c binary heap  %8.3f\n", seconds(t));
+    assert(sum == check);
+    free(heap.p);
+
+    /* quadratic, so only on a slice */
+    int m = n < 20000 ? n : 20000;
+    struct node *front = NULL;
+    t = clock();
+    for (int i = 0; i < m; i++) list_insert(&front, values[i]);
+    while (front) list_remove_min(&front);
+    double list_t = seconds(t);
+    pq_t pq;
+    pq_init(&pq, sizeof(int), cmp_int, 0);
+    t = clock();
+    for (int i = 0; i < m; i++) pq_push(&pq, &values[i]);
+    while (pq_pop(&pq, NULL) == 0) continue;
+    printf("linked list, %d elems  %8.3f  (4-ary heap: %.3f)\n", m, list_t,
+           seconds(t));
+    pq_destroy(&pq);
+
+    free(values);
+}
+
+int main(int argc, char **argv)
+{
+    test();
+
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (n > 0)
+        benchmark(n);
+    return 0;
+}
@@ -0,0 +1,475 @@
+/*
+    Self-test of the ordered map and an insert / lookup / erase throughput
+    comparison against an AVL tree and an unbalanced binary search tree.
+
+    The AVL and BST below are the int-key algorithms of
+    binary_trees/avl_tree.c and binary_trees/binary_search_tree.c (one
+    malloc per node, recursive insert and delete), reduced to what the
+    benchmark needs since those files are standalone programs.
+
+    usage: ./main [number of keys]
+*/
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ordered_map.h"
+
+/* ---------------------------------------------------------------------
+    helpers for the tests
+   --------------------------------------------------------------------- */
+
+static int cmp_int(const void *a, const void *b)
+{
+    intptr_t x = (intptr_t)a, y = (intptr_t)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_str(const void *a, const void *b)
+{
+    return strcmp((const char *)a, (const char *)b);
+}
+
+/* checks the red-black properties below `node` and returns its black height */
+static int check_subtree(const omap_t *map, const omap_node_t *node)
+{
+    if (node == NULL)
+        return 1;
+
+    if (node->left != NULL)
+    {
+        assert(node->left->parent == node);
+        assert(map->cmp(node->left->key, node->key) < 0);
+    }
+    if (node->right != NULL)
+    {
+        assert(node->right->parent == node);
+        assert(map->cmp(node->right->key, node->key) > 0);
+    }
+    if (node->red)
+    {
+        assert(node->left == NULL || !node->left->red);
+        assert(node->right == NULL || !node->right->red);
+    }
+
+    int lh = check_subtree(map, node->left);
+    int rh = check_subtree(map, node->right);
+    assert(lh == rh);
+    return lh + !node->red;
+}
+
+static void check_map(const omap_t *map)
+{
+    assert(map->root == NULL || (!map->root->red && !map->root->parent));
+    check_subtree(map, map->root);
+
+    /* in-order walk must be sorted and match the size */
+    size_t count = 0;
+    const omap_node_t *prev = NULL;
+    for (omap_node_t *n = omap_first(map); n != NULL; n = omap_next(n))
+    {
+        if (prev != NULL)
+            assert(map->cmp(prev->key, n->key) < 0);
+        prev = n;
+        count++;
+    }
+    assert(count == map->size);
+}
+
+static int sum_visit(const void *key, void *value, void *ctx)
+{
+    (void)value;
+    *(long *)ctx += (long)(intptr_t)key;
+    return 0;
+}
+
+static int stop_after_three(const void *key, void *value, void *ctx)
+{
+    (void)key;
+    (void)value;
+    return ++*(int *)ctx == 3;
+}
+
+static void test()
+{
+    enum
+    {
+        N = 2000
+    };
+    static char present[N];
+    omap_t map;
+    omap_init(&map, cmp_int);
+
+    /* random inserts and erases checked against a presence table */
+    srand(5);
+    for (int i = 0; i < 20000; i++)
+    {
+        intptr_t k = rand() % N;
+        if (rand() % 3)
+        {
+            int r = omap_insert(&map, (void *)k, (void *)(k * 2));
+            assert(r == !present[k]);
+            present[k] = 1;
+        }
+        else
+        {
+            assert(omap_erase(&map, (void *)k) == present[k]);
+            present[k] = 0;
+        }
+        if (i % 1000 == 0)
+            check_map(&map);
+    }
+    check_map(&map);
+    for (intptr_t k = 0; k < N; k++)
+    {
+        omap_node_t *n = omap_find(&map, (void *)k);
+        assert((n != NULL) == present[k]);
+        if (n)
+            assert((intptr_t)n->value == k * 2);
+    }
+
+    /* lower / upper bound and range walks */
+    for (intptr_t k = -1; k <= N; k++)
+    {
+        intptr_t lb = k < 0 ? 0 : k;
+        while (lb < N && !present[lb]) lb++;
+        omap_node_t *n = omap_lower_bound(&map, (void *)k);
+        assert(lb == N ? n == NULL : (intptr_t)n->key == lb);
+
+        intptr_t ub = k + 1 < 0 ? 0 : k + 1;
+        while (ub < N && !present[ub]) ub++;
+        n = omap_upper_bound(&map, (void *)k);
+        assert(ub >= N ? n == NULL : (intptr_t)n->key == ub);
+    }
+    long sum = 0, expected = 0;
+    for (int k = 100; k < 700; k++)
+        if (present[k])
+            expected += k;
+    omap_range(&map, (void *)100, (void *)700, sum_visit, &sum);
+    assert(sum == expected);
+    int seen = 0;
+    assert(omap_range(&map, NULL, NULL, stop_after_three, &seen) == 3);
+
+    /* backwards iteration visits everything too */
+    size_t back = 0;
+    for (omap_node_t *n = omap_last(&map); n != NULL; n = omap_prev(n))
+        back++;
+    assert(back == map.size);
+
+    /* erase everything, the nodes go back to the pool */
+    while (map.root != NULL) omap_erase_node(&map, map.root);
+    assert(map.size == 0);
+    omap_destroy(&map);
+
+    /* bulk loading gives a valid tree for every size */
+    static const void *keys[N];
+    for (intptr_t i = 0; i < N; i++) keys[i] = (void *)(3 * i);
+    for (size_t n = 0; n <= 300; n++)
+    {
+        omap_init(&map, cmp_int);
+        assert(omap_build_sorted(&map, keys, NULL, n) == 0);
+        check_map(&map);
+        /* and stays valid under further updates */
+        omap_insert(&map, (void *)(intptr_t)1, NULL);
+        omap_erase(&map, (void *)(intptr_t)0);
+        check_map(&map);
+        omap_destroy(&map);
+    }
+    omap_init(&map, cmp_int);
+    const void *unsorted[] = {(void *)1, (void *)3, (void *)2};
+    assert(omap_build_sorted(&map, unsorted, NULL, 3) == -1);
+    omap_destroy(&map);
+
+    /* any comparator can be used */
+    const char *words[] = {"pear", "apple", "fig", "banana", "cherry"};
+    omap_init(&map, cmp_str);
+    for (int i = 0; i < 5; i++) omap_insert(&map, words[i], NULL);
+    check_map(&map);
+    assert(strcmp(omap_lower_bound(&map, "c")->key, "cherry") == 0);
+    assert(strcmp(omap_first(&map)->key, "apple") == 0);
+    assert(omap_range(&map, "b", "g", NULL, NULL) == 3);
+    omap_destroy(&map);
+
+    printf("All tests have successfully passed!\n");
+}
+
+/* ---------------------------------------------------------------------
+    baselines for the benchmark
+   --------------------------------------------------------------------- */
+
+typedef struct avl_node
+{
+    int key;
+    struct avl_node *left;
+    struct avl_node *right;
+    int height;
+} avl_node;
+
+static int avl_height(avl_node *n) { return n ? n->height : -1; }
+
+static int avl_diff(avl_node *n)
+{
+    return n ? avl_height(n->left) - avl_height(n->right) : 0;
+}
+
+static void avl_update(avl_node *n)
+{
+    int l = avl_height(n->left), r = avl_height(n->right);
+    n->height = (l > r ? l : r) + 1;
+}
+
+static avl_node *avl_rotate_right(avl_node *z)
+{
+    avl_node *y = z->left;
+    z->left = y->right;
+    y->right = z;
+    avl_update(z);
+    avl_update(y);
+    return y;
+}
+
+static avl_node *avl_rotate_left(avl_node *z)
+{
+    avl_node *y = z->right;
+    z->right = y->left;
+    y->left = z;
+    avl_update(z);
+    avl_update(y);
+    return y;
+}
+
+static avl_node *avl_balance(avl_node *node)
+{
+    avl_update(node);
+    int balance = avl_diff(node);
+    if (balance > 1)
+    {
+        if (avl_diff(node->left) < 0)
+            node->left = avl_rotate_left(node->left);
+        return avl_rotate_right(node);
+    }
+    if (balance < -1)
+    {
+        if (avl_diff(node->right) > 0)
+            node->right = avl_rotate_right(node->right);
+        return avl_rotate_left(node);
+    }
+    return node;
+}
+
+static avl_node *avl_insert(avl_node *node, int key)
+{
+    if (node == NULL)
+    {
+        node = (avl_node *)malloc(sizeof(avl_node));
+        node->key = key;
+        node->left = node->right = NULL;
+        node->height = 0;
+        return node;
+    }
+    if (key < node->key)
+        node->left = avl_insert(node->left, key);
+    else if (key > node->key)
+        node->right = avl_insert(node->right, key);
+    return avl_balance(node);
+}
+
+static avl_node *avl_delete(avl_node *node, int key)
+{
+    if (node == NULL)
+        return NULL;
+    if (key < node->key)
+        node->left = avl_delete(node->left, key);
+    else if (key > node->key)
+        node->right = avl_delete(node->right, key);
+    else if (node->left == NULL || node->right == NULL)
+    {
+        avl_node *child = node->left ? node->left : node->right;
+        free(node);
+        return child;
+    }
+    else
+    {
+        avl_node *min = node->right;
+        while (min->left != NULL) min = min->left;
+        node->key = min->key;
+        node->right = avl_delete(node->right, min->key);
+    }
+    return avl_balance(node);
+}
+
+static avl_node *avl_find(avl_node *node, int key)
+{
+    while (node != NULL && node->key != key)
+        node = key < node->key ? node->left : node->right;
+    return node;
+}
+
+typedef struct bst_node
+{
+    struct bst_node *left;
+    struct bst_node *right;
+    int data;
+} bst_node;
+
+static bst_node *bst_insert(bst_node *root, int data)
+{
+    if (root == NULL)
+    {
+        root = (bst_node *)malloc(sizeof(bst_node));
+        root->data = data;
+        root->left = root->right = NULL;
+    }
+    else if (data > root->data)
+        root->right = bst_insert(root->right, data);
+    else if (data < root->data)
+        root->left = bst_insert(root->left, data);
+    return root;
+}
+
+static bst_node *bst_delete(bst_node *root, int data)
+{
+    if (root == NULL)
+        return NULL;
+    if (data > root->data)
+        root->right = bst_delete(root->right, data);
+    else if (data < root->data)
+        root->left = bst_delete(root->left, data);
+    else if (root->left == NULL || root->right == NULL)
+    {
+        bst_node *child = root->left ? root->left : root->right;
+        free(root);
+        return child;
+    }
+    else
+    {
+        bst_node *max = root->left;
+        while (max->right != NULL) max = max->right;
+        root->data = max->data;
+        root->left = bst_delete(root->left, max->data);
+    }
+    return root;
+}
+
+static int bst_find(bst_node *root, int data)
+{
+    while (root != NULL && root->data != data)
+        root = data < root->data ? root->left : root->right;
+    return root != NULL;
+}
+
+/* ---------------------------------------------------------------------
+    benchmark
+   --------------------------------------------------------------------- */
+
+static double seconds(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void shuffle(int *a, int n)
+{
+    for (int i = n - 1; i > 0; i--)
+    {
+        int j = rand() % (i + 1);
+        int t = a[i];
+        a[i] = a[j];
+        a[j] = t;
+    }
+}
+
+static void report(const char *name, int n, double ins, double find,
+                   double del)
+{
+    printf("%-16s insert %7.2f  lookup %7.2f  erase %7.2f  Mops/s\n", name,
+           n / ins / 1e6, n / find / 1e6, n / del / 1e6);
+}
+
+static void benchmark(int n)
+{
+    int *order = (int *)malloc(n * sizeof(int));
+    int *probe = (int *)malloc(n * sizeof(int));
+    clock_t t;
+    double ins, find, del;
+    long hits = 0;
+
+    srand(1);
+    for (int i = 0; i < n; i++) order[i] = probe[i] = i;
+    shuffle(order, n);
+    shuffle(probe, n);
+    printf("\n%d random keys\n", n);
+
+    omap_t map;
+    omap_init(&map, cmp_int);
+    t = clock();
+    for (int i = 0; i < n; i++)
+        omap_insert(&map, (void *)(intptr_t)order[i], NULL);
+    ins = seconds(t);
+    t = clock();
+    for (int i = 0; i < n; i++)
+        hits += omap_find(&map, (void *)(intptr_t)probe[i]) != NULL;
+    find = seconds(t);
+    t = clock();
+    for (int i = 0; i < n; i++) omap_erase(&map, (void *)(intptr_t)probe[i]);
+    del = seconds(t);
+    report("red-black (map)", n, ins, find, del);
+    omap_destroy(&map);
+
+    avl_node *avl = NULL;
+    t = clock();
+    for (int i = 0; i < n; i++) avl = avl_insert(avl, order[i]);
+    ins = seconds(t);
+    t = clock();
+    for (int i = 0; i < n; i++) hits += avl_find(avl, probe[i]) != NULL;
+    find = seconds(t);
+    t = clock();
+    for (int i = 0; i < n; i++) avl = avl_delete(avl, probe[i]);
+    del = seconds(t);
+    report("avl", n, ins, find, del);
+
+    bst_node *bst = NULL;
+    t = clock();
+    for (int i = 0; i < n; i++) bst = bst_insert(bst, order[i]);
+    ins = seconds(t);
+    t = clock();
+    for (int i = 0; i < n; i++) hits += bst_find(bst, probe[i]);
+    find = seconds(t);
+    t = clock();
+    for (int i = 0; i < n; i++) bst = bst_delete(bst, probe[i]);
+    del = seconds(t);
+    report("bst", n, ins, find, del);
+
+    /* sorted input: bulk load against one insert at a time */
+    const void **keys = (const void **)malloc(n * sizeof(void *));
+    for (int i = 0; i < n; i++) keys[i] = (void *)(intptr_t)i;
+    omap_init(&map, cmp_int);
+    t = clock();
+    for (int i = 0; i < n; i++) omap_insert(&map, keys[i], NULL);
+    ins = seconds(t);
+    omap_destroy(&map);
+    omap_init(&map, cmp_int);
+    t = clock();
+    omap_build_sorted(&map, keys, NULL, n);
+    double bulk = seconds(t);
+    omap_destroy(&map);
+    printf("sorted input     insert %7.2f  bulk load %7.2f  Mops/s\n",
+           n / ins / 1e6, n / bulk / 1e6);
+
+    assert(hits == 3L * n);
+    free(keys);
+    free(order);
+    free(probe);
+}
+
+int main(int argc, char **argv)
+{
+    test();
+
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (n > 0)
+        benchmark(n);
+    return 0;
+}
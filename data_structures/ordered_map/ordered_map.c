@@ -0,0 +1,498 @@
+#include <stdlib.h>
+
+#include "ordered_map.h"
+
+/* ---------------------------------------------------------------------
+    node pool
+   --------------------------------------------------------------------- */
+
+/* pushes a fresh block able to hold at least `count` nodes */
+static int pool_grow(omap_t *map, size_t count)
+{
+    size_t capacity = map->blocks ? map->blocks->capacity * 2
+                                  : OMAP_POOL_MIN_BLOCK;
+    if (capacity > OMAP_POOL_MAX_BLOCK)
+        capacity = OMAP_POOL_MAX_BLOCK;
+    if (capacity < count)
+        capacity = count;
+
+    omap_block_t *block = (omap_block_t *)malloc(
+        sizeof(omap_block_t) + capacity * sizeof(omap_node_t));
+    if (block == NULL)
+        return -1;
+
+    block->capacity = capacity;
+    block->next = map->blocks;
+    map->blocks = block;
+    map->block_used = 0;
+    return 0;
+}
+
+static omap_node_t *node_alloc(omap_t *map)
+{
+    if (map->free_list != NULL)
+    {
+        omap_node_t *node = map->free_list;
+        map->free_list = node->right;
+        return node;
+    }
+    if (map->blocks == NULL || map->block_used == map->blocks->capacity)
+    {
+        if (pool_grow(map, 1) != 0)
+            return NULL;
+    }
+    return &map->blocks->nodes[map->block_used++];
+}
+
+static void node_free(omap_t *map, omap_node_t *node)
+{
+    node->right = map->free_list;
+    map->free_list = node;
+}
+
+void omap_init(omap_t *map, omap_cmp_t cmp)
+{
+    map->root = NULL;
+    map->size = 0;
+    map->cmp = cmp;
+    map->blocks = NULL;
+    map->block_used = 0;
+    map->free_list = NULL;
+}
+
+void omap_clear(omap_t *map)
+{
+    omap_block_t *block = map->blocks;
+    while (block != NULL)
+    {
+        omap_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    map->root = NULL;
+    map->size = 0;
+    map->blocks = NULL;
+    map->block_used = 0;
+    map->free_list = NULL;
+}
+
+void omap_destroy(omap_t *map) { omap_clear(map); }
+
+/* ---------------------------------------------------------------------
+    red-black tree primitives
+   --------------------------------------------------------------------- */
+
+/* puts `v` where `u` hangs from its parent (or the root) */
+static void replace_child(omap_t *map, omap_node_t *u, omap_node_t *v)
+{
+    if (u->parent == NULL)
+        map->root = v;
+    else if (u == u->parent->left)
+        u->parent->left = v;
+    else
+        u->parent->right = v;
+    if (v != NULL)
+        v->parent = u->parent;
+}
+
+static void rotate_left(omap_t *map, omap_node_t *x)
+{
+    omap_node_t *y = x->right;
+
+    x->right = y->left;
+    if (y->left != NULL)
+        y->left->parent = x;
+    replace_child(map, x, y);
+    y->left = x;
+    x->parent = y;
+}
+
+static void rotate_right(omap_t *map, omap_node_t *x)
+{
+    omap_node_t *y = x->left;
+
+    x->left = y->right;
+    if (y->right != NULL)
+        y->right->parent = x;
+    replace_child(map, x, y);
+    y->right = x;
+    x->parent = y;
+}
+
+static int is_red(const omap_node_t *node) { return node && node->red; }
+
+static void insert_fixup(omap_t *map, omap_node_t *node)
+{
+    omap_node_t *parent;
+
+    while ((parent = node->parent) != NULL && parent->red)
+    {
+        /* a red parent is never the root, so the grand parent exists */
+        omap_node_t *grand = parent->parent;
+
+        if (parent == grand->left)
+        {
+            omap_node_t *uncle = grand->right;
+            if (is_red(uncle))
+            {
+                parent->red = uncle->red = 0;
+                grand->red = 1;
+                node = grand;
+                continue;
+            }
+            if (node == parent->right)
+            {
+                rotate_left(map, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = 0;
+            grand->red = 1;
+            rotate_right(map, grand);
+        }
+        else
+        {
+            omap_node_t *uncle = grand->left;
+            if (is_red(uncle))
+            {
+                parent->red = uncle->red = 0;
+                grand->red = 1;
+                node = grand;
+                continue;
+            }
+            if (node == parent->left)
+            {
+                rotate_right(map, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = 0;
+            grand->red = 1;
+            rotate_left(map, grand);
+        }
+    }
+    map->root->red = 0;
+}
+
+/* `x` (possibly NULL) is one black short; `parent` is its parent */
+static void erase_fixup(omap_t *map, omap_node_t *x, omap_node_t *parent)
+{
+    while (x != map->root && !is_red(x))
+    {
+        if (x == parent->left)
+        {
+            omap_node_t *w = parent->right;
+            if (w->red)
+            {
+                w->red = 0;
+                parent->red = 1;
+                rotate_left(map, parent);
+                w = parent->right;
+            }
+            if (!is_red(w->left) && !is_red(w->right))
+            {
+                w->red = 1;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if (!is_red(w->right))
+            {
+                w->left->red = 0;
+                w->red = 1;
+                rotate_right(map, w);
+                w = parent->right;
+            }
+            w->red = parent->red;
+            parent->red = 0;
+            w->right->red = 0;
+            rotate_left(map, parent);
+        }
+        else
+        {
+            omap_node_t *w = parent->left;
+            if (w->red)
+            {
+                w->red = 0;
+                parent->red = 1;
+                rotate_right(map, parent);
+                w = parent->left;
+            }
+            if (!is_red(w->left) && !is_red(w->right))
+            {
+                w->red = 1;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if (!is_red(w->left))
+            {
+                w->right->red = 0;
+                w->red = 1;
+                rotate_left(map, w);
+                w = parent->left;
+            }
+            w->red = parent->red;
+            parent->red = 0;
+            w->left->red = 0;
+            rotate_right(map, parent);
+        }
+        x = map->root;
+    }
+    if (x != NULL)
+        x->red = 0;
+}
+
+/* ---------------------------------------------------------------------
+    public interface
+   --------------------------------------------------------------------- */
+
+int omap_insert(omap_t *map, const void *key, void *value)
+{
+    omap_node_t *parent = NULL;
+    omap_node_t **link = &map->root;
+
+    while (*link != NULL)
+    {
+        parent = *link;
+        int c = map->cmp(key, parent->key);
+        if (c == 0)
+        {
+            parent->value = value;
+            return 0;
+        }
+        link = c < 0 ? &parent->left : &parent->right;
+    }
+
+    omap_node_t *node = node_alloc(map);
+    if (node == NULL)
+        return -1;
+    node->key = key;
+    node->value = value;
+    node->left = node->right = NULL;
+    node->parent = parent;
+    node->red = 1;
+    *link = node;
+    map->size++;
+
+    insert_fixup(map, node);
+    return 1;
+}
+
+omap_node_t *omap_find(const omap_t *map, const void *key)
+{
+    omap_node_t *node = map->root;
+
+    while (node != NULL)
+    {
+        int c = map->cmp(key, node->key);
+        if (c == 0)
+            return node;
+        node = c < 0 ? node->left : node->right;
+    }
+    return NULL;
+}
+
+void omap_erase_node(omap_t *map, omap_node_t *z)
+{
+    omap_node_t *x, *x_parent;
+    int removed_red = z->red;
+
+    if (z->left == NULL)
+    {
+        x = z->right;
+        x_parent = z->parent;
+        replace_child(map, z, z->right);
+    }
+    else if (z->right == NULL)
+    {
+        x = z->left;
+        x_parent = z->parent;
+        replace_child(map, z, z->left);
+    }
+    else
+    {
+        /* the successor takes the place (and colour) of z */
+        omap_node_t *y = z->right;
+        while (y->left != NULL) y = y->left;
+
+        removed_red = y->red;
+        x = y->right;
+        if (y->parent == z)
+        {
+            x_parent = y;
+        }
+        else
+        {
+            x_parent = y->parent;
+            replace_child(map, y, y->right);
+            y->right = z->right;
+            y->right->parent = y;
+        }
+        replace_child(map, z, y);
+        y->left = z->left;
+        y->left->parent = y;
+        y->red = z->red;
+    }
+
+    if (!removed_red)
+        erase_fixup(map, x, x_parent);
+
+    node_free(map, z);
+    map->size--;
+}
+
+int omap_erase(omap_t *map, const void *key)
+{
+    omap_node_t *node = omap_find(map, key);
+    if (node == NULL)
+        return 0;
+    omap_erase_node(map, node);
+    return 1;
+}
+
+omap_node_t *omap_first(const omap_t *map)
+{
+    omap_node_t *node = map->root;
+    if (node != NULL)
+        while (node->left != NULL) node = node->left;
+    return node;
+}
+
+omap_node_t *omap_last(const omap_t *map)
+{
+    omap_node_t *node = map->root;
+    if (node != NULL)
+        while (node->right != NULL) node = node->right;
+    return node;
+}
+
+omap_node_t *omap_next(const omap_node_t *node)
+{
+    if (node->right != NULL)
+    {
+        node = node->right;
+        while (node->left != NULL) node = node->left;
+        return (omap_node_t *)node;
+    }
+    while (node->parent != NULL && node == node->parent->right)
+        node = node->parent;
+    return node->parent;
+}
+
+omap_node_t *omap_prev(const omap_node_t *node)
+{
+    if (node->left != NULL)
+    {
+        node = node->left;
+        while (node->right != NULL) node = node->right;
+        return (omap_node_t *)node;
+    }
+    while (node->parent != NULL && node == node->parent->left)
+        node = node->parent;
+    return node->parent;
+}
+
+omap_node_t *omap_lower_bound(const omap_t *map, const void *key)
+{
+    omap_node_t *node = map->root, *best = NULL;
+
+    while (node != NULL)
+    {
+        if (map->cmp(node->key, key) >= 0)
+        {
+            best = node;
+            node = node->left;
+        }
+        else
+        {
+            node = node->right;
+        }
+    }
+    return best;
+}
+
+omap_node_t *omap_upper_bound(const omap_t *map, const void *key)
+{
+    omap_node_t *node = map->root, *best = NULL;
+
+    while (node != NULL)
+    {
+        if (map->cmp(node->key, key) > 0)
+        {
+            best = node;
+            node = node->left;
+        }
+        else
+        {
+            node = node->right;
+        }
+    }
+    return best;
+}
+
+size_t omap_range(const omap_t *map, const void *lo, const void *hi,
+                  omap_visit_t visit, void *ctx)
+{
+    size_t count = 0;
+    omap_node_t *node = lo ? omap_lower_bound(map, lo) : omap_first(map);
+
+    while (node != NULL && (hi == NULL || map->cmp(node->key, hi) < 0))
+    {
+        count++;
+        if (visit != NULL && visit(node->key, node->value, ctx))
+            break;
+        node = omap_next(node);
+    }
+    return count;
+}
+
+/* links keys[lo, hi) below `parent` as a perfectly balanced subtree. All
+ * levels but the deepest are full, so colouring the deepest level red and
+ * everything else black gives every path the same number of black nodes. */
+static omap_node_t *build_range(omap_t *map, const void *const *keys,
+                                void *const *values, size_t lo, size_t hi,
+                                omap_node_t *parent, int depth, int red_depth)
+{
+    if (lo >= hi)
+        return NULL;
+
+    size_t mid = lo + (hi - lo) / 2;
+    omap_node_t *node = &map->blocks->nodes[map->block_used++];
+
+    node->key = keys[mid];
+    node->value = values ? values[mid] : NULL;
+    node->parent = parent;
+    node->red = depth == red_depth && depth > 0;
+    node->left = build_range(map, keys, values, lo, mid, node, depth + 1,
+                             red_depth);
+    node->right = build_range(map, keys, values, mid + 1, hi, node,
+                              depth + 1, red_depth);
+    return node;
+}
+
+int omap_build_sorted(omap_t *map, const void *const *keys,
+                      void *const *values, size_t n)
+{
+    if (map->root != NULL)
+        return -1;
+    for (size_t i = 1; i < n; i++)
+        if (map->cmp(keys[i - 1], keys[i]) >= 0)
+            return -1;
+    if (n == 0)
+        return 0;
+
+    /* take all nodes from a single block of exactly the right size */
+    if (map->blocks == NULL || map->blocks->capacity - map->block_used < n)
+    {
+        if (pool_grow(map, n) != 0)
+            return -1;
+    }
+
+    int red_depth = 0;
+    while (((size_t)2 << red_depth) <= n) red_depth++;
+
+    map->root = build_range(map, keys, values, 0, n, NULL, 0, red_depth);
+    map->size = n;
+    return 0;
+}
@@ -0,0 +1,98 @@
+#ifndef __ORDERED_MAP__
+#define __ORDERED_MAP__
+
+#include <stddef.h>
+
+/*
+    Generic ordered map backed by a red-black tree.
+
+    Keys and values are stored as pointers and are owned by the caller; the
+    order is given by the comparator passed to omap_init(). Small integer
+    keys can be stored directly in the pointer with (void *)(intptr_t)k
+    together with a comparator that compares (intptr_t) values.
+
+    Nodes are carved out of pool blocks owned by the map, so inserting does
+    not call malloc for every element and omap_destroy() releases the whole
+    tree without walking it.
+*/
+
+#define OMAP_POOL_MIN_BLOCK 64
+#define OMAP_POOL_MAX_BLOCK (1 << 16)
+
+/* returns <0, 0 or >0 like strcmp */
+typedef int (*omap_cmp_t)(const void *a, const void *b);
+
+typedef struct omap_node
+{
+    struct omap_node *left;
+    struct omap_node *right;
+    struct omap_node *parent;
+    const void *key;
+    void *value;
+    int red; /* 1 for a red node, 0 for a black one */
+} omap_node_t;
+
+/* chunk of nodes handed out by the pool */
+typedef struct omap_block
+{
+    struct omap_block *next;
+    size_t capacity;
+    omap_node_t nodes[];
+} omap_block_t;
+
+typedef struct
+{
+    omap_node_t *root;
+    size_t size;
+    omap_cmp_t cmp;
+
+    omap_block_t *blocks;   /* most recent block first */
+    size_t block_used;      /* nodes taken from the newest block */
+    omap_node_t *free_list; /* erased nodes, linked through ->right */
+} omap_t;
+
+/* called for every element of a range, returning non-zero stops the walk */
+typedef int (*omap_visit_t)(const void *key, void *value, void *ctx);
+
+extern void omap_init(omap_t *map, omap_cmp_t cmp);
+
+extern void omap_destroy(omap_t *map);
+
+extern void omap_clear(omap_t *map);
+
+/* returns 1 if the key was added, 0 if an existing value was replaced and -1
+ * if no memory was available */
+extern int omap_insert(omap_t *map, const void *key, void *value);
+
+extern omap_node_t *omap_find(const omap_t *map, const void *key);
+
+/* returns 1 if the key was removed, 0 if it was not in the map */
+extern int omap_erase(omap_t *map, const void *key);
+
+extern void omap_erase_node(omap_t *map, omap_node_t *node);
+
+extern omap_node_t *omap_first(const omap_t *map);
+
+extern omap_node_t *omap_last(const omap_t *map);
+
+extern omap_node_t *omap_next(const omap_node_t *node);
+
+extern omap_node_t *omap_prev(const omap_node_t *node);
+
+/* first element whose key is >= key, or NULL */
+extern omap_node_t *omap_lower_bound(const omap_t *map, const void *key);
+
+/* first element whose key is > key, or NULL */
+extern omap_node_t *omap_upper_bound(const omap_t *map, const void *key);
+
+/* visits the keys in [lo, hi) in order and returns how many were visited;
+ * NULL bounds are open ended */
+extern size_t omap_range(const omap_t *map, const void *lo, const void *hi,
+                         omap_visit_t visit, void *ctx);
+
+/* builds the map from n strictly increasing keys in O(n); the map must be
+ * empty, values may be NULL. returns 0 on success and -1 otherwise */
+extern int omap_build_sorted(omap_t *map, const void *const *keys,
+                             void *const *values, size_t n);
+
+#endif
@@ -0,0 +1,471 @@
+/*
+    Self-test of the ternary search tree and a comparison on large word
+    lists against the 26-way trie of trie/trie.c and the hashing of
+    hash_set/hash_set.c.
+
+    Both baselines are reduced copies, as trie.c is a standalone program
+    and hash_set.c compares keys by pointer and resizes on every bucket
+    collision, which never settles on a real word list. The copy keeps its
+    adler-32 hash and bucket index and resolves collisions by linear
+    probing with strcmp.
+
+    usage: ./main [word list] [number of random words]
+    (the word list defaults to ../trie/dictionary.txt)
+*/
+// needed for strdup
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tst.h"
+
+/* ---------------------------------------------------------------------
+    helpers for the tests
+   --------------------------------------------------------------------- */
+
+static int cmp_str(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/* checks that keys arrive in strcmp order and counts them */
+typedef struct
+{
+    char last[64];
+    int count;
+    int limit;
+} ordered_t;
+
+static int visit_ordered(const char *key, void *ctx)
+{
+    ordered_t *o = (ordered_t *)ctx;
+    if (o->count > 0)
+        assert(strcmp(o->last, key) < 0);
+    strncpy(o->last, key, sizeof(o->last) - 1);
+    return ++o->count == o->limit;
+}
+
+static int matches(const char *pattern, const char *key)
+{
+    for (; *pattern && *key; pattern++, key++)
+        if (*pattern != TST_WILDCARD && *pattern != *key)
+            return 0;
+    return *pattern == *key;
+}
+
+static int hamming(const char *a, const char *b)
+{
+    int d = 0;
+    for (; *a || *b; a += *a != 0, b += *b != 0) d += *a != *b;
+    return d;
+}
+
+/* longest chain of nodes from the root */
+static int height(const tst_node_t *p)
+{
+    if (p == NULL)
+        return 0;
+    int lo = height(p->lokid), hi = height(p->hikid);
+    int eq = p->splitchar ? height(p->u.eqkid) : 0;
+    int h = lo > hi ? lo : hi;
+    return 1 + (eq > h ? eq : h);
+}
+
+static void test()
+{
+    enum
+    {
+        N = 2000
+    };
+    static char words[N][8];
+    static const char *ptrs[N];
+    tst_t tree, other;
+
+    tst_init(&tree);
+    assert(!tst_contains(&tree, "") && !tst_contains(&tree, "a"));
+    assert(tst_partial_match(&tree, "...", NULL, NULL) == 0);
+
+    /* short words over a small alphabet, so many share prefixes */
+    srand(32);
+    for (int i = 0; i < N; i++)
+    {
+        int len = 1 + rand() % 6;
+        for (int j = 0; j < len; j++) words[i][j] = "abcd"[rand() % 4];
+        words[i][len] = 0;
+        ptrs[i] = words[i];
+    }
+    size_t distinct = 0;
+    for (int i = 0; i < N; i++)
+    {
+        int seen = 0;
+        for (int j = 0; j < i && !seen; j++)
+            seen = strcmp(words[i], words[j]) == 0;
+        distinct += !seen;
+        assert(tst_insert(&tree, words[i]) == !seen);
+    }
+    assert(tree.size == distinct);
+
+    for (int i = 0; i < N; i++)
+    {
+        char miss[9];
+        assert(tst_contains(&tree, words[i]));
+        strcat(strcpy(miss, words[i]), "e");
+        assert(!tst_contains(&tree, miss));
+    }
+    assert(!tst_contains(&tree, ""));
+
+    /* queries against a scan of the distinct words */
+    qsort(ptrs, N, sizeof(ptrs[0]), cmp_str);
+    const char *patterns[] = {"a.c", "....", "d", ".", "ab..d.", "x.."};
+    for (int k = 0; k < 6; k++)
+    {
+        size_t expect = 0;
+        for (int i = 0; i < N; i++)
+            expect += (i == 0 || strcmp(ptrs[i], ptrs[i - 1])) &&
+                      matches(patterns[k], ptrs[i]);
+        ordered_t o = {"", 0, -1};
+        assert(tst_partial_match(&tree, patterns[k], visit_ordered, &o) ==
+               expect);
+        assert((size_t)o.count == expect);
+    }
+    for (int k = 0; k < 20; k++)
+    {
+        const char *key = words[rand() % N];
+        for (int d = 0; d <= 3; d++)
+        {
+            size_t expect = 0;
+            for (int i = 0; i < N; i++)
+                expect += (i == 0 || strcmp(ptrs[i], ptrs[i - 1])) &&
+                          hamming(key, ptrs[i]) <= d;
+            ordered_t o = {"", 0, -1};
+            assert(tst_near(&tree, key, d, visit_ordered, &o) == expect);
+            assert(d > 0 || expect == 1);
+        }
+    }
+
+    /* a visitor returning non-zero stops the search */
+    ordered_t o = {"", 0, 3};
+    assert(tst_partial_match(&tree, "...", visit_ordered, &o) == 3);
+    o.count = 0;
+    assert(tst_near(&tree, "abcd", 4, visit_ordered, &o) == 3);
+
+    /* the sorted batch holds the same keys in a shallower tree */
+    tst_init(&other);
+    assert(tst_insert_sorted(&other, ptrs, N) == (long)distinct);
+    assert(other.size == tree.size && other.nodes == tree.nodes);
+    for (int i = 0; i < N; i++) assert(tst_contains(&other, words[i]));
+    tst_destroy(&other);
+
+    static char numbered[N][8];
+    for (int i = 0; i < N; i++)
+    {
+        snprintf(numbered[i], sizeof(numbered[i]), "k%04d", i);
+        ptrs[i] = numbered[i];
+    }
+    tst_init(&other);
+    assert(tst_insert_sorted(&other, ptrs, N) == N);
+    int balanced = height(other.root);
+    tst_destroy(&other);
+    tst_init(&other);
+    for (int i = 0; i < N; i++) tst_insert(&other, numbered[i]);
+    assert(balanced < height(other.root));
+
+    /* keys longer than a pool block, bytes above 127, two trees at once */
+    static char long_key[3 * TST_KEYS_MIN_BLOCK];
+    memset(long_key, 'z', sizeof(long_key) - 1);
+    assert(tst_insert(&other, long_key) == 1 && tst_contains(&other, long_key));
+    assert(tst_insert(&other, "\xe9t\xe9") == 1);
+    assert(tst_insert(&other, "ete") == 1);
+    o = (ordered_t){"", 0, -1};
+    assert(tst_partial_match(&other, ".t.", visit_ordered, &o) == 2);
+    assert(!tst_contains(&tree, "\xe9t\xe9"));
+
+    tst_destroy(&other);
+    tst_destroy(&tree);
+    assert(tree.root == NULL && tree.size == 0);
+    printf("All tests have successfully passed!\n");
+}
+
+/* ---------------------------------------------------------------------
+    baselines
+   --------------------------------------------------------------------- */
+
+/* trie.c: a node of 26 children per character, lower case keys only */
+struct trie
+{
+    struct trie *children[26];
+    int end_of_word;
+};
+
+static long trie_nodes;
+
+static int trie_insert(struct trie *trie, const char *word)
+{
+    for (; *word; word++)
+    {
+        unsigned index = (unsigned)(*word - 'a');
+        if (index >= 26)
+            return -1;
+        if (trie->children[index] == NULL)
+        {
+            trie->children[index] = calloc(1, sizeof(struct trie));
+            trie_nodes++;
+        }
+        trie = trie->children[index];
+    }
+    trie->end_of_word = 1;
+    return 0;
+}
+
+static int trie_contains(const struct trie *trie, const char *word)
+{
+    for (; *word && trie; word++)
+    {
+        unsigned index = (unsigned)(*word - 'a');
+        trie = index < 26 ? trie->children[index] : NULL;
+    }
+    return trie && trie->end_of_word;
+}
+
+static void trie_free(struct trie *trie)
+{
+    for (int i = 0; i < 26; i++)
+        if (trie->children[i])
+            trie_free(trie->children[i]);
+    free(trie);
+}
+
+/* hash_set.c: adler-32 and its bucket index, plus linear probing */
+typedef struct
+{
+    const char **keys;
+    unsigned capacity;
+    unsigned length;
+} strset_t;
+
+static long long adler32(const char *str)
+{
+    int a = 1, b = 0;
+    const int MODADLER = 65521;
+    for (int i = 0; str[i] != '\0'; i++)
+    {
+        a = (a + str[i]) % MODADLER;
+        b = (b + a) % MODADLER;
+    }
+    return (b << 16) | a;
+}
+
+static unsigned bucket(long long hash, unsigned capacity)
+{
+    return (capacity - 1) & (hash ^ (hash >> 12));
+}
+
+static void strset_add(strset_t *set, const char *key);
+
+static void strset_grow(strset_t *set)
+{
+    strset_t bigger = {NULL, set->capacity ? set->capacity * 2 : 1024, 0};
+    bigger.keys = calloc(bigger.capacity, sizeof(char *));
+    for (unsigned i = 0; i < set->capacity; i++)
+        if (set->keys[i])
+            strset_add(&bigger, set->keys[i]);
+    free(set->keys);
+    *set = bigger;
+}
+
+static void strset_add(strset_t *set, const char *key)
+{
+    if (2 * (set->length + 1) > set->capacity)
+        strset_grow(set);
+    unsigned i = bucket(adler32(key), set->capacity);
+    while (set->keys[i] && strcmp(set->keys[i], key) != 0)
+        i = (i + 1) & (set->capacity - 1);
+    if (set->keys[i] == NULL)
+    {
+        set->keys[i] = key;
+        set->length++;
+    }
+}
+
+static int strset_contains(const strset_t *set, const char *key)
+{
+    unsigned i = bucket(adler32(key), set->capacity);
+    for (; set->keys[i]; i = (i + 1) & (set->capacity - 1))
+        if (strcmp(set->keys[i], key) == 0)
+            return 1;
+    return 0;
+}
+
+/* ---------------------------------------------------------------------
+    benchmark
+   --------------------------------------------------------------------- */
+
+static double seconds(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void shuffle(char **a, size_t n)
+{
+    for (size_t i = n; i > 1; i--)
+    {
+        size_t j = (size_t)rand() % i;
+        char *t = a[i - 1];
+        a[i - 1] = a[j];
+        a[j] = t;
+    }
+}
+
+static void row(const char *name, double build, double hits, double misses,
+                double mib)
+{
+    printf("%-22s %8.3f %8.3f %8.3f %9.1f\n", name, build, hits, misses, mib);
+}
+
+static void benchmark(char **words, size_t n)
+{
+    /* misses: every word with its last letter replaced by a digit */
+    char **misses = malloc(n * sizeof(char *));
+    for (size_t i = 0; i < n; i++)
+    {
+        misses[i] = strdup(words[i]);
+        misses[i][strlen(misses[i]) - 1] = '0' + i % 10;
+    }
+    shuffle(words, n);
+    long found;
+    clock_t t;
+
+    char title[32];
+    snprintf(title, sizeof(title), "%zu words", n);
+    printf("\n%-22s %8s %8s %8s %9s\n", title, "build", "hits", "misses",
+           "MiB");
+
+    tst_t tree;
+    tst_init(&tree);
+    t = clock();
+    for (size_t i = 0; i < n; i++) tst_insert(&tree, words[i]);
+    double build = seconds(t);
+    t = clock();
+    found = 0;
+    for (size_t i = 0; i < n; i++) found += tst_contains(&tree, words[i]);
+    double hits = seconds(t);
+    assert((size_t)found == n);
+    t = clock();
+    for (size_t i = 0; i < n; i++) found -= tst_contains(&tree, misses[i]);
+    double miss = seconds(t);
+    double mib = tree.nodes * sizeof(tst_node_t) / 1048576.0;
+    for (tst_key_block_t *b = tree.key_blocks; b; b = b->next)
+        mib += b->capacity / 1048576.0;
+    row("tst, random order", build, hits, miss, mib);
+
+    /* sorting is part of building from unsorted input */
+    tst_t sorted;
+    tst_init(&sorted);
+    t = clock();
+    qsort(words, n, sizeof(char *), cmp_str);
+    tst_insert_sorted(&sorted, (const char *const *)words, n);
+    build = seconds(t);
+    shuffle(words, n);
+    t = clock();
+    found = 0;
+    for (size_t i = 0; i < n; i++) found += tst_contains(&sorted, words[i]);
+    hits = seconds(t);
+    assert((size_t)found == n);
+    t = clock();
+    for (size_t i = 0; i < n; i++) found -= tst_contains(&sorted, misses[i]);
+    miss = seconds(t);
+    row("tst, sorted batch", build, hits, miss, mib);
+    tst_destroy(&sorted);
+
+    struct trie *root = calloc(1, sizeof(struct trie));
+    trie_nodes = 1;
+    t = clock();
+    for (size_t i = 0; i < n; i++) trie_insert(root, words[i]);
+    build = seconds(t);
+    t = clock();
+    found = 0;
+    for (size_t i = 0; i < n; i++) found += trie_contains(root, words[i]);
+    hits = seconds(t);
+    t = clock();
+    for (size_t i = 0; i < n; i++) found -= trie_contains(root, misses[i]);
+    miss = seconds(t);
+    row("trie.c", build, hits, miss,
+        trie_nodes * sizeof(struct trie) / 1048576.0);
+    trie_free(root);
+
+    strset_t set = {NULL, 0, 0};
+    t = clock();
+    for (size_t i = 0; i < n; i++) strset_add(&set, words[i]);
+    build = seconds(t);
+    t = clock();
+    found = 0;
+    for (size_t i = 0; i < n; i++) found += strset_contains(&set, words[i]);
+    hits = seconds(t);
+    t = clock();
+    for (size_t i = 0; i < n; i++) found -= strset_contains(&set, misses[i]);
+    miss = seconds(t);
+    row("hash_set.c hashing", build, hits, miss,
+        set.capacity * sizeof(char *) / 1048576.0);
+    free(set.keys);
+
+    /* the queries a hash table cannot answer */
+    const char *patterns[] = {"r.b.c..", "....ing", ".a.a.a."};
+    t = clock();
+    size_t total = 0;
+    for (int k = 0; k < 3; k++)
+        total += tst_partial_match(&tree, patterns[k], NULL, NULL);
+    printf("\n3 partial matches     %8.4f s, %zu words\n", seconds(t), total);
+    t = clock();
+    total = 0;
+    for (size_t i = 0; i < 100 && i < n; i++)
+        total += tst_near(&tree, words[i], 1, NULL, NULL);
+    printf("100 near searches, d=1 %8.4f s, %zu words\n", seconds(t), total);
+
+    tst_destroy(&tree);
+    for (size_t i = 0; i < n; i++) free(misses[i]);
+    free(misses);
+}
+
+int main(int argc, char **argv)
+{
+    test();
+
+    const char *path = argc > 1 ? argv[1] : "../trie/dictionary.txt";
+    size_t random_words = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+    size_t n = 0, cap = 1 << 16;
+    char **words = malloc(cap * sizeof(char *)), word[101];
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        fprintf(stderr, "could not open %s\n", path);
+    while (fp != NULL && fscanf(fp, "%100s", word) == 1)
+    {
+        if (n == cap)
+            words = realloc(words, (cap *= 2) * sizeof(char *));
+        words[n++] = strdup(word);
+    }
+    if (fp != NULL)
+        fclose(fp);
+
+    /* lower case words of 4 to 12 letters */
+    for (size_t i = 0; i < random_words; i++)
+    {
+        int len = 4 + rand() % 9;
+        for (int j = 0; j < len; j++) word[j] = 'a' + rand() % 26;
+        word[len] = 0;
+        if (n == cap)
+            words = realloc(words, (cap *= 2) * sizeof(char *));
+        words[n++] = strdup(word);
+    }
+
+    if (n > 0)
+        benchmark(words, n);
+    for (size_t i = 0; i < n; i++) free(words[i]);
+    free(words);
+    return 0;
+}
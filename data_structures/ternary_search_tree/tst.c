@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "tst.h"
+
+/* ---------------------------------------------------------------------
+    pools
+   --------------------------------------------------------------------- */
+
+/* makes room for `count` consecutive nodes in the newest block */
+static int node_reserve(tst_t *tree, size_t count)
+{
+    tst_node_block_t *last = tree->node_blocks;
+    if (last != NULL && last->capacity - tree->node_used >= count)
+        return 0;
+
+    size_t capacity = last ? last->capacity * 2 : TST_POOL_MIN_BLOCK;
+    if (capacity > TST_POOL_MAX_BLOCK)
+        capacity = TST_POOL_MAX_BLOCK;
+    if (capacity < count)
+        capacity = count;
+
+    tst_node_block_t *block = (tst_node_block_t *)malloc(
+        sizeof(tst_node_block_t) + capacity * sizeof(tst_node_t));
+    if (block == NULL)
+        return -1;
+    block->capacity = capacity;
+    block->next = last;
+    tree->node_blocks = block;
+    tree->node_used = 0;
+    return 0;
+}
+
+/* copies a key into the key pool */
+static const char *key_copy(tst_t *tree, const char *key, size_t len)
+{
+    tst_key_block_t *last = tree->key_blocks;
+    if (last == NULL || last->capacity - tree->key_used < len + 1)
+    {
+        size_t capacity = last ? last->capacity * 2 : TST_KEYS_MIN_BLOCK;
+        if (capacity > TST_KEYS_MAX_BLOCK)
+            capacity = TST_KEYS_MAX_BLOCK;
+        if (capacity < len + 1)
+            capacity = len + 1;
+
+        tst_key_block_t *block =
+            (tst_key_block_t *)malloc(sizeof(tst_key_block_t) + capacity);
+        if (block == NULL)
+            return NULL;
+        block->capacity = capacity;
+        block->next = last;
+        tree->key_blocks = last = block;
+        tree->key_used = 0;
+    }
+
+    char *copy = last->chars + tree->key_used;
+    memcpy(copy, key, len + 1);
+    tree->key_used += len + 1;
+    return copy;
+}
+
+/* ---------------------------------------------------------------------
+    building
+   --------------------------------------------------------------------- */
+
+void tst_init(tst_t *tree)
+{
+    tree->root = NULL;
+    tree->size = tree->nodes = 0;
+    tree->node_blocks = NULL;
+    tree->node_used = 0;
+    tree->key_blocks = NULL;
+    tree->key_used = 0;
+}
+
+void tst_destroy(tst_t *tree)
+{
+    while (tree->node_blocks != NULL)
+    {
+        tst_node_block_t *next = tree->node_blocks->next;
+        free(tree->node_blocks);
+        tree->node_blocks = next;
+    }
+    while (tree->key_blocks != NULL)
+    {
+        tst_key_block_t *next = tree->key_blocks->next;
+        free(tree->key_blocks);
+        tree->key_blocks = next;
+    }
+    tst_init(tree);
+}
+
+int tst_insert(tst_t *tree, const char *key)
+{
+    const unsigned char *s = (const unsigned char *)key;
+    tst_node_t **p = &tree->root, *pp;
+
+    /* follow the key as far as the tree has it */
+    while ((pp = *p) != NULL)
+    {
+        int d = *s - pp->splitchar;
+        if (d == 0)
+        {
+            if (*s++ == 0)
+                return 0;
+            p = &pp->u.eqkid;
+        }
+        else if (d < 0)
+            p = &pp->lokid;
+        else
+            p = &pp->hikid;
+    }
+
+    /* then hang the rest of it below, taking all the memory up front so
+     * that a failure leaves the tree unchanged */
+    size_t rest = strlen((const char *)s);
+    const char *copy = key_copy(tree, key, (const char *)s - key + rest);
+    if (copy == NULL || node_reserve(tree, rest + 1) != 0)
+        return -1;
+
+    tst_node_t *node = tree->node_blocks->nodes + tree->node_used;
+    tree->node_used += rest + 1;
+    tree->nodes += rest + 1;
+    tree->size++;
+    for (;; node++)
+    {
+        node->splitchar = *s;
+        node->lokid = node->hikid = NULL;
+        *p = node;
+        if (*s++ == 0)
+        {
+            node->u.key = copy;
+            return 1;
+        }
+        p = &node->u.eqkid;
+    }
+}
+
+/* inserts the median first, then each half the same way */
+static long insert_range(tst_t *tree, const char *const *keys, size_t n)
+{
+    if (n == 0)
+        return 0;
+    size_t mid = n / 2;
+    int added = tst_insert(tree, keys[mid]);
+    if (added < 0)
+        return -1;
+    long lo = insert_range(tree, keys, mid);
+    long hi = insert_range(tree, keys + mid + 1, n - mid - 1);
+    if (lo < 0 || hi < 0)
+        return -1;
+    return added + lo + hi;
+}
+
+long tst_insert_sorted(tst_t *tree, const char *const *keys, size_t n)
+{
+    return insert_range(tree, keys, n);
+}
+
+/* ---------------------------------------------------------------------
+    queries
+   --------------------------------------------------------------------- */
+
+int tst_contains(const tst_t *tree, const char *key)
+{
+    const unsigned char *s = (const unsigned char *)key;
+    const tst_node_t *p = tree->root;
+    int c = *s;
+
+    while (p != NULL)
+    {
+        int d = c - p->splitchar;
+        if (d == 0)
+        {
+            if (c == 0)
+                return 1;
+            c = *++s;
+            p = p->u.eqkid;
+        }
+        else if (d < 0)
+            p = p->lokid;
+        else
+            p = p->hikid;
+    }
+    return 0;
+}
+
+/* state shared by the recursive searches */
+struct query
+{
+    tst_visit_t visit;
+    void *ctx;
+    size_t count;
+    int stop;
+};
+
+static void report(struct query *q, const char *key)
+{
+    q->count++;
+    if (q->visit != NULL && q->visit(key, q->ctx) != 0)
+        q->stop = 1;
+}
+
+/* the hi links are followed in the loop rather than by recursion, so the
+ * stack only grows with the length of the keys and the lo links */
+static void partial_match(const tst_node_t *p, const unsigned char *s,
+                          struct query *q)
+{
+    for (; p != NULL && !q->stop; p = p->hikid)
+    {
+        if (*s == TST_WILDCARD || *s < p->splitchar)
+            partial_match(p->lokid, s, q);
+        if (q->stop)
+            return;
+        if ((*s == TST_WILDCARD || *s == p->splitchar) && p->splitchar && *s)
+            partial_match(p->u.eqkid, s + 1, q);
+        if (*s == 0 && p->splitchar == 0)
+            report(q, p->u.key);
+        if (*s != TST_WILDCARD && *s <= p->splitchar)
+            return;
+    }
+}
+
+size_t tst_partial_match(const tst_t *tree, const char *pattern,
+                         tst_visit_t visit, void *ctx)
+{
+    struct query q = {visit, ctx, 0, 0};
+    partial_match(tree->root, (const unsigned char *)pattern, &q);
+    return q.count;
+}
+
+/* whether s holds at most d characters */
+static int at_most(const unsigned char *s, int d)
+{
+    for (int i = 0; i <= d; i++)
+        if (s[i] == 0)
+            return 1;
+    return 0;
+}
+
+static void near(const tst_node_t *p, const unsigned char *s, int d,
+                 struct query *q)
+{
+    for (; p != NULL && d >= 0 && !q->stop; p = p->hikid)
+    {
+        if (d > 0 || *s < p->splitchar)
+            near(p->lokid, s, d, q);
+        if (q->stop)
+            return;
+        if (p->splitchar == 0)
+        {
+            if (at_most(s, d))
+                report(q, p->u.key);
+        }
+        else
+            near(p->u.eqkid, *s ? s + 1 : s, *s == p->splitchar ? d : d - 1,
+                 q);
+        if (d == 0 && *s <= p->splitchar)
+            return;
+    }
+}
+
+size_t tst_near(const tst_t *tree, const char *key, int distance,
+                tst_visit_t visit, void *ctx)
+{
+    struct query q = {visit, ctx, 0, 0};
+    near(tree->root, (const unsigned char *)key, distance, &q);
+    return q.count;
+}
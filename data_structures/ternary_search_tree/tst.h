@@ -0,0 +1,100 @@
+#ifndef __TST__
+#define __TST__
+
+#include <stddef.h>
+
+/*
+    Ternary search tree holding a set of strings.
+
+    This is the tree of sorting/multikey_quick_sort.c (Bentley & Sedgewick,
+    "Fast Algorithms for Sorting and Searching Strings") made into a value
+    type: all state lives in tst_t, so any number of trees can be used side
+    by side. Nodes and the copies of the keys come out of blocks owned by
+    the tree which grow without limit and are released together by
+    tst_destroy().
+
+    Inserting keys in sorted order one by one degenerates the lo/hi links
+    into lists; tst_insert_sorted() inserts a sorted batch median first,
+    which keeps those subtrees balanced.
+
+    Keys are NUL-terminated and compared as unsigned bytes, like strcmp.
+    Queries report every match through a callback, in sorted order.
+*/
+
+/* node pool blocks, in nodes, and key pool blocks, in bytes */
+#define TST_POOL_MIN_BLOCK 64
+#define TST_POOL_MAX_BLOCK (1 << 16)
+#define TST_KEYS_MIN_BLOCK 1024
+#define TST_KEYS_MAX_BLOCK (1 << 20)
+
+/* matches any single character in tst_partial_match() patterns */
+#define TST_WILDCARD '.'
+
+typedef struct tst_node
+{
+    unsigned char splitchar; /* 0 ends a key */
+    struct tst_node *lokid;
+    struct tst_node *hikid;
+    union
+    {
+        struct tst_node *eqkid; /* when splitchar != 0 */
+        const char *key;        /* the stored key when splitchar == 0 */
+    } u;
+} tst_node_t;
+
+/* chunks handed out by the node and key pools */
+typedef struct tst_node_block
+{
+    struct tst_node_block *next;
+    size_t capacity;
+    tst_node_t nodes[];
+} tst_node_block_t;
+
+typedef struct tst_key_block
+{
+    struct tst_key_block *next;
+    size_t capacity;
+    char chars[];
+} tst_key_block_t;
+
+typedef struct
+{
+    tst_node_t *root;
+    size_t size;  /* number of keys */
+    size_t nodes; /* number of nodes */
+
+    tst_node_block_t *node_blocks; /* most recent block first */
+    size_t node_used;              /* nodes taken from the newest block */
+    tst_key_block_t *key_blocks;
+    size_t key_used;
+} tst_t;
+
+/* called for every key found by a query, returning non-zero stops it */
+typedef int (*tst_visit_t)(const char *key, void *ctx);
+
+extern void tst_init(tst_t *tree);
+
+extern void tst_destroy(tst_t *tree);
+
+/* returns 1 if the key was added, 0 if it was already there and -1 if no
+ * memory was available */
+extern int tst_insert(tst_t *tree, const char *key);
+
+/* inserts n keys sorted in strcmp order so that the tree stays balanced;
+ * returns the number of keys added or -1 if no memory was available */
+extern long tst_insert_sorted(tst_t *tree, const char *const *keys, size_t n);
+
+extern int tst_contains(const tst_t *tree, const char *key);
+
+/* reports the keys as long as `pattern` that match it, TST_WILDCARD
+ * matching any character; returns the number of keys reported */
+extern size_t tst_partial_match(const tst_t *tree, const char *pattern,
+                                tst_visit_t visit, void *ctx);
+
+/* reports the keys within Hamming distance `distance` of `key`, characters
+ * beyond the end of the shorter string counting as mismatches; returns the
+ * number of keys reported */
+extern size_t tst_near(const tst_t *tree, const char *key, int distance,
+                       tst_visit_t visit, void *ctx);
+
+#endif
@@ -0,0 +1,900 @@
+/**
+ * @file
+ * @brief Compact, path-compressed [radix
+ * trie](https://en.wikipedia.org/wiki/Radix_tree) over arbitrary bytes
+ * @details
+ * trie.c allocates one node with 26 child pointers per character, which
+ * costs about 200 bytes per node and limits keys to 'a'-'z'. This trie is
+ * built once from a list of keys and stored in two flat arrays:
+ *
+ * - `nodes`: one 20 byte record per node. The children of a node are stored
+ *   next to each other, sorted by the first byte of their edge label, so a
+ *   node only needs the index of its first child and the number of
+ *   children. Subtrees are laid out depth first, so a lookup walking down
+ *   one path touches few cache lines.
+ * - `labels`: the edge labels longer than 4 bytes; shorter ones are kept in
+ *   the node. Chains of single-child nodes are merged into one edge (path
+ *   compression), so there are at most 2n nodes for n keys.
+ *
+ * Keys may hold any byte value, including 0. Every key gets the id of its
+ * rank in sorted order. Lookups and prefix walks are iterative, the walk
+ * reports the keys through a callback. Because the arrays contain no
+ * pointers, a trie can be written to a file and used straight from a
+ * read-only memory mapping of that file (native byte order).
+ *
+ * Run `./radix_trie [word list]` to compare memory and lookup time against
+ * the 26-way trie of trie.c on `dictionary.txt` and search prefixes
+ * interactively. On that list the trie is about 20 times smaller than
+ * trie.c and is built faster; a random lookup, which scans the siblings at
+ * every level, takes about as long.
+ */
+
+// needed for mmap
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RADIX_TRIE_HAS_MMAP
+#endif
+
+/** value of a node at which no key ends */
+#define RADIX_TRIE_NONE UINT32_MAX
+
+/** edge labels up to this long are stored in the node itself */
+#define RADIX_TRIE_INLINE 4
+
+/** tag at the start of a serialised trie */
+#define RADIX_TRIE_MAGIC "RDXTRIE1"
+
+/** a node of the trie */
+struct radix_trie_node
+{
+    uint32_t label;       ///< offset of the edge label in `labels`, or the
+                          ///< label itself if at most RADIX_TRIE_INLINE long
+    uint32_t label_len;   ///< length of the edge label
+    uint32_t first_child; ///< index of the first child
+    uint32_t value;       ///< id of the key ending here or RADIX_TRIE_NONE
+    uint16_t child_count; ///< number of children
+    uint8_t first;        ///< first byte of the edge label
+    uint8_t unused;
+};
+
+/** the trie, node 0 is the root and has an empty label */
+struct radix_trie
+{
+    const struct radix_trie_node *nodes;
+    const uint8_t *labels;
+    uint32_t node_count;
+    uint32_t label_size;
+    uint32_t key_count;
+
+    void *memory;       ///< block holding the arrays
+    size_t memory_size; ///< its size
+    int mapped;         ///< whether `memory` is a file mapping
+};
+
+/** header of a serialised trie, followed by the two arrays */
+struct radix_trie_header
+{
+    char magic[8];
+    uint32_t node_count;
+    uint32_t label_size;
+    uint32_t key_count;
+    uint32_t reserved;
+};
+
+/** a key handed to the builder */
+struct radix_trie_key
+{
+    const uint8_t *data;
+    size_t len;
+};
+
+/** called for every key found by radix_trie_prefix(); non-zero stops */
+typedef int (*radix_trie_visit)(const uint8_t *key, size_t len, uint32_t id,
+                                void *ctx);
+
+/*--compare two keys byte by byte, shorter first on a tie--*/
+static int key_compare(const void *a, const void *b)
+{
+    const struct radix_trie_key *x = a, *y = b;
+    size_t n = x->len < y->len ? x->len : y->len;
+    int c = memcmp(x->data, y->data, n);
+    if (c != 0)
+        return c;
+    return (x->len > y->len) - (x->len < y->len);
+}
+
+/*--length of the common prefix of two keys--*/
+static size_t common_prefix(const struct radix_trie_key *a,
+                            const struct radix_trie_key *b)
+{
+    size_t n = a->len < b->len ? a->len : b->len, i = 0;
+    while (i < n && a->data[i] == b->data[i]) i++;
+    return i;
+}
+
+/*--layout of the arrays inside one memory block--*/
+static size_t layout(uint32_t node_count, uint32_t label_size,
+                     size_t *labels_off)
+{
+    size_t off = sizeof(struct radix_trie_header);
+    off += (size_t)node_count * sizeof(struct radix_trie_node);
+    *labels_off = off;
+    return off + label_size;
+}
+
+/*--point the arrays of the trie into its memory block--*/
+static void attach(struct radix_trie *trie)
+{
+    const struct radix_trie_header *h = trie->memory;
+    size_t lb;
+    layout(h->node_count, h->label_size, &lb);
+    trie->node_count = h->node_count;
+    trie->label_size = h->label_size;
+    trie->key_count = h->key_count;
+    trie->nodes = (const struct radix_trie_node *)(h + 1);
+    trie->labels = (const uint8_t *)trie->memory + lb;
+}
+
+/**
+ * Builds a trie from a list of keys. The keys are copied, duplicates are
+ * merged and each distinct key gets its rank in sorted order as id.
+ * @param trie trie to build
+ * @param keys the keys, in any order
+ * @param count number of keys
+ * @returns 0 on success, -1 if out of memory
+ */
+int radix_trie_build(struct radix_trie *trie, const struct radix_trie_key *keys,
+                     size_t count)
+{
+    int ret = -1;
+    struct radix_trie_key *sorted = malloc((count + 1) * sizeof(*sorted));
+    if (NULL == sorted)
+        return -1;
+    if (count > 0)
+        memcpy(sorted, keys, count * sizeof(*sorted));
+    qsort(sorted, count, sizeof(*sorted), key_compare);
+
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++)
+        if (0 == n || key_compare(&sorted[n - 1], &sorted[i]) != 0)
+            sorted[n++] = sorted[i];
+
+    // upper bounds: a node per key plus one branching node per key, and no
+    // more label bytes than the keys themselves hold
+    size_t max_nodes = 2 * n + 1, max_labels = 0;
+    for (size_t i = 0; i < n; i++) max_labels += sorted[i].len;
+
+    struct radix_trie_node *nodes = malloc(max_nodes * sizeof(*nodes));
+    uint8_t *labels = malloc(max_labels + 1);
+    // pending nodes: key range [lo, hi) whose first `depth` bytes are spelt
+    // out by the path to the node
+    struct pending
+    {
+        uint32_t node, lo, hi;
+        size_t depth;
+    } *stack = malloc(max_nodes * sizeof(*stack));
+    if (!nodes || !labels || !stack)
+        goto out;
+
+    uint32_t node_count = 1, label_size = 0;
+    size_t top = 0;
+    nodes[0].label = nodes[0].label_len = 0;
+    nodes[0].first = nodes[0].unused = 0;
+    stack[top++] = (struct pending){0, 0, (uint32_t)n, 0};
+
+    // the children of a node are created together, then the subtree of the
+    // first child is laid out before its siblings' so that a lookup going
+    // down one path mostly stays within a few cache lines
+    while (top > 0)
+    {
+        struct pending p = stack[--top];
+        struct radix_trie_node *node = &nodes[p.node];
+        uint32_t lo = p.lo;
+
+        // in sorted order the key ending at this node comes first
+        node->value = RADIX_TRIE_NONE;
+        if (lo < p.hi && sorted[lo].len == p.depth)
+            node->value = lo++;
+
+        node->first_child = node_count;
+        node->child_count = 0;
+        size_t pushed = top;
+        while (lo < p.hi)
+        {
+            uint8_t b = sorted[lo].data[p.depth];
+            uint32_t end = lo + 1;
+            while (end < p.hi && sorted[end].data[p.depth] == b) end++;
+
+            // the edge goes as far as all keys of the group agree
+            size_t depth = common_prefix(&sorted[lo], &sorted[end - 1]);
+            uint32_t child = node_count++;
+            uint32_t len = (uint32_t)(depth - p.depth);
+            nodes[child].label = 0;
+            nodes[child].label_len = len;
+            if (len <= RADIX_TRIE_INLINE)
+                memcpy(&nodes[child].label, sorted[lo].data + p.depth, len);
+            else
+            {
+                nodes[child].label = label_size;
+                memcpy(labels + label_size, sorted[lo].data + p.depth, len);
+                label_size += len;
+            }
+            nodes[child].first = b;
+            nodes[child].unused = 0;
+            node->child_count++;
+            stack[top++] = (struct pending){child, lo, end, depth};
+            lo = end;
+        }
+
+        // reverse the new entries so that the first child is popped first
+        for (size_t i = pushed, j = top; i + 1 < j; i++, j--)
+        {
+            struct pending t = stack[i];
+            stack[i] = stack[j - 1];
+            stack[j - 1] = t;
+        }
+    }
+
+    // copy into a single block laid out like the file format
+    size_t lb;
+    trie->memory_size = layout(node_count, label_size, &lb);
+    trie->memory = malloc(trie->memory_size);
+    if (NULL == trie->memory)
+        goto out;
+    struct radix_trie_header *h = trie->memory;
+    memcpy(h->magic, RADIX_TRIE_MAGIC, sizeof(h->magic));
+    h->node_count = node_count;
+    h->label_size = label_size;
+    h->key_count = (uint32_t)n;
+    h->reserved = 0;
+    memcpy(h + 1, nodes, node_count * sizeof(*nodes));
+    memcpy((uint8_t *)trie->memory + lb, labels, label_size);
+    trie->mapped = 0;
+    attach(trie);
+    ret = 0;
+
+out:
+    free(sorted);
+    free(nodes);
+    free(labels);
+    free(stack);
+    return ret;
+}
+
+/**
+ * Frees a trie, or unmaps it if it was loaded with radix_trie_map()
+ * @param trie trie to release
+ */
+void radix_trie_free(struct radix_trie *trie)
+{
+#ifdef RADIX_TRIE_HAS_MMAP
+    if (trie->mapped)
+        munmap(trie->memory, trie->memory_size);
+    else
+#endif
+        free(trie->memory);
+    trie->memory = NULL;
+    trie->nodes = NULL;
+}
+
+/*--bytes of the edge label leading to a node--*/
+static inline const uint8_t *label_of(const struct radix_trie *trie,
+                                      const struct radix_trie_node *node)
+{
+    if (node->label_len <= RADIX_TRIE_INLINE)
+        return (const uint8_t *)&node->label;
+    return trie->labels + node->label;
+}
+
+/*--child of `node` whose label starts with `b`, or -1--*/
+static int64_t find_child(const struct radix_trie *trie, uint32_t node,
+                          uint8_t b)
+{
+    uint32_t first = trie->nodes[node].first_child;
+    uint32_t last = first + trie->nodes[node].child_count;
+
+    // siblings are sorted by first byte and most nodes have few children, so
+    // a short scan is cheaper than a binary search; it also brings in the
+    // child about to be read
+    for (uint32_t i = first; i < last && trie->nodes[i].first <= b; i++)
+        if (trie->nodes[i].first == b)
+            return i;
+    return -1;
+}
+
+/*--walks down `key`; returns the node whose path has `key` as a prefix, or
+    -1 if no key starts with `key`. *label_start receives the length of the
+    path above the node's own label and *exact whether the path is `key`--*/
+static int64_t descend(const struct radix_trie *trie, const uint8_t *key,
+                       size_t len, size_t *label_start, int *exact)
+{
+    uint32_t node = 0;
+    size_t pos = 0;
+
+    *label_start = 0;
+    while (pos < len)
+    {
+        int64_t child = find_child(trie, node, key[pos]);
+        if (child < 0)
+            return -1;
+
+        // labels are mostly short, and their first byte is already known to
+        // match, so compare the rest by hand rather than calling memcmp
+        const struct radix_trie_node *c = &trie->nodes[child];
+        const uint8_t *label = label_of(trie, c);
+        size_t n = len - pos < c->label_len ? len - pos : c->label_len;
+        for (size_t i = 1; i < n; i++)
+            if (label[i] != key[pos + i])
+                return -1;
+        node = (uint32_t)child;
+        *label_start = pos;
+        pos += c->label_len;
+    }
+    *exact = pos == len;
+    return node;
+}
+
+/**
+ * Looks up a key
+ * @param trie trie to search
+ * @param key key bytes
+ * @param len key length
+ * @returns the id of the key or RADIX_TRIE_NONE if it is not in the trie
+ */
+uint32_t radix_trie_find(const struct radix_trie *trie, const uint8_t *key,
+                         size_t len)
+{
+    size_t label_start;
+    int exact = 0;
+    int64_t node = descend(trie, key, len, &label_start, &exact);
+    if (node < 0 || !exact)
+        return RADIX_TRIE_NONE;
+    return trie->nodes[node].value;
+}
+
+/**
+ * Reports, in sorted order, every key starting with `prefix`
+ * @param trie trie to search
+ * @param prefix prefix bytes
+ * @param len prefix length
+ * @param visit callback receiving each key; returning non-zero stops
+ * @param ctx passed through to `visit`
+ * @returns number of keys reported, or -1 if out of memory
+ */
+long radix_trie_prefix(const struct radix_trie *trie, const uint8_t *prefix,
+                       size_t len, radix_trie_visit visit, void *ctx)
+{
+    size_t label_start;
+    int exact;
+    int64_t start = descend(trie, prefix, len, &label_start, &exact);
+    if (start < 0)
+        return 0;
+
+    // the key being spelt out, and the nodes still to visit along with the
+    // length of the path above their label
+    struct frame
+    {
+        uint32_t node;
+        size_t depth;
+    };
+    size_t cap = 256, stack_cap = 256, top = 0;
+    uint8_t *buf = malloc(cap);
+    struct frame *stack = malloc(stack_cap * sizeof(*stack));
+    long count = 0;
+    if (!buf || !stack)
+        goto fail;
+
+    // keys starting inside the label of `start` still match the prefix
+    if (label_start > cap)
+    {
+        cap = label_start;
+        uint8_t *grown = realloc(buf, cap);
+        if (NULL == grown)
+            goto fail;
+        buf = grown;
+    }
+    memcpy(buf, prefix, label_start);
+    stack[top++] = (struct frame){(uint32_t)start, label_start};
+
+    while (top > 0)
+    {
+        struct frame f = stack[--top];
+        const struct radix_trie_node *n = &trie->nodes[f.node];
+        size_t end = f.depth + n->label_len;
+
+        if (end > cap)
+        {
+            while (cap < end) cap *= 2;
+            uint8_t *grown = realloc(buf, cap);
+            if (NULL == grown)
+                goto fail;
+            buf = grown;
+        }
+        memcpy(buf + f.depth, label_of(trie, n), n->label_len);
+
+        if (n->value != RADIX_TRIE_NONE)
+        {
+            count++;
+            if (visit && visit(buf, end, n->value, ctx))
+                break;
+        }
+
+        // push the children last to first so the first is visited next
+        if (top + n->child_count > stack_cap)
+        {
+            while (top + n->child_count > stack_cap) stack_cap *= 2;
+            struct frame *grown = realloc(stack, stack_cap * sizeof(*stack));
+            if (NULL == grown)
+                goto fail;
+            stack = grown;
+        }
+        for (uint32_t i = n->child_count; i-- > 0;)
+            stack[top++] = (struct frame){n->first_child + i, end};
+    }
+
+    free(buf);
+    free(stack);
+    return count;
+
+fail:
+    free(buf);
+    free(stack);
+    return -1;
+}
+
+/**
+ * Writes a trie to a file that radix_trie_map() can load
+ * @param trie trie to save
+ * @param path file name
+ * @returns 0 on success, -1 on error
+ */
+int radix_trie_save(const struct radix_trie *trie, const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    if (NULL == fp)
+        return -1;
+
+    size_t written = fwrite(trie->memory, 1, trie->memory_size, fp);
+    if (fclose(fp) != 0 || written != trie->memory_size)
+        return -1;
+    return 0;
+}
+
+/*--checks that a block holds a complete serialised trie--*/
+static int check_header(const void *memory, size_t size)
+{
+    const struct radix_trie_header *h = memory;
+    size_t lb;
+    if (size < sizeof(*h) ||
+        memcmp(h->magic, RADIX_TRIE_MAGIC, sizeof(h->magic)) != 0 ||
+        0 == h->node_count)
+        return -1;
+    if (layout(h->node_count, h->label_size, &lb) != size)
+        return -1;
+    return 0;
+}
+
+/**
+ * Loads a trie written by radix_trie_save(). Where available the file is
+ * mapped read-only rather than read, so loading costs no copying and the
+ * pages are shared between processes using the same file. The file is
+ * trusted: only its header and size are checked.
+ * @param trie trie to load into
+ * @param path file name
+ * @returns 0 on success, -1 on error
+ */
+int radix_trie_map(struct radix_trie *trie, const char *path)
+{
+#ifdef RADIX_TRIE_HAS_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    void *memory = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == memory)
+        return -1;
+    if (check_header(memory, size) != 0)
+    {
+        munmap(memory, size);
+        return -1;
+    }
+    trie->mapped = 1;
+#else
+    FILE *fp = fopen(path, "rb");
+    if (NULL == fp)
+        return -1;
+
+    size_t size = 0, cap = 1 << 16, got;
+    void *memory = malloc(cap);
+    while (memory && (got = fread((char *)memory + size, 1, cap - size, fp)))
+    {
+        size += got;
+        if (size == cap)
+        {
+            void *grown = realloc(memory, cap *= 2);
+            if (NULL == grown)
+                free(memory);
+            memory = grown;
+        }
+    }
+    fclose(fp);
+    if (NULL == memory || check_header(memory, size) != 0)
+    {
+        free(memory);
+        return -1;
+    }
+    trie->mapped = 0;
+#endif
+    trie->memory = memory;
+    trie->memory_size = size;
+    attach(trie);
+    return 0;
+}
+
+/*--------------------------------------------------------------------------
+    Tests
+  --------------------------------------------------------------------------*/
+
+/** collects the keys reported by radix_trie_prefix() */
+struct collected
+{
+    char keys[64][16];
+    size_t lens[64];
+    uint32_t ids[64];
+    int count;
+    int limit;
+};
+
+static int collect(const uint8_t *key, size_t len, uint32_t id, void *ctx)
+{
+    struct collected *c = ctx;
+    memcpy(c->keys[c->count], key, len);
+    c->lens[c->count] = len;
+    c->ids[c->count] = id;
+    return ++c->count == c->limit;
+}
+
+/*--checks the trie built from `keys` against a brute force scan--*/
+static void check(const struct radix_trie *trie,
+                  const struct radix_trie_key *keys, size_t count)
+{
+    // ids are ranks, so the number of distinct smaller keys
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t rank = 0;
+        for (size_t j = 0; j < count; j++)
+        {
+            int c = key_compare(&keys[j], &keys[i]);
+            int seen = 0;
+            for (size_t k = 0; k < j && c < 0 && !seen; k++)
+                seen = key_compare(&keys[k], &keys[j]) == 0;
+            rank += c < 0 && !seen;
+        }
+        assert(radix_trie_find(trie, keys[i].data, keys[i].len) == rank);
+    }
+
+    // every prefix of a key enumerates exactly the keys extending it
+    for (size_t i = 0; i < count; i++)
+        for (size_t p = 0; p <= keys[i].len; p++)
+        {
+            long expect = 0;
+            for (size_t j = 0; j < count; j++)
+            {
+                int dup = 0;
+                for (size_t k = 0; k < j && !dup; k++)
+                    dup = key_compare(&keys[k], &keys[j]) == 0;
+                expect += !dup && keys[j].len >= p &&
+                          0 == memcmp(keys[j].data, keys[i].data, p);
+            }
+            assert(radix_trie_prefix(trie, keys[i].data, p, NULL, NULL) ==
+                   expect);
+        }
+}
+
+static void test()
+{
+    // the key set of the original demo, binary keys, a duplicate and ""
+    static const struct radix_trie_key keys[] = {
+        {(const uint8_t *)"romane", 6},    {(const uint8_t *)"romanus", 7},
+        {(const uint8_t *)"romulus", 7},   {(const uint8_t *)"rubens", 6},
+        {(const uint8_t *)"ruber", 5},     {(const uint8_t *)"rubicon", 7},
+        {(const uint8_t *)"rubicundus", 10}, {(const uint8_t *)"rom", 3},
+        {(const uint8_t *)"a\0b", 3},      {(const uint8_t *)"a\0", 2},
+        {(const uint8_t *)"\xff\xfe", 2},  {(const uint8_t *)"ruber", 5},
+        {(const uint8_t *)"", 0},
+    };
+    const size_t count = sizeof(keys) / sizeof(keys[0]);
+    struct radix_trie trie;
+
+    assert(radix_trie_build(&trie, keys, count) == 0);
+    assert(trie.key_count == count - 1);
+    assert(trie.node_count < 2 * trie.key_count + 1);
+    check(&trie, keys, count);
+
+    assert(radix_trie_find(&trie, (const uint8_t *)"roma", 4) ==
+           RADIX_TRIE_NONE);
+    assert(radix_trie_find(&trie, (const uint8_t *)"romanes", 7) ==
+           RADIX_TRIE_NONE);
+    assert(radix_trie_find(&trie, (const uint8_t *)"a", 1) == RADIX_TRIE_NONE);
+    assert(radix_trie_prefix(&trie, (const uint8_t *)"x", 1, NULL, NULL) == 0);
+
+    // sorted order, stopping early, and a prefix ending inside a label
+    struct collected c = {.limit = 64};
+    assert(radix_trie_prefix(&trie, (const uint8_t *)"rub", 3, collect, &c) ==
+           4);
+    assert(c.count == 4 && 0 == memcmp(c.keys[0], "rubens", 6) &&
+           0 == memcmp(c.keys[3], "rubicundus", 10));
+    assert(c.ids[1] + 1 == c.ids[2]);
+    c = (struct collected){.limit = 2};
+    assert(radix_trie_prefix(&trie, (const uint8_t *)"ro", 2, collect, &c) ==
+           2);
+    assert(c.lens[0] == 3 && c.lens[1] == 6);
+
+    // round trip through a file
+    const char *path = "radix_trie.test.bin";
+    struct radix_trie loaded;
+    assert(radix_trie_save(&trie, path) == 0);
+    assert(radix_trie_map(&loaded, path) == 0);
+    assert(loaded.node_count == trie.node_count);
+    check(&loaded, keys, count);
+    radix_trie_free(&loaded);
+
+    // a truncated file is rejected
+    FILE *fp = fopen(path, "wb");
+    fwrite(trie.memory, 1, trie.memory_size - 1, fp);
+    fclose(fp);
+    assert(radix_trie_map(&loaded, path) == -1);
+    remove(path);
+    radix_trie_free(&trie);
+
+    // random binary keys over a small alphabet, so that they share prefixes
+    static uint8_t data[300][8];
+    static struct radix_trie_key random_keys[300];
+    srand(31);
+    for (int i = 0; i < 300; i++)
+    {
+        random_keys[i].data = data[i];
+        random_keys[i].len = rand() % 9;
+        for (size_t j = 0; j < random_keys[i].len; j++)
+            data[i][j] = (uint8_t)(rand() % 3 * 127);
+    }
+    assert(radix_trie_build(&trie, random_keys, 300) == 0);
+    check(&trie, random_keys, 300);
+    radix_trie_free(&trie);
+
+    assert(radix_trie_build(&trie, NULL, 0) == 0);
+    assert(trie.node_count == 1 && radix_trie_find(&trie, NULL, 0) ==
+                                       RADIX_TRIE_NONE);
+    radix_trie_free(&trie);
+
+    printf("All tests have successfully passed!\n");
+}
+
+/*--------------------------------------------------------------------------
+    Comparison with trie.c
+  --------------------------------------------------------------------------*/
+
+/** the node of trie.c, with its insert and search made iterative */
+struct trie
+{
+    struct trie *children[26];
+    int end_of_word;
+};
+
+static long trie_nodes;
+
+static int trie_insert(struct trie *trie, const char *word, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned index = (unsigned)(word[i] - 'a');
+        if (index >= 26)
+            return -1;
+        if (NULL == trie->children[index])
+        {
+            trie->children[index] = calloc(1, sizeof(struct trie));
+            if (NULL == trie->children[index])
+                return -1;
+            trie_nodes++;
+        }
+        trie = trie->children[index];
+    }
+    trie->end_of_word = 1;
+    return 0;
+}
+
+static int trie_find(const struct trie *trie, const char *word, size_t len)
+{
+    for (size_t i = 0; i < len && trie; i++)
+        trie = trie->children[(unsigned)(word[i] - 'a')];
+    return trie && trie->end_of_word;
+}
+
+static void trie_free(struct trie *trie)
+{
+    for (int i = 0; i < 26; i++)
+        if (trie->children[i])
+            trie_free(trie->children[i]);
+    free(trie);
+}
+
+static double seconds(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/** prints a word found by radix_trie_prefix() */
+static int print_word(const uint8_t *key, size_t len, uint32_t id, void *ctx)
+{
+    (void)id;
+    (void)ctx;
+    printf("%.*s\n", (int)len, (const char *)key);
+    return 0;
+}
+
+/**
+ * Loads a word list into both tries, compares them, then searches prefixes
+ * typed by the user
+ */
+static int demo(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (NULL == fp)
+    {
+        fprintf(stderr, "Could not open %s\n", path);
+        return 1;
+    }
+
+    size_t count = 0, cap = 1024, text_size = 0;
+    struct radix_trie_key *keys = malloc(cap * sizeof(*keys));
+    char *text = NULL, word[101];
+    long text_cap = 0;
+    fseek(fp, 0, SEEK_END);
+    text_cap = ftell(fp) + 1;
+    rewind(fp);
+    text = malloc(text_cap);
+    while (keys && text && 1 == fscanf(fp, "%100s", word))
+    {
+        size_t len = strlen(word);
+        if (count == cap)
+            keys = realloc(keys, (cap *= 2) * sizeof(*keys));
+        if (NULL == keys || text_size + len > (size_t)text_cap)
+            break;
+        memcpy(text + text_size, word, len);
+        keys[count].data = (const uint8_t *)text + text_size;
+        keys[count++].len = len;
+        text_size += len;
+    }
+    fclose(fp);
+    if (!keys || !text)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    struct radix_trie radix;
+    clock_t t = clock();
+    if (radix_trie_build(&radix, keys, count) != 0)
+    {
+        fprintf(stderr, "Could not build the radix trie\n");
+        return 1;
+    }
+    double radix_build = seconds(t);
+
+    struct trie *root = calloc(1, sizeof(struct trie));
+    t = clock();
+    for (size_t i = 0; i < count && root; i++)
+        if (trie_insert(root, (const char *)keys[i].data, keys[i].len) != 0)
+        {
+            fprintf(stderr, "Could not insert word into trie\n");
+            return 1;
+        }
+    double trie_build = seconds(t);
+
+    // look the words up in random order, as sorted lookups hide cache misses
+    for (size_t i = count; i > 1; i--)
+    {
+        size_t j = (size_t)rand() % i;
+        struct radix_trie_key k = keys[i - 1];
+        keys[i - 1] = keys[j];
+        keys[j] = k;
+    }
+
+    long found = 0;
+    t = clock();
+    for (size_t i = 0; i < count; i++)
+        found += radix_trie_find(&radix, keys[i].data, keys[i].len) !=
+                 RADIX_TRIE_NONE;
+    double radix_find = seconds(t);
+    assert((size_t)found == count);
+
+    found = 0;
+    t = clock();
+    for (size_t i = 0; i < count; i++)
+        found += trie_find(root, (const char *)keys[i].data, keys[i].len);
+    double trie_find_time = seconds(t);
+    assert((size_t)found == count);
+
+    printf("\n%zu words from %s\n", count, path);
+    printf("            nodes      memory (MiB)  build (s)  find all (s)\n");
+    printf("trie.c      %-10ld %-13.1f %-10.3f %.3f\n", trie_nodes + 1,
+           (trie_nodes + 1) * sizeof(struct trie) / 1048576.0, trie_build,
+           trie_find_time);
+    printf("radix trie  %-10u %-13.1f %-10.3f %.3f\n", radix.node_count,
+           radix.memory_size / 1048576.0, radix_build, radix_find);
+
+    // reloading a saved trie only maps the file
+    const char *saved = "radix_trie.bin";
+    struct radix_trie loaded;
+    double map_time = -1;
+    t = clock();
+    if (0 == radix_trie_save(&radix, saved))
+    {
+        double save_time = seconds(t);
+        t = clock();
+        if (0 == radix_trie_map(&loaded, saved))
+        {
+            map_time = seconds(t);
+            for (size_t i = 0; i < count; i++)
+                assert(radix_trie_find(&loaded, keys[i].data, keys[i].len) ==
+                       radix_trie_find(&radix, keys[i].data, keys[i].len));
+            radix_trie_free(&loaded);
+        }
+        remove(saved);
+        printf("radix trie saved in %.3f s, mapped back in %.6f s\n",
+               save_time, map_time);
+    }
+
+    trie_free(root);
+    free(keys);
+    free(text);
+
+    char prefix[101];
+    while (1)
+    {
+        printf("Enter keyword: ");
+        if (1 != scanf("%100s", prefix))
+            break;
+
+        printf("\n===================== Possible Words =====================\n");
+        if (radix_trie_prefix(&radix, (const uint8_t *)prefix, strlen(prefix),
+                              print_word, NULL) == 0)
+            printf("No results\n");
+        printf("==========================================================\n");
+    }
+    printf("\n");
+
+    radix_trie_free(&radix);
+    return 0;
+}
+
+/**
+ * Main function
+ * @param argc number of arguments
+ * @param argv optional word list, `dictionary.txt` by default
+ * @returns 0 on exit
+ */
+int main(int argc, char **argv)
+{
+    test();
+    return demo(argc > 1 ? argv[1] : "dictionary.txt");
+}
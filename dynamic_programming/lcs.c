@@ -10,10 +10,12 @@
  * @author [Kurtz](https://github.com/itskurtz)
  */
 
+#include <stdint.h>		/* for uint64_t */
 #include <stdio.h>		/* for io operations */
 #include <stdlib.h>		/* for memory management & exit */
 #include <string.h>		/* for string manipulation & ooperations */
 #include <assert.h>		/* for asserts */
+#include <time.h>		/* for clock */
 
 enum {LEFT, UP, DIAG};
 
@@ -93,6 +95,770 @@ char *lcsbuild(const char *s1, int l1, int l2, int **L, int **B) {
 	return lcs;
 }
 
+/*
+ * The DP above keeps two (l1+1) x (l2+1) tables of ints: two sequences of
+ * 100000 lines need 80 GB. The functions below work on sequences of symbols
+ * (bytes, or lines numbered by lcs_intern_lines()) in O(l1 + l2) memory:
+ * - lcs_bitparallel_length() computes the length of the LCS with the
+ *   bit-vector recurrence of Allison-Dix and Hyyro, 64 cells per operation;
+ * - lcs_hirschberg() finds the LCS itself, splitting the problem with the
+ *   rows of the bit-parallel kernel as Hirschberg does with the DP rows;
+ * - myers_diff() finds the shortest edit script in O((l1 + l2) D) time, D
+ *   being the number of inserted and deleted symbols, with Myers' search of
+ *   the middle snake, so it is fastest on similar sequences.
+ */
+
+#define HIRSCHBERG_BASE 4096	/* DP below this many cells */
+
+/**
+ * @brief Work space of the bit-parallel kernel for sequences of symbols
+ * below `symbols`; the per-symbol arrays are restored after each use
+ */
+struct bp_work {
+	size_t symbols;		/* number of different symbols */
+	uint32_t *count;	/* occurrences of each symbol in `a` */
+	int32_t *slot;		/* dense mask of each symbol, or -1 */
+	size_t *start;		/* first position of each sparse symbol in `pos` */
+	size_t *pos;		/* positions of the sparse symbols */
+	uint64_t *v;		/* the bit-vector, 1 where the row does not grow */
+	uint64_t *m;		/* match mask of a sparse symbol, zero between uses */
+	uint64_t *dense;	/* match masks of the frequent symbols */
+	size_t dense_cap;	/* words allocated in `dense` */
+};
+
+/**
+ * @brief Allocates the work space for sequences `a` of at most `m` symbols
+ * @returns 0 on success, -1 if out of memory
+ */
+static int bp_init(struct bp_work *w, size_t symbols, size_t m) {
+	size_t words = m / 64 + 1, i;
+
+	w->symbols = symbols;
+	w->count = (uint32_t *)calloc(symbols, sizeof(uint32_t));
+	w->slot = (int32_t *)malloc(symbols * sizeof(int32_t));
+	w->start = (size_t *)malloc(symbols * sizeof(size_t));
+	w->pos = (size_t *)malloc((m + 1) * sizeof(size_t));
+	w->v = (uint64_t *)malloc(words * sizeof(uint64_t));
+	w->m = (uint64_t *)calloc(words, sizeof(uint64_t));
+	/* a symbol is dense if it occurs at least once per word, so all the
+	   dense masks together take at most m + words words */
+	w->dense_cap = m + words;
+	w->dense = (uint64_t *)malloc(w->dense_cap * sizeof(uint64_t));
+	if (!w->count || !w->slot || !w->start || !w->pos || !w->v || !w->m ||
+	    !w->dense)
+		return -1;
+	for (i = 0; i < symbols; i++)
+		w->slot[i] = -1;
+	return 0;
+}
+
+/**
+ * @brief Frees the work space of the bit-parallel kernel
+ * @returns void
+ */
+static void bp_free(struct bp_work *w) {
+	free(w->count);
+	free(w->slot);
+	free(w->start);
+	free(w->pos);
+	free(w->v);
+	free(w->m);
+	free(w->dense);
+}
+
+/**
+ * @brief Runs the bit-parallel LCS recurrence of `a` against `b`
+ *
+ * Bit i of the bit-vector V is 0 where L[j][i + 1] = L[j][i] + 1 in the
+ * row j of the DP, and for each symbol of `b`, with M the positions of that
+ * symbol in `a`, V' = (V + (V & M)) | (V & ~M). Symbols seen at least once
+ * per word of V get a mask of their own; the others are set in a shared mask
+ * for their row and cleared after.
+ * @param w work space
+ * @param a sequence along the bits
+ * @param m length of `a`
+ * @param b sequence along the rows
+ * @param n length of `b`
+ * @param row if not NULL, receives L[n][i] for i = 0..m
+ * @returns length of the LCS of `a` and `b`
+ */
+static size_t bp_run(struct bp_work *w, const unsigned *a, size_t m,
+		     const unsigned *b, size_t n, int *row) {
+	size_t words = m / 64 + 1, ndense = 0, next = 0, i, j, k, zeros = 0;
+
+	for (i = 0; i < m; i++)
+		w->count[a[i]]++;
+	for (i = 0; i < m; i++) {
+		unsigned s = a[i];
+		if (w->count[s] >= words && w->slot[s] < 0) {
+			w->slot[s] = (int32_t)ndense;
+			memset(w->dense + ndense++ * words, 0,
+			       words * sizeof(uint64_t));
+		}
+		else if (w->count[s] < words && w->count[s] > 0) {
+			/* sparse: reserve its positions, then mark it done */
+			w->start[s] = next;
+			next += w->count[s];
+			w->count[s] = 0;
+		}
+	}
+	/* count now holds the positions filled for the sparse symbols */
+	for (i = 0; i < m; i++) {
+		unsigned s = a[i];
+		if (w->slot[s] >= 0)
+			w->dense[w->slot[s] * words + i / 64] |= 1ULL << (i % 64);
+		else
+			w->pos[w->start[s] + w->count[s]++] = i;
+	}
+
+	for (k = 0; k < words; k++)
+		w->v[k] = ~0ULL;
+	for (j = 0; j < n; j++) {
+		unsigned s = b[j];
+		const uint64_t *mask;
+		uint64_t carry = 0;
+
+		if (w->slot[s] >= 0)
+			mask = w->dense + w->slot[s] * words;
+		else if (w->count[s] > 0) {
+			for (k = 0; k < w->count[s]; k++) {
+				i = w->pos[w->start[s] + k];
+				w->m[i / 64] |= 1ULL << (i % 64);
+			}
+			mask = w->m;
+		}
+		else
+			continue;	/* not in a: the row does not change */
+
+		for (k = 0; k < words; k++) {
+			uint64_t v = w->v[k], u = v & mask[k];
+			uint64_t t = v + carry, sum = t + u;
+			carry = (t < carry) | (sum < u);
+			w->v[k] = sum | (v & ~mask[k]);
+		}
+
+		if (mask == w->m)
+			for (k = 0; k < w->count[s]; k++) {
+				i = w->pos[w->start[s] + k];
+				w->m[i / 64] = 0;
+			}
+	}
+
+	if (row)
+		row[0] = 0;
+	for (i = 0; i < m; i++) {
+		zeros += !((w->v[i / 64] >> (i % 64)) & 1);
+		if (row)
+			row[i + 1] = (int)zeros;
+	}
+
+	for (i = 0; i < m; i++) {
+		w->count[a[i]] = 0;
+		w->slot[a[i]] = -1;
+	}
+	return zeros;
+}
+
+/**
+ * @brief Length of the LCS with the bit-parallel kernel, in O(l1 l2 / 64)
+ * time and O(l1 + symbols) memory
+ * @param a first sequence
+ * @param l1 length of a
+ * @param b second sequence
+ * @param l2 length of b
+ * @param symbols all symbols of a and b are below it
+ * @returns length of the LCS, or -1 if out of memory
+ */
+long lcs_bitparallel_length(const unsigned *a, size_t l1, const unsigned *b,
+			    size_t l2, size_t symbols) {
+	struct bp_work w;
+	long len = -1;
+
+	if (bp_init(&w, symbols, l1) == 0)
+		len = (long)bp_run(&w, a, l1, b, l2, NULL);
+	bp_free(&w);
+	return len;
+}
+
+/**
+ * @brief State of lcs_hirschberg()
+ */
+struct hirschberg {
+	const unsigned *a, *b;		/* the sequences */
+	const unsigned *ra, *rb;	/* the sequences reversed */
+	size_t l1, l2;			/* their lengths */
+	struct bp_work w;		/* bit-parallel work space */
+	int *fwd, *bwd;			/* rows of the two halves */
+	int *table;			/* DP table of the small problems */
+	size_t *ai, *bi;		/* the LCS as pairs of positions */
+	size_t len;			/* pairs found */
+};
+
+/**
+ * @brief Solves a small problem with the DP of lcslen() and appends its LCS
+ * @returns void
+ */
+static void hirschberg_dp(struct hirschberg *h, size_t a0, size_t a1,
+			  size_t b0, size_t b1) {
+	size_t m = a1 - a0, n = b1 - b0, i, j, k;
+	int *L = h->table;
+
+	for (i = 0; i <= m; i++) {
+		for (j = 0; j <= n; j++) {
+			if (i == 0 || j == 0)
+				L[i * (n + 1) + j] = 0;
+			else if (h->a[a0 + i - 1] == h->b[b0 + j - 1])
+				L[i * (n + 1) + j] = L[(i - 1) * (n + 1) + j - 1] + 1;
+			else if (L[(i - 1) * (n + 1) + j] < L[i * (n + 1) + j - 1])
+				L[i * (n + 1) + j] = L[i * (n + 1) + j - 1];
+			else
+				L[i * (n + 1) + j] = L[(i - 1) * (n + 1) + j];
+		}
+	}
+
+	/* walk back, writing the pairs from the end */
+	k = h->len + L[m * (n + 1) + n];
+	h->len = k;
+	for (i = m, j = n; i > 0 && j > 0;) {
+		if (h->a[a0 + i - 1] == h->b[b0 + j - 1]) {
+			k--;
+			h->ai[k] = a0 + --i;
+			h->bi[k] = b0 + --j;
+		}
+		else if (L[(i - 1) * (n + 1) + j] < L[i * (n + 1) + j - 1])
+			j--;
+		else
+			i--;
+	}
+}
+
+/**
+ * @brief Appends the LCS of a[a0..a1) and b[b0..b1) to the pairs
+ * @returns void
+ */
+static void hirschberg_rec(struct hirschberg *h, size_t a0, size_t a1,
+			   size_t b0, size_t b1) {
+	size_t tail = 0, m, mid, best = 0, i;
+	long best_len = -1;
+
+	/* common prefix and suffix */
+	while (a0 < a1 && b0 < b1 && h->a[a0] == h->b[b0]) {
+		h->ai[h->len] = a0++;
+		h->bi[h->len++] = b0++;
+	}
+	while (a0 < a1 && b0 < b1 && h->a[a1 - 1] == h->b[b1 - 1]) {
+		a1--;
+		b1--;
+		tail++;
+	}
+
+	m = a1 - a0;
+	if (m == 0 || b1 == b0)
+		;
+	else if (b1 - b0 == 1) {
+		for (i = a0; i < a1 && h->a[i] != h->b[b0]; i++)
+			;
+		if (i < a1) {
+			h->ai[h->len] = i;
+			h->bi[h->len++] = b0;
+		}
+	}
+	else if (m * (b1 - b0) <= HIRSCHBERG_BASE)
+		hirschberg_dp(h, a0, a1, b0, b1);
+	else {
+		/* the LCS crosses the middle row between the best prefix of
+		   a with the top half and the rest of a with the bottom half */
+		mid = b0 + (b1 - b0) / 2;
+		bp_run(&h->w, h->a + a0, m, h->b + b0, mid - b0, h->fwd);
+		bp_run(&h->w, h->ra + (h->l1 - a1), m, h->rb + (h->l2 - b1),
+		       b1 - mid, h->bwd);
+		for (i = 0; i <= m; i++)
+			if (h->fwd[i] + h->bwd[m - i] > best_len) {
+				best_len = h->fwd[i] + h->bwd[m - i];
+				best = i;
+			}
+		hirschberg_rec(h, a0, a0 + best, b0, mid);
+		hirschberg_rec(h, a0 + best, a1, mid, b1);
+	}
+
+	for (i = 0; i < tail; i++) {
+		h->ai[h->len] = a1 + i;
+		h->bi[h->len++] = b1 + i;
+	}
+}
+
+/**
+ * @brief Finds a longest common subsequence in linear space with
+ * Hirschberg's divide and conquer
+ * @param a first sequence
+ * @param l1 length of a
+ * @param b second sequence
+ * @param l2 length of b
+ * @param symbols all symbols of a and b are below it
+ * @param ai receives the positions in a of the LCS, min(l1, l2) of them
+ * @param bi receives the matching positions in b
+ * @returns length of the LCS, or -1 if out of memory
+ */
+long lcs_hirschberg(const unsigned *a, size_t l1, const unsigned *b,
+		    size_t l2, size_t symbols, size_t *ai, size_t *bi) {
+	struct hirschberg h;
+	unsigned *ra = (unsigned *)malloc((l1 + 1) * sizeof(unsigned));
+	unsigned *rb = (unsigned *)malloc((l2 + 1) * sizeof(unsigned));
+	long len = -1;
+	size_t i;
+
+	memset(&h, 0, sizeof(h));
+	h.fwd = (int *)malloc((l1 + 1) * sizeof(int));
+	h.bwd = (int *)malloc((l1 + 1) * sizeof(int));
+	h.table = (int *)malloc((2 * HIRSCHBERG_BASE + 2) * sizeof(int));
+	if (bp_init(&h.w, symbols, l1) == 0 && ra && rb && h.fwd && h.bwd &&
+	    h.table) {
+		for (i = 0; i < l1; i++)
+			ra[i] = a[l1 - 1 - i];
+		for (i = 0; i < l2; i++)
+			rb[i] = b[l2 - 1 - i];
+		h.a = a, h.b = b, h.ra = ra, h.rb = rb;
+		h.l1 = l1, h.l2 = l2;
+		h.ai = ai, h.bi = bi;
+		hirschberg_rec(&h, 0, l1, 0, l2);
+		len = (long)h.len;
+	}
+
+	bp_free(&h.w);
+	free(h.fwd);
+	free(h.bwd);
+	free(h.table);
+	free(ra);
+	free(rb);
+	return len;
+}
+
+/**
+ * @brief One operation of an edit script: `len` symbols that are equal
+ * (`' '`), deleted from a (`'-'`), or inserted from b (`'+'`), from a[a]
+ * and b[b]
+ */
+struct edit {
+	char op;
+	size_t a, b, len;
+};
+
+/**
+ * @brief Edit script turning a into b
+ */
+struct edit_script {
+	struct edit *e;		/* the operations in order */
+	size_t count, cap;	/* operations used and allocated */
+	size_t d;		/* symbols deleted and inserted */
+	int failed;		/* out of memory */
+};
+
+/**
+ * @brief Appends an operation, merging it with the last one if they follow
+ * each other
+ * @returns void
+ */
+static void script_add(struct edit_script *s, char op, size_t a, size_t b,
+		       size_t len) {
+	struct edit *last = s->count ? &s->e[s->count - 1] : NULL;
+
+	if (len == 0)
+		return;
+	if (op != ' ')
+		s->d += len;
+	if (last && last->op == op && last->a + (op != '+') * last->len == a &&
+	    last->b + (op != '-') * last->len == b) {
+		last->len += len;
+		return;
+	}
+	if (s->count == s->cap) {
+		size_t cap = s->cap ? 2 * s->cap : 64;
+		struct edit *e = (struct edit *)realloc(s->e, cap * sizeof(*e));
+		if (!e) {
+			s->failed = 1;
+			return;
+		}
+		s->e = e;
+		s->cap = cap;
+	}
+	s->e[s->count].op = op;
+	s->e[s->count].a = a;
+	s->e[s->count].b = b;
+	s->e[s->count++].len = len;
+}
+
+/**
+ * @brief Shortest edit script of a[a0..a1) into b[b0..b1): common prefix
+ * and suffix, then the middle snake of Myers' bidirectional search, where a
+ * forward and a backward furthest-reaching D-path meet, splits the problem
+ * in two
+ * @returns void
+ */
+static void myers_rec(const unsigned *a, size_t a0, size_t a1,
+		      const unsigned *b, size_t b0, size_t b1,
+		      struct edit_script *s) {
+	size_t head = 0, tail = 0;
+	long n1, n2, max_d, delta, d, k, x1, y1, x2, y2;
+	long k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+	long *v1, *v2, split_x = -1, split_y = -1;
+	int front;
+
+	while (a0 + head < a1 && b0 + head < b1 && a[a0 + head] == b[b0 + head])
+		head++;
+	script_add(s, ' ', a0, b0, head);
+	a0 += head;
+	b0 += head;
+	while (a0 + tail < a1 && b0 + tail < b1 &&
+	       a[a1 - 1 - tail] == b[b1 - 1 - tail])
+		tail++;
+	a1 -= tail;
+	b1 -= tail;
+
+	n1 = (long)(a1 - a0);
+	n2 = (long)(b1 - b0);
+	if (n1 == 0 || n2 == 0) {
+		script_add(s, '-', a0, b0, n1);
+		script_add(s, '+', a1, b0, n2);
+		script_add(s, ' ', a1, b1, tail);
+		return;
+	}
+
+	max_d = (n1 + n2 + 1) / 2;
+	v1 = (long *)malloc((2 * max_d + 2) * sizeof(long));
+	v2 = (long *)malloc((2 * max_d + 2) * sizeof(long));
+	if (!v1 || !v2) {
+		free(v1);
+		free(v2);
+		s->failed = 1;
+		return;
+	}
+	for (k = 0; k < 2 * max_d + 2; k++)
+		v1[k] = v2[k] = -1;
+	v1[max_d + 1] = v2[max_d + 1] = 0;
+	delta = n1 - n2;
+	front = delta % 2 != 0;	/* the forward path meets the backward one */
+
+	for (d = 0; d < max_d && split_x < 0; d++) {
+		/* forward paths on diagonals k = x - y */
+		for (k = -d + k1start; k <= d - k1end && split_x < 0; k += 2) {
+			long *v = v1 + max_d + k;
+			if (k == -d || (k != d && v[-1] < v[1]))
+				x1 = v[1];
+			else
+				x1 = v[-1] + 1;
+			y1 = x1 - k;
+			while (x1 < n1 && y1 < n2 && a[a0 + x1] == b[b0 + y1])
+				x1++, y1++;
+			*v = x1;
+			if (x1 > n1)
+				k1end += 2;	/* off the right */
+			else if (y1 > n2)
+				k1start += 2;	/* off the bottom */
+			else if (front) {
+				long k2 = max_d + delta - k;
+				if (k2 >= 0 && k2 < 2 * max_d + 2 && v2[k2] != -1 &&
+				    x1 >= n1 - v2[k2])
+					split_x = x1, split_y = y1;
+			}
+		}
+		/* backward paths, x and y counted from the ends */
+		for (k = -d + k2start; k <= d - k2end && split_x < 0; k += 2) {
+			long *v = v2 + max_d + k;
+			if (k == -d || (k != d && v[-1] < v[1]))
+				x2 = v[1];
+			else
+				x2 = v[-1] + 1;
+			y2 = x2 - k;
+			while (x2 < n1 && y2 < n2 &&
+			       a[a1 - 1 - x2] == b[b1 - 1 - y2])
+				x2++, y2++;
+			*v = x2;
+			if (x2 > n1)
+				k2end += 2;
+			else if (y2 > n2)
+				k2start += 2;
+			else if (!front) {
+				long k1 = max_d + delta - k;
+				if (k1 >= 0 && k1 < 2 * max_d + 2 && v1[k1] != -1) {
+					x1 = v1[k1];
+					y1 = max_d + x1 - k1;
+					if (x1 >= n1 - x2)
+						split_x = x1, split_y = y1;
+				}
+			}
+		}
+	}
+	free(v1);
+	free(v2);
+
+	if (split_x < 0) {	/* nothing in common */
+		script_add(s, '-', a0, b0, n1);
+		script_add(s, '+', a1, b0, n2);
+	}
+	else {
+		myers_rec(a, a0, a0 + split_x, b, b0, b0 + split_y, s);
+		myers_rec(a, a0 + split_x, a1, b, b0 + split_y, b1, s);
+	}
+	script_add(s, ' ', a1, b1, tail);
+}
+
+/**
+ * @brief Shortest edit script turning a into b, with Myers' O(ND)
+ * algorithm in linear space; its equal symbols are a longest common
+ * subsequence
+ * @param a first sequence
+ * @param l1 length of a
+ * @param b second sequence
+ * @param l2 length of b
+ * @param s receives the script, to release with free(s->e)
+ * @returns number of deleted and inserted symbols, or -1 if out of memory
+ */
+long myers_diff(const unsigned *a, size_t l1, const unsigned *b, size_t l2,
+		struct edit_script *s) {
+	memset(s, 0, sizeof(*s));
+	myers_rec(a, 0, l1, b, 0, l2, s);
+	return s->failed ? -1 : (long)s->d;
+}
+
+/**
+ * @brief Table numbering the different lines of texts
+ */
+struct line_table {
+	const char **text;	/* first occurrence of each line */
+	size_t *len;		/* and its length */
+	size_t *hash;		/* and its hash */
+	unsigned *index;	/* open addressing table of line numbers + 1 */
+	size_t count, cap;	/* lines numbered, table size */
+};
+
+/**
+ * @brief Splits a text into lines and numbers them, the same line getting
+ * the same number in all the texts given to the same table
+ * @param t table, zero-initialized before the first text
+ * @param text the text
+ * @param size its size in bytes
+ * @param lines receives the first byte of each line, or NULL
+ * @param symbols receives the number of each line
+ * @returns number of lines, or -1 if out of memory
+ */
+long lcs_intern_lines(struct line_table *t, const char *text, size_t size,
+		      const char **lines, unsigned *symbols) {
+	size_t n = 0, at = 0, i;
+
+	while (at < size) {
+		const char *line = text + at;
+		const char *end = (const char *)memchr(line, '\n', size - at);
+		size_t len = end ? (size_t)(end - line) + 1 : size - at;
+		size_t h = 14695981039346656037ULL;	/* FNV-1a */
+
+		for (i = 0; i < len; i++)
+			h = (h ^ (unsigned char)line[i]) * 1099511628211ULL;
+		if (2 * (t->count + 1) > t->cap) {
+			/* grow to keep the table at most half full */
+			size_t cap = t->cap ? 2 * t->cap : 1024, j;
+			unsigned *index = (unsigned *)calloc(cap, sizeof(unsigned));
+			const char **txt = (const char **)realloc(
+				t->text, cap / 2 * sizeof(char *));
+			size_t *lens = (size_t *)realloc(t->len,
+							 cap / 2 * sizeof(size_t));
+			size_t *hashes = (size_t *)realloc(
+				t->hash, cap / 2 * sizeof(size_t));
+			if (txt)
+				t->text = txt;
+			if (lens)
+				t->len = lens;
+			if (hashes)
+				t->hash = hashes;
+			if (!index || !txt || !lens || !hashes) {
+				free(index);
+				return -1;
+			}
+			for (j = 0; j < t->count; j++) {
+				size_t slot = t->hash[j] & (cap - 1);
+				while (index[slot])
+					slot = (slot + 1) & (cap - 1);
+				index[slot] = (unsigned)j + 1;
+			}
+			free(t->index);
+			t->index = index;
+			t->cap = cap;
+		}
+		for (i = h & (t->cap - 1); t->index[i];
+		     i = (i + 1) & (t->cap - 1)) {
+			unsigned k = t->index[i] - 1;
+			if (t->hash[k] == h && t->len[k] == len &&
+			    memcmp(t->text[k], line, len) == 0)
+				break;
+		}
+		if (!t->index[i]) {
+			t->text[t->count] = line;
+			t->len[t->count] = len;
+			t->hash[t->count] = h;
+			t->index[i] = (unsigned)++t->count;
+		}
+		if (lines)
+			lines[n] = line;
+		symbols[n++] = t->index[i] - 1;
+		at += len;
+	}
+	return (long)n;
+}
+
+/**
+ * @brief Frees a line table
+ * @returns void
+ */
+void lcs_free_lines(struct line_table *t) {
+	free(t->text);
+	free(t->len);
+	free(t->hash);
+	free(t->index);
+}
+
+/**
+ * @brief LCS length of two strings with lcslen(), and the LCS if `lcs` is
+ * not NULL
+ * @returns the length, or -1 if out of memory
+ */
+static long lcs_dp(const char *s1, const char *s2, char **lcs) {
+	int l1 = strlen(s1), l2 = strlen(s2), i;
+	int **L = (int **)calloc(l1 + 1, sizeof(int *));
+	int **B = (int **)calloc(l1 + 1, sizeof(int *));
+	long len = -1;
+
+	for (i = 0; L && B && i <= l1; i++) {
+		L[i] = (int *)calloc(l2 + 1, sizeof(int));
+		B[i] = (int *)calloc(l2 + 1, sizeof(int));
+		if (!L[i] || !B[i])
+			break;
+	}
+	if (L && B && i > l1) {
+		lcslen(s1, s2, l1, l2, L, B);
+		len = L[l1][l2];
+		if (lcs)
+			*lcs = lcsbuild(s1, l1, l2, L, B);
+	}
+	for (i = 0; L && B && i <= l1; i++)
+		free(L[i]), free(B[i]);
+	free(L);
+	free(B);
+	return len;
+}
+
+/**
+ * @brief Checks that a script turns a into b with d changes
+ * @returns number of equal symbols of the script
+ */
+static size_t check_script(const struct edit_script *s, const unsigned *a,
+			   size_t l1, const unsigned *b, size_t l2) {
+	size_t i = 0, j = 0, equal = 0, d = 0, k, t;
+
+	for (k = 0; k < s->count; k++) {
+		const struct edit *e = &s->e[k];
+		assert(e->a == i && e->b == j && e->len > 0);
+		if (e->op == ' ')
+			for (t = 0; t < e->len; t++, equal++)
+				assert(a[i + t] == b[j + t]);
+		i += e->op != '+' ? e->len : 0;
+		j += e->op != '-' ? e->len : 0;
+		d += e->op != ' ' ? e->len : 0;
+	}
+	assert(i == l1 && j == l2 && d == s->d);
+	return equal;
+}
+
+/**
+ * @brief A random sequence of `n` symbols below `sigma` in a, and in b
+ * either another one or a with random changes
+ * @returns length of b
+ */
+static size_t random_pair(unsigned *a, size_t n, unsigned *b, unsigned sigma,
+			  int edits) {
+	size_t i, m = 0;
+
+	for (i = 0; i < n; i++)
+		a[i] = rand() % sigma;
+	if (edits < 0) {
+		for (i = 0; i < n; i++)
+			b[i] = rand() % sigma;
+		return n;
+	}
+	/* about `edits` changes per 1000 symbols, as in edited files */
+	for (i = 0; i < n; i++) {
+		int r = rand() % 1000;
+		if (r < edits / 3)
+			continue;				/* deleted */
+		if (r < 2 * edits / 3)
+			b[m++] = rand() % sigma;		/* inserted */
+		b[m++] = r < edits ? rand() % sigma : a[i];	/* replaced */
+	}
+	return m;
+}
+
+/**
+ * @brief Checks the linear-space functions against lcslen()
+ * @returns void
+ */
+static void test_linear() {
+	unsigned a[600], b[1200];
+	size_t ai[600], bi[600];
+	char s1[601], s2[1201], *lcs;
+	struct edit_script s;
+	struct line_table t;
+	int trial;
+	long got;
+
+	srand(11);
+	for (trial = 0; trial < 400; trial++) {
+		size_t l1 = rand() % 600, l2, i;
+		unsigned sigma = 1 + rand() % (trial % 2 ? 4 : 200);
+		long len, d;
+
+		l2 = random_pair(a, l1, b, sigma, trial % 3 ? 20 * (trial % 7) : -1);
+		for (i = 0; i < l1; i++)
+			s1[i] = (char)(a[i] + 1);
+		for (i = 0; i < l2; i++)
+			s2[i] = (char)(b[i] + 1);
+		s1[l1] = s2[l2] = '\0';
+		len = lcs_dp(s1, s2, NULL);
+
+		got = lcs_bitparallel_length(a, l1, b, l2, sigma);
+		assert(got == len);
+		got = lcs_hirschberg(a, l1, b, l2, sigma, ai, bi);
+		assert(got == len);
+		for (i = 0; i < (size_t)len; i++) {
+			assert(a[ai[i]] == b[bi[i]]);
+			assert(i == 0 || (ai[i] > ai[i - 1] && bi[i] > bi[i - 1]));
+		}
+		d = myers_diff(a, l1, b, l2, &s);
+		assert(d == (long)(l1 + l2) - 2 * len);
+		assert(check_script(&s, a, l1, b, l2) == (size_t)len);
+		free(s.e);
+	}
+
+	/* the sequences of test() */
+	strcpy(s1, "ACGGTGTCGTGCTATGCTGATGCTGACTTATATGCTA");
+	strcpy(s2, "CGTTCGGCTATCGTACGTTCTATTCTATGATTTCTAA");
+	for (trial = 0; s1[trial]; trial++)
+		a[trial] = (unsigned char)s1[trial], b[trial] = (unsigned char)s2[trial];
+	got = lcs_hirschberg(a, trial, b, trial, 256, ai, bi);
+	assert(got == 27);
+	got = lcs_dp(s1, s2, &lcs);
+	assert(got == 27 && strlen(lcs) == 27);
+	free(lcs);
+
+	/* lines are numbered by content across both texts */
+	memset(&t, 0, sizeof(t));
+	got = lcs_intern_lines(&t, "a\nb\na\n", 6, NULL, a);
+	assert(got == 3);
+	got = lcs_intern_lines(&t, "b\na\nc", 5, NULL, b);
+	assert(got == 3);
+	assert(a[0] == 0 && a[1] == 1 && a[2] == 0);
+	assert(b[0] == 1 && b[1] == 0 && b[2] == 2 && t.count == 3);
+	lcs_free_lines(&t);
+	(void)got;
+}
+
 /**
  * @brief Self-test implementations
  * @returns void
@@ -153,13 +919,210 @@ static void test() {
 	printf("All tests have successfully passed!\n");
 }
 
+/**
+ * @brief Seconds since an arbitrary point
+ */
+static double seconds() {
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+/**
+ * @brief Times the DP against the linear-space functions on sequences with
+ * 1% of changes and on unrelated sequences
+ * @returns void
+ */
+static void benchmark() {
+	const struct {
+		size_t n;
+		unsigned sigma;
+		int edits;
+	} cases[] = {{2000, 200, 10}, {4000, 200, 10}, {4000, 200, -1},
+		     {100000, 5000, 10}, {20000, 5000, -1}};
+	size_t c;
+
+	printf("\n%8s %8s %8s %14s %10s %10s %10s %10s\n", "n", "changes",
+	       "LCS", "DP", "bit-par.", "Hirsch.", "Myers", "D");
+	for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+		size_t n = cases[c].n, l2, i;
+		unsigned *a = (unsigned *)malloc(n * sizeof(unsigned));
+		unsigned *b = (unsigned *)malloc(2 * n * sizeof(unsigned));
+		size_t *ai = (size_t *)malloc(n * sizeof(size_t));
+		size_t *bi = (size_t *)malloc(n * sizeof(size_t));
+		struct edit_script s;
+		double t;
+		long len, got, d;
+
+		if (!a || !b || !ai || !bi) {
+			perror("malloc");
+			exit(1);
+		}
+		l2 = random_pair(a, n, b, cases[c].sigma, cases[c].edits);
+		printf("%8zu %8s", n, cases[c].edits < 0 ? "all" : "1%");
+
+		t = seconds();
+		len = lcs_bitparallel_length(a, n, b, l2, cases[c].sigma);
+		t = seconds() - t;
+		printf(" %8ld", len);
+		if (n <= 4000 && cases[c].sigma < 256) {
+			/* two (n+1)^2 tables of ints */
+			char *s1 = (char *)malloc(n + 1), *s2 = (char *)malloc(l2 + 1);
+			double t_dp = seconds();
+			for (i = 0; i < n; i++)
+				s1[i] = (char)(a[i] + 1);
+			for (i = 0; i < l2; i++)
+				s2[i] = (char)(b[i] + 1);
+			s1[n] = s2[l2] = '\0';
+			got = lcs_dp(s1, s2, NULL);
+			printf(" %6.3f s %3zu MB", seconds() - t_dp,
+			       2 * (n + 1) * (l2 + 1) * sizeof(int) >> 20);
+			assert(got == len);
+			free(s1);
+			free(s2);
+		}
+		else
+			printf(" %14s", "-");
+		printf(" %8.3f s", t);
+
+		t = seconds();
+		got = lcs_hirschberg(a, n, b, l2, cases[c].sigma, ai, bi);
+		printf(" %8.3f s", seconds() - t);
+		assert(got == len);
+
+		t = seconds();
+		d = myers_diff(a, n, b, l2, &s);
+		printf(" %8.3f s %10ld\n", seconds() - t, d);
+		assert(d == (long)(n + l2) - 2 * len);
+		(void)got;
+		free(s.e);
+		free(a);
+		free(b);
+		free(ai);
+		free(bi);
+	}
+}
+
+/**
+ * @brief Reads a whole file
+ * @returns the contents, to free(), or NULL on error
+ */
+static char *read_file(const char *name, size_t *size) {
+	FILE *fp = fopen(name, "rb");
+	char *data = NULL;
+	size_t cap = 0;
+
+	*size = 0;
+	if (!fp) {
+		perror(name);
+		return NULL;
+	}
+	for (;;) {
+		if (*size == cap) {
+			char *grown = (char *)realloc(data, cap = cap ? 2 * cap : 65536);
+			if (!grown) {
+				perror("realloc");
+				free(data);
+				fclose(fp);
+				return NULL;
+			}
+			data = grown;
+		}
+		size_t got = fread(data + *size, 1, cap - *size, fp);
+		if (got == 0)
+			break;
+		*size += got;
+	}
+	fclose(fp);
+	return data;
+}
+
+/**
+ * @brief Prints the differences between two files, by lines, or by bytes
+ * with `bytes`
+ * @returns 0 on success, 1 on error
+ */
+static int diff_files(const char *name1, const char *name2, int bytes) {
+	size_t size1, size2, l1, l2, k, i;
+	char *text1 = read_file(name1, &size1), *text2 = read_file(name2, &size2);
+	unsigned *a = (unsigned *)malloc((size1 + 1) * sizeof(unsigned));
+	unsigned *b = (unsigned *)malloc((size2 + 1) * sizeof(unsigned));
+	const char **lines1 = (const char **)malloc((size1 + 1) * sizeof(char *));
+	const char **lines2 = (const char **)malloc((size2 + 1) * sizeof(char *));
+	struct line_table t;
+	struct edit_script s;
+	int ret = 1;
+
+	memset(&t, 0, sizeof(t));
+	memset(&s, 0, sizeof(s));
+	if (!text1 || !text2 || !a || !b || !lines1 || !lines2)
+		goto done;
+	if (bytes) {
+		for (l1 = 0; l1 < size1; l1++)
+			a[l1] = (unsigned char)text1[l1];
+		for (l2 = 0; l2 < size2; l2++)
+			b[l2] = (unsigned char)text2[l2];
+	}
+	else {
+		long n1 = lcs_intern_lines(&t, text1, size1, lines1, a);
+		long n2 = lcs_intern_lines(&t, text2, size2, lines2, b);
+		if (n1 < 0 || n2 < 0)
+			goto done;
+		l1 = n1, l2 = n2;
+		lines1[l1] = text1 + size1;
+		lines2[l2] = text2 + size2;
+	}
+	if (myers_diff(a, l1, b, l2, &s) < 0)
+		goto done;
+
+	for (k = 0; k < s.count; k++) {
+		const struct edit *e = &s.e[k];
+		if (e->op == ' ')
+			continue;
+		/* a change: deleted symbols and the inserted ones after */
+		if (k == 0 || s.e[k - 1].op == ' ') {
+			size_t del = e->op == '-' ? e->len : 0;
+			size_t ins = e->op == '+' ? e->len :
+				     k + 1 < s.count && s.e[k + 1].op == '+' ?
+				     s.e[k + 1].len : 0;
+			printf("@@ -%zu,%zu +%zu,%zu @@\n", e->a + 1, del,
+			       e->b + 1, ins);
+		}
+		for (i = 0; !bytes && i < e->len; i++) {
+			const char *line = e->op == '-' ? lines1[e->a + i] :
+							  lines2[e->b + i];
+			const char *end = e->op == '-' ? lines1[e->a + i + 1] :
+							 lines2[e->b + i + 1];
+			printf("%c%.*s", e->op, (int)(end - line), line);
+			if (end[-1] != '\n')
+				printf("\n\\ No newline at end of file\n");
+		}
+	}
+	fprintf(stderr, "%zu changed %s, LCS %zu\n", s.d,
+		bytes ? "bytes" : "lines", (l1 + l2 - s.d) / 2);
+	ret = 0;
+done:
+	free(text1);
+	free(text2);
+	free(a);
+	free(b);
+	free(lines1);
+	free(lines2);
+	free(s.e);
+	lcs_free_lines(&t);
+	return ret;
+}
+
 /**
  * @brief Main function
- * @param argc commandline argument count (ignored)
- * @param argv commandline array of arguments (ignored)
+ * @param argc commandline argument count
+ * @param argv `[-b] file1 file2` to print their differences by lines, or
+ * by bytes with `-b`; without arguments, runs the tests and the benchmark
  * @returns 0 on exit
  */
 int main(int argc, char *argv[]) {
+	if (argc == 3 || (argc == 4 && strcmp(argv[1], "-b") == 0))
+		return diff_files(argv[argc - 2], argv[argc - 1], argc == 4);
 	test();  // run self-test implementations
+	test_linear();
+	benchmark();
 	return 0;
 }
@@ -8,66 +8,405 @@
  * multiply a given sequence of matrices. The problem is not actually to perform
  * the multiplications, but merely to decide the sequence of the matrix
  * multiplications involved.
+ *
+ * matrixChainOrder() is the classic O(n^3) dynamic programming algorithm. Its
+ * costs are 64-bit and kept in one n x n table, where the cost of the chain
+ * i..j is stored both at [i][j] and at [j][i], so that the inner loop reads
+ * the costs of the two halves along rows. The chains of the same length are
+ * independent, and are computed in parallel with OpenMP, one length after
+ * the other.
+ *
+ * matrixChainOrderHuShing() solves chains of thousands of matrices with the
+ * theory of [Hu and Shing](https://doi.org/10.1137/0211028): the chain is a
+ * convex polygon whose vertices weigh the dimensions, and an optimal
+ * triangulation only uses arcs whose inner vertices all weigh more than
+ * both ends, and fans from the lightest vertex of each region they bound.
  * @author [CascadingCascade](https://github.com/CascadingCascade)
  */
 
 #include <assert.h>  /// for assert
-#include <limits.h>  /// for INT_MAX macro
+#include <stdint.h>  /// for uint64_t and UINT64_MAX
 #include <stdio.h>   /// for IO operations
 #include <stdlib.h>  /// for malloc() and free()
+#include <string.h>  /// for memset()
+#include <time.h>    /// for clock()
+#ifdef _OPENMP
+#include <omp.h>  /// for omp_get_wtime()
+#endif
 
 /**
  * @brief Finds the optimal sequence using the classic O(n^3) algorithm.
- * @param l length of cost array
- * @param p costs of each matrix
- * @param s location to store results
- * @returns number of operations
+ * @param l length of the dimensions array, one more than the number of
+ * matrices
+ * @param p dimensions: matrix i is p[i] x p[i + 1]
+ * @param s location to store results: s[i * l + j] is the last matrix of the
+ * first half of the chain i..j
+ * @returns number of scalar multiplications, or UINT64_MAX if out of memory
  */
-int matrixChainOrder(int l, const int *p, int *s)
+uint64_t matrixChainOrder(int l, const int *p, int *s)
 {
-    // mat stores the cost for a chain that starts at i and ends on j (inclusive
-    // on both ends)
-    int **mat = malloc(l * sizeof(int *));
-    for (int i = 0; i < l; ++i)
+    const size_t n = l - 1;  // number of matrices
+    if (l < 2)
     {
-        mat[i] = malloc(l * sizeof(int));
+        return 0;
     }
 
-    for (int i = 0; i < l; ++i)
+    // cost[i * n + j] and cost[j * n + i] are the cost of the chain i..j
+    uint64_t *cost = malloc(n * n * sizeof(uint64_t));
+    if (cost == NULL)
+    {
+        return UINT64_MAX;
+    }
+    for (size_t i = 0; i < n; ++i)
     {
-        mat[i][i] = 0;
+        cost[i * n + i] = 0;
+        s[i * l + i] = (int)i;
     }
+
     // cl denotes the difference between start / end indices, cl + 1 would be
-    // chain length.
-    for (int cl = 1; cl < l; ++cl)
+    // chain length. The chains of a length only need shorter ones.
+#ifdef _OPENMP
+#pragma omp parallel if (n >= 256)
+#endif
+    for (size_t cl = 1; cl < n; ++cl)
     {
-        for (int i = 0; i < l - cl; ++i)
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 8)
+#endif
+        for (size_t i = 0; i < n - cl; ++i)
         {
-            int j = i + cl;
-            mat[i][j] = INT_MAX;
-            for (int div = i; div < j; ++div)
+            size_t j = i + cl, div = i;
+            const uint64_t *left = cost + i * n;   // left[k] = cost(i, k)
+            const uint64_t *right = cost + j * n;  // right[k] = cost(k, j)
+            uint64_t outer = (uint64_t)p[i] * p[j + 1], best = UINT64_MAX;
+            for (size_t k = i; k < j; ++k)
             {
-                int q = mat[i][div] + mat[div + 1][j] + p[i] * p[div] * p[j];
-                if (q < mat[i][j])
+                uint64_t q = left[k] + right[k + 1] + outer * p[k + 1];
+                if (q < best)
                 {
-                    mat[i][j] = q;
-                    s[i * l + j] = div;
+                    best = q;
+                    div = k;
                 }
             }
+            cost[i * n + j] = cost[j * n + i] = best;
+            s[i * l + j] = (int)div;
         }
     }
-    int result = mat[0][l - 1];
+    uint64_t result = cost[n - 1];
+
+    free(cost);
+    return result;
+}
+
+/**
+ * @brief Arc of the polygon of matrixChainOrderHuShing(), or the whole
+ * polygon for the root
+ */
+struct arc
+{
+    int i, j;        ///< ends, as positions from the lightest vertex
+    int m;           ///< lighter end, the apex of the fan of its region
+    int parent;      ///< smallest arc around it
+    int child;       ///< first arc inside it
+    int sibling;     ///< next arc inside its parent
+    int depth;       ///< number of arcs around it
+    uint64_t sides;  ///< weight of its sides not inside a smaller arc
+    size_t bits;     ///< first of its `depth` bits of decisions
+    uint64_t *f;     ///< best cost under each arc around it
+};
+
+/**
+ * @brief Arcs by start, then the enclosing ones first, for qsort()
+ */
+static int compareArcs(const void *a, const void *b)
+{
+    const struct arc *x = a, *y = b;
+    if (x->i != y->i)
+    {
+        return x->i < y->i ? -1 : 1;
+    }
+    return (x->j < y->j) - (x->j > y->j);
+}
 
-    // Free dynamically allocated memory
-    for (int i = 0; i < l; ++i)
+/**
+ * @brief Finds an optimal sequence for long chains, in O(n h) time and
+ * memory, h being the largest number of nested arcs (h-arcs)
+ *
+ * The dimensions are the vertices of a polygon, and a triangle xyz of a
+ * triangulation costs p[x] p[y] p[z]. With the vertices numbered from the
+ * lightest V1 and ties broken by position, the arcs whose inner vertices
+ * are all heavier than both ends are found with a stack and nest like
+ * parentheses. An optimal triangulation keeps some of them, and fans each
+ * region they bound from its lightest vertex, which is the lighter end of
+ * the arc around it. Hu and Shing decide which arcs to keep in O(n log n)
+ * with mergeable queues; this function rather computes, for each arc and
+ * each arc around it, the best cost of its inside when the arc around is
+ * the nearest kept one. h is about log n for random dimensions, and up to
+ * n / 2 when the dimensions grow and then shrink. Every order, not only
+ * the best, must cost less than 2^64.
+ * @param l length of the dimensions array
+ * @param p dimensions: matrix i is p[i] x p[i + 1]
+ * @param tri if not NULL, receives the l - 2 triangles of the
+ * triangulation, three dimension indices each
+ * @returns number of scalar multiplications, or UINT64_MAX if out of memory
+ */
+uint64_t matrixChainOrderHuShing(int l, const int *p, int *tri)
+{
+    const int n = l;  // vertices; position n is vertex 0 again
+    if (l < 3)
     {
-        free(mat[i]);
+        return 0;
     }
-    free(mat);
 
+    int r = 0;  // the lightest vertex, first if several
+    for (int k = 1; k < n; ++k)
+    {
+        if (p[k] < p[r])
+        {
+            r = k;
+        }
+    }
+    uint64_t *w = malloc((n + 1) * sizeof(uint64_t));
+    int *stack = malloc((n + 1) * sizeof(int));
+    int *owner = malloc(n * sizeof(int));  // arc owning each side k, k + 1
+    struct arc *arcs = malloc(n * sizeof(struct arc));
+    uint64_t *sum = malloc(n * sizeof(uint64_t));
+    int *path = malloc(n * sizeof(int));
+    unsigned char *keep = NULL;
+    uint64_t result = UINT64_MAX;
+    int count = 1, top = -1, t;
+    if (!w || !stack || !owner || !arcs || !sum || !path)
+    {
+        goto done;
+    }
+    for (int k = 0; k <= n; ++k)
+    {
+        w[k] = (uint64_t)p[(k + r) % n];
+    }
+// v heavier than u, with ties broken by position and n being vertex 0
+#define HEAVIER(v, u) \
+    (w[v] > w[u] || (w[v] == w[u] && (v) % n > (u) % n))
+
+    // arcs: each vertex popped by a lighter one at j is heavier than both
+    // j and the vertex below it on the stack, as are those between them
+    arcs[0].i = 0;
+    arcs[0].j = n;
+    for (int j = 0; j <= n; ++j)
+    {
+        while (top >= 0 && HEAVIER(stack[top], j))
+        {
+            if (--top >= 0 && !(stack[top] == 0 && j == n))
+            {
+                arcs[count].i = stack[top];
+                arcs[count++].j = j;
+            }
+        }
+        stack[++top] = j;
+    }
+    qsort(arcs + 1, count - 1, sizeof(struct arc), compareArcs);
+
+    // tree of the arcs, and the sides each one owns, parents first
+    size_t bits = 0;
+    top = -1;
+    for (int c = 0; c < count; ++c)
+    {
+        struct arc *a = &arcs[c];
+        while (top >= 0 && a->i >= arcs[stack[top]].j)
+        {
+            --top;
+        }
+        a->parent = top >= 0 ? stack[top] : -1;
+        a->depth = top + 1;
+        a->m = a->j == n ? 0 : HEAVIER(a->j, a->i) ? a->i : a->j;
+        a->child = a->sibling = -1;
+        a->sides = 0;
+        a->bits = bits;
+        a->f = NULL;
+        bits += a->depth;
+        for (int k = a->i; k < a->j; ++k)
+        {
+            owner[k] = c;
+        }
+        stack[++top] = c;
+    }
+    for (int c = count - 1; c > 0; --c)
+    {
+        arcs[c].sibling = arcs[arcs[c].parent].child;
+        arcs[arcs[c].parent].child = c;
+    }
+    for (int k = 0; k < n; ++k)
+    {
+        arcs[owner[k]].sides += w[k] * w[k + 1];
+    }
+#undef HEAVIER
+
+    keep = calloc(bits / 8 + 1, 1);
+    if (keep == NULL)
+    {
+        goto done;
+    }
+
+// weight of the sides of arc c not touching the apex at position m
+#define SIDES(c, m)                                                       \
+    (arcs[c].sides -                                                      \
+     (owner[m] == (c) ? w[m] * w[(m) + 1] : 0) -                          \
+     (owner[(m) ? (m)-1 : n - 1] == (c) ? w[(m) ? (m)-1 : n - 1] * w[m] \
+                                        : 0))
+    // arcs inside first: f[t] is the best cost of the inside of the arc
+    // when the nearest kept arc around it is its ancestor at depth t
+    for (int c = count - 1; c >= 0; --c)
+    {
+        struct arc *a = &arcs[c];
+        int depth = a->depth;
+        uint64_t g;
+
+        for (t = 0; t <= depth; ++t)
+        {
+            sum[t] = 0;
+        }
+        for (int d = a->child; d >= 0; d = arcs[d].sibling)
+        {
+            for (t = 0; t <= depth; ++t)
+            {
+                sum[t] += arcs[d].f[t];
+            }
+            free(arcs[d].f);
+            arcs[d].f = NULL;
+        }
+        // cost of the inside if this arc is kept: its region is a fan
+        g = sum[depth] + w[a->m] * SIDES(c, a->m);
+        if (c == 0)
+        {
+            result = g;
+            break;
+        }
+
+        a->f = malloc(depth * sizeof(uint64_t));
+        if (a->f == NULL)
+        {
+            goto done;
+        }
+        for (int anc = a->parent; anc >= 0; anc = arcs[anc].parent)
+        {
+            path[arcs[anc].depth] = arcs[anc].m;
+        }
+        for (t = 0; t < depth; ++t)
+        {
+            int m = path[t];  // apex of the region of the kept arc around
+            uint64_t kept = g, dropped = sum[t] + w[m] * SIDES(c, m);
+            if (a->i % n != m && a->j % n != m)
+            {
+                kept += w[m] * w[a->i] * w[a->j];  // the arc is a side
+            }
+            a->f[t] = kept < dropped ? kept : dropped;
+            if (kept < dropped)
+            {
+                keep[(a->bits + t) / 8] |= 1 << ((a->bits + t) % 8);
+            }
+        }
+    }
+#undef SIDES
+
+    // the triangles, from the root down
+    if (tri != NULL)
+    {
+        int made = 0;
+        top = -1;
+        stack[++top] = 0;
+        path[0] = 0;  // depth of the nearest kept arc around each arc
+        while (top >= 0)
+        {
+            int c = stack[top--];
+            struct arc *a = &arcs[c];
+            int kd = c ? path[c] : 0, m = arcs[c].m;
+            if (c != 0)
+            {
+                int anc = a->parent;
+                while (arcs[anc].depth > kd)
+                {
+                    anc = arcs[anc].parent;
+                }
+                size_t bit = a->bits + kd;
+                if (keep[bit / 8] >> (bit % 8) & 1)
+                {
+                    int am = arcs[anc].m;
+                    if (a->i % n != am && a->j % n != am)
+                    {
+                        tri[3 * made] = am;
+                        tri[3 * made + 1] = a->i % n;
+                        tri[3 * made + 2] = a->j % n;
+                        made++;
+                    }
+                    kd = a->depth;
+                }
+                else
+                {
+                    m = arcs[anc].m;
+                }
+            }
+            for (int k = a->i; k < a->j; ++k)
+            {
+                if (owner[k] == c && k != m && (k + 1) % n != m)
+                {
+                    tri[3 * made] = m;
+                    tri[3 * made + 1] = k;
+                    tri[3 * made + 2] = (k + 1) % n;
+                    made++;
+                }
+            }
+            for (int d = a->child; d >= 0; d = arcs[d].sibling)
+            {
+                path[d] = kd;
+                stack[++top] = d;
+            }
+        }
+        assert(made == l - 2);
+        for (t = 0; t < 3 * made; ++t)
+        {
+            tri[t] = (tri[t] + r) % n;  // back to the indices of p
+        }
+    }
+
+done:
+    for (int c = 0; arcs != NULL && c < count; ++c)
+    {
+        free(arcs[c].f);
+    }
+    free(w);
+    free(stack);
+    free(owner);
+    free(arcs);
+    free(sum);
+    free(path);
+    free(keep);
     return result;
 }
 
+/**
+ * @brief Converts a triangulation to the solutions of matrixChainOrder()
+ * @param l length of the dimensions array
+ * @param tri the l - 2 triangles of matrixChainOrderHuShing()
+ * @param s location to store results
+ * @returns void
+ */
+void triangulationToSolution(int l, const int *tri, int *s)
+{
+    for (int t = 0; t < l - 2; ++t)
+    {
+        int x = tri[3 * t], y = tri[3 * t + 1], z = tri[3 * t + 2];
+        int lo = x < y ? x : y, hi = x < y ? y : x;
+        // the triangle lo, mid, hi splits the chain lo..hi-1 after mid-1
+        int mid = z < lo ? lo : z > hi ? hi : z;
+        lo = z < lo ? z : lo;
+        hi = z > hi ? z : hi;
+        s[lo * l + hi - 1] = mid - 1;
+    }
+    for (int i = 0; i < l - 1; ++i)
+    {
+        s[i * l + i] = i;
+    }
+}
+
 /**
  * @brief Recursively prints the solution
  * @param l dimension of the solutions array
@@ -89,6 +428,93 @@ void printSolution(int l, int *s, int i, int j)
     putchar(')');
 }
 
+/**
+ * @brief Cost of multiplying the chain i..j in the order of a solution
+ * @param l dimension of the solutions array
+ * @param p dimensions
+ * @param s solutions
+ * @param i starting index
+ * @param j ending index
+ * @returns number of scalar multiplications
+ */
+static uint64_t solutionCost(int l, const int *p, const int *s, int i, int j)
+{
+    if (i == j)
+    {
+        return 0;
+    }
+    int div = s[i * l + j];
+    assert(div >= i && div < j);
+    return solutionCost(l, p, s, i, div) + solutionCost(l, p, s, div + 1, j) +
+           (uint64_t)p[i] * p[div + 1] * p[j + 1];
+}
+
+/**
+ * @brief Cost of the best order of the chain i..j, trying them all
+ * @param p dimensions
+ * @param i starting index
+ * @param j ending index
+ * @returns number of scalar multiplications
+ */
+static uint64_t bruteForce(const int *p, int i, int j)
+{
+    uint64_t best = UINT64_MAX;
+    if (i == j)
+    {
+        return 0;
+    }
+    for (int k = i; k < j; ++k)
+    {
+        uint64_t q = bruteForce(p, i, k) + bruteForce(p, k + 1, j) +
+                     (uint64_t)p[i] * p[k + 1] * p[j + 1];
+        best = q < best ? q : best;
+    }
+    return best;
+}
+
+/**
+ * @brief Fills dimensions: random ones up to `range`, or for `shape` 1
+ * rising then falling, 2 falling then rising
+ * @param l length of the dimensions array
+ * @param p dimensions
+ * @param range largest dimension
+ * @param shape ordering of the dimensions
+ * @returns void
+ */
+static void randomChain(int l, int *p, int range, int shape)
+{
+    for (int k = 0; k < l; ++k)
+    {
+        p[k] = 1 + rand() % range;
+        if (shape)
+        {
+            int rise = k < l / 2 ? k : l - k;
+            p[k] = (shape == 1 ? 1 + rise : l - rise) * range / l + 1;
+            p[k] += rand() % 3;
+        }
+    }
+}
+
+/**
+ * @brief Solves a chain with both algorithms and checks they agree
+ * @param l length of the dimensions array
+ * @param p dimensions
+ * @returns the cost
+ */
+static uint64_t checkChain(int l, const int *p)
+{
+    int *s = malloc(l * l * sizeof(int));
+    int *tri = malloc(3 * l * sizeof(int));
+    uint64_t r = matrixChainOrder(l, p, s);
+    assert(solutionCost(l, p, s, 0, l - 2) == r);
+    assert(matrixChainOrderHuShing(l, p, tri) == r);
+    triangulationToSolution(l, tri, s);
+    assert(solutionCost(l, p, s, 0, l - 2) == r);
+    free(s);
+    free(tri);
+    return r;
+}
+
 /**
  * @brief Self-test implementations
  * @returns void
@@ -98,14 +524,88 @@ static void test()
     int sizes[] = {35, 15, 5, 10, 20, 25};
     int len = 6;
     int *sol = malloc(len * len * sizeof(int));
-    int r = matrixChainOrder(len, sizes, sol);
-    assert(r == 18625);
-    printf("Result : %d\n", r);
+    uint64_t r = matrixChainOrder(len, sizes, sol);
+    assert(r == 10500);
+    assert(r == bruteForce(sizes, 0, len - 2));
+    printf("Result : %llu\n", (unsigned long long)r);
     printf("Optimal ordering : ");
-    printSolution(len, sol, 0, 5);
+    printSolution(len, sol, 0, len - 2);
     free(sol);
-
     printf("\n");
+
+    int clrs[] = {30, 35, 15, 5, 10, 20, 25};
+    assert(checkChain(7, clrs) == 15125);
+    int one[] = {10, 20}, two[] = {10, 20, 30}, equal[] = {5, 5, 5, 5, 5};
+    assert(matrixChainOrderHuShing(2, one, NULL) == 0);
+    assert(checkChain(3, two) == 6000);
+    assert(checkChain(5, equal) == 375);
+
+    int p[160];
+    srand(42);
+    for (int t = 0; t < 2000; ++t)
+    {
+        int l = 2 + rand() % 8;
+        randomChain(l, p, t % 2 ? 4 : 100, 0);
+        assert(checkChain(l, p) == bruteForce(p, 0, l - 2));
+    }
+    for (int t = 0; t < 3000; ++t)
+    {
+        int l = 2 + rand() % 159, range[] = {3, 30, 1000, 100000};
+        randomChain(l, p, range[t % 4], t % 3);
+        checkChain(l, p);
+    }
+}
+
+/**
+ * @brief Times both algorithms on chains of 1000 to 10000 matrices
+ * @returns void
+ */
+static void benchmark()
+{
+    const int sizes[] = {1000, 2000, 5000, 10000};
+    const char *shapes[] = {"random", "rising then falling"};
+    int *p = malloc((sizes[3] + 1) * sizeof(int));
+    int *tri = malloc(3 * (sizes[3] + 1) * sizeof(int));
+
+    for (int shape = 0; shape < 2; ++shape)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            int l = sizes[k] + 1;
+            uint64_t dp = 0, hs;
+            double dpTime = 0, hsTime;
+            clock_t start;
+            srand(k);
+            randomChain(l, p, 1000, shape);
+            if (l <= 2001)  // 8 l^2 bytes of costs and l^3 / 6 steps
+            {
+                int *s = malloc((size_t)l * l * sizeof(int));
+#ifdef _OPENMP
+                double wall = omp_get_wtime();
+                dp = matrixChainOrder(l, p, s);
+                dpTime = omp_get_wtime() - wall;
+#else
+                start = clock();
+                dp = matrixChainOrder(l, p, s);
+                dpTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+#endif
+                free(s);
+            }
+            start = clock();
+            hs = matrixChainOrderHuShing(l, p, tri);
+            hsTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+            assert(dp == 0 || dp == hs);
+            printf("%-19s %5d matrices: cost %llu, Hu-Shing %.4f s",
+                   shapes[shape], l - 1, (unsigned long long)hs, hsTime);
+            if (dp)
+            {
+                printf(", dynamic programming %.3f s", dpTime);
+            }
+            printf("\n");
+        }
+    }
+    free(p);
+    free(tri);
 }
 
 /**
@@ -115,5 +615,6 @@ static void test()
 int main()
 {
     test();  // run self-test implementations
+    benchmark();
     return 0;
 }
@@ -0,0 +1,233 @@
+/*
+    Tests of the streaming word counter of word_count.c: words cut by the
+    chunks, case folding and punctuation, merging, the ties of the top
+    words and the file counted by 1 or more threads.
+
+    usage: gcc -fopenmp test_word_count.c word_count.c && ./a.out
+*/
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "word_count.h"
+
+#define TEST_FILE "test_word_count.txt"
+
+static const char *const sample =
+    "Joe can't tell between 'large' and large. JOE's 42 CAN'T, "
+    "rock'n'roll'' \xc3\xa9t\xc3\xa9";
+
+/* counts text given in chunks of `chunk` bytes */
+static void count_chunks(word_counter_t *counter, const char *text,
+                         size_t chunk)
+{
+    size_t length = strlen(text), i, n;
+    int error = word_count_init(counter);
+
+    for (i = 0; !error && i < length; i += n)
+    {
+        n = length - i < chunk ? length - i : chunk;
+        error = word_count_feed(counter, text + i, n);
+    }
+    if (!error)
+    {
+        error = word_count_finish(counter);
+    }
+    assert(error == 0);
+    (void)error;
+}
+
+/* whether two counters hold the same words the same number of times */
+static int same_counts(const word_counter_t *a, const word_counter_t *b)
+{
+    size_t i;
+    if (a->unique != b->unique || a->total != b->total)
+    {
+        return 0;
+    }
+    for (i = 0; i < a->capacity; i++)
+    {
+        const word_count_entry_t *e = &a->slots[i];
+        if (e->count && word_count_lookup(b, e->text) != e->count)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void test_folding(void)
+{
+    word_counter_t counter;
+    word_count_word_t word = {"LARGE", 0};
+    int total;
+
+    count_chunks(&counter, sample, strlen(sample));
+    assert(counter.total == 12 && counter.unique == 10);
+    assert(word_count_lookup(&counter, "joe") == 1);
+    assert(word_count_lookup(&counter, "Joe's") == 1);
+    assert(word_count_lookup(&counter, "can't") == 2);
+    assert(word_count_lookup(&counter, "large") == 2);
+    assert(word_count_lookup(&counter, "'large'") == 0);
+    assert(word_count_lookup(&counter, "42") == 1);
+    assert(word_count_lookup(&counter, "rock'n'roll") == 1);
+    assert(word_count_lookup(&counter, "\xc3\xa9t\xc3\xa9") == 1);
+    assert(word_count_lookup(&counter, "") == 0);
+    word_count_free(&counter);
+
+    total = word_count(sample, &word);
+    assert(total == 12 && word.count == 2);
+    (void)total;
+}
+
+static void test_chunks(void)
+{
+    word_counter_t whole, parts;
+    char *longest = malloc(1001);
+    size_t chunk;
+
+    /* every chunk size cuts the words and apostrophes somewhere else */
+    count_chunks(&whole, sample, strlen(sample));
+    for (chunk = 1; chunk < strlen(sample); chunk++)
+    {
+        count_chunks(&parts, sample, chunk);
+        assert(same_counts(&whole, &parts));
+        word_count_free(&parts);
+    }
+    word_count_free(&whole);
+
+    /* a word longer than MAX_WORD_LENGTH, over many chunks */
+    assert(longest != NULL);
+    memset(longest, 'x', 1000);
+    longest[1000] = '\0';
+    count_chunks(&parts, longest, 7);
+    assert(parts.total == 1 && word_count_lookup(&parts, longest) == 1);
+    word_count_free(&parts);
+    free(longest);
+}
+
+static void test_merge(void)
+{
+    word_counter_t a, b;
+    int error;
+
+    count_chunks(&a, "the cat, the", 64);
+    count_chunks(&b, "The dog", 64);
+    error = word_count_merge(&a, &b);
+    assert(error == 0);
+    assert(a.total == 5 && a.unique == 3);
+    assert(word_count_lookup(&a, "the") == 3);
+    assert(word_count_lookup(&a, "cat") == 1);
+    assert(word_count_lookup(&a, "dog") == 1);
+    assert(b.total == 2 && word_count_lookup(&b, "the") == 1);
+    word_count_free(&a);
+    word_count_free(&b);
+    (void)error;
+}
+
+static void test_top(void)
+{
+    word_counter_t counter;
+    word_count_entry_t top[10];
+    size_t n;
+
+    count_chunks(&counter, "b b a a c c e e e d", 64);
+    n = word_count_top(&counter, 3, top);
+    assert(n == 3);
+    assert(strcmp(top[0].text, "e") == 0 && top[0].count == 3);
+    assert(strcmp(top[1].text, "a") == 0 && top[1].count == 2);
+    assert(strcmp(top[2].text, "b") == 0 && top[2].count == 2);
+    n = word_count_top(&counter, 10, top);
+    assert(n == 5);
+    assert(strcmp(top[3].text, "c") == 0 && strcmp(top[4].text, "d") == 0);
+    n = word_count_top(&counter, 0, top);
+    assert(n == 0);
+    word_count_free(&counter);
+    (void)n;
+}
+
+/* writes text to TEST_FILE */
+static void write_file(const char *text)
+{
+    FILE *file = fopen(TEST_FILE, "wb");
+    size_t written;
+    assert(file != NULL);
+    written = fwrite(text, 1, strlen(text), file);
+    assert(written == strlen(text));
+    fclose(file);
+    (void)written;
+}
+
+/* the file counted by 1 to 8 and 64 threads, and in memory */
+static void check_file(const char *text)
+{
+    static const int threads[] = {1, 2, 3, 4, 5, 8, 64};
+    word_counter_t expected, counter;
+    size_t t;
+    int error;
+
+    write_file(text);
+    count_chunks(&expected, text, 4096);
+    for (t = 0; t < sizeof(threads) / sizeof(threads[0]); t++)
+    {
+        error = word_count_init(&counter);
+        assert(error == 0);
+        error = word_count_file(TEST_FILE, threads[t], &counter);
+        assert(error == 0);
+        assert(same_counts(&expected, &counter));
+        word_count_free(&counter);
+    }
+    word_count_free(&expected);
+    (void)error;
+}
+
+static void test_file(void)
+{
+    static const char *const words[] = {"the", "Word", "count's", "'quoted'",
+                                        "A",   "b",    "\xc3\xa9t\xc3\xa9"};
+    static const char separators[] = " \n\t.,;!?-\"";
+    size_t size = 200000, length = 0, i;
+    char *text = malloc(size + 64);
+    word_counter_t counter;
+    int error;
+
+    assert(text != NULL);
+    srand(1);
+    while (length < size)
+    {
+        const char *w = words[rand() % 7];
+        memcpy(text + length, w, strlen(w));
+        length += strlen(w);
+        for (i = rand() % 3 + 1; i > 0; i--)
+        {
+            text[length++] = separators[rand() % (sizeof(separators) - 1)];
+        }
+    }
+    text[length] = '\0';
+    check_file(text);
+
+    /* more threads than bytes, and a word at the very end */
+    check_file("a b");
+    check_file("");
+
+    error = word_count_init(&counter);
+    assert(error == 0);
+    remove(TEST_FILE);
+    error = word_count_file(TEST_FILE, 2, &counter);
+    assert(error == WORD_COUNT_FILE_ERROR && counter.total == 0);
+    word_count_free(&counter);
+    free(text);
+    (void)error;
+}
+
+int main(void)
+{
+    test_folding();
+    test_chunks();
+    test_merge();
+    test_top();
+    test_file();
+    printf("All tests have successfully passed!\n");
+    return 0;
+}
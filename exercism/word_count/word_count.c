@@ -1,91 +1,520 @@
 #include "word_count.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-/*
-    word_count: returns the full number of words in the input_text,
-                otherwise an error code: (see below)
+#define WORD_COUNT_ARENA 65536    // bytes of keys per block
+#define WORD_COUNT_READ 65536     // bytes read at once from a file
+#define WORD_COUNT_APOSTROPHE 1  // in fold[], besides letters and digits
 
-    error codes: EXCESSIVE_LENGTH_WORD     -1
-                 EXCESSIVE_NUMBER_OF_WORDS -2
-
-    The function manipulates the given structure of type word_count_word_t
-    After that process the member count contains the number of occures.
+/*
+    fold: the lower case of letters, digits and bytes of UTF-8 sequences,
+          WORD_COUNT_APOSTROPHE for '\'' and 0 for the separators. It is
+          constant, so the threads of word_count_file() can share it.
 */
-int word_count(const char *input_text, word_count_word_t *words)
+static const unsigned char fold[256] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+    0x38, 0x39, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+    0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f,
+    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77,
+    0x78, 0x79, 0x7a, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+    0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f,
+    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77,
+    0x78, 0x79, 0x7a, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f,
+    0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+    0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f,
+    0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf,
+    0xb0, 0xb1, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7,
+    0xb8, 0xb9, 0xba, 0xbb, 0xbc, 0xbd, 0xbe, 0xbf,
+    0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+    0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf,
+    0xd0, 0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7,
+    0xd8, 0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde, 0xdf,
+    0xe0, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7,
+    0xe8, 0xe9, 0xea, 0xeb, 0xec, 0xed, 0xee, 0xef,
+    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+    0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
+
+/* FNV-1a */
+static uint64_t hash_word(const char *text, size_t length)
 {
-    char word_list[MAX_WORDS][MAX_WORD_LENGTH];
-    char input[1000];
-    strcpy(input, input_text);
-    char *p_str = input;
+    uint64_t h = 14695981039346656037ULL;
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        h = (h ^ (unsigned char)text[i]) * 1099511628211ULL;
+    }
+    return h;
+}
 
-    /* index for iteration over input string */
-    int index = 0;
+int word_count_init(word_counter_t *counter)
+{
+    memset(counter, 0, sizeof(*counter));
+    counter->capacity = 1024;
+    counter->slots = calloc(counter->capacity, sizeof(word_count_entry_t));
+    return counter->slots ? 0 : WORD_COUNT_NO_MEMORY;
+}
 
-    /* index for word_list */
-    int index_list = 0;
+void word_count_free(word_counter_t *counter)
+{
+    while (counter->arena)
+    {
+        word_count_block_t *next = counter->arena->next;
+        free(counter->arena);
+        counter->arena = next;
+    }
+    free(counter->slots);
+    free(counter->word);
+    memset(counter, 0, sizeof(*counter));
+}
 
-    /* counts all words */
-    int count_all = 0;
+/* copies a key into the arena, null-terminated */
+static const char *store(word_counter_t *counter, const char *text,
+                         size_t length)
+{
+    word_count_block_t *block = counter->arena;
+    char *key;
+    if (block == NULL || block->size - block->used < length + 1)
+    {
+        size_t size = length + 1 > WORD_COUNT_ARENA ? length + 1
+                                                    : WORD_COUNT_ARENA;
+        block = malloc(sizeof(word_count_block_t) + size);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+        block->next = counter->arena;
+        block->used = 0;
+        block->size = size;
+        counter->arena = block;
+    }
+    key = block->data + block->used;
+    memcpy(key, text, length);
+    key[length] = '\0';
+    block->used += length + 1;
+    return key;
+}
 
-    /* for controlling the while loop */
-    int loop = 1;
+/* doubles the table, moving the entries but not their keys */
+static int grow(word_counter_t *counter)
+{
+    size_t capacity = 2 * counter->capacity, i, j;
+    word_count_entry_t *slots = calloc(capacity, sizeof(word_count_entry_t));
+    if (slots == NULL)
+    {
+        return WORD_COUNT_NO_MEMORY;
+    }
+    for (i = 0; i < counter->capacity; i++)
+    {
+        if (counter->slots[i].count)
+        {
+            j = counter->slots[i].hash & (capacity - 1);
+            while (slots[j].count)
+            {
+                j = (j + 1) & (capacity - 1);
+            }
+            slots[j] = counter->slots[i];
+        }
+    }
+    free(counter->slots);
+    counter->slots = slots;
+    counter->capacity = capacity;
+    return 0;
+}
 
-    /* for the for-loop */
-    int i = 0;
+/* the slot of a word, or the empty slot where it belongs */
+static word_count_entry_t *find(const word_counter_t *counter,
+                                const char *text, size_t length,
+                                uint64_t hash)
+{
+    size_t mask = counter->capacity - 1, i = hash & mask;
+    word_count_entry_t *slot = &counter->slots[i];
+    while (slot->count &&
+           (slot->hash != hash || slot->length != length ||
+            memcmp(slot->text, text, length) != 0))
+    {
+        i = (i + 1) & mask;
+        slot = &counter->slots[i];
+    }
+    return slot;
+}
 
-    /* collects all words in the word_list */
-    while (input[index] && loop)
+int word_count_add(word_counter_t *counter, const char *text, size_t length,
+                   uint64_t count)
+{
+    uint64_t hash = hash_word(text, length);
+    word_count_entry_t *slot = find(counter, text, length, hash);
+    if (slot->count == 0)
     {
-        if (input[index] == ' ')
+        if (2 * (counter->unique + 1) > counter->capacity)
         {
-            input[index] = '\0';
-            if (strlen(p_str) <= MAX_WORD_LENGTH)
+            if (grow(counter))
             {
-                if (index_list <= MAX_WORDS)
-                {
-                    strcpy(word_list[index_list], p_str);
+                return WORD_COUNT_NO_MEMORY;
+            }
+            slot = find(counter, text, length, hash);
+        }
+        slot->text = store(counter, text, length);
+        if (slot->text == NULL)
+        {
+            return WORD_COUNT_NO_MEMORY;
+        }
+        slot->length = (uint32_t)length;
+        slot->hash = hash;
+        counter->unique++;
+    }
+    slot->count += count;
+    counter->total += count;
+    return 0;
+}
 
-                    /* sets pointer to the next position */
-                    p_str = input + index + 1;
-                    index_list++;
+/* counts the word read so far, without its trailing apostrophes */
+static int end_word(word_counter_t *counter)
+{
+    size_t length = counter->length;
+    counter->length = 0;
+    while (length && counter->word[length - 1] == '\'')
+    {
+        length--;
+    }
+    return length ? word_count_add(counter, counter->word, length, 1) : 0;
+}
 
-                    /* counts the word */
-                    count_all++;
-                }
-                else /* error case too many words */
+int word_count_feed(word_counter_t *counter, const char *text, size_t length)
+{
+    const unsigned char *p = (const unsigned char *)text;
+    const unsigned char *end = p + length;
+
+    while (p < end)
+    {
+        /* the next run of word bytes; an apostrophe cannot start a word */
+        const unsigned char *start = p;
+        while (p < end && (fold[*p] > WORD_COUNT_APOSTROPHE ||
+                           (fold[*p] && (p > start || counter->length))))
+        {
+            p++;
+        }
+        if (p > start)
+        {
+            size_t n = p - start, i;
+            if (counter->length + n > counter->room)
+            {
+                size_t room = 2 * (counter->length + n);
+                char *word = realloc(counter->word, room);
+                if (word == NULL)
                 {
-                    count_all = EXCESSIVE_NUMBER_OF_WORDS;
-                    loop = 0;
+                    return WORD_COUNT_NO_MEMORY;
                 }
+                counter->word = word;
+                counter->room = room;
             }
-            else /* error case: word is too long */
+            for (i = 0; i < n; i++)
             {
-                count_all = EXCESSIVE_LENGTH_WORD;
-                loop = 0;
+                counter->word[counter->length + i] =
+                    start[i] == '\'' ? '\'' : (char)fold[start[i]];
             }
+            counter->length += n;
         }
+        if (p < end)
+        {
+            if (counter->length && end_word(counter))
+            {
+                return WORD_COUNT_NO_MEMORY;
+            }
+            p++;  // the separator
+        }
+    }
+    return 0;
+}
 
-        index++;
+int word_count_finish(word_counter_t *counter)
+{
+    return end_word(counter);
+}
+
+uint64_t word_count_lookup(const word_counter_t *counter, const char *text)
+{
+    size_t length = strlen(text), i;
+    char small[MAX_WORD_LENGTH], *folded = small;
+    uint64_t count;
+    if (length == 0)
+    {
+        return 0;
     }
+    if (length > sizeof(small))
+    {
+        folded = malloc(length);
+        if (folded == NULL)
+        {
+            return 0;
+        }
+    }
+    for (i = 0; i < length; i++)
+    {
+        unsigned char c = text[i];
+        folded[i] = fold[c] > WORD_COUNT_APOSTROPHE ? (char)fold[c] : c;
+    }
+    count = find(counter, folded, length, hash_word(folded, length))->count;
+    if (folded != small)
+    {
+        free(folded);
+    }
+    return count;
+}
 
-    words->count = 0;
+int word_count_merge(word_counter_t *into, const word_counter_t *from)
+{
+    size_t i;
+    for (i = 0; i < from->capacity; i++)
+    {
+        const word_count_entry_t *e = &from->slots[i];
+        if (e->count && word_count_add(into, e->text, e->length, e->count))
+        {
+            return WORD_COUNT_NO_MEMORY;
+        }
+    }
+    return 0;
+}
 
-    /* make sure none error is occurred */
-    if (loop)
+/* whether a comes before b in word_count_top() */
+static int before(const word_count_entry_t *a, const word_count_entry_t *b)
+{
+    return a->count != b->count ? a->count > b->count
+                                : strcmp(a->text, b->text) < 0;
+}
+
+/* restores the heap below i, whose root is the entry coming last */
+static void sift_down(word_count_entry_t *heap, size_t size, size_t i)
+{
+    for (;;)
     {
-        /* collects the last word up to the \0-character. and counts it.*/
-        strcpy(word_list[index_list], p_str);
-        count_all++;
+        size_t last = i, l = 2 * i + 1, r = l + 1;
+        word_count_entry_t t;
+        if (l < size && before(&heap[last], &heap[l]))
+        {
+            last = l;
+        }
+        if (r < size && before(&heap[last], &heap[r]))
+        {
+            last = r;
+        }
+        if (last == i)
+        {
+            return;
+        }
+        t = heap[i];
+        heap[i] = heap[last];
+        heap[last] = t;
+        i = last;
+    }
+}
 
-        for (i = 0; i <= index_list; i++)
+size_t word_count_top(const word_counter_t *counter, size_t k,
+                      word_count_entry_t *top)
+{
+    size_t size = 0, i;
+    for (i = 0; i < counter->capacity && k; i++)
+    {
+        const word_count_entry_t *e = &counter->slots[i];
+        if (e->count == 0)
+        {
+            continue;
+        }
+        if (size < k)
         {
-            if (strcmp(word_list[i], words->text) == 0)
+            /* sift up */
+            size_t j = size++;
+            while (j && before(&top[(j - 1) / 2], e))
             {
-                words->count++;
+                top[j] = top[(j - 1) / 2];
+                j = (j - 1) / 2;
             }
+            top[j] = *e;
         }
+        else if (before(e, &top[0]))
+        {
+            top[0] = *e;
+            sift_down(top, size, 0);
+        }
+    }
+    /* pop the last ones to the end: the array ends up in order */
+    for (i = size; i > 1; i--)
+    {
+        word_count_entry_t t = top[0];
+        top[0] = top[i - 1];
+        top[i - 1] = t;
+        sift_down(top, i - 1, 0);
+    }
+    return size;
+}
+
+/* counts the bytes [start, end) of a file */
+static int count_range(const char *path, long start, long end,
+                       word_counter_t *counter)
+{
+    FILE *file = fopen(path, "rb");
+    char *buffer = malloc(WORD_COUNT_READ);
+    int error = file == NULL     ? WORD_COUNT_FILE_ERROR
+                : buffer == NULL ? WORD_COUNT_NO_MEMORY
+                                 : 0;
+
+    if (!error && fseek(file, start, SEEK_SET) != 0)
+    {
+        error = WORD_COUNT_FILE_ERROR;
+    }
+    while (!error && start < end)
+    {
+        size_t want = end - start < WORD_COUNT_READ ? (size_t)(end - start)
+                                                    : WORD_COUNT_READ;
+        size_t got = fread(buffer, 1, want, file);
+        if (got == 0)
+        {
+            error = WORD_COUNT_FILE_ERROR;
+            break;
+        }
+        error = word_count_feed(counter, buffer, got);
+        start += (long)got;
+    }
+    if (!error)
+    {
+        error = word_count_finish(counter);
+    }
+    if (file)
+    {
+        fclose(file);
+    }
+    free(buffer);
+    return error;
+}
+
+int word_count_file(const char *path, int threads, word_counter_t *counter)
+{
+    FILE *file = fopen(path, "rb");
+    long size, *bounds;
+    word_counter_t *parts;
+    int t, c, error = 0;
+
+    if (file == NULL || fseek(file, 0, SEEK_END) != 0 ||
+        (size = ftell(file)) < 0)
+    {
+        if (file)
+        {
+            fclose(file);
+        }
+        return WORD_COUNT_FILE_ERROR;
+    }
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+    bounds = malloc((threads + 1) * sizeof(long));
+    parts = calloc(threads, sizeof(word_counter_t));
+    if (bounds == NULL || parts == NULL)
+    {
+        fclose(file);
+        free(bounds);
+        free(parts);
+        return WORD_COUNT_NO_MEMORY;
+    }
+
+    /* each chunk starts after a separator, so that no word is cut */
+    bounds[0] = 0;
+    bounds[threads] = size;
+    for (t = 1; t < threads; t++)
+    {
+        long b = size / threads * t;
+        if (b <= bounds[t - 1])
+        {
+            b = bounds[t - 1];
+        }
+        else if (fseek(file, b - 1, SEEK_SET) == 0)
+        {
+            while ((c = fgetc(file)) != EOF && fold[c])
+            {
+                b++;
+            }
+        }
+        bounds[t] = b < size ? b : size;
+    }
+    fclose(file);
+
+    /* the error codes are negative: min keeps the file errors over the
+       memory ones, so that both are told apart from success */
+    for (t = 0; t < threads; t++)
+    {
+        c = word_count_init(&parts[t]);
+        error = c < error ? c : error;
+    }
+    if (!error)
+    {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static, 1) \
+    reduction(min : error)
+#endif
+        for (t = 0; t < threads; t++)
+        {
+            if (bounds[t] < bounds[t + 1])
+            {
+                int e = count_range(path, bounds[t], bounds[t + 1], &parts[t]);
+                error = e < error ? e : error;
+            }
+        }
+    }
+    for (t = 0; t < threads; t++)
+    {
+        if (!error)
+        {
+            error = word_count_merge(counter, &parts[t]);
+        }
+        word_count_free(&parts[t]);
+    }
+    free(bounds);
+    free(parts);
+    return error;
+}
+
+/*
+    word_count: returns the full number of words in the input_text,
+                otherwise an error code: (see below)
+
+    error codes: WORD_COUNT_NO_MEMORY      -3
+
+    The function manipulates the given structure of type word_count_word_t
+    After that process the member count contains the number of occures.
+*/
+int word_count(const char *input_text, word_count_word_t *words)
+{
+    word_counter_t counter;
+    int result = word_count_init(&counter);
+
+    if (result == 0)
+    {
+        result = word_count_feed(&counter, input_text, strlen(input_text));
+    }
+    if (result == 0)
+    {
+        result = word_count_finish(&counter);
+    }
+    if (result == 0)
+    {
+        words->count = (int)word_count_lookup(&counter, words->text);
+        result = (int)counter.total;
     }
 
-    /* returns the number of words or an error code */
-    return count_all;
+    word_count_free(&counter);
+    return result;
 }
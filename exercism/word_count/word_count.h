@@ -1,8 +1,11 @@
 #ifndef WORD_COUNT_H
 #define WORD_COUNT_H
 
-#define MAX_WORDS 20  // at most MAX_WORDS can be found in the test input string
-#define MAX_WORD_LENGTH 50  // no individual word can exceed this length
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_WORDS 20  // kept for compatibility, word_count() has no limit
+#define MAX_WORD_LENGTH 50  // longest word that word_count_word_t can hold
 
 // results structure
 typedef struct word_count_word
@@ -13,16 +16,86 @@ typedef struct word_count_word
 
 #define EXCESSIVE_LENGTH_WORD -1
 #define EXCESSIVE_NUMBER_OF_WORDS -2
+#define WORD_COUNT_NO_MEMORY -3
+#define WORD_COUNT_FILE_ERROR -4
 
-// word_count - routine to classify the unique words and their frequency in a
-// test input string inputs:
+// word_count - counts the words of a test input string, and how often the
+// word given in words->text occurs. Words are letters, digits and inner
+// apostrophes, compared without case.
+// inputs:
 //    input_text =  a null-terminated string containing that is analyzed
 //
 // outputs:
-//    words = allocated structure to record the words found and their frequency
-//    uniqueWords - number of words in the words structure
-//           returns a negative number if an error.
-//           words will contain the results up to that point.
+//    words = structure whose text is the word to look for, and whose count
+//            receives its number of occurrences
+//    returns the number of words, or a negative number if an error.
 int word_count(const char *input_text, word_count_word_t *words);
 
+// one distinct word of a word_counter_t
+typedef struct word_count_entry
+{
+    const char *text;  // lower case and null-terminated, in the arena
+    uint32_t length;
+    uint64_t hash;
+    uint64_t count;  // 0 for an empty slot
+} word_count_entry_t;
+
+// keys are copied into blocks that never move
+typedef struct word_count_block
+{
+    struct word_count_block *next;
+    size_t used, size;
+    char data[];
+} word_count_block_t;
+
+// streaming word-frequency counter: an open-addressing hash table, linear
+// probing, at most half full
+typedef struct word_counter
+{
+    word_count_entry_t *slots;
+    size_t capacity;  // power of two
+    size_t unique;    // distinct words
+    uint64_t total;   // words
+    word_count_block_t *arena;
+    char *word;  // the word being read, which may continue in the next chunk
+    size_t length, room;
+} word_counter_t;
+
+// word_count_init - prepares an empty counter, returns 0 or an error code
+int word_count_init(word_counter_t *counter);
+
+// word_count_free - releases the table, the keys and the partial word
+void word_count_free(word_counter_t *counter);
+
+// word_count_feed - counts the words of the next `length` bytes of a text
+// given in chunks of any size. A word cut at the end of a chunk carries over
+// to the next one. Returns 0 or an error code.
+int word_count_feed(word_counter_t *counter, const char *text, size_t length);
+
+// word_count_finish - counts the word at the end of the text, if any
+int word_count_finish(word_counter_t *counter);
+
+// word_count_add - adds `count` occurrences of a word already lower case
+int word_count_add(word_counter_t *counter, const char *text, size_t length,
+                   uint64_t count);
+
+// word_count_lookup - number of occurrences of a word, in any case
+uint64_t word_count_lookup(const word_counter_t *counter, const char *text);
+
+// word_count_merge - adds the counts of `from` to `into`
+int word_count_merge(word_counter_t *into, const word_counter_t *from);
+
+// word_count_top - writes the `k` most frequent words into `top`, most
+// frequent first and ties in alphabetical order. Returns how many were
+// written, at most `unique`. The texts belong to the counter.
+size_t word_count_top(const word_counter_t *counter, size_t k,
+                      word_count_entry_t *top);
+
+// word_count_file - counts the words of a file into `counter` (map-reduce):
+// the file is cut into `threads` chunks between words, each counted by its
+// own thread into its own table, and the tables are merged. Without OpenMP
+// the chunks are counted one after the other. Returns 0,
+// WORD_COUNT_FILE_ERROR if the file cannot be read or WORD_COUNT_NO_MEMORY.
+int word_count_file(const char *path, int threads, word_counter_t *counter);
+
 #endif
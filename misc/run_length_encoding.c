@@ -8,62 +8,396 @@
  * and encodes that series of consecutive symbols into the
  * counted symbol and a number denoting the number of
  * consecutive occorences.
- * 
+ *
  * For example the string "AAAABBCCD" gets encoded into "4A2B2C1D"
- * 
+ *
+ * run_length_encode() produces that text form. For binary data, such as
+ * telemetry with long runs, rle_encode() and rle_decode() stream bytes
+ * through buffers of the caller without allocating. The encoded stream
+ * is a sequence of tokens, each starting with a varint header h:
+ *
+ * - h = 2 * n + 1, then one byte: a run of n copies of that byte, n >= 3;
+ * - h = 2 * n, then n bytes, n <= #RLE_MAX_LITERAL: literal bytes.
+ *
+ * Short literal tokens keep random data within 1/63 of its size, like
+ * PackBits, while the varint lets a run of any length take a few bytes.
+ * The end of a run is found 16 bytes at a time with SSE2, or 8 at a time
+ * with a 64-bit compare otherwise (memchr() finds a byte, not the first
+ * byte that differs, so it does not help here).
+ *
+ * Run `./run_length_encoding [MiB]` for the self-test and a round-trip
+ * benchmark on MiB of data (default 64), or `./run_length_encoding -c` /
+ * `-d` to encode / decode standard input to standard output.
  */
 
+#include <stdint.h> /// for uint8_t, uint64_t
 #include <stdio.h>  /// for IO operations
 #include <string.h> /// for string functions
 #include <stdlib.h> /// for malloc/free
 #include <assert.h> /// for assert
+#include <time.h>   /// for clock
+#ifdef __SSE2__
+#include <emmintrin.h> /// for _mm_cmpeq_epi8, _mm_movemask_epi8
+#endif
+
+/** longest literal token; its header 2 * 63 still fits in one byte */
+#define RLE_MAX_LITERAL 63
+
+/** shortest run worth a run token; shorter ones go into literals */
+#define RLE_MIN_RUN 3
+
+/** longest varint, for 64-bit headers */
+#define RLE_VARINT_MAX 10
+
+/** state of a streaming encoder, zero initialised */
+typedef struct {
+    uint8_t literal[RLE_MAX_LITERAL]; ///< literal bytes not yet written
+    size_t literal_len;
+    uint64_t run_len; ///< length of the run in progress, 0 for none
+    uint8_t run_byte;
+} rle_encoder;
+
+/** state of a streaming decoder, zero initialised */
+typedef struct {
+    uint64_t header; ///< header being read, or of the current token
+    int shift;       ///< bits of the header read so far
+    int stage;       ///< 0 header, 1 run byte, 2 run, 3 literal
+    uint64_t left;   ///< bytes of the current token still to output
+    uint8_t run_byte;
+} rle_decoder;
 
 /**
  * @brief Encodes a null-terminated string using run-length encoding
  * @param str String to encode
- * @return char* Encoded string
+ * @return char* Encoded string, NULL if it cannot be allocated
+ */
+char* run_length_encode(const char* str) {
+    size_t size = 1;
+
+    // one pass to size the output, a second one to write it
+    for (int pass = 0; pass < 2; ++pass) {
+        char* encoded = pass ? malloc(size) : NULL;
+        char* o = encoded;
+        if (pass && encoded == NULL) {
+            return NULL;
+        }
+
+        for (const char* p = str; *p != '\0';) {
+            const char* q = p;
+            while (*q == *p) q++;
+
+            //convert occurrence amount to string, digits in reverse
+            char digits[20];
+            int d = 0;
+            for (size_t count = q - p; count > 0; count /= 10) {
+                digits[d++] = (char)('0' + count % 10);
+            }
+            if (pass) {
+                while (d > 0) *o++ = digits[--d];
+                *o++ = *p;
+            } else {
+                size += d + 1;
+            }
+            p = q;
+        }
+
+        if (pass) {
+            *o = '\0';
+            return encoded;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Output size enough for any call to rle_encode() on n bytes, or
+ * to rle_encode_finish() with n = 0
+ * @param n input size
+ * @returns bound in bytes
+ */
+size_t rle_encode_bound(size_t n) {
+    // each literal token adds one byte per 63; the slack covers the bytes
+    // held back by an earlier call
+    return n + n / RLE_MAX_LITERAL + RLE_MAX_LITERAL + 3 * RLE_VARINT_MAX;
+}
+
+/** writes x as a varint, 7 bits per byte, low bits first */
+static uint8_t* rle_put_varint(uint8_t* out, uint64_t x) {
+    while (x >= 0x80) {
+        *out++ = (uint8_t)(x | 0x80);
+        x >>= 7;
+    }
+    *out++ = (uint8_t)x;
+    return out;
+}
+
+/** writes the pending literal bytes as one token */
+static uint8_t* rle_flush_literal(rle_encoder* e, uint8_t* out) {
+    if (e->literal_len > 0) {
+        out = rle_put_varint(out, 2 * (uint64_t)e->literal_len);
+        memcpy(out, e->literal, e->literal_len);
+        out += e->literal_len;
+        e->literal_len = 0;
+    }
+    return out;
+}
+
+/** writes the finished run, or adds it to the literal if too short */
+static uint8_t* rle_flush_run(rle_encoder* e, uint8_t* out) {
+    if (e->run_len >= RLE_MIN_RUN) {
+        out = rle_flush_literal(e, out);
+        out = rle_put_varint(out, 2 * e->run_len + 1);
+        *out++ = e->run_byte;
+    } else {
+        for (uint64_t i = 0; i < e->run_len; ++i) {
+            if (e->literal_len == RLE_MAX_LITERAL) {
+                out = rle_flush_literal(e, out);
+            }
+            e->literal[e->literal_len++] = e->run_byte;
+        }
+    }
+    e->run_len = 0;
+    return out;
+}
+
+/** first byte from p that is not b, or end */
+static const uint8_t* rle_scan_run(const uint8_t* p, const uint8_t* end,
+                                   uint8_t b) {
+    // in literal data most runs stop at once
+    if (p == end || *p != b) {
+        return p;
+    }
+#ifdef __SSE2__
+    const __m128i pattern = _mm_set1_epi8((char)b);
+    for (; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)p);
+        unsigned same = _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+        unsigned differ = same ^ 0xffff;
+        if (differ) {
+            return p + __builtin_ctz(differ);
+        }
+    }
+#else
+    const uint64_t pattern = UINT64_C(0x0101010101010101) * b;
+    for (; end - p >= 8; p += 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        if (word != pattern) {
+            break;
+        }
+    }
+#endif
+    while (p < end && *p == b) p++;
+    return p;
+}
+
+/**
+ * @brief Encodes the next n bytes of a stream
+ * @param e encoder state; a run or a few literal bytes at the end of the
+ * input are held back until the next call
+ * @param in input bytes
+ * @param n number of input bytes
+ * @param out output of at least rle_encode_bound(n) bytes
+ * @returns number of bytes written to out
+ */
+size_t rle_encode(rle_encoder* e, const uint8_t* in, size_t n, uint8_t* out) {
+    const uint8_t* p = in;
+    const uint8_t* end = in + n;
+    uint8_t* o = out;
+
+    while (p < end) {
+        if (e->run_len > 0) {
+            const uint8_t* q = rle_scan_run(p, end, e->run_byte);
+            e->run_len += q - p;
+            p = q;
+            if (p == end) {
+                break; // the run may go on in the next call
+            }
+            o = rle_flush_run(e, o);
+        }
+
+        // bytes that start no run long enough go straight to the literal
+        while (end - p >= RLE_MIN_RUN && (p[0] != p[1] || p[1] != p[2])) {
+            if (e->literal_len == RLE_MAX_LITERAL) {
+                o = rle_flush_literal(e, o);
+            }
+            e->literal[e->literal_len++] = *p++;
+        }
+        if (p == end) {
+            break;
+        }
+        e->run_byte = *p++;
+        e->run_len = 1;
+    }
+    return o - out;
+}
+
+/**
+ * @brief Writes what the encoder holds back, ending the stream
+ * @param e encoder state, ready for a new stream afterwards
+ * @param out output of at least rle_encode_bound(0) bytes
+ * @returns number of bytes written to out
+ */
+size_t rle_encode_finish(rle_encoder* e, uint8_t* out) {
+    uint8_t* o = rle_flush_run(e, out);
+    o = rle_flush_literal(e, o);
+    return o - out;
+}
+
+/**
+ * @brief Decodes the next bytes of a stream
+ * @param d decoder state; a token may span several calls
+ * @param in encoded bytes
+ * @param n number of encoded bytes
+ * @param consumed set to the number of encoded bytes used, which is less
+ * than n only when out is full
+ * @param out output buffer
+ * @param cap size of out
+ * @returns number of bytes written to out, or -1 on a malformed header
  */
+long rle_decode(rle_decoder* d, const uint8_t* in, size_t n, size_t* consumed,
+                uint8_t* out, size_t cap) {
+    const uint8_t* p = in;
+    const uint8_t* end = in + n;
+    uint8_t* o = out;
+    uint8_t* o_end = out + cap;
+
+    for (;;) {
+        if (d->stage == 0) { // header
+            if (p == end) {
+                break;
+            }
+            if (d->shift >= 64) {
+                return -1;
+            }
+            d->header |= (uint64_t)(*p & 0x7f) << d->shift;
+            d->shift += 7;
+            if (*p++ & 0x80) {
+                continue;
+            }
+            d->left = d->header >> 1;
+            d->stage = d->header & 1 ? 1 : 3;
+            if ((d->stage == 1 && d->left < RLE_MIN_RUN) ||
+                (d->stage == 3 && d->left > RLE_MAX_LITERAL)) {
+                return -1;
+            }
+            d->header = 0;
+            d->shift = 0;
+        } else if (d->stage == 1) { // byte of a run
+            if (p == end) {
+                break;
+            }
+            d->run_byte = *p++;
+            d->stage = 2;
+        } else { // body of a run or literal
+            size_t room = o_end - o;
+            size_t avail = d->stage == 2 ? room : (size_t)(end - p);
+            size_t k = d->left < avail ? (size_t)d->left : avail;
+            if (k > room) {
+                k = room;
+            }
+            if (d->stage == 2) {
+                memset(o, d->run_byte, k);
+            } else {
+                memcpy(o, p, k);
+                p += k;
+            }
+            o += k;
+            d->left -= k;
+            if (d->left > 0) {
+                break; // out of room or of input
+            }
+            d->stage = 0;
+        }
+    }
 
-char* run_length_encode(char* str) {
+    *consumed = p - in;
+    return o - out;
+}
+
+/**
+ * @brief Whether the decoder stopped between two tokens, as it should at
+ * the end of a stream
+ * @param d decoder state
+ * @returns 1 if so, 0 otherwise
+ */
+int rle_decode_done(const rle_decoder* d) {
+    return d->stage == 0 && d->shift == 0;
+}
+
+/** previous version of run_length_encode(), for the benchmark */
+static char* run_length_encode_previous(char* str) {
     int str_length = strlen(str);
     int encoded_index = 0;
-
-    //allocate space for worst-case scenario
-    char* encoded = malloc(2 * strlen(str));
-    
-    //temp space for int to str conversion
+    char* encoded = malloc(2 * strlen(str) + 1);
     char int_str[20];
 
-    for(int i = 0; i < str_length; ++i) {
+    for (int i = 0; i < str_length; ++i) {
         int count = 0;
         char current = str[i];
-
-        //count occurences
-        while(current == str[i + count]) count++;
-
+        while (current == str[i + count]) count++;
         i += count - 1;
-
-        //convert occurrence amount to string and write to encoded string
         sprintf(int_str, "%d", count);
-        int int_str_length = strlen(int_str);
-        strncpy(&encoded[encoded_index], int_str, strlen(int_str));
-
-        //write current char to encoded string
+        memcpy(&encoded[encoded_index], int_str, strlen(int_str));
         encoded_index += strlen(int_str);
         encoded[encoded_index] = current;
         ++encoded_index;
     }
 
-    //null terminate string and move encoded string to compacted memory space 
     encoded[encoded_index] = '\0';
     char* compacted_string = malloc(strlen(encoded) + 1);
     strcpy(compacted_string, encoded);
-    
     free(encoded);
-
     return compacted_string;
 }
 
+/**
+ * @brief Encodes and decodes n bytes in chunks of the given size and
+ * checks the result
+ * @returns encoded size
+ */
+static size_t round_trip(const uint8_t* in, size_t n, size_t chunk,
+                         uint8_t* encoded, uint8_t* decoded) {
+    rle_encoder e = {0};
+    rle_decoder d = {0};
+    size_t size = 0, out = 0;
+
+    for (size_t i = 0; i < n; i += chunk) {
+        size_t k = n - i < chunk ? n - i : chunk;
+        size += rle_encode(&e, in + i, k, encoded + size);
+    }
+    size += rle_encode_finish(&e, encoded + size);
+
+    // decode with input and output cut at odd places
+    for (size_t i = 0; i < size || !rle_decode_done(&d);) {
+        size_t k = size - i < chunk ? size - i : chunk, used;
+        size_t cap = n - out < chunk / 2 + 1 ? n - out : chunk / 2 + 1;
+        long got = rle_decode(&d, encoded + i, k, &used, decoded + out, cap);
+        assert(got >= 0 && (got > 0 || used > 0));
+        out += got;
+        i += used;
+    }
+    assert(out == n && memcmp(in, decoded, n) == 0);
+    return size;
+}
+
+/** fills a with n bytes of telemetry-like data: long runs and noise */
+static void fill_telemetry(uint8_t* a, size_t n, unsigned seed) {
+    srand(seed);
+    for (size_t i = 0; i < n;) {
+        size_t len = 1 + rand() % (rand() % 4 ? 4096 : 64);
+        if (len > n - i) {
+            len = n - i;
+        }
+        if (rand() % 3) {
+            memset(a + i, rand() % 4, len); // an idle sensor
+        } else {
+            for (size_t j = 0; j < len; ++j) a[i + j] = (uint8_t)rand();
+        }
+        i += len;
+    }
+}
+
 /**
  * @brief Self-test implementations
  * @returns void
@@ -74,19 +408,174 @@ static void test() {
     assert(!strcmp(test, "7a3b2a4c1d1e1f2a1d1r"));
     free(test);
     test = run_length_encode("lidjhvipdurevbeirbgipeahapoeuhwaipefupwieofb");
-    assert(!strcmp(test, "1l1i1d1j1h1v1i1p1d1u1r1e1v1b1e1i1r1b1g1i1p1e1a1h1a1p1o1e1u1h1w1a1i1p1e1f1u1p1w1i1e1o1f1bq"));
+    assert(!strcmp(test, "1l1i1d1j1h1v1i1p1d1u1r1e1v1b1e1i1r1b1g1i1p1e1a1h1a1p1o1e1u1h1w1a1i1p1e1f1u1p1w1i1e1o1f1b"));
     free(test);
     test = run_length_encode("htuuuurwuquququuuaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaahghghrw");
     assert(!strcmp(test, "1h1t4u1r1w1u1q1u1q1u1q3u76a1h1g1h1g1h1r1w"));
     free(test);
+    test = run_length_encode("");
+    assert(!strcmp(test, ""));
+    free(test);
+
+    // tokens: a literal "ab", a run of 5 'c', a literal "dd"
+    rle_encoder e = {0};
+    uint8_t out[128];
+    size_t size = rle_encode(&e, (const uint8_t*)"abcccccdd", 9, out);
+    size += rle_encode_finish(&e, out + size);
+    assert(size == 8 && !memcmp(out, "\x04" "ab" "\x0b" "c" "\x04" "dd", 8));
+
+    // a run of 300 bytes spread over three calls takes a 2-byte header
+    uint8_t zeros[100] = {0};
+    size = 0;
+    for (int i = 0; i < 3; ++i) size += rle_encode(&e, zeros, 100, out);
+    size += rle_encode_finish(&e, out + size);
+    assert(size == 3 && out[0] == ((601 & 0x7f) | 0x80) && out[1] == 601 >> 7);
+
+    // malformed streams
+    rle_decoder d = {0};
+    size_t used;
+    assert(rle_decode(&d, (const uint8_t*)"\x03x", 2, &used, out, 128) < 0);
+    memset(&d, 0, sizeof(d));
+    assert(rle_decode(&d, (const uint8_t*)"\x80", 1, &used, out, 128) == 0);
+    assert(used == 1 && !rle_decode_done(&d));
+
+    // round trips in chunks of various sizes
+    size_t n = 1 << 18;
+    uint8_t* in = malloc(n);
+    uint8_t* encoded = malloc(rle_encode_bound(n) + n);
+    uint8_t* decoded = malloc(n);
+    assert(in && encoded && decoded);
+    fill_telemetry(in, n, 1);
+    for (size_t chunk = 1; chunk <= n; chunk *= 7) {
+        round_trip(in, n, chunk, encoded, decoded);
+    }
+    for (size_t i = 0; i < n; ++i) in[i] = (uint8_t)rand();
+    assert(round_trip(in, n, n, encoded, decoded) <= rle_encode_bound(n));
+    free(in);
+    free(encoded);
+    free(decoded);
+}
+
+/**
+ * @brief Round-trip throughput on mib MiB of telemetry-like, random and
+ * constant data
+ * @returns void
+ */
+static void benchmark(size_t mib) {
+    size_t n = mib << 20, chunk = 1 << 16;
+    uint8_t* in = malloc(n + 1);
+    uint8_t* encoded = malloc(rle_encode_bound(n));
+    uint8_t* decoded = malloc(n);
+    assert(in && encoded && decoded);
+
+    printf("\n%zu MiB in chunks of %zu KiB   ratio  encode MB/s  decode MB/s\n",
+           mib, chunk >> 10);
+    for (int kind = 0; kind < 3; ++kind) {
+        static const char* names[] = {"telemetry", "random", "constant"};
+        if (kind == 0) {
+            fill_telemetry(in, n, 2);
+        } else {
+            for (size_t i = 0; i < n; ++i) in[i] = kind == 1 ? (uint8_t)rand() : 7;
+        }
+
+        rle_encoder e = {0};
+        clock_t start = clock();
+        size_t size = 0;
+        for (size_t i = 0; i < n; i += chunk) {
+            size_t k = n - i < chunk ? n - i : chunk;
+            size += rle_encode(&e, in + i, k, encoded + size);
+        }
+        size += rle_encode_finish(&e, encoded + size);
+        double t_enc = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        rle_decoder d = {0};
+        start = clock();
+        size_t out = 0;
+        for (size_t i = 0; i < size || !rle_decode_done(&d);) {
+            size_t k = size - i < chunk ? size - i : chunk, used;
+            size_t cap = n - out < chunk ? n - out : chunk;
+            out += rle_decode(&d, encoded + i, k, &used, decoded + out, cap);
+            i += used;
+        }
+        double t_dec = (double)(clock() - start) / CLOCKS_PER_SEC;
+        assert(out == n && rle_decode_done(&d) && !memcmp(in, decoded, n));
+
+        printf("%-37s %6.3f %12.0f %12.0f\n", names[kind], (double)size / n,
+               n / 1e6 / t_enc, n / 1e6 / t_dec);
+    }
+
+    // the text encoders need text without NUL bytes
+    fill_telemetry(in, n, 2);
+    for (size_t i = 0; i < n; ++i) in[i] = (uint8_t)('a' + in[i] % 26);
+    in[n] = '\0';
+    clock_t start = clock();
+    char* text = run_length_encode_previous((char*)in);
+    double t_prev = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    char* text2 = run_length_encode((const char*)in);
+    double t_text = (double)(clock() - start) / CLOCKS_PER_SEC;
+    assert(!strcmp(text, text2));
+    printf("text, previous run_length_encode()  %6.3f %12.0f\n",
+           (double)strlen(text) / n, n / 1e6 / t_prev);
+    printf("text, run_length_encode()           %6.3f %12.0f\n",
+           (double)strlen(text2) / n, n / 1e6 / t_text);
+    free(text);
+    free(text2);
+
+    free(in);
+    free(encoded);
+    free(decoded);
+}
+
+/** encodes (-c) or decodes (-d) stdin to stdout; @returns 0 on success */
+static int filter(int decode) {
+    static uint8_t in[1 << 16];
+    static uint8_t out[(1 << 16) + (1 << 16) / RLE_MAX_LITERAL + 256];
+    size_t n;
+    rle_encoder e = {0};
+    rle_decoder d = {0};
+
+    while ((n = fread(in, 1, sizeof(in), stdin)) > 0) {
+        if (!decode) {
+            size_t k = rle_encode(&e, in, n, out);
+            if (fwrite(out, 1, k, stdout) != k) {
+                return 1;
+            }
+            continue;
+        }
+        for (size_t i = 0; i < n;) {
+            size_t used;
+            long k = rle_decode(&d, in + i, n - i, &used, out, sizeof(out));
+            if (k < 0 || fwrite(out, 1, k, stdout) != (size_t)k) {
+                return 1;
+            }
+            i += used;
+        }
+    }
+    if (!decode) {
+        n = rle_encode_finish(&e, out);
+        if (fwrite(out, 1, n, stdout) != n) {
+            return 1;
+        }
+    }
+    if (ferror(stdin) || (decode && !rle_decode_done(&d))) {
+        return 1;
+    }
+    return fflush(stdout) != 0;
 }
 
 /**
  * @brief Main function
+ * @param argc number of arguments
+ * @param argv `-c` / `-d` to filter, or the MiB to benchmark
  * @returns 0 on exit
  */
-int main() {
+int main(int argc, char** argv) {
+    if (argc > 1 && (!strcmp(argv[1], "-c") || !strcmp(argv[1], "-d"))) {
+        return filter(argv[1][1] == 'd');
+    }
     test();  // run self-test implementations
     printf("All tests have passed!\n");
+    benchmark(argc > 1 ? strtoul(argv[1], NULL, 10) : 64);
     return 0;
 }
@@ -1,18 +1,22 @@
 /**
  * @file
- * @brief Sudoku Solver using recursive implementation of brute-force algorithm
+ * @brief Sudoku Solver using constraint propagation and backtracking
  *
  * @details
  * Given an incomplete N*N Sudoku and asked to solve it using the
  * following recursive algorithm:
- * 1. Scan the Sudoku from left to right row-wise to search for an empty cell.
- * 2. If there are no empty cells, print the Sudoku. Go to step 5.
- * 3. In the empty cell, try putting numbers 1 to N
- * while ensuring that no two numbers in a single row, column, or box are same.
- * Go back to step 1.
+ * 1. Fill the cells that accept a single value, and the values that fit a
+ * single cell of a row, column or box, until there are none left.
+ * 2. If there are no empty cells, the Sudoku is solved. Go to step 5.
+ * 3. In the empty cell with the fewest candidates, try each of them and go
+ * back to step 1 on a copy of the grid.
  * 4. Declare that the Sudoku is Invalid.
  * 5. Exit.
  *
+ * The values used by each row, column and box are bit masks, so that the
+ * candidates of a cell cost three OR operations. `-b puzzles.txt` solves a
+ * file of one-line puzzles with OpenMP threads and reports puzzles/s.
+ *
  * @authors [Anuj Shah](https://github.com/anujms1999)
  * @authors [Krishna Vedala](https://github.com/kvedala)
  */
@@ -23,6 +27,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /** @addtogroup sudoku Sudoku solver
  * @{
@@ -132,92 +140,426 @@ void print(const struct sudoku *a)
                    (j == a->N - 1 ? '\n' : ' '));
 }
 
+/** Largest supported size: candidates are bits of a `uint32_t` */
+#define SUDOKU_MAX 25
+
+/** Search state of solve(): the grid and the digits used by each unit
+ */
+struct sudoku_state
+{
+    uint32_t row[SUDOKU_MAX]; /**< digits used in each row, bit v-1 for v */
+    uint32_t col[SUDOKU_MAX]; /**< digits used in each column */
+    uint32_t box[SUDOKU_MAX]; /**< digits used in each box */
+    uint8_t cell[SUDOKU_MAX * SUDOKU_MAX]; /**< values, 0 if unknown */
+    int unknown;                           /**< number of unknown cells */
+};
+
+/**
+ * Count the candidates in a mask
+ * @param m mask of candidates
+ * @returns number of bits set
+ */
+static inline int count_bits(uint32_t m)
+{
+#if defined(__GNUC__)
+    return __builtin_popcount(m);
+#else
+    int c = 0;
+    for (; m; m &= m - 1) c++;
+    return c;
+#endif
+}
+
+/**
+ * Index of the lowest candidate in a mask
+ * @param m non-zero mask of candidates
+ * @returns index of the lowest bit set
+ */
+static inline int lowest_bit(uint32_t m)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(m);
+#else
+    int i = 0;
+    for (; !(m & 1); m >>= 1) i++;
+    return i;
+#endif
+}
+
+/**
+ * Place a value in an unknown cell
+ * @param a ::sudoku giving the dimensions
+ * @param s state to update
+ * @param i row of the cell
+ * @param j column of the cell
+ * @param v value to place
+ */
+static inline void place(const struct sudoku *a, struct sudoku_state *s,
+                         int i, int j, int v)
+{
+    uint32_t bit = 1u << (v - 1);
+    s->cell[i * a->N + j] = v;
+    s->row[i] |= bit;
+    s->col[j] |= bit;
+    s->box[i / a->N2 * a->N2 + j / a->N2] |= bit;
+    s->unknown--;
+}
+
+/**
+ * Candidates of a cell: values not used in its row, column or box
+ * @param a ::sudoku giving the dimensions
+ * @param s state to query
+ * @param i row of the cell
+ * @param j column of the cell
+ * @returns mask of the candidates, bit v-1 for value v
+ */
+static inline uint32_t candidates(const struct sudoku *a,
+                                  const struct sudoku_state *s, int i, int j)
+{
+    uint32_t all = (1u << a->N) - 1;
+    return all &
+           ~(s->row[i] | s->col[j] | s->box[i / a->N2 * a->N2 + j / a->N2]);
+}
+
+/**
+ * Values used by a unit
+ * @param s state to query
+ * @param kind 0 for a row, 1 for a column, 2 for a box
+ * @param u index of the unit
+ * @returns mask of the values
+ */
+static inline uint32_t unit_used(const struct sudoku_state *s, int kind, int u)
+{
+    return kind == 0 ? s->row[u] : kind == 1 ? s->col[u] : s->box[u];
+}
+
 /**
- * @brief Find and get the location for next empty cell.
+ * @brief Fill the cells that have a single candidate (naked singles) and
+ * the values that fit a single cell of a row, column or box (hidden
+ * singles), until neither is left.
  *
- * @param [in] a pointer to sudoku instance
- * @param [out] x pointer to row index of next unknown
- * @param [out] y pointer to column index of next unknown
- * @returns `true` if an empty location was found
- * @returns `false` if no more empty locations found
+ * @param [in] a ::sudoku giving the dimensions
+ * @param [in,out] s state to propagate
+ * @returns `false` if a cell or a value of a unit has no place left
  */
-bool get_next_unknown(const struct sudoku *a, int *x, int *y)
+static bool propagate(const struct sudoku *a, struct sudoku_state *s)
 {
-    for (int i = 0; i < a->N; i++)
+    const int N = a->N, N2 = a->N2;
+    const uint32_t all = (1u << N) - 1;
+    bool changed = true;
+
+    while (changed && s->unknown)
     {
-        for (int j = 0; j < a->N; j++)
-        {
-            if (a->a[i * a->N + j] == 0)
+        changed = false;
+        for (int i = 0; i < N; i++)
+            for (int j = 0; j < N; j++)
             {
-                *x = i;
-                *y = j;
-                return true;
+                if (s->cell[i * N + j])
+                    continue;
+                uint32_t c = candidates(a, s, i, j);
+                if (c == 0)
+                    return false;
+                if ((c & (c - 1)) == 0)
+                {
+                    place(a, s, i, j, lowest_bit(c) + 1);
+                    changed = true;
+                }
             }
+
+        /* unit u of kind 0, 1, 2 is row u, column u or box u; its k-th cell
+           is (i, j) below */
+        for (int kind = 0; kind < 3; kind++)
+            for (int u = 0; u < N; u++)
+            {
+                uint32_t once = 0, twice = 0;
+                int cells[SUDOKU_MAX];
+                for (int k = 0; k < N; k++)
+                {
+                    int i = kind == 0 ? u : kind == 1 ? k
+                                                      : u / N2 * N2 + k / N2;
+                    int j = kind == 0 ? k : kind == 1 ? u
+                                                      : u % N2 * N2 + k % N2;
+                    cells[k] = i * N + j;
+                    if (s->cell[i * N + j])
+                        continue;
+                    uint32_t c = candidates(a, s, i, j);
+                    twice |= once & c;
+                    once |= c;
+                }
+                if ((once | unit_used(s, kind, u)) != all)
+                    return false;  // a value has no place in the unit
+                for (uint32_t h = once & ~twice; h; h &= h - 1)
+                {
+                    int v = lowest_bit(h);
+                    for (int k = 0; k < N; k++)
+                    {
+                        int i = cells[k] / N, j = cells[k] % N;
+                        if (s->cell[cells[k]] ||
+                            !(candidates(a, s, i, j) & (1u << v)))
+                            continue;
+                        place(a, s, i, j, v + 1);
+                        changed = true;
+                        break;
+                    }
+                    if (!(unit_used(s, kind, u) & (1u << v)))
+                        return false;  // its only cell took another value
+                }
+            }
+    }
+    return true;
+}
+
+/**
+ * @brief Depth-first search: propagate, then try each candidate of the
+ * unknown cell with the fewest of them (minimum remaining values).
+ *
+ * @param [in] a ::sudoku giving the dimensions
+ * @param [in,out] s state to complete
+ * @returns `true` if `s` was completed
+ */
+static bool search(const struct sudoku *a, struct sudoku_state *s)
+{
+    if (!propagate(a, s))
+        return false;
+    if (s->unknown == 0)
+        return true;
+
+    int best = -1, fewest = SUDOKU_MAX + 1;
+    uint32_t choices = 0;
+    for (int x = 0; x < a->N * a->N && fewest > 2; x++)
+    {
+        if (s->cell[x])
+            continue;
+        uint32_t c = candidates(a, s, x / a->N, x % a->N);
+        if (count_bits(c) < fewest)
+        {
+            fewest = count_bits(c);
+            best = x;
+            choices = c;
         }
     }
 
-    /* no unknown locations found */
+    for (; choices; choices &= choices - 1)
+    {
+        struct sudoku_state next = *s;
+        place(a, &next, best / a->N, best % a->N, lowest_bit(choices) + 1);
+        if (search(a, &next))
+        {
+            *s = next;
+            return true;
+        }
+    }
     return false;
 }
 
 /**
- * @brief Function to solve a partially filled sudoku matrix. For each unknown
- * value (0), the function fills a possible value and calls the function again
- * to check forvalid solution.
+ * @brief Function to solve a partially filled sudoku matrix. Each row,
+ * column and box keeps a mask of the values it uses, so that the
+ * candidates of a cell are a few bit operations. Singles are filled in by
+ * propagate(), and the search branches on the cell with the fewest
+ * candidates.
  *
- * @param [in,out] a sudoku matrix to solve
+ * @param [in,out] a sudoku matrix to solve, with 0 for unknown values
  * @return `true` if solution found
- * @return `false` if no solution found
+ * @return `false` if no solution found, `a` being left unchanged
  */
 bool solve(struct sudoku *a)
 {
-    static uint32_t counter = 0;
-    int i, j;
-    static char prefix[100] = "";  // enough memory
+    struct sudoku_state s;
+    const int N = a->N;
+
+    if (N > SUDOKU_MAX || a->N2 * a->N2 != N)
+        return false;
+    memset(&s, 0, sizeof(s));
+    s.unknown = N * N;
+    for (int i = 0; i < N; i++)
+        for (int j = 0; j < N; j++)
+        {
+            int v = a->a[i * N + j];
+            if (v == 0)
+                continue;
+            if (v > N || !(candidates(a, &s, i, j) & (1u << (v - 1))))
+                return false;  // invalid or repeated given
+            place(a, &s, i, j, v);
+        }
 
-    if (!get_next_unknown(a, &i, &j))
+    if (!search(a, &s))
+        return false;
+    memcpy(a->a, s.cell, N * N);
+    return true;
+}
+
+/**
+ * @brief Read a puzzle written on one line, as in the usual puzzle
+ * collections: N*N characters, `1`-`9` then `A`... for the values and `.`
+ * or `0` for the unknowns.
+ *
+ * @param [in] line text of the puzzle
+ * @param [out] a ::sudoku to fill, whose array holds SUDOKU_MAX^2 values
+ * @returns `false` if the line is not a puzzle
+ */
+bool parse_puzzle(const char *line, struct sudoku *a)
+{
+    int len = 0, N = 1;
+    while (line[len] && line[len] != '\n' && line[len] != '\r') len++;
+    while (N * N * N * N < len) N++;
+    if (N * N * N * N != len || N * N > SUDOKU_MAX)
+        return false;
+    a->N2 = N;
+    a->N = N * N;
+    for (int k = 0; k < len; k++)
     {
-        /* no more empty location found
-           implies all good in the matrix
-         */
-        return true;
+        char c = line[k];
+        int v = c == '.' ? 0
+                : c >= '0' && c <= '9' ? c - '0'
+                : c >= 'A' && c <= 'Z' ? c - 'A' + 10
+                                       : -1;
+        if (v < 0 || v > a->N)
+            return false;
+        a->a[k] = v;
     }
+    return true;
+}
 
-    /* try all possible values for the unknown */
-    for (uint8_t v = 1; v <= a->N; v++)
-    { /* try all possible values 1 thru N */
-        printf("%sTry (%d,%d) = %" SCNu8 "... ", prefix, i, j, v);
-        counter++;
-        if (OK(a, i, j, v))
+/**
+ * Write a grid on one line, the format of parse_puzzle()
+ * @param [in] a grid to write
+ * @param [out] line at least N*N+1 characters
+ */
+void format_puzzle(const struct sudoku *a, char *line)
+{
+    int k;
+    for (k = 0; k < a->N * a->N; k++)
+        line[k] = a->a[k] == 0  ? '.'
+                  : a->a[k] < 10 ? '0' + a->a[k]
+                                 : 'A' + a->a[k] - 10;
+    line[k] = '\0';
+}
+
+/**
+ * Check that a grid is complete, valid, and keeps the givens of a puzzle
+ * @param [in] a solved grid
+ * @param [in] given puzzle it was solved from
+ * @returns `true` if `a` solves `given`
+ */
+bool check_solution(const struct sudoku *a, const uint8_t *given)
+{
+    for (int i = 0; i < a->N; i++)
+        for (int j = 0; j < a->N; j++)
         {
-            /* if assignment checks satisfy, set the value and
-             continue with remaining elements */
-            printf("passed (counter=%" SCNu32 ")\n", counter);
-            a->a[i * a->N + j] = v;
-            strcat(prefix, "  ");
-            if (solve(a))
-            {
-                /* solution found */
-                return true;
-            }
+            int k = i * a->N + j, v = a->a[k];
+            if (v == 0 || (given[k] && given[k] != v))
+                return false;
+            a->a[k] = 0;  // OK() looks for repeats of v among the others
+            bool ok = OK(a, i, j, v);
+            a->a[k] = v;
+            if (!ok)
+                return false;
+        }
+    return true;
+}
+
+/**
+ * @brief Solve a file of puzzles, one per line, with one thread per core
+ *
+ * @param [in] in file of puzzles
+ * @param [in] out file receiving the solutions, one per line with `-` for
+ * a puzzle without solution, or NULL
+ * @returns number of puzzles solved, or -1 on error
+ */
+long solve_batch(FILE *in, FILE *out)
+{
+    const int width = SUDOKU_MAX * SUDOKU_MAX + 2;
+    long count = 0, capacity = 1024, solved = 0, invalid = 0;
+    char *lines = malloc(capacity * width);
 
-            printf("%sBacktrack (%d,%d) <- %" SCNu8 " (counter=%" SCNu32 ")\n",
-                   prefix, i, j, a->a[i * a->N + j], counter);
+    while (lines && fgets(lines + count * width, width, in))
+    {
+        if (lines[count * width] == '\n' || lines[count * width] == '#')
+            continue;  // blank line or comment
+        if (++count == capacity)
+        {
+            char *grown = realloc(lines, 2 * capacity * width);
+            if (grown == NULL)
+                break;
+            lines = grown;
+            capacity *= 2;
+        }
+    }
+    if (lines == NULL || count == capacity)
+    {
+        free(lines);
+        return -1;
+    }
 
-            prefix[strlen(prefix) - 2] = '\0';  // truncate the prefix
-            a->a[i * a->N + j] = 0;
+#ifdef _OPENMP
+    double start = omp_get_wtime();
+#pragma omp parallel for schedule(dynamic, 16) reduction(+ : solved, invalid)
+#else
+    clock_t start = clock();
+#endif
+    for (long p = 0; p < count; p++)
+    {
+        uint8_t grid[SUDOKU_MAX * SUDOKU_MAX];
+        struct sudoku a = {.a = grid};
+        char *line = lines + p * width;
+        if (!parse_puzzle(line, &a))
+        {
+            invalid++;
+            strcpy(line, "-");
         }
-        else
+        else if (solve(&a))
         {
-            printf("\r");
+            solved++;
+            format_puzzle(&a, line);
         }
+        else
+            strcpy(line, "-");
     }
+#ifdef _OPENMP
+    double seconds = omp_get_wtime() - start;
+#else
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+#endif
 
-    return false;
+    for (long p = 0; out && p < count; p++)
+        fprintf(out, "%s\n", lines + p * width);
+    fprintf(stderr,
+            "%ld puzzles, %ld solved, %ld not puzzles: %.3f s, %.0f "
+            "puzzles/s\n",
+            count, solved, invalid, seconds,
+            seconds > 0 ? count / seconds : 0.0);
+    free(lines);
+    return solved;
 }
 
 /** @} */
 
+/**
+ * Solve a one-line puzzle and check the solution
+ * @param [in] givens start of the puzzle
+ * @param [in] length of the puzzle, the end of `givens` being unknowns
+ * @returns `true` if it was solved
+ */
+static bool test_line(const char *givens, int length)
+{
+    uint8_t grid[SUDOKU_MAX * SUDOKU_MAX], given[SUDOKU_MAX * SUDOKU_MAX];
+    char line[SUDOKU_MAX * SUDOKU_MAX + 1];
+    struct sudoku a = {.a = grid};
+    memset(line, '.', length);
+    memcpy(line, givens, strlen(givens));
+    line[length] = '\0';
+    assert(parse_puzzle(line, &a));
+    memcpy(given, grid, sizeof(grid));
+    if (!solve(&a))
+    {
+        assert(memcmp(given, grid, a.N * a.N) == 0);
+        return false;
+    }
+    assert(check_solution(&a, given));
+    return true;
+}
+
 void test()
 {
     printf("Test begin...\n");
@@ -239,12 +581,47 @@ void test()
         for (int j = 0; j < a.N; j++)
             assert(a.a[i * a.N + j] == expected[i * a.N + j]);
 
+    // hard puzzles: few givens, or needing deep searches
+    assert(test_line("8..........36......7..9.2...5...7.......457....."
+                     "1...3...1....68..85...1..9....4..",
+                     81));
+    assert(test_line(".......1.4.........2...........5.4.7..8...3....1."
+                     "9....3..4..2...5.1........8.6...",
+                     81));
+    assert(test_line("", 81));
+    // other sizes
+    assert(test_line("1...........4...", 16));
+    assert(test_line("123456789ABCDEFG", 256));
+    assert(test_line("", 625));
+    // repeated given, and a valid start without solution
+    assert(!test_line("11", 81));
+    assert(!test_line("12345678.........9", 81));
+    assert(!parse_puzzle("123", &a));
+
     printf("Test passed\n");
 }
 
-/** \brief Main function */
-int main()
+/** \brief Main function: `-b puzzles.txt [-o solutions.txt]` solves a file
+ * of puzzles, otherwise a puzzle is read from stdin after the self-tests */
+int main(int argc, char **argv)
 {
+    if (argc >= 3 && strcmp(argv[1], "-b") == 0)
+    {
+        FILE *in = fopen(argv[2], "r"), *out = NULL;
+        if (argc >= 5 && strcmp(argv[3], "-o") == 0)
+            out = fopen(argv[4], "w");
+        if (in == NULL || (argc >= 5 && out == NULL))
+        {
+            perror("sudoku_solver");
+            return 1;
+        }
+        long solved = solve_batch(in, out);
+        fclose(in);
+        if (out)
+            fclose(out);
+        return solved < 0;
+    }
+
     test();
 
     struct sudoku a;  // store the matrix as a 1D array
@@ -28,35 +28,23 @@
  * width="400" alt="Roots evolution - shows the initial approximation of the
  * roots and their convergence to a final approximation along with the iterative
  * approximations" />
+ *
+ * The iterations are those of polynomial_roots.h, with the Aberth-Ehrlich
+ * correction by default; `./durand_kerner_roots bench` instead checks the
+ * library and measures how many polynomials per second it solves, with both
+ * methods, for degrees 5 to 200. Builds with `DEBUG` defined log every
+ * iteration to `durand_kerner.log.csv`.
  */
 
+#include <assert.h>
 #include <complex.h>
-#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-#define ACCURACY 1e-10 /**< maximum accuracy limit */
-
-/**
- * Evaluate the value of a polynomial with given coefficients
- * \param[in] coeffs coefficients of the polynomial
- * \param[in] degree degree of polynomial
- * \param[in] x point at which to evaluate the polynomial
- * \returns \f$f(x)\f$
- */
-long double complex poly_function(long double *coeffs, unsigned int degree,
-                                  long double complex x)
-{
-    long double complex out = 0.;
-    unsigned int n;
-
-    for (n = 0; n < degree; n++) out += coeffs[n] * cpow(x, degree - n - 1);
-
-    return out;
-}
+#include "polynomial_roots.h"
 
 /**
  * create a textual form of complex number
@@ -74,30 +62,202 @@ const char *complex_str(long double complex x)
     return msg;
 }
 
+/** wall clock time in seconds */
+static double now(void)
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
 /**
- * check for termination condition
- * \param[in] delta point at which to evaluate the polynomial
- * \returns 0 if termination not reached
- * \returns 1 if termination reached
+ * coefficients of the real polynomial with the given roots and their
+ * conjugates
+ * @param[in] 	z	roots, each one counted with its conjugate if it is not
+ *			real
+ * @param[in] 	m	number of roots in `z`
+ * @param[out] 	coeffs	coefficients, highest power first
+ * \returns the degree
  */
-char check_termination(long double delta)
+static int poly_from_roots(const double complex *z, int m, double *coeffs)
 {
-    static long double past_delta = INFINITY;
-    if (fabsl(past_delta - delta) <= ACCURACY || delta < ACCURACY)
-        return 1;
-    past_delta = delta;
-    return 0;
+    double complex *c = (double complex *)calloc(2 * m + 1,
+                                                 sizeof(double complex));
+    int n = 0;
+
+    c[0] = 1;
+    for (int k = 0; k < m; k++)
+    {
+        int twice = cimag(z[k]) != 0;
+        for (int t = 0; t <= twice; t++)
+        {
+            double complex r = t ? conj(z[k]) : z[k];
+            n++;
+            for (int i = n; i > 0; i--) c[i] -= r * c[i - 1];
+        }
+    }
+    for (int i = 0; i <= n; i++) coeffs[i] = creal(c[i]);
+    free(c);
+    return n;
+}
+
+/**
+ * largest distance from a root in `expected` to the nearest one in `roots`
+ */
+static double root_distance(const double complex *roots,
+                            const double complex *expected, int n)
+{
+    double worst = 0;
+    for (int k = 0; k < n; k++)
+    {
+        double best = INFINITY;
+        for (int j = 0; j < n; j++)
+            best = fmin(best, cabs(roots[j] - expected[k]));
+        worst = fmax(worst, best);
+    }
+    return worst;
+}
+
+/**
+ * Self-test of polynomial_roots.h
+ */
+static void test(void)
+{
+    struct poly_options opt = poly_default_options();
+    double complex roots[20], expected[20], z[10];
+    double coeffs[21];
+    int iter;
+
+    // x^4 - 1
+    double quartic[] = {1, 0, 0, 0, -1};
+    double complex units[] = {1, -1, I, -I};
+    iter = poly_roots(quartic, 4, roots, NULL);
+    assert(iter > 0);
+    assert(root_distance(roots, units, 4) < 1e-12);
+
+    // (x-1)(x-2)(x-3), with both methods
+    double cubic[] = {2, -12, 22, -12};
+    double complex small[] = {1, 2, 3};
+    for (int m = POLY_DURAND_KERNER; m <= POLY_ABERTH; m++)
+    {
+        opt.method = (enum poly_method)m;
+        iter = poly_roots(cubic, 3, roots, &opt);
+        assert(iter > 0);
+        assert(root_distance(roots, small, 3) < 1e-12);
+
+        // corrections that overflow leave no roots, and say so
+        double huge[] = {1e-300, 1e300, 1, 1};
+        iter = poly_roots(huge, 3, roots, &opt);
+        assert(iter == -1);
+        assert(isnan(creal(roots[0])) && isnan(creal(roots[2])));
+    }
+
+    // random roots, in conjugate pairs; Aberth-Ehrlich takes fewer
+    // iterations. The coefficients lose accuracy quickly as the degree grows,
+    // so the degree is kept small enough to check the roots closely
+    srand(1);
+    for (int k = 0; k < 10; k++)
+    {
+        double rho = 0.5 + 0.5 * rand() / RAND_MAX;
+        double theta = acos(-1) * (k + 0.5 * rand() / RAND_MAX) / 10;
+        z[k] = rho * cexp(I * theta);
+        expected[2 * k] = z[k];
+        expected[2 * k + 1] = conj(z[k]);
+    }
+    int n = poly_from_roots(z, 10, coeffs);
+    assert(n == 20);
+    opt.method = POLY_ABERTH;
+    int aberth = poly_roots(coeffs, n, roots, &opt);
+    assert(aberth > 0 && root_distance(roots, expected, n) < 1e-9);
+    opt.method = POLY_DURAND_KERNER;
+    int kerner = poly_roots(coeffs, n, roots, &opt);
+    assert(kerner > aberth && root_distance(roots, expected, n) < 1e-9);
+
+    // the batch finds the same roots as one polynomial at a time
+    double batch[5 * 21];
+    double complex batch_roots[5 * 20];
+    int iterations[5];
+    for (int i = 0; i < 5; i++)
+        for (int j = 0; j <= n; j++)
+            batch[i * (n + 1) + j] = coeffs[j] * (i + 1);
+    batch[2 * (n + 1)] = 0;  // no leading coefficient
+    opt.method = POLY_ABERTH;
+    size_t converged =
+        poly_roots_batch(batch, n, 5, batch_roots, iterations, &opt);
+    assert(converged == 4);
+    assert(iterations[2] == -1 && iterations[0] == aberth);
+    poly_roots(coeffs, n, roots, &opt);
+    assert(memcmp(roots, batch_roots, n * sizeof(double complex)) == 0);
+    (void)iter;
+    (void)converged;
+
+    printf("All tests have successfully passed!\n");
+}
+
+/**
+ * polynomials per second with both methods, for random polynomials
+ * (coefficients uniform in \f$[-1,1]\f$) of degrees 5 to 200
+ */
+static void benchmark(void)
+{
+    const int degrees[] = {5, 10, 20, 50, 100, 200};
+    const char *names[] = {"Durand-Kerner", "Aberth-Ehrlich"};
+
+    printf("%6s %8s %-15s %12s %10s %10s\n", "degree", "count", "method",
+           "polys/s", "mean iter", "converged");
+    for (size_t d = 0; d < sizeof(degrees) / sizeof(degrees[0]); d++)
+    {
+        int n = degrees[d];
+        size_t count = 2000000 / (n * n) + 20;
+        double *coeffs = (double *)malloc(count * (n + 1) * sizeof(double));
+        double complex *roots =
+            (double complex *)malloc(count * n * sizeof(double complex));
+        int *iterations = (int *)malloc(count * sizeof(int));
+        if (!coeffs || !roots || !iterations)
+        {
+            perror("Unable to allocate memory!");
+            free(coeffs);
+            free(roots);
+            free(iterations);
+            return;
+        }
+        srand(n);
+        for (size_t i = 0; i < count * (n + 1); i++)
+            coeffs[i] = 2.0 * rand() / RAND_MAX - 1;
+
+        for (int m = POLY_DURAND_KERNER; m <= POLY_ABERTH; m++)
+        {
+            struct poly_options opt = poly_default_options();
+            opt.method = (enum poly_method)m;
+            double start = now();
+            size_t converged = poly_roots_batch(coeffs, n, count, roots,
+                                                iterations, &opt);
+            double seconds = now() - start;
+            double mean = 0;
+            for (size_t i = 0; i < count; i++)
+                mean += iterations[i] >= 0 ? iterations[i] : opt.max_iter;
+            printf("%6d %8zu %-15s %12.0f %10.1f %9.1f%%\n", n, count,
+                   names[m], count / seconds, mean / count,
+                   100.0 * converged / count);
+        }
+        free(coeffs);
+        free(roots);
+        free(iterations);
+    }
 }
 
 /***
- * the comandline inputs are taken as coeffiecients of a polynomial
+ * the comandline inputs are taken as coeffiecients of a polynomial;
+ * `bench` runs the self-test and the benchmark
  */
 int main(int argc, char **argv)
 {
-    long double *coeffs = NULL;
-    long double complex *s0 = NULL;
+    double *coeffs = NULL;
+    double complex *s0 = NULL;
     unsigned int degree = 0;
-    unsigned int n, i;
+    unsigned int n;
 
     if (argc < 2)
     {
@@ -106,16 +266,19 @@ int main(int argc, char **argv)
             "arguments.\n");
         return 0;
     }
+    if (strcmp(argv[1], "bench") == 0)
+    {
+        test();
+        benchmark();
+        return 0;
+    }
 
     degree = argc - 1; /* detected polynomial degree */
-    coeffs = (long double *)malloc(
-        degree * sizeof(long double)); /* store all input coefficients */
-    s0 = (long double complex *)malloc(
-        (degree - 1) *
-        sizeof(long double complex)); /* number of roots = degree-1 */
-
-    /* initialize random seed: */
-    srand(time(NULL));
+    coeffs = (double *)malloc(
+        degree * sizeof(double)); /* store all input coefficients */
+    s0 = (double complex *)malloc(
+        (degree > 1 ? degree - 1 : 1) *
+        sizeof(double complex)); /* number of roots = degree-1 */
 
     if (!coeffs || !s0)
     {
@@ -127,7 +290,8 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-#if defined(DEBUG) || !defined(NDEBUG)
+    struct poly_options opt = poly_default_options();
+#if defined(DEBUG)
     /**
      * store intermediate values to a CSV file
      */
@@ -140,6 +304,9 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
     fprintf(log_file, "iter#,");
+    for (n = 0; n + 1 < degree; n++) fprintf(log_file, "root_%d,", n);
+    fprintf(log_file, "max. correction\n");
+    opt.log = log_file;
 #endif
 
     printf("Computing the roots for:\n\t");
@@ -147,101 +314,26 @@ int main(int argc, char **argv)
     {
         coeffs[n] = strtod(argv[n + 1], NULL);
         if (n < degree - 1 && coeffs[n] != 0)
-            printf("(%Lg) x^%d + ", coeffs[n], degree - n - 1);
+            printf("(%g) x^%d + ", coeffs[n], degree - n - 1);
         else if (coeffs[n] != 0)
-            printf("(%Lg) x^%d = 0\n", coeffs[n], degree - n - 1);
-
-        double tmp;
-        if (n > 0)
-            coeffs[n] /= tmp; /* numerical errors less when the first
-                                 coefficient is "1" */
-        else
-        {
-            tmp = coeffs[0];
-            coeffs[0] = 1;
-        }
-
-        /* initialize root approximations with random values */
-        if (n < degree - 1)
-        {
-            s0[n] = (long double)rand() + (long double)rand() * I;
-#if defined(DEBUG) || !defined(NDEBUG)
-            fprintf(log_file, "root_%d,", n);
-#endif
-        }
+            printf("(%g) x^%d = 0\n", coeffs[n], degree - n - 1);
     }
 
-#if defined(DEBUG) || !defined(NDEBUG)
-    fprintf(log_file, "avg. correction");
-    fprintf(log_file, "\n0,");
-    for (n = 0; n < degree - 1; n++)
-        fprintf(log_file, "%s,", complex_str(s0[n]));
-#endif
-
-    double tol_condition = 1;
-    unsigned long iter = 0;
-
     clock_t end_time, start_time = clock();
-    while (!check_termination(tol_condition) && iter < INT_MAX)
-    {
-        long double complex delta = 0;
-        tol_condition = 0;
-        iter++;
-
-#if defined(DEBUG) || !defined(NDEBUG)
-        fprintf(log_file, "\n%ld,", iter);
-#endif
-
-        for (n = 0; n < degree - 1; n++)
-        {
-            long double complex numerator =
-                poly_function(coeffs, degree, s0[n]);
-            long double complex denominator = 1.0;
-            for (i = 0; i < degree - 1; i++)
-                if (i != n)
-                    denominator *= s0[n] - s0[i];
-
-            delta = numerator / denominator;
-
-            if (isnan(cabsl(delta)) || isinf(cabsl(delta)))
-            {
-                printf("\n\nOverflow/underrun error - got value = %Lg",
-                       cabsl(delta));
-                goto end;
-            }
-
-            s0[n] -= delta;
-
-            tol_condition = fmaxl(tol_condition, fabsl(cabsl(delta)));
-
-#if defined(DEBUG) || !defined(NDEBUG)
-            fprintf(log_file, "%s,", complex_str(s0[n]));
-#endif
-        }
-        // tol_condition /= (degree - 1);
-
-#if defined(DEBUG) || !defined(NDEBUG)
-        if (iter % 500 == 0)
-        {
-            printf("Iter: %lu\t", iter);
-            for (n = 0; n < degree - 1; n++) printf("\t%s", complex_str(s0[n]));
-            printf("\t\tabsolute average change: %.4g\n", tol_condition);
-        }
-
-        fprintf(log_file, "%.4g", tol_condition);
-#endif
-    }
-end:
-
+    int iter = poly_roots(coeffs, degree - 1, s0, &opt);
     end_time = clock();
 
-#if defined(DEBUG) || !defined(NDEBUG)
+#if defined(DEBUG)
     fclose(log_file);
 #endif
 
-    printf("\nIterations: %lu\n", iter);
-    for (n = 0; n < degree - 1; n++) printf("\t%s\n", complex_str(s0[n]));
-    printf("absolute average change: %.4g\n", tol_condition);
+    if (iter < 0)
+        printf("\nNo convergence, or the first coefficient is 0\n");
+    else
+    {
+        printf("\nIterations: %d\n", iter);
+        for (n = 0; n + 1 < degree; n++) printf("\t%s\n", complex_str(s0[n]));
+    }
     printf("Time taken: %.4g sec\n",
            (end_time - start_time) / (double)CLOCKS_PER_SEC);
 
@@ -1,6 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <float.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /*
 
@@ -10,6 +15,7 @@
 	 - In this file, `a` and `b` represents the lower and upper bound, respectively.
 	 - The integrand(function to integrate) is called 'f'
 	 - All integrands take a double as an argument, even if no decimal numbers are provided or needed(for generalization purposes and precision)
+	 - The adaptive methods take a vectorised integrand instead, which evaluates many nodes per call(see `vector_function`)
 
  * @reference: For more information, consult https://en.wikipedia.org/wiki/Newton%E2%80%93Cotes_formulas
 
@@ -29,6 +35,10 @@
 
 #define MAX_ITERATIONS 100
 
+#define BATCH 64		// most sub-intervals bisected per round
+#define SIMPSON_START 8		// equal sub-intervals the Simpson rule starts from
+#define PARALLEL_NODES 1024	// fewest nodes per call worth spreading over threads
+
 #define FUNCTION(n) f##n
 #define EXPAND(x) FUNCTION(x) // Expand the given function_code to the corresponding function
 #define DEFAULT 0 // the default function is f0, change this to use another function
@@ -66,6 +76,44 @@ double mid_point_rule(function, int, double, double);
 double boole(function, int, double, double);
 
 
+/*
+ * @brief: Vectorised integrand: y[i] = f(x[i]) for 0 <= i < n
+ * @description: One call evaluates all the nodes of many sub-intervals, so that the
+   loop over them can use SIMD instructions and the cost of the call is shared.
+   The adaptive methods may call it from several OpenMP threads at once, on disjoint slices.
+*/
+typedef void (*vector_function)(const double *x, double *y, size_t n);
+
+/*
+ * @brief: Generates the vectorised version `name##_v` of a scalar integrand `name`
+*/
+#define VECTORIZE(name)								\
+	void name##_v(const double *x, double *y, size_t n){			\
+		for (size_t i=0; i<n; i++)					\
+			y[i] = name(x[i]);					\
+	}
+
+/*
+ * @brief: Rules of the adaptive integrator
+	 - GAUSS_KRONROD_15: 7-point Gauss rule embedded in the 15-point Kronrod rule(15 nodes per sub-interval)
+	 - ADAPTIVE_SIMPSON: Simpson's rule on the sub-interval and on its halves(5 nodes per sub-interval)
+*/
+enum rule {GAUSS_KRONROD_15, ADAPTIVE_SIMPSON};
+
+/*
+ * @brief: Result of the adaptive integrator
+*/
+struct quadrature {
+	double value;		// estimate of the integral
+	double error;		// estimate of its absolute error
+	size_t evaluations;	// nodes evaluated
+	size_t intervals;	// sub-intervals of the final partition
+	int converged;		// 1 if error <= max(abs_tol, rel_tol*|value|)
+};
+
+struct quadrature adaptive_integrate(vector_function, enum rule, double, double, double, double, size_t);
+
+
 /*
  * Example functions to integrate
 */
@@ -82,6 +130,34 @@ double f2(double x){
 	return x*x*x;  // Cubic function: x³
 }
 
+/*
+ * Integrands of the benchmark, on [0, 1]
+*/
+
+double smooth(double x){
+	return exp(x);  // Integral: e - 1
+}
+
+double peak(double x){
+	return 1/(1e-4 + (x-0.3)*(x-0.3));  // Narrow peak at 0.3. Integral: 100*(atan(70) + atan(30))
+}
+
+double root(double x){
+	return sqrt(x);  // Infinite derivative at 0. Integral: 2/3
+}
+
+double wave(double x){
+	return cos(50*x);  // Oscillatory. Integral: sin(50)/50
+}
+
+VECTORIZE(f0)
+VECTORIZE(f1)
+VECTORIZE(f2)
+VECTORIZE(smooth)
+VECTORIZE(peak)
+VECTORIZE(root)
+VECTORIZE(wave)
+
 
 /*
  * @brief: Function that generate an example for each solving method function
@@ -117,10 +193,79 @@ void test(void){
 	assert(COMPARE_DOUBLE(mid_point_rule(EXPAND(DEFAULT), MAX_ITERATIONS, 1, 3), result, precision) == 1);
 	assert(COMPARE_DOUBLE(boole(EXPAND(DEFAULT), MAX_ITERATIONS, 1, 3), result, precision) == 1);
 
+	// Gauss-Kronrod is exact for polynomials: one sub-interval is enough
+	struct quadrature q = adaptive_integrate(f2_v, GAUSS_KRONROD_15, 1, 3, 1e-12, 0, 1000);
+	assert(q.converged && q.evaluations == 15 && COMPARE_DOUBLE(q.value, 20.0, 1e-12));
+	q = adaptive_integrate(f1_v, GAUSS_KRONROD_15, 3, 0, 1e-12, 0, 1000);
+	assert(COMPARE_DOUBLE(q.value, -9.0, 1e-12));  // reversed bounds
+	q = adaptive_integrate(f0_v, ADAPTIVE_SIMPSON, 1, 3, 1e-12, 0, 1000);
+	assert(q.converged && q.evaluations == 5*SIMPSON_START && COMPARE_DOUBLE(q.value, result, 1e-12));
+	q = adaptive_integrate(f0_v, GAUSS_KRONROD_15, 2, 2, 1e-12, 0, 1000);
+	assert(q.converged && q.value == 0);
+
+	// the error estimates hold, with far fewer evaluations than the fixed rules need; Simpson's
+	// assumes a smooth integrand, and is a few times too low next to the singularity of sqrt
+	struct {vector_function f; double exact;} cases[] = {
+		{smooth_v, exp(1)-1}, {peak_v, 100*(atan(70)+atan(30))},
+		{root_v, 2.0/3}, {wave_v, sin(50)/50}
+	};
+	for (int i=0; i<4; i++){
+		for (int r=GAUSS_KRONROD_15; r<=ADAPTIVE_SIMPSON; r++){
+			double tol = r == GAUSS_KRONROD_15 ? 1e-10 : 1e-7;
+			q = adaptive_integrate(cases[i].f, r, 0, 1, tol, 0, 1000000);
+			assert(q.converged && q.error <= tol);
+			assert(fabs(q.value - cases[i].exact) <= (r == ADAPTIVE_SIMPSON ? 10 : 1)*tol*fmax(1, fabs(cases[i].exact)));
+		}
+	}
+
+	// a budget too small stops before the tolerance is met
+	q = adaptive_integrate(peak_v, GAUSS_KRONROD_15, 0, 1, 1e-12, 0, 100);
+	assert(!q.converged && q.evaluations <= 100);
+
 	printf("All tests ran successfully...");
 }
 
 
+/*
+ * @brief: Prints the error against the number of evaluations of the fixed and adaptive
+   methods, for each integrand of the benchmark
+ * @returns: nothing
+*/
+void benchmark(void){
+	struct {const char *name; function f; vector_function v; double exact;} cases[] = {
+		{"exp(x)", smooth, smooth_v, exp(1)-1},
+		{"1/(1e-4+(x-0.3)^2)", peak, peak_v, 100*(atan(70)+atan(30))},
+		{"sqrt(x)", root, root_v, 2.0/3},
+		{"cos(50x)", wave, wave_v, sin(50)/50}
+	};
+	struct {const char *name; method m;} fixed[] = {
+		{"trapezoid", trapezoid}, {"simpson 1/3", simpson1_3}, {"boole", boole}
+	};
+	double tolerances[] = {1e-4, 1e-8, 1e-12};
+
+	for (int i=0; i<4; i++){
+		printf("\n\nIntegral of %s between 0 and 1\n", cases[i].name);
+		printf("%-16s %-10s %12s %12s %12s\n", "method", "n / tol", "evaluations", "error", "estimate");
+		for (int m=0; m<3; m++){
+			for (int n=16; n<=4096; n*=4){
+				double error = fabs(fixed[m].m(cases[i].f, n, 0, 1) - cases[i].exact);
+				printf("%-16s %-10d %12d %12.3e %12s\n", fixed[m].name, n, n+1, error, "-");
+			}
+		}
+		for (int r=GAUSS_KRONROD_15; r<=ADAPTIVE_SIMPSON; r++){
+			for (int t=0; t<3; t++){
+				struct quadrature q = adaptive_integrate(cases[i].v, r, 0, 1, tolerances[t], 0, 10000000);
+				printf("%-16s %-10.0e %12zu %12.3e %12.3e%s\n",
+					r == GAUSS_KRONROD_15 ? "gauss-kronrod" : "adaptive simpson",
+					tolerances[t], q.evaluations, fabs(q.value - cases[i].exact), q.error,
+					q.converged ? "" : " (not converged)");
+			}
+		}
+	}
+	printf("\n");
+}
+
+
 /*
  * @brief: Function to allow the user to input values and test the script
  * @returns: nothing
@@ -144,6 +289,7 @@ void experimentation(void){
 */
 int main(void){
 	test(); // call experimentation() to test for yourself this script
+	benchmark();
 	return EXIT_SUCCESS;
 }
 
@@ -207,3 +353,257 @@ double mid_point_rule(function f, int n, double a, double b){
 	}
 	return area*h;
 }
+
+
+// Adaptive methods section
+
+/*
+ * @brief: Nodes and weights of the 15-point Kronrod rule on [-1, 1], and of the
+   7-point Gauss rule on its nodes 1, 3, 5 and 7(QUADPACK's qk15)
+*/
+static const double xgk[8] = {
+	0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+	0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+	0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+	0.207784955007898467600689403773245, 0.000000000000000000000000000000000
+};
+static const double wgk[8] = {
+	0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+	0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+	0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+	0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+};
+static const double wg[4] = {
+	0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+	0.381830050505118944950369775488975, 0.417959183673469387755102040816327
+};
+
+/*
+ * @brief: A sub-interval, its integral, the estimated error, and the part of that error
+   due to rounding, which bisecting would not reduce
+*/
+struct interval {
+	double a, b, value, error, roundoff;
+};
+
+/*
+ * @brief: Adds a sub-interval to a max-heap ordered by error
+*/
+static void heap_push(struct interval *heap, size_t *count, struct interval iv){
+	size_t i = (*count)++;
+	while (i > 0 && heap[(i-1)/2].error < iv.error){
+		heap[i] = heap[(i-1)/2];
+		i = (i-1)/2;
+	}
+	heap[i] = iv;
+}
+
+/*
+ * @brief: Removes the sub-interval of largest error from the heap
+*/
+static struct interval heap_pop(struct interval *heap, size_t *count){
+	struct interval top = heap[0], last = heap[--*count];
+	size_t i = 0, n = *count;
+
+	for (size_t c = 1; c < n; c = 2*i+1){
+		if (c+1 < n && heap[c+1].error > heap[c].error)
+			c++;
+		if (heap[c].error <= last.error)
+			break;
+		heap[i] = heap[c];
+		i = c;
+	}
+	if (n > 0)
+		heap[i] = last;
+	return top;
+}
+
+/*
+ * @brief: Evaluates the integrand on n nodes; large batches are split into one slice per
+   OpenMP thread
+*/
+static void evaluate(vector_function f, const double *x, double *y, size_t n){
+#ifdef _OPENMP
+	if (n >= PARALLEL_NODES && omp_get_max_threads() > 1){
+		#pragma omp parallel
+		{
+			size_t threads = omp_get_num_threads(), t = omp_get_thread_num();
+			size_t first = n*t/threads, last = n*(t+1)/threads;
+			f(x+first, y+first, last-first);
+		}
+		return;
+	}
+#endif
+	f(x, y, n);
+}
+
+/*
+ * @brief: Places the nodes of a rule on a sub-interval
+ * @returns: the number of nodes
+*/
+static size_t place_nodes(enum rule r, const struct interval *iv, double *x){
+	double c = 0.5*(iv->a+iv->b), h = 0.5*(iv->b-iv->a);
+
+	if (r == ADAPTIVE_SIMPSON){
+		x[0] = iv->a;
+		x[1] = iv->a + 0.5*h;
+		x[2] = c;
+		x[3] = c + 0.5*h;
+		x[4] = iv->b;
+		return 5;
+	}
+	x[0] = c;
+	for (int j=0; j<7; j++){
+		x[1+2*j] = c - h*xgk[j];
+		x[2+2*j] = c + h*xgk[j];
+	}
+	return 15;
+}
+
+/*
+ * @brief: Integral and error of a sub-interval from the values at its nodes
+ * @description:
+	 - Gauss-Kronrod: the Kronrod sum, and QUADPACK's estimate of its error from the
+	   difference with the Gauss sum, scaled by how much the integrand varies
+	 - Simpson: Richardson extrapolation of Simpson's rule on the halves against the whole
+*/
+static void apply_rule(enum rule r, const double *y, struct interval *iv){
+	double h = 0.5*(iv->b-iv->a);
+
+	iv->roundoff = 0;
+	if (r == ADAPTIVE_SIMPSON){
+		double s1 = h/3*(y[0] + 4*y[2] + y[4]);
+		double s2 = h/6*(y[0] + 4*y[1] + 2*y[2] + 4*y[3] + y[4]);
+		iv->value = s2 + (s2-s1)/15;
+		iv->error = fabs(s2-s1)/15;
+		return;
+	}
+
+	double resk = wgk[7]*y[0], resg = wg[3]*y[0], resabs = fabs(resk);
+	for (int j=0; j<7; j++){
+		double sum = y[1+2*j] + y[2+2*j];
+		resk += wgk[j]*sum;
+		resabs += wgk[j]*(fabs(y[1+2*j]) + fabs(y[2+2*j]));
+		if (j%2 == 1)
+			resg += wg[j/2]*sum;
+	}
+	double mean = 0.5*resk, resasc = wgk[7]*fabs(y[0]-mean);
+	for (int j=0; j<7; j++)
+		resasc += wgk[j]*(fabs(y[1+2*j]-mean) + fabs(y[2+2*j]-mean));
+
+	double error = fabs((resk-resg)*h);
+	resasc *= h;
+	resabs *= h;
+	if (resasc != 0 && error != 0)
+		error = resasc*fmin(1, pow(200*error/resasc, 1.5));
+	if (resabs > DBL_MIN/(50*DBL_EPSILON)){
+		iv->roundoff = 50*DBL_EPSILON*resabs;
+		error = fmax(iv->roundoff, error);
+	}
+	iv->value = resk*h;
+	iv->error = error;
+}
+
+/*
+ * @brief: Globally adaptive integration
+ * @description: The sub-intervals are kept in a heap ordered by their error. Each round
+   bisects the worst of them, as many as would bring the total error under the tolerance
+   if their halves were exact(at most BATCH), and evaluates the nodes of all the halves with
+   one call of the integrand. It stops when the total error is below the tolerance, when the
+   next round would exceed max_evaluations, or when the error left is rounding, which
+   bisecting cannot reduce.
+ * @params:
+	 - f: vectorised integrand
+	 - r: the rule applied to each sub-interval
+	 - a: the lower bound
+	 - b: the upper bound
+	 - abs_tol, rel_tol: the tolerance is max(abs_tol, rel_tol*|integral|)
+	 - max_evaluations: budget of evaluations of the integrand
+ * @returns: the estimate, its error and the work done; value is NAN if memory ran out
+*/
+struct quadrature adaptive_integrate(vector_function f, enum rule r, double a, double b, double abs_tol, double rel_tol, size_t max_evaluations){
+	struct quadrature q = {0};
+	struct interval batch[2*BATCH];
+	size_t nodes = r == ADAPTIVE_SIMPSON ? 5 : 15, count = 0, capacity = 4*BATCH, frozen = 0, k = 1;
+	struct interval *heap = malloc(capacity*sizeof(struct interval));
+	double *x = malloc(2*BATCH*nodes*sizeof(double)), *y = malloc(2*BATCH*nodes*sizeof(double));
+	double sign = 1, frozen_value = 0, frozen_error = 0;  // sub-intervals too narrow to bisect
+
+	if (heap == NULL || x == NULL || y == NULL){
+		q.value = NAN;
+		goto done;
+	}
+	if (a > b){
+		double t = a;
+		a = b;
+		b = t;
+		sign = -1;
+	}
+	// 5 nodes on the whole interval may miss its features entirely and agree by chance
+	if (r == ADAPTIVE_SIMPSON){
+		k = SIMPSON_START;
+		for (size_t i=0; i<k; i++)
+			batch[i] = (struct interval){a + (b-a)*i/k, i+1 == k ? b : a + (b-a)*(i+1)/k, 0, 0, 0};
+	} else
+		batch[0] = (struct interval){a, b, 0, 0, 0};
+
+	for (;;){
+		for (size_t i=0; i<k; i++)
+			place_nodes(r, &batch[i], x + i*nodes);
+		evaluate(f, x, y, k*nodes);
+		q.evaluations += k*nodes;
+
+		if (count + k > capacity){
+			struct interval *grown = realloc(heap, 2*(count+k)*sizeof(struct interval));
+			if (grown == NULL){
+				q.value = NAN;
+				goto done;
+			}
+			heap = grown;
+			capacity = 2*(count+k);
+		}
+		for (size_t i=0; i<k; i++){
+			apply_rule(r, y + i*nodes, &batch[i]);
+			heap_push(heap, &count, batch[i]);
+		}
+
+		double value = frozen_value, error = frozen_error;
+		for (size_t i=0; i<count; i++){
+			value += heap[i].value;
+			error += heap[i].error;
+		}
+		double tolerance = fmax(abs_tol, rel_tol*fabs(value));
+		q.value = sign*value;
+		q.error = error;
+		q.intervals = count + frozen;
+		if (error <= tolerance){
+			q.converged = 1;
+			break;
+		}
+
+		// the worst sub-intervals, until the others would meet the tolerance
+		double left = error;
+		k = 0;
+		while (count > 0 && k < 2*BATCH && left > 0.5*tolerance && q.evaluations + (k+2)*nodes <= max_evaluations){
+			struct interval worst = heap_pop(heap, &count);
+			double mid = 0.5*(worst.a + worst.b);
+			left -= worst.error;
+			if (!(worst.a < mid && mid < worst.b) || worst.error <= worst.roundoff){
+				frozen_value += worst.value;
+				frozen_error += worst.error;
+				frozen++;
+				continue;
+			}
+			batch[k++] = (struct interval){worst.a, mid, 0, 0, 0};
+			batch[k++] = (struct interval){mid, worst.b, 0, 0, 0};
+		}
+		if (k == 0)
+			break;
+	}
+
+done:
+	free(heap);
+	free(x);
+	free(y);
+	return q;
+}
@@ -0,0 +1,380 @@
+/**
+ * \file
+ * \authors [Krishna Vedala](https://github.com/kvedala)
+ * \brief Solve first order [ordinary differential equations
+ * (ODEs)](https://en.wikipedia.org/wiki/Ordinary_differential_equation) with
+ * the adaptive [Dormand-Prince
+ * method](https://en.wikipedia.org/wiki/Dormand%E2%80%93Prince_method) of
+ * ode_solver.h, and compare it with the Euler methods.
+ *
+ * \details
+ * The first ODE is the one of the Euler programs:
+ * \f{eqnarray*}{
+ * \dot{u} &=& v\\
+ * \dot{v} &=& -\omega^2 u\\
+ * \omega &=& 1\\
+ * [x_0, u_0, v_0] &=& [0,1,0]\qquad\ldots\text{(initial values)}
+ * \f}
+ * with the exact solution \f$u(x)=\cos(x)\f$, \f$v(x)=-\sin(x)\f$. The
+ * benchmark gives the error at \f$x=10\f$ and the time of each method for a
+ * range of step sizes and tolerances.
+ *
+ * The second is a batch of [Van der Pol
+ * oscillators](https://en.wikipedia.org/wiki/Van_der_Pol_oscillator), each
+ * with its own \f$\mu\f$, integrated one at a time and all at once.
+ *
+ * The result of the Dormand-Prince method for the first ODE is stored every
+ * 0.01 to a text file `dormand_prince.csv`.
+ * \see ode_forward_euler.c, ode_midpoint_euler.c, ode_semi_implicit_euler.c
+ */
+
+#include <assert.h>  /// for assert
+#include <math.h>    /// for cos, sin, fabs
+#include <stdio.h>   /// for printf, fopen, tmpfile
+#include <stdlib.h>  /// for malloc, atoi
+#include <time.h>    /// for clock
+
+#include "ode_solver.h"  /// for ode_integrate, ode_batch_dormand_prince
+
+/**
+ * @brief Harmonic oscillator \f$\ddot{u}=-\omega^2u\f$
+ * @param[in] 	x	independent variable
+ * @param[in] 	y	\f$[u, v]\f$
+ * @param[out] 	dy	\f$[\dot{u}, \dot{v}]\f$
+ * @param[in] 	ctx	pointer to \f$\omega\f$
+ */
+static void oscillator(double x, const double *y, double *dy, void *ctx)
+{
+    const double omega = *(const double *)ctx;
+    (void)x;
+    dy[0] = y[1];
+    dy[1] = -omega * omega * y[0];
+}
+
+/**
+ * @brief Van der Pol oscillator
+ * \f$\ddot{u}=\mu\left(1-u^2\right)\dot{u}-u\f$
+ * @param[in] 	x	independent variable
+ * @param[in] 	y	\f$[u, v]\f$
+ * @param[out] 	dy	\f$[\dot{u}, \dot{v}]\f$
+ * @param[in] 	ctx	pointer to \f$\mu\f$
+ */
+static void van_der_pol(double x, const double *y, double *dy, void *ctx)
+{
+    const double mu = *(const double *)ctx;
+    (void)x;
+    dy[0] = y[1];
+    dy[1] = mu * (1 - y[0] * y[0]) * y[1] - y[0];
+}
+
+/**
+ * @brief Van der Pol oscillators of a batch, system `first + i` with
+ * \f$\mu\f$ `((double *)ctx)[first + i]`
+ */
+static void van_der_pol_batch(const double *x, const double *y, double *dy,
+                              size_t n, size_t first, void *ctx)
+{
+    const double *restrict mu = (const double *)ctx + first;
+    const double *restrict u = y, *restrict v = y + n;
+    double *restrict du = dy, *restrict dv = dy + n;
+    (void)x;
+
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for (size_t i = 0; i < n; i++)
+    {
+        du[i] = v[i];
+        dv[i] = mu[i] * (1 - u[i] * u[i]) * v[i] - u[i];
+    }
+}
+
+/**
+ * @brief \f$\dot{y}=y\f$ up to \f$x=1\f$ and undefined (NaN) past it, for
+ * `n` systems of a batch
+ */
+static void undefined_batch(const double *x, const double *y, double *dy,
+                            size_t n, size_t first, void *ctx)
+{
+    (void)first;
+    (void)ctx;
+    for (size_t i = 0; i < n; i++) dy[i] = x[i] < 1 ? y[i] : NAN;
+}
+
+/** @brief ::undefined_batch for one system */
+static void undefined(double x, const double *y, double *dy, void *ctx)
+{
+    undefined_batch(&x, y, dy, 1, 0, ctx);
+}
+
+/** names of the methods of ::ode_method */
+static const char *method_names[] = {"forward Euler", "midpoint Euler",
+                                     "semi-implicit Euler", "Dormand-Prince"};
+
+/** wall clock time in seconds */
+static double now(void)
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/**
+ * error at \f$x=10\f$ of the oscillator integrated with `opt`
+ * @param[in] 	opt	method and its parameters
+ * @param[out] 	st	work done
+ */
+static double oscillator_error(const struct ode_options *opt,
+                               struct ode_stats *st)
+{
+    double omega = 1, y[2] = {1, 0};
+    struct ode_system sys = {2, oscillator, &omega};
+
+    if (ode_integrate(&sys, opt, 0, 10, y, NULL, st) < 0)
+        return INFINITY;
+    return fmax(fabs(y[0] - cos(10.)), fabs(y[1] + sin(10.)));
+}
+
+/**
+ * Self-test: orders of the Euler methods, accuracy of the Dormand-Prince
+ * method, batch against one at a time, and the decimated output
+ * \returns void
+ */
+static void test(void)
+{
+    struct ode_options opt = {ODE_FORWARD_EULER, 1e-3, 0, 0, 0};
+    struct ode_stats st;
+
+    // halving the step divides the error by 2 at first order, 4 at second
+    const double ratio[] = {2, 4, 2};
+    for (int m = ODE_FORWARD_EULER; m <= ODE_SEMI_IMPLICIT_EULER; m++)
+    {
+        opt.method = (enum ode_method)m;
+        opt.dx = 1e-3;
+        double e1 = oscillator_error(&opt, &st);
+        assert(st.steps == 10000);
+        opt.dx = 5e-4;
+        double e2 = oscillator_error(&opt, &st);
+        assert(fabs(e1 / e2 / ratio[m] - 1) < 0.1);
+    }
+
+    // the error follows the tolerance, with much fewer evaluations
+    opt.method = ODE_DORMAND_PRINCE;
+    opt.dx = 0;
+    for (double tol = 1e-4; tol >= 1e-10; tol /= 100)
+    {
+        opt.rtol = opt.atol = tol;
+        assert(oscillator_error(&opt, &st) < 100 * tol);
+        assert(st.evals == 6 * (st.steps + st.rejected) + 1);
+    }
+    assert(st.steps < 1000);
+    opt.max_steps = 10;
+    assert(oscillator_error(&opt, &st) == INFINITY && st.steps <= 10);
+    opt.max_steps = 0;
+
+    // a right-hand side that becomes NaN fails the integration instead of
+    // taking steps forever, one system at a time or in a batch
+    struct ode_system undef = {1, undefined, NULL};
+    struct ode_batch undef_batch = {1, undefined_batch, NULL};
+    double yu[3] = {1, 1, 1};
+    int status = ode_integrate(&undef, &opt, 0, 2, yu, NULL, &st);
+    assert(status == -1);
+    status = ode_batch_dormand_prince(&undef_batch, &opt, 0, 2, yu, 3, &st);
+    assert(status == -1);
+
+    // the batch gives the solution of the systems one at a time; not
+    // bit for bit, as the compiler may contract either into FMA differently
+    const size_t n = 3 * ODE_BATCH_BLOCK + 17;
+    double *mu = (double *)malloc(n * sizeof(double));
+    double *y = (double *)malloc(2 * n * sizeof(double));
+    struct ode_batch batch = {2, van_der_pol_batch, mu};
+    assert(mu != NULL && y != NULL);
+    for (size_t i = 0; i < n; i++)
+    {
+        mu[i] = 0.5 + 1.5 * i / n;
+        y[i] = 2;
+        y[n + i] = 0;
+    }
+    opt.rtol = opt.atol = 1e-6;
+    status = ode_batch_dormand_prince(&batch, &opt, 0, 20, y, n, &st);
+    assert(status == 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        double yi[2] = {2, 0};
+        struct ode_system sys = {2, van_der_pol, &mu[i]};
+        status = ode_integrate(&sys, &opt, 0, 20, yi, NULL, NULL);
+        assert(status == 0);
+        assert(fabs(yi[0] - y[i]) <= 1e-3 * opt.rtol * (fabs(yi[0]) + 1));
+        assert(fabs(yi[1] - y[n + i]) <= 1e-3 * opt.rtol * (fabs(yi[1]) + 1));
+    }
+    // max_steps holds for each system of a batch
+    opt.max_steps = 10;
+    status = ode_batch_dormand_prince(&batch, &opt, 0, 20, y, n, &st);
+    assert(status == -1 && st.steps + st.rejected <= 10 * (long)n);
+    opt.max_steps = 0;
+    free(mu);
+    free(y);
+
+    // rows of the steps at least 1 apart, or interpolated every 0.5, and
+    // the last one at x_max
+    for (int m = 0; m < 2; m++)
+    {
+        FILE *fp = tmpfile();
+        struct ode_output out;
+        double omega = 1, yo[2] = {1, 0}, row[3], last = -1;
+        struct ode_system sys = {2, oscillator, &omega};
+        int rows = 0;
+        assert(fp != NULL);
+        ode_output_init(&out, fp, m ? 0.5 : 1);
+        opt.method = m ? ODE_DORMAND_PRINCE : ODE_MIDPOINT_EULER;
+        opt.dx = m ? 0 : 0.001;
+        status = ode_integrate(&sys, &opt, 0, 10.25, yo, &out, NULL);
+        assert(status == 0);
+        rewind(fp);
+        while (fscanf(fp, "%lf,%lf,%lf", &row[0], &row[1], &row[2]) == 3)
+        {
+            assert(m ? row[0] == rows * 0.5 || row[0] == 10.25
+                     : row[0] >= last + 1 || row[0] == 10.25);
+            assert(fabs(row[1] - cos(row[0])) < 1e-4);
+            last = row[0];
+            rows++;
+        }
+        assert(rows == (m ? 22 : 12) && last == 10.25);
+        fclose(fp);
+    }
+    (void)status;
+
+    printf("All tests have successfully passed!\n");
+}
+
+/**
+ * Accuracy and time of each method for the oscillator, cost of the output,
+ * and a batch of Van der Pol oscillators one at a time and all at once
+ * \param[in] n number of Van der Pol oscillators
+ * \returns void
+ */
+static void benchmark(size_t n)
+{
+    struct ode_options opt = {ODE_FORWARD_EULER, 0, 0, 0, 0};
+    struct ode_stats st;
+
+    printf("\n%-20s %8s %10s %10s %10s %10s\n", "method", "dx/tol", "steps",
+           "evals", "error", "time (ms)");
+    for (int m = ODE_FORWARD_EULER; m <= ODE_DORMAND_PRINCE; m++)
+    {
+        opt.method = (enum ode_method)m;
+        for (double p = 1e-2; p > 1e-11; p /= 10)
+        {
+            if (m != ODE_DORMAND_PRINCE && p < 1e-6)
+                break;  // fixed steps this small take too long
+            opt.dx = m == ODE_DORMAND_PRINCE ? 0 : p;
+            opt.rtol = opt.atol = p;
+            double t = now(), error = oscillator_error(&opt, &st);
+            printf("%-20s %8.0e %10ld %10ld %10.2e %10.3f\n", method_names[m],
+                   p, st.steps, st.evals, error, (now() - t) * 1e3);
+        }
+    }
+
+    // rows of every step with fprintf, as the Euler programs do, against
+    // ode_output with rows of every step and of every 0.01
+    double omega = 1, y[2] = {1, 0}, t;
+    struct ode_system sys = {2, oscillator, &omega};
+    struct ode_output out;
+    FILE *fp = tmpfile();
+    if (fp != NULL)
+    {
+        opt.method = ODE_FORWARD_EULER;
+        opt.dx = 1e-5;
+        t = now();
+        double x = 0, dy[2];
+        for (long i = 0; i < 1000000; i++)
+        {
+            fprintf(fp, "%.4g,%.4g,%.4g\n", x, y[0], y[1]);
+            oscillator(x, y, dy, &omega);
+            y[0] += opt.dx * dy[0];
+            y[1] += opt.dx * dy[1];
+            x = (i + 1) * opt.dx;
+        }
+        printf("\n10^6 forward Euler steps, fprintf per step: %8.1f ms\n",
+               (now() - t) * 1e3);
+        for (int d = 0; d < 2; d++)
+        {
+            y[0] = 1;
+            y[1] = 0;
+            rewind(fp);
+            ode_output_init(&out, fp, d ? 0.01 : 0);
+            t = now();
+            ode_integrate(&sys, &opt, 0, 10, y, &out, NULL);
+            printf("10^6 forward Euler steps, rows every %-8g %8.1f ms\n",
+                   out.every, (now() - t) * 1e3);
+        }
+        fclose(fp);
+    }
+
+    // Van der Pol oscillators with mu from 0.5 to 2
+    double *mu = (double *)malloc(n * sizeof(double));
+    double *yb = (double *)malloc(2 * n * sizeof(double));
+    struct ode_batch batch = {2, van_der_pol_batch, mu};
+    if (mu == NULL || yb == NULL)
+    {
+        free(mu);
+        free(yb);
+        return;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        mu[i] = 0.5 + 1.5 * i / n;
+        yb[i] = 2;
+        yb[n + i] = 0;
+    }
+    opt.method = ODE_DORMAND_PRINCE;
+    opt.dx = 0;
+    opt.rtol = opt.atol = 1e-6;
+
+    t = now();
+    for (size_t i = 0; i < n; i++)
+    {
+        double yi[2] = {2, 0};
+        struct ode_system vdp = {2, van_der_pol, &mu[i]};
+        ode_integrate(&vdp, &opt, 0, 20, yi, NULL, NULL);
+    }
+    printf("\n%zu Van der Pol oscillators, one at a time: %8.1f ms\n", n,
+           (now() - t) * 1e3);
+    t = now();
+    ode_batch_dormand_prince(&batch, &opt, 0, 20, yb, n, &st);
+    printf("%zu Van der Pol oscillators, batch:         %8.1f ms"
+           " (%ld steps, %ld rejected)\n",
+           n, (now() - t) * 1e3, st.steps, st.rejected);
+
+    free(mu);
+    free(yb);
+}
+
+/**
+    Main Function
+*/
+int main(int argc, char *argv[])
+{
+    double omega = 1, y[2] = {1, 0};
+    struct ode_system sys = {2, oscillator, &omega};
+    struct ode_options opt = {ODE_DORMAND_PRINCE, 0, 1e-8, 1e-8, 0};
+    struct ode_output out;
+
+    test();
+    benchmark(argc > 1 ? (size_t)atoi(argv[1]) : 10000);
+
+    FILE *fp = fopen("dormand_prince.csv", "w+");
+    if (fp == NULL)
+    {
+        perror("Error! ");
+        return -1;
+    }
+    ode_output_init(&out, fp, 0.01);
+    if (ode_integrate(&sys, &opt, 0, 10, y, &out, NULL) < 0)
+        perror("Error! ");
+    fclose(fp);
+
+    return 0;
+}
@@ -0,0 +1,611 @@
+/**
+ * @file
+ * \brief Library functions to integrate systems of first order [ordinary
+ * differential equations](https://en.wikipedia.org/wiki/Ordinary_differential_equation)
+ * with the Euler methods of ode_forward_euler.c, ode_midpoint_euler.c and
+ * ode_semi_implicit_euler.c or with the adaptive [Dormand-Prince
+ * method](https://en.wikipedia.org/wiki/Dormand%E2%80%93Prince_method)
+ * (RK45).
+ *
+ * \details
+ * Unlike the Euler programs, the system is not a compile time `order` and a
+ * global `problem()`: a struct ode_system holds its order, its right-hand
+ * side and a context pointer for its parameters, so one program integrates
+ * many different systems.
+ *
+ * The results go through a struct ode_output that keeps at most one row per
+ * `every` of the independent variable, so that formatting them does not
+ * take longer than the integration with small steps.
+ *
+ * ode_batch_dormand_prince() integrates many independent systems with the
+ * same equations at once. Their values are stored as a structure of arrays,
+ * component `o` of system `i` at `y[o * n + i]`, so that the right-hand side
+ * and each stage of the method are loops over the systems that the compiler
+ * vectorizes. Every system keeps its own step size.
+ * \author [Krishna Vedala](https://github.com/kvedala)
+ */
+
+#ifndef ODE_SOLVER_H
+#define ODE_SOLVER_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/** systems of a batch integrated together, small enough to stay in cache */
+#define ODE_BATCH_BLOCK 256
+
+/**
+ * right-hand side \f$\dot{y}=f(x,y)\f$ of a system
+ * @param[in] 	x	independent variable
+ * @param[in] 	y	dependent variables
+ * @param[out]	dy	first derivatives of the dependent variables
+ * @param[in] 	ctx	parameters of the system
+ */
+typedef void (*ode_func)(double x, const double *y, double *dy, void *ctx);
+
+/**
+ * right-hand side of `n` systems of a batch, stored as a structure of
+ * arrays: `x[i]` and `y[o * n + i]` are the variables of system `first + i`
+ * of the batch, and `dy[o * n + i]` receives the derivative of
+ * `y[o * n + i]`; `first` locates the parameters of each system in `ctx`
+ */
+typedef void (*ode_batch_func)(const double *x, const double *y, double *dy,
+                               size_t n, size_t first, void *ctx);
+
+/** a system of first order ODEs */
+struct ode_system
+{
+    int order;   /**< number of dependent variables */
+    ode_func f;  /**< right-hand side */
+    void *ctx;   /**< parameters passed to ::f */
+};
+
+/** a batch of systems with the same equations */
+struct ode_batch
+{
+    int order;         /**< number of dependent variables of each system */
+    ode_batch_func f;  /**< right-hand side of a batch */
+    void *ctx;         /**< parameters passed to ::f */
+};
+
+/** integration methods */
+enum ode_method
+{
+    ODE_FORWARD_EULER,        /**< fixed step, first order */
+    ODE_MIDPOINT_EULER,       /**< fixed step, second order */
+    ODE_SEMI_IMPLICIT_EULER,  /**< fixed step, first order, symplectic */
+    ODE_DORMAND_PRINCE        /**< adaptive step, fifth order */
+};
+
+/** parameters of an integration */
+struct ode_options
+{
+    enum ode_method method; /**< integration method */
+    double dx;        /**< step size, or first step of ::ODE_DORMAND_PRINCE
+                           (0 to choose it) */
+    double rtol;      /**< relative tolerance of ::ODE_DORMAND_PRINCE */
+    double atol;      /**< absolute tolerance of ::ODE_DORMAND_PRINCE */
+    long max_steps;   /**< steps before giving up, 0 for no limit */
+};
+
+/** work done by an integration */
+struct ode_stats
+{
+    long steps;     /**< accepted steps */
+    long rejected;  /**< steps rejected by the error control */
+    long evals;     /**< evaluations of the right-hand side */
+};
+
+/** decimated writer of the rows `x,y[0],y[1],...` */
+struct ode_output
+{
+    FILE *fp;      /**< destination */
+    double every;  /**< least distance in x between rows, 0 for every step */
+    double first;  /**< x of the first row */
+    double next;   /**< x from which the next row is kept */
+    double last;   /**< x of the last row */
+    long rows;     /**< rows written */
+};
+
+/**
+ * prepares an output
+ * @param[out] 	out	output
+ * @param[in] 	fp	destination
+ * @param[in] 	every	least distance in x between two rows, 0 for all rows
+ */
+void ode_output_init(struct ode_output *out, FILE *fp, double every)
+{
+    out->fp = fp;
+    out->every = every;
+    out->first = out->next = out->last = -INFINITY;
+    out->rows = 0;
+}
+
+/**
+ * adds the row of the state `x, y`
+ * \returns 0 on success, -1 if a write failed
+ */
+int ode_output_write(struct ode_output *out, double x, const double *y,
+                     int order)
+{
+    if (out->rows++ == 0)
+        out->first = x;
+    // rows on a grid from the first, without drift from adding every
+    out->next = out->first + out->rows * out->every;
+    out->last = x;
+    if (fprintf(out->fp, "%.10g", x) < 0)
+        return -1;
+    for (int o = 0; o < order; o++)
+        if (fprintf(out->fp, ",%.10g", y[o]) < 0)
+            return -1;
+    return putc('\n', out->fp) == EOF ? -1 : 0;
+}
+
+/**
+ * adds the row of the state `x, y` if it is `every` past the last one
+ * \returns 0 on success, -1 if a write failed
+ */
+int ode_output_row(struct ode_output *out, double x, const double *y,
+                   int order)
+{
+    return x < out->next ? 0 : ode_output_write(out, x, y, order);
+}
+
+/**
+ * @brief Compute next step approximation using the forward-Euler method.
+ * @f[y_{n+1}=y_n + dx\cdot f\left(x_n,y_n\right)@f]
+ * \returns evaluations of the right-hand side
+ */
+static int ode_forward_euler_step(const struct ode_system *sys, double dx,
+                                  double x, double *y, double *work)
+{
+    sys->f(x, y, work, sys->ctx);
+    for (int o = 0; o < sys->order; o++) y[o] += dx * work[o];
+    return 1;
+}
+
+/**
+ * @brief Compute next step approximation using the midpoint-Euler method.
+ * @f[y_{n+1} = y_n + dx\, f\left(x_n+\frac{1}{2}dx,
+ * y_n + \frac{1}{2}dx\,f\left(x_n,y_n\right)\right)@f]
+ * \returns evaluations of the right-hand side
+ */
+static int ode_midpoint_euler_step(const struct ode_system *sys, double dx,
+                                   double x, double *y, double *work)
+{
+    double *dy = work, *tmp = work + sys->order;
+
+    sys->f(x, y, dy, sys->ctx);
+    for (int o = 0; o < sys->order; o++) tmp[o] = y[o] + 0.5 * dx * dy[o];
+    sys->f(x + 0.5 * dx, tmp, dy, sys->ctx);
+    for (int o = 0; o < sys->order; o++) y[o] += dx * dy[o];
+    return 2;
+}
+
+/**
+ * @brief Compute next step approximation using the semi-implicit-Euler
+ * method: the first variable moves first, and the others move with the
+ * derivatives at its new value.
+ * \returns evaluations of the right-hand side
+ */
+static int ode_semi_implicit_euler_step(const struct ode_system *sys,
+                                        double dx, double x, double *y,
+                                        double *work)
+{
+    sys->f(x, y, work, sys->ctx);
+    y[0] += dx * work[0];
+    sys->f(x, y, work, sys->ctx);
+    for (int o = 1; o < sys->order; o++) y[o] += dx * work[o];
+    return 2;
+}
+
+/** nodes of the Dormand-Prince method */
+static const double ode_dp_c[7] = {0, 1. / 5, 3. / 10, 4. / 5, 8. / 9, 1, 1};
+/** coefficients of the stages of the Dormand-Prince method */
+static const double ode_dp_a[7][6] = {
+    {0},
+    {1. / 5},
+    {3. / 40, 9. / 40},
+    {44. / 45, -56. / 15, 32. / 9},
+    {19372. / 6561, -25360. / 2187, 64448. / 6561, -212. / 729},
+    {9017. / 3168, -355. / 33, 46732. / 5247, 49. / 176, -5103. / 18656},
+    {35. / 384, 0, 500. / 1113, 125. / 192, -2187. / 6784, 11. / 84}};
+/**
+ * difference of the weights of the fifth and fourth order solutions; those
+ * of the fifth order are the last stage, so its derivative starts the next
+ * step (first same as last)
+ */
+static const double ode_dp_e[7] = {71. / 57600,      0,           -71. / 16695,
+                                   71. / 1920,       -17253. / 339200,
+                                   22. / 525,        -1. / 40};
+
+/**
+ * step size factor for the error `err` of a step (1 is the tolerance); a NaN
+ * error, from a right-hand side that is not defined there, shrinks the step
+ * as much as a large one
+ */
+static double ode_dp_factor(double err)
+{
+    if (isnan(err))
+        return 0.2;
+    double factor = err > 0 ? 0.9 * pow(err, -0.2) : 5;
+    return factor < 0.2 ? 0.2 : factor > 5 ? 5 : factor;
+}
+
+/**
+ * first step of the Dormand-Prince method when none is given, after Hairer,
+ * Norsett and Wanner: 1% of the step that changes `y` by its own size
+ * @param[in] 	opt	tolerances
+ * @param[in] 	y	initial values, `order` of them `stride` apart
+ * @param[in] 	dy	initial derivatives, with the same layout
+ */
+static double ode_dp_first_step(const struct ode_options *opt,
+                                const double *y, const double *dy, int order,
+                                size_t stride)
+{
+    double d0 = 0, d1 = 0;
+    for (int o = 0; o < order; o++)
+    {
+        double scale = opt->atol + opt->rtol * fabs(y[o * stride]);
+        d0 += (y[o * stride] / scale) * (y[o * stride] / scale);
+        d1 += (dy[o * stride] / scale) * (dy[o * stride] / scale);
+    }
+    return d0 < 1e-10 || d1 < 1e-10 ? 1e-6 : 0.01 * sqrt(d0 / d1);
+}
+
+/**
+ * writes the rows due in the step from `x` to `x + h`, interpolated with the
+ * cubic Hermite polynomial of the values and derivatives at both ends
+ * @param[in,out] 	out	output
+ * @param[in] 	x	start of the step
+ * @param[in] 	h	step size
+ * @param[in] 	y0	values at `x`
+ * @param[in] 	f0	derivatives at `x`
+ * @param[in] 	y1	values at `x + h`
+ * @param[in] 	f1	derivatives at `x + h`
+ * @param[out] 	tmp	space for `order` values
+ * @param[in] 	order	number of dependent variables
+ * \returns 0 on success, -1 if a write failed
+ */
+static int ode_dp_dense_output(struct ode_output *out, double x, double h,
+                               const double *y0, const double *f0,
+                               const double *y1, const double *f1,
+                               double *tmp, int order)
+{
+    while (out->next <= x + h)
+    {
+        double t = (out->next - x) / h, t2 = t * t, t3 = t2 * t;
+        for (int o = 0; o < order; o++)
+            tmp[o] = (2 * t3 - 3 * t2 + 1) * y0[o] +
+                     (t3 - 2 * t2 + t) * h * f0[o] +
+                     (3 * t2 - 2 * t3) * y1[o] + (t3 - t2) * h * f1[o];
+        if (ode_output_write(out, out->next, tmp, order) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Compute approximation using the given method in the given limits.
+ *
+ * Fixed step methods shorten the last step to end at `x_max`, and write
+ * the rows of the steps. ::ODE_DORMAND_PRINCE takes steps of a fifth order
+ * solution and adapts their size so that the RMS of the error of the
+ * embedded fourth order solution, relative to `atol + rtol |y|`, stays below
+ * 1; its steps are long, so with an `every` it writes the rows at
+ * `x0 + k every` interpolated in the steps instead.
+ * @param[in] 		sys	system to solve
+ * @param[in] 		opt	method and its parameters
+ * @param[in] 		x0	initial value of independent variable
+ * @param[in] 		x_max	final value of independent variable
+ * @param[in,out] 	y	take \f$y(x_0)\f$ and compute \f$y(x_{max})\f$
+ * @param[out] 		out	rows of the solution, NULL for none
+ * @param[out] 		stats	work done, NULL if not needed
+ * \returns 0 on success, -1 if out of memory, if the step size became too
+ * small or `max_steps` was reached, or if a write failed
+ */
+int ode_integrate(const struct ode_system *sys, const struct ode_options *opt,
+                  double x0, double x_max, double *y, struct ode_output *out,
+                  struct ode_stats *stats)
+{
+    const int order = sys->order;
+    struct ode_stats st = {0, 0, 0};
+    double *work = (double *)malloc(9 * order * sizeof(double));
+    double x = x0, dx = opt->dx;
+    int ret = 0;
+
+    if (work == NULL)
+        return -1;
+    if (out != NULL)
+        ret = ode_output_row(out, x, y, order);
+
+    if (opt->method != ODE_DORMAND_PRINCE)
+    {
+        for (long i = 1; ret == 0 && x < x_max; i++)
+        {
+            double next = x0 + i * dx;  // no drift from adding dx
+            double h = next < x_max ? next - x : x_max - x;
+
+            if (opt->max_steps > 0 && st.steps == opt->max_steps)
+            {
+                ret = -1;
+                break;
+            }
+            if (opt->method == ODE_FORWARD_EULER)
+                st.evals += ode_forward_euler_step(sys, h, x, y, work);
+            else if (opt->method == ODE_MIDPOINT_EULER)
+                st.evals += ode_midpoint_euler_step(sys, h, x, y, work);
+            else
+                st.evals += ode_semi_implicit_euler_step(sys, h, x, y, work);
+            x = next < x_max ? next : x_max;
+            st.steps++;
+            if (out != NULL)
+                ret = ode_output_row(out, x, y, order);
+        }
+    }
+    else
+    {
+        double *k[7], *tmp = work + 7 * order, *y5 = work + 8 * order;
+        for (int s = 0; s < 7; s++) k[s] = work + s * order;
+
+        sys->f(x, y, k[0], sys->ctx);
+        st.evals++;
+        if (dx <= 0)
+            dx = ode_dp_first_step(opt, y, k[0], order, 1);
+
+        while (ret == 0 && x < x_max)
+        {
+            double h = dx < x_max - x ? dx : x_max - x, err = 0;
+
+            if (opt->max_steps > 0 && st.steps + st.rejected == opt->max_steps)
+            {
+                ret = -1;
+                break;
+            }
+            for (int s = 1; s < 7; s++)
+            {
+                for (int o = 0; o < order; o++)
+                {
+                    double sum = 0;
+                    for (int j = 0; j < s; j++) sum += ode_dp_a[s][j] * k[j][o];
+                    tmp[o] = y[o] + h * sum;
+                }
+                sys->f(x + ode_dp_c[s] * h, tmp, k[s], sys->ctx);
+            }
+            st.evals += 6;
+            memcpy(y5, tmp, order * sizeof(double));
+
+            for (int o = 0; o < order; o++)
+            {
+                double e = 0, scale;
+                for (int s = 0; s < 7; s++) e += ode_dp_e[s] * k[s][o];
+                scale = opt->atol +
+                        opt->rtol * fmax(fabs(y[o]), fabs(y5[o]));
+                err += (h * e / scale) * (h * e / scale);
+            }
+            err = sqrt(err / order);
+
+            if (err <= 1)
+            {
+                if (out != NULL && out->every > 0)
+                    ret = ode_dp_dense_output(out, x, h, y, k[0], y5, k[6],
+                                              tmp, order);
+                x = h < x_max - x ? x + h : x_max;
+                memcpy(y, y5, order * sizeof(double));
+                memcpy(k[0], k[6], order * sizeof(double));
+                st.steps++;
+                dx = h * ode_dp_factor(err);
+                if (out != NULL && out->every == 0 && ret == 0)
+                    ret = ode_output_row(out, x, y, order);
+            }
+            else
+            {
+                st.rejected++;
+                dx = h * fmin(ode_dp_factor(err), 1);
+            }
+            // cannot resolve the solution
+            if (x < x_max && dx < 1e-12 * fmax(fabs(x), 1))
+                ret = -1;
+        }
+    }
+
+    if (out != NULL && ret == 0 && out->last < x)
+        ret = ode_output_write(out, x, y, order);  // always end at x_max
+    if (out != NULL && ret == 0 && fflush(out->fp) == EOF)
+        ret = -1;
+    if (stats != NULL)
+        *stats = st;
+    free(work);
+    return ret;
+}
+
+/**
+ * Dormand-Prince integration of `n <= ::ODE_BATCH_BLOCK` systems from
+ * `first` stored with stride `n`; the work arrays hold 9 times `y`
+ * \returns 0 on success, -1 if the step size of a system became too small
+ * or a system reached `max_steps`
+ */
+static int ode_batch_block(const struct ode_batch *sys,
+                           const struct ode_options *opt, double x0,
+                           double x_max, double *y, size_t n, size_t first,
+                           double *work, struct ode_stats *st)
+{
+    const size_t len = sys->order * n;
+    double *k[7], *tmp = work + 7 * len, *y5 = work + 8 * len;
+    double x[ODE_BATCH_BLOCK] = {0}, h[ODE_BATCH_BLOCK], dx[ODE_BATCH_BLOCK];
+    double err[ODE_BATCH_BLOCK], xs[ODE_BATCH_BLOCK];
+    long taken[ODE_BATCH_BLOCK] = {0};  // steps tried by each system
+    size_t active = n;
+    int ret = 0;
+
+    for (int s = 0; s < 7; s++) k[s] = work + s * len;
+    for (size_t i = 0; i < n; i++) x[i] = x0;
+    sys->f(x, y, k[0], n, first, sys->ctx);
+    st->evals += n;
+    for (size_t i = 0; i < n; i++)
+        dx[i] = opt->dx > 0 ? opt->dx
+                            : ode_dp_first_step(opt, y + i, k[0] + i,
+                                                sys->order, n);
+
+    while (active > 0)
+    {
+        // systems that have reached x_max take steps of 0 and do not move
+        for (size_t i = 0; i < n; i++)
+        {
+            h[i] = dx[i] < x_max - x[i] ? dx[i] : x_max - x[i];
+            err[i] = 0;
+        }
+
+        for (int s = 1; s < 7; s++)
+        {
+            for (size_t i = 0; i < n; i++) xs[i] = x[i] + ode_dp_c[s] * h[i];
+            for (size_t o = 0; o < len; o += n)
+            {
+                const double *restrict yo = y + o;
+                double *restrict to = tmp + o;
+                for (size_t i = 0; i < n; i++) to[i] = 0;
+                for (int j = 0; j < s; j++)
+                {
+                    const double a = ode_dp_a[s][j];
+                    const double *restrict kj = k[j] + o;
+                    if (a == 0)
+                        continue;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+                    for (size_t i = 0; i < n; i++) to[i] += a * kj[i];
+                }
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+                for (size_t i = 0; i < n; i++) to[i] = yo[i] + h[i] * to[i];
+            }
+            sys->f(xs, tmp, k[s], n, first, sys->ctx);
+        }
+        st->evals += 6 * active;
+        memcpy(y5, tmp, len * sizeof(double));
+
+        for (size_t o = 0; o < len; o += n)
+        {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+            for (size_t i = 0; i < n; i++)
+            {
+                double e = 0, scale, r;
+                for (int s = 0; s < 7; s++) e += ode_dp_e[s] * k[s][o + i];
+                scale = opt->atol +
+                        opt->rtol * fmax(fabs(y[o + i]), fabs(y5[o + i]));
+                r = h[i] * e / scale;
+                err[i] += r * r;
+            }
+        }
+
+        active = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (x[i] >= x_max)
+                continue;
+            double e = sqrt(err[i] / sys->order);
+            if (e <= 1)
+            {
+                x[i] = h[i] < x_max - x[i] ? x[i] + h[i] : x_max;
+                for (size_t o = 0; o < len; o += n)
+                {
+                    y[o + i] = y5[o + i];
+                    k[0][o + i] = k[6][o + i];
+                }
+                st->steps++;
+                dx[i] = h[i] * ode_dp_factor(e);
+            }
+            else
+            {
+                st->rejected++;
+                dx[i] = h[i] * fmin(ode_dp_factor(e), 1);
+            }
+            if (x[i] < x_max && (dx[i] < 1e-12 * fmax(fabs(x[i]), 1) ||
+                                 ++taken[i] == opt->max_steps))
+            {
+                ret = -1;
+                x[i] = x_max;  // give up on this system only
+            }
+            active += x[i] < x_max;
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief Integrate `n` systems with the same equations from `x0` to `x_max`
+ * with the Dormand-Prince method, each with its own step size.
+ *
+ * The systems are integrated in blocks of ::ODE_BATCH_BLOCK, in parallel
+ * with OpenMP. A right-hand side evaluation covers the whole block, with the
+ * systems that are done or have rejected their step along.
+ * @param[in] 		sys	equations of the systems
+ * @param[in] 		opt	`dx` (first step, 0 to choose), `rtol`, `atol` and
+ *			`max_steps`, counted for each system
+ * @param[in] 		x0	initial value of independent variable
+ * @param[in] 		x_max	final value of independent variable
+ * @param[in,out] 	y	initial values, then values at `x_max`;
+ *			component `o` of system `i` is `y[o * n + i]`
+ * @param[in] 		n	number of systems
+ * @param[out] 		stats	work done, summed over the systems, or NULL
+ * \returns 0 on success, -1 if out of memory, or if the step size of a
+ * system became too small or a system reached `max_steps`
+ */
+int ode_batch_dormand_prince(const struct ode_batch *sys,
+                             const struct ode_options *opt, double x0,
+                             double x_max, double *y, size_t n,
+                             struct ode_stats *stats)
+{
+    const size_t blocks = (n + ODE_BATCH_BLOCK - 1) / ODE_BATCH_BLOCK;
+    long steps = 0, rejected = 0, evals = 0;
+    int failed = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) \
+    reduction(+ : steps, rejected, evals) reduction(| : failed)
+#endif
+    for (size_t b = 0; b < blocks; b++)
+    {
+        size_t first = b * ODE_BATCH_BLOCK;
+        size_t m = n - first < ODE_BATCH_BLOCK ? n - first : ODE_BATCH_BLOCK;
+        size_t len = sys->order * m;
+        double *work = (double *)malloc(10 * len * sizeof(double));
+        double *block = work + 9 * len;
+        struct ode_stats st = {0, 0, 0};
+
+        if (work == NULL)
+        {
+            failed = 1;
+            continue;
+        }
+        // copy the block to stride m so the systems are contiguous
+        for (int o = 0; o < sys->order; o++)
+            memcpy(block + o * m, y + o * n + first, m * sizeof(double));
+        if (ode_batch_block(sys, opt, x0, x_max, block, m, first, work, &st))
+            failed = 1;
+        for (int o = 0; o < sys->order; o++)
+            memcpy(y + o * n + first, block + o * m, m * sizeof(double));
+        steps += st.steps;
+        rejected += st.rejected;
+        evals += st.evals;
+        free(work);
+    }
+
+    if (stats != NULL)
+    {
+        stats->steps = steps;
+        stats->rejected = rejected;
+        stats->evals = evals;
+    }
+    return failed ? -1 : 0;
+}
+
+#endif  // ODE_SOLVER_H
@@ -0,0 +1,410 @@
+/**
+ * @file
+ * \brief Library functions to compute all the roots of many polynomials
+ * with the [Durand-Kerner
+ * method](https://en.wikipedia.org/wiki/Durand%E2%80%93Kerner_method) of
+ * durand_kerner_roots.c or with the [Aberth-Ehrlich
+ * method](https://en.wikipedia.org/wiki/Aberth_method).
+ *
+ * \details
+ * A polynomial of degree \f$n\f$ is given by its \f$n+1\f$ real
+ * coefficients, highest power first, as on the command line of
+ * durand_kerner_roots.c. All its roots are refined together: the
+ * Durand-Kerner correction of root \f$z_k\f$ is
+ * \f$p(z_k)/\prod_{j\ne k}(z_k-z_j)\f$, the Aberth-Ehrlich correction is
+ * \f[w_k=\frac{N_k}{1-N_k\sum_{j\ne k}\frac{1}{z_k-z_j}},\qquad
+ * N_k=\frac{p(z_k)}{p'(z_k)}\f]
+ * which converges cubically instead of quadratically, in fewer iterations.
+ *
+ * \f$p\f$ and \f$p'\f$ are evaluated together by Horner's scheme, for all
+ * the roots at once: the loop over the coefficients is outside, and the
+ * loop over the roots inside works on separate arrays of real and imaginary
+ * parts, so that the compiler vectorizes it over the roots. A root stops
+ * when its correction is below the tolerance, or when \f$|p(z_k)|\f$ is
+ * below the rounding error of its evaluation; the roots still moving are
+ * kept first in these arrays, so that each iteration only computes them.
+ *
+ * poly_roots_batch() solves many polynomials of the same degree, in
+ * parallel with OpenMP.
+ */
+
+#ifndef POLYNOMIAL_ROOTS_H
+#define POLYNOMIAL_ROOTS_H
+
+#include <complex.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/** root finding methods */
+enum poly_method
+{
+    POLY_DURAND_KERNER,  /**< quadratic convergence */
+    POLY_ABERTH          /**< cubic convergence */
+};
+
+/** parameters of a root finding */
+struct poly_options
+{
+    enum poly_method method; /**< root finding method */
+    double tol;     /**< relative size of the last correction of a root */
+    int max_iter;   /**< iterations before giving up */
+    FILE *log;      /**< if not NULL, receives the roots and the largest
+                         correction of every iteration, as CSV */
+};
+
+/** working arrays of a polynomial of degree `n` */
+struct poly_work
+{
+    double *a, *abs_a;  /**< monic coefficients, and their moduli */
+    double *zr, *zi;    /**< roots: the `active` first ones still move */
+    double *pr, *pi;    /**< \f$p(z_k)\f$ */
+    double *dr, *di;    /**< \f$p'(z_k)\f$ */
+    double *wr, *wi;    /**< corrections */
+    double *e;          /**< bound of the rounding error of \f$p(z_k)\f$ */
+    double *az;         /**< \f$|z_k|\f$ */
+    int *slot;          /**< index in the output of each root */
+};
+
+/**
+ * allocates the working arrays of a polynomial of degree `n`
+ * \returns 0 on success, -1 if out of memory
+ */
+static int poly_work_init(struct poly_work *w, int n)
+{
+    double *all = (double *)malloc((2 * (n + 1) + 12 * n) * sizeof(double));
+    w->slot = (int *)malloc(n * sizeof(int));
+    if (all == NULL || w->slot == NULL)
+    {
+        free(all);
+        free(w->slot);
+        return -1;
+    }
+    w->a = all;
+    w->abs_a = w->a + n + 1;
+    w->zr = w->abs_a + n + 1;
+    w->zi = w->zr + n;
+    w->pr = w->zi + n;
+    w->pi = w->pr + n;
+    w->dr = w->pi + n;
+    w->di = w->dr + n;
+    w->wr = w->di + n;
+    w->wi = w->wr + n;
+    w->e = w->wi + n;
+    w->az = w->e + n;
+    return 0;
+}
+
+/** frees the working arrays */
+static void poly_work_free(struct poly_work *w)
+{
+    free(w->a);
+    free(w->slot);
+}
+
+/**
+ * Newton correction \f$p(z)/p'(z)\f$ of a root \f$|z|>1\f$ where \f$p\f$
+ * overflows, from the reversed polynomial
+ * \f$q(v)=v^np(1/v)\f$: \f$p/p'=zq/(nq-vq')\f$ with \f$v=1/z\f$
+ * @param[in] 	a	monic coefficients, highest power first
+ * @param[in] 	abs_a	their moduli
+ * @param[in] 	n	degree
+ * @param[in] 	z	the root
+ * @param[out] 	small	1 if \f$p(z)\f$ is below its rounding error
+ * \returns the correction
+ */
+static double complex poly_reversed_newton(const double *a,
+                                           const double *abs_a, int n,
+                                           double complex z, int *small)
+{
+    double complex v = 1 / z, q = 0, dq = 0;
+    double av = cabs(v), e = 0;
+
+    for (int i = n; i >= 0; i--)
+    {
+        dq = dq * v + q;
+        q = q * v + a[i];
+        e = e * av + abs_a[i];
+    }
+    *small = cabs(q) <= 4 * DBL_EPSILON * e;
+    return z * q / (n * q - v * dq);
+}
+
+/**
+ * writes the roots of an iteration to the log
+ */
+static void poly_log(FILE *log, const struct poly_work *w, int n, int iter,
+                     double change)
+{
+    double complex *z = (double complex *)malloc(n * sizeof(double complex));
+    if (z == NULL)
+        return;
+    for (int k = 0; k < n; k++) z[w->slot[k]] = w->zr[k] + w->zi[k] * I;
+    fprintf(log, "%d,", iter);
+    for (int k = 0; k < n; k++)
+        fprintf(log, "% 7.04g%+7.04gj,", creal(z[k]), cimag(z[k]));
+    fprintf(log, "%.4g\n", change);
+    free(z);
+}
+
+/**
+ * computes the roots of one polynomial with the working arrays `w`
+ * @param[in] 	coeffs	\f$n+1\f$ coefficients, highest power first
+ * @param[in] 	n	degree
+ * @param[out] 	roots	the \f$n\f$ roots, in no particular order
+ * @param[in] 	opt	method, tolerance and iterations
+ * @param[in] 	w	working arrays for degree `n`
+ * \returns the number of iterations, or -1 if the roots did not converge
+ * (`roots` holds the last estimates) or, with `roots` set to NaN, if the
+ * leading coefficient is 0 or a correction overflowed
+ */
+static int poly_roots_work(const double *coeffs, int n, double complex *roots,
+                           const struct poly_options *opt,
+                           struct poly_work *w)
+{
+    const double tau = 2 * acos(-1);
+    int active = n, iter = 0;
+
+    if (coeffs[0] == 0 || !isfinite(coeffs[0]))
+    {
+        for (int k = 0; k < n; k++) roots[k] = NAN;
+        return -1;
+    }
+    for (int i = 0; i <= n; i++)
+    {
+        w->a[i] = coeffs[i] / coeffs[0];
+        w->abs_a[i] = fabs(w->a[i]);
+    }
+
+    /* starting points on a circle around the centroid of the roots, of
+     * radius their geometric mean distance to it, turned off the real axis
+     * so that they are not symmetric */
+    double complex c = -w->a[1] / n, pc = 0;
+    for (int i = 0; i <= n; i++) pc = pc * c + w->a[i];
+    double r = pow(cabs(pc), 1.0 / n);
+    if (!(r > 0 && isfinite(r)))
+        r = 1;
+    for (int k = 0; k < n; k++)
+    {
+        double theta = tau * k / n + 0.4;
+        w->zr[k] = creal(c) + r * cos(theta);
+        w->zi[k] = cimag(c) + r * sin(theta);
+        w->slot[k] = k;
+    }
+
+    while (active > 0 && iter < opt->max_iter)
+    {
+        double *restrict zr = w->zr, *restrict zi = w->zi;
+        double *restrict pr = w->pr, *restrict pi = w->pi;
+        double *restrict dr = w->dr, *restrict di = w->di, *restrict e = w->e;
+        double *restrict az = w->az, change = 0;
+        iter++;
+
+        // Horner's scheme for p, p' and the error bound, over the roots
+        for (int k = 0; k < active; k++)
+        {
+            pr[k] = 1;
+            pi[k] = dr[k] = di[k] = 0;
+            e[k] = 1;
+            az[k] = hypot(zr[k], zi[k]);
+        }
+        for (int i = 1; i <= n; i++)
+        {
+            const double ai = w->a[i], abs_ai = w->abs_a[i];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+            for (int k = 0; k < active; k++)
+            {
+                double x = zr[k], y = zi[k];
+                double tr = dr[k] * x - di[k] * y + pr[k];
+                double ti = dr[k] * y + di[k] * x + pi[k];
+                double ur = pr[k] * x - pi[k] * y + ai;
+                double ui = pr[k] * y + pi[k] * x;
+                dr[k] = tr;
+                di[k] = ti;
+                pr[k] = ur;
+                pi[k] = ui;
+                e[k] = e[k] * az[k] + abs_ai;
+            }
+        }
+
+        // corrections, with all the roots, still moving or not
+        for (int k = 0; k < active; k++)
+        {
+            double complex z = zr[k] + zi[k] * I, p = pr[k] + pi[k] * I;
+            double complex dp = dr[k] + di[k] * I, step;
+            int small = hypot(pr[k], pi[k]) <= 4 * DBL_EPSILON * e[k];
+
+            if (opt->method == POLY_DURAND_KERNER)
+            {
+                double complex q = 1;
+                for (int j = 0; j < n; j++)
+                    if (j != k)
+                        q *= z - (zr[j] + zi[j] * I);
+                step = p / q;
+            }
+            else
+            {
+                double sr = 0, si = 0;
+                if (!isfinite(creal(p)) || !isfinite(cimag(p)) ||
+                    !isfinite(creal(dp)) || !isfinite(cimag(dp)))
+                    step = poly_reversed_newton(w->a, w->abs_a, n, z, &small);
+                else
+                    step = p / dp;
+                // sum of 1/(z_k - z_j) = conj(d)/|d|^2, vectorized over j
+#ifdef _OPENMP
+#pragma omp simd reduction(+ : sr, si)
+#endif
+                for (int j = 0; j < k; j++)
+                {
+                    double xr = zr[k] - zr[j], xi = zi[k] - zi[j];
+                    double m = 1 / (xr * xr + xi * xi);
+                    sr += xr * m;
+                    si -= xi * m;
+                }
+#ifdef _OPENMP
+#pragma omp simd reduction(+ : sr, si)
+#endif
+                for (int j = k + 1; j < n; j++)
+                {
+                    double xr = zr[k] - zr[j], xi = zi[k] - zi[j];
+                    double m = 1 / (xr * xr + xi * xi);
+                    sr += xr * m;
+                    si -= xi * m;
+                }
+                step = step / (1 - step * (sr + si * I));
+            }
+            if (small)
+                step = 0;  // p(z) is rounding noise: z is as good as it gets
+            w->wr[k] = creal(step);
+            w->wi[k] = cimag(step);
+        }
+
+        // apply the corrections together, and set the converged roots
+        // aside behind the moving ones
+        for (int k = 0; k < active;)
+        {
+            double x = zr[k] - w->wr[k], y = zi[k] - w->wi[k];
+            double size = hypot(w->wr[k], w->wi[k]);
+            if (!isfinite(x) || !isfinite(y))
+            {
+                // the correction overflowed: no estimate is worth keeping
+                for (int j = 0; j < n; j++) roots[j] = NAN;
+                return -1;
+            }
+            zr[k] = x;
+            zi[k] = y;
+            change = fmax(change, size);
+            if (size <= opt->tol * hypot(x, y) || size == 0)
+            {
+                int last = --active;
+                double t;
+                int s;
+                t = zr[k], zr[k] = zr[last], zr[last] = t;
+                t = zi[k], zi[k] = zi[last], zi[last] = t;
+                t = w->wr[k], w->wr[k] = w->wr[last], w->wr[last] = t;
+                t = w->wi[k], w->wi[k] = w->wi[last], w->wi[last] = t;
+                s = w->slot[k], w->slot[k] = w->slot[last], w->slot[last] = s;
+                continue;  // look at the root swapped in
+            }
+            k++;
+        }
+        if (opt->log != NULL)
+            poly_log(opt->log, w, n, iter, change);
+    }
+
+    for (int k = 0; k < n; k++)
+        roots[w->slot[k]] = w->zr[k] + w->zi[k] * I;
+    return active == 0 ? iter : -1;
+}
+
+/**
+ * default options: Aberth-Ehrlich, tolerance \f$4\epsilon\f$, 500
+ * iterations, no log
+ */
+static struct poly_options poly_default_options(void)
+{
+    struct poly_options opt = {POLY_ABERTH, 4 * DBL_EPSILON, 500, NULL};
+    return opt;
+}
+
+/**
+ * computes all the roots of a polynomial
+ * @param[in] 	coeffs	\f$n+1\f$ coefficients, highest power first
+ * @param[in] 	n	degree
+ * @param[out] 	roots	the \f$n\f$ roots, in no particular order
+ * @param[in] 	opt	method, tolerance and iterations, or NULL for
+ *			poly_default_options()
+ * \returns the number of iterations, or -1 if the roots did not converge,
+ * if the leading coefficient is 0 or if out of memory
+ */
+int poly_roots(const double *coeffs, int n, double complex *roots,
+               const struct poly_options *opt)
+{
+    struct poly_options def = poly_default_options();
+    struct poly_work w;
+    int iter;
+
+    if (n < 1 || poly_work_init(&w, n) != 0)
+        return -1;
+    iter = poly_roots_work(coeffs, n, roots, opt ? opt : &def, &w);
+    poly_work_free(&w);
+    return iter;
+}
+
+/**
+ * computes all the roots of `count` polynomials of degree `n`, in parallel
+ * @param[in] 	coeffs	coefficients of polynomial `i` at
+ *			`coeffs[i * (n + 1)]`, highest power first
+ * @param[in] 	n	degree
+ * @param[in] 	count	number of polynomials
+ * @param[out] 	roots	roots of polynomial `i` at `roots[i * n]`
+ * @param[out] 	iterations	iterations of each polynomial, -1 if it did
+ *			not converge, or NULL
+ * @param[in] 	opt	method, tolerance and iterations, or NULL for
+ *			poly_default_options(); `log` is ignored
+ * \returns the number of polynomials whose roots converged, or 0 if out of
+ * memory
+ */
+size_t poly_roots_batch(const double *coeffs, int n, size_t count,
+                        double complex *roots, int *iterations,
+                        const struct poly_options *opt)
+{
+    struct poly_options o = opt ? *opt : poly_default_options();
+    size_t converged = 0;
+    int failed = 0;
+
+    if (n < 1)
+        return 0;
+    o.log = NULL;  // the threads would interleave their rows
+#ifdef _OPENMP
+#pragma omp parallel reduction(+ : converged) reduction(| : failed)
+#endif
+    {
+        struct poly_work w;
+        if (poly_work_init(&w, n) != 0)
+            failed = 1;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+        for (long i = 0; i < (long)count; i++)
+        {
+            int iter = failed ? -1
+                              : poly_roots_work(coeffs + i * (n + 1), n,
+                                                roots + i * n, &o, &w);
+            converged += iter >= 0;
+            if (iterations != NULL)
+                iterations[i] = iter;
+        }
+        if (!failed)
+            poly_work_free(&w);
+    }
+    return failed ? 0 : converged;
+}
+
+#endif  // POLYNOMIAL_ROOTS_H
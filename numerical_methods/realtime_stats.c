@@ -6,152 +6,673 @@
  * This algorithm is really beneficial to compute statistics on data read in
  * realtime. For example, devices reading biometrics data. The algorithm is
  * simple enough to be easily implemented in an embedded system.
+ *
+ * Every stream has its own accumulator, so any number of streams can be
+ * followed at once, by any number of threads as long as each accumulator
+ * is updated by one thread at a time:
+ *
+ * - struct running_stats keeps the count, minimum, maximum, a compensated
+ *   (Kahan-Babuska) sum, and the mean and sums of the 2nd to 4th powers of
+ *   the deviations from the mean updated with Welford's method. This gives
+ *   the variance, skewness and kurtosis without the cancellation of the
+ *   textbook formulas. Two accumulators merge exactly, as if one had seen
+ *   the data of both, so threads can each summarise a part of a stream.
+ * - struct p2_quantile follows one quantile, for example the median, with
+ *   the 5 markers of the P² algorithm of Jain and Chlamtac, in constant
+ *   memory and time; it cannot be merged.
+ * - struct tdigest is Dunning's merging t-digest: a sorted list of at most
+ *   #TDIGEST_COMPRESSION centroids, small near the ends and large in the
+ *   middle, that gives any quantile, tails included, with a small error,
+ *   and merges.
+ *
+ * None of them keeps the data, so median.c's sort of the whole data set is
+ * not needed for streams.
  */
-#include <assert.h>
-#include <math.h>
-#include <stdio.h>
+#include <assert.h>  /// for assert
+#include <math.h>    /// for sqrt, asin, sin
+#include <stdint.h>  /// for uint64_t
+#include <stdio.h>   /// for printf, scanf
+#include <stdlib.h>  /// for qsort, rand
+#include <string.h>  /// for memcpy
+#include <time.h>    /// for clock
+#ifdef _OPENMP
+#include <omp.h>  /// for omp_get_thread_num
+#endif
+
+/** most centroids of a t-digest; its accuracy grows with it */
+#define TDIGEST_COMPRESSION 100
+/** values a t-digest buffers before folding them into its centroids */
+#define TDIGEST_BUFFER 400
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846 /**< pi */
+#endif
+
+/** running moments of a stream, all zero when empty */
+struct running_stats
+{
+    uint64_t n;          ///< number of values
+    double min, max;     ///< extreme values
+    double sum, sum_c;   ///< compensated sum and its running error
+    double mean;         ///< Welford mean
+    double m2, m3, m4;   ///< sums of the powers of the deviations
+};
+
+/** P² estimate of the quantile p of a stream */
+struct p2_quantile
+{
+    double p;         ///< quantile followed, in [0, 1]
+    int count;        ///< values seen, up to 5
+    double q[5];      ///< marker heights, the 5 first values at first
+    double pos[5];    ///< marker positions
+    double want[5];   ///< desired marker positions
+};
+
+/** a cluster of values of a t-digest */
+struct centroid
+{
+    double mean;
+    double weight;
+};
+
+/** merging t-digest */
+struct tdigest
+{
+    size_t count;     ///< centroids in use
+    size_t buffered;  ///< values waiting in buffer
+    double weight;    ///< total weight of the centroids
+    double min, max;  ///< extreme values
+    struct centroid c[TDIGEST_COMPRESSION];  ///< centroids by mean
+    struct centroid buffer[TDIGEST_BUFFER];  ///< unsorted new values
+};
+
+/** empties an accumulator */
+void stats_init(struct running_stats *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+/** adds y to the compensated sum (Neumaier's variant of Kahan's method) */
+static void kahan_add(double *sum, double *c, double y)
+{
+    double t = *sum + y;
+    if (fabs(*sum) >= fabs(y))
+        *c += (*sum - t) + y;
+    else
+        *c += (y - t) + *sum;
+    *sum = t;
+}
 
 /**
- * continuous mean and variance computance using
- * first value as an approximation for the mean.
- * If the first number is much far form the mean, the algorithm becomes very
- * inaccurate to compute variance and standard deviation.
+ * adds a value to a stream
+ * \param[in,out] s accumulator
  * \param[in] x new value added to data set
- * \param[out] mean if not NULL, mean returns mean of data set
- * \param[out] variance if not NULL, mean returns variance of data set
- * \param[out] std if not NULL, mean returns standard deviation of data set
  */
-void stats_computer1(float x, float *mean, float *variance, float *std)
+void stats_add(struct running_stats *s, double x)
+{
+    double n1 = (double)s->n, n = n1 + 1;
+    double delta = x - s->mean, delta_n = delta / n;
+    double delta_n2 = delta_n * delta_n, term = delta * delta_n * n1;
+
+    if (s->n == 0 || x < s->min)
+        s->min = x;
+    if (s->n == 0 || x > s->max)
+        s->max = x;
+    kahan_add(&s->sum, &s->sum_c, x);
+
+    // the higher moments use the lower ones before their update
+    s->mean += delta_n;
+    s->m4 += term * delta_n2 * (n * n - 3 * n + 3) + 6 * delta_n2 * s->m2 -
+             4 * delta_n * s->m3;
+    s->m3 += term * delta_n * (n - 2) - 3 * delta_n * s->m2;
+    s->m2 += term;
+    s->n++;
+}
+
+/**
+ * merges b into a, with the formulas of Chan et al. and of Pébay
+ * \param[in,out] a accumulator receiving the data of both
+ * \param[in] b other accumulator
+ */
+void stats_merge(struct running_stats *a, const struct running_stats *b)
+{
+    if (b->n == 0)
+        return;
+    if (a->n == 0)
+    {
+        *a = *b;
+        return;
+    }
+
+    double na = (double)a->n, nb = (double)b->n, n = na + nb;
+    double delta = b->mean - a->mean, d2 = delta * delta;
+    double m2 = a->m2 + b->m2 + d2 * na * nb / n;
+    double m3 = a->m3 + b->m3 + d2 * delta * na * nb * (na - nb) / (n * n) +
+                3 * delta * (na * b->m2 - nb * a->m2) / n;
+    double m4 = a->m4 + b->m4 +
+                d2 * d2 * na * nb * (na * na - na * nb + nb * nb) /
+                    (n * n * n) +
+                6 * d2 * (na * na * b->m2 + nb * nb * a->m2) / (n * n) +
+                4 * delta * (na * b->m3 - nb * a->m3) / n;
+
+    a->mean += delta * nb / n;
+    a->m2 = m2;
+    a->m3 = m3;
+    a->m4 = m4;
+    a->n += b->n;
+    a->min = b->min < a->min ? b->min : a->min;
+    a->max = b->max > a->max ? b->max : a->max;
+    kahan_add(&a->sum, &a->sum_c, b->sum);
+    kahan_add(&a->sum, &a->sum_c, b->sum_c);
+}
+
+/** sum of the values */
+double stats_sum(const struct running_stats *s) { return s->sum + s->sum_c; }
+
+/** mean of the values, 0 for none */
+double stats_mean(const struct running_stats *s) { return s->mean; }
+
+/** population variance (divided by n), 0 for less than 2 values */
+double stats_variance(const struct running_stats *s)
+{
+    return s->n > 1 ? s->m2 / (double)s->n : 0;
+}
+
+/** sample variance (divided by n - 1), 0 for less than 2 values */
+double stats_sample_variance(const struct running_stats *s)
+{
+    return s->n > 1 ? s->m2 / (double)(s->n - 1) : 0;
+}
+
+/** population standard deviation */
+double stats_std(const struct running_stats *s)
+{
+    return sqrt(stats_variance(s));
+}
+
+/** skewness, 0 for a constant stream */
+double stats_skewness(const struct running_stats *s)
+{
+    return s->m2 > 0 ? sqrt((double)s->n) * s->m3 / pow(s->m2, 1.5) : 0;
+}
+
+/** excess kurtosis, 0 for a normal distribution and a constant stream */
+double stats_kurtosis(const struct running_stats *s)
+{
+    return s->m2 > 0 ? (double)s->n * s->m4 / (s->m2 * s->m2) - 3 : 0;
+}
+
+/**
+ * starts following the quantile p
+ * \param[out] e estimator
+ * \param[in] p quantile in [0, 1], 0.5 for the median
+ */
+void p2_init(struct p2_quantile *e, double p)
+{
+    memset(e, 0, sizeof(*e));
+    e->p = p;
+}
+
+/** ascending order of doubles for qsort() */
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/** adds a value to the stream of a P² estimator */
+void p2_add(struct p2_quantile *e, double x)
+{
+    double p = e->p;
+    int k;
+
+    if (e->count < 5)
+    {
+        e->q[e->count++] = x;
+        if (e->count == 5)
+        {
+            qsort(e->q, 5, sizeof(double), cmp_double);
+            for (int i = 0; i < 5; i++) e->pos[i] = i + 1;
+            e->want[0] = 1;
+            e->want[1] = 1 + 2 * p;
+            e->want[2] = 1 + 4 * p;
+            e->want[3] = 3 + 2 * p;
+            e->want[4] = 5;
+        }
+        return;
+    }
+
+    // cell of x, widening the extreme markers if needed
+    if (x < e->q[0])
+    {
+        e->q[0] = x;
+        k = 0;
+    }
+    else if (x >= e->q[4])
+    {
+        e->q[4] = x;
+        k = 3;
+    }
+    else
+        for (k = 0; x >= e->q[k + 1]; k++) continue;
+
+    for (int i = k + 1; i < 5; i++) e->pos[i]++;
+    e->want[1] += p / 2;
+    e->want[2] += p;
+    e->want[3] += (1 + p) / 2;
+    e->want[4] += 1;
+
+    // move the middle markers that are a position or more off
+    for (int i = 1; i < 4; i++)
+    {
+        double d = e->want[i] - e->pos[i];
+        if ((d < 1 || e->pos[i + 1] - e->pos[i] <= 1) &&
+            (d > -1 || e->pos[i - 1] - e->pos[i] >= -1))
+            continue;
+        d = d > 0 ? 1 : -1;
+
+        // piecewise-parabolic prediction, or linear if it is not monotone
+        double np = e->pos[i + 1] - e->pos[i - 1];
+        double q = e->q[i] +
+                   d / np *
+                       ((e->pos[i] - e->pos[i - 1] + d) *
+                            (e->q[i + 1] - e->q[i]) /
+                            (e->pos[i + 1] - e->pos[i]) +
+                        (e->pos[i + 1] - e->pos[i] - d) *
+                            (e->q[i] - e->q[i - 1]) /
+                            (e->pos[i] - e->pos[i - 1]));
+        if (q <= e->q[i - 1] || q >= e->q[i + 1])
+        {
+            int j = i + (int)d;
+            q = e->q[i] + d * (e->q[j] - e->q[i]) / (e->pos[j] - e->pos[i]);
+        }
+        e->q[i] = q;
+        e->pos[i] += d;
+    }
+}
+
+/** estimated quantile, NAN for an empty stream */
+double p2_value(const struct p2_quantile *e)
+{
+    if (e->count == 0)
+        return NAN;
+    if (e->count < 5)
+    {
+        // the exact quantile of the few values seen
+        double q[5];
+        memcpy(q, e->q, e->count * sizeof(double));
+        qsort(q, e->count, sizeof(double), cmp_double);
+        return q[(int)(e->p * (e->count - 1) + 0.5)];
+    }
+    return e->q[2];
+}
+
+/** empties a t-digest */
+void tdigest_init(struct tdigest *t)
+{
+    t->count = t->buffered = 0;
+    t->weight = 0;
+    t->min = INFINITY;
+    t->max = -INFINITY;
+}
+
+/** ascending order of centroids by mean for qsort() */
+static int cmp_centroid(const void *a, const void *b)
+{
+    return cmp_double(&((const struct centroid *)a)->mean,
+                      &((const struct centroid *)b)->mean);
+}
+
+/**
+ * scale function k1 of the t-digest: a centroid may span at most one unit
+ * of k, which keeps the centroids near q = 0 and q = 1 small. The range of
+ * k is #TDIGEST_COMPRESSION / 2 - 1 units and no two neighbours fit in one,
+ * so there are at most #TDIGEST_COMPRESSION centroids.
+ */
+static double tdigest_k(double q)
 {
-    /* following variables declared static becuase they need to be remembered
-     * when updating for next sample, when received.
-     */
-    static unsigned int n = 0;
-    static float Ex = 0.f, Ex2 = 0.f;
-    static float K = 0.f;
+    return (TDIGEST_COMPRESSION / 2 - 1) / M_PI * asin(2 * q - 1);
+}
 
+/** inverse of tdigest_k(), 1 past its range */
+static double tdigest_q(double k)
+{
+    if (2 * k >= TDIGEST_COMPRESSION / 2 - 1)
+        return 1;
+    return (sin(k * M_PI / (TDIGEST_COMPRESSION / 2 - 1)) + 1) / 2;
+}
+
+/**
+ * folds the sorted centroids in into t, merging neighbours while they fit
+ * in one unit of tdigest_k(), which bounds their number
+ */
+static void tdigest_fold(struct tdigest *t, struct centroid *in, size_t n)
+{
+    double total = 0, before = 0;
+
+    for (size_t i = 0; i < n; i++) total += in[i].weight;
+
+    size_t count = 0;
+    struct centroid cur = in[0];
+    double limit = total * tdigest_q(tdigest_k(0) + 1);
+    for (size_t i = 1; i < n; i++)
+    {
+        if (before + cur.weight + in[i].weight <= limit)
+        {
+            cur.weight += in[i].weight;
+            cur.mean += (in[i].mean - cur.mean) * in[i].weight / cur.weight;
+            continue;
+        }
+        t->c[count++] = cur;
+        before += cur.weight;
+        limit = total * tdigest_q(tdigest_k(before / total) + 1);
+        cur = in[i];
+    }
+    t->c[count++] = cur;
+    assert(count <= TDIGEST_COMPRESSION);
+    t->count = count;
+    t->weight = total;
+}
+
+/** folds the buffered values, and those of other if not NULL, into t */
+static void tdigest_compress(struct tdigest *t, const struct tdigest *other)
+{
+    struct centroid all[2 * (TDIGEST_COMPRESSION + TDIGEST_BUFFER)];
+    size_t n = 0;
+
+    if (t->buffered == 0 && other == NULL)
+        return;
+    memcpy(all, t->c, t->count * sizeof(struct centroid));
+    n += t->count;
+    memcpy(all + n, t->buffer, t->buffered * sizeof(struct centroid));
+    n += t->buffered;
+    if (other != NULL)
+    {
+        memcpy(all + n, other->c, other->count * sizeof(struct centroid));
+        n += other->count;
+        memcpy(all + n, other->buffer,
+               other->buffered * sizeof(struct centroid));
+        n += other->buffered;
+    }
+    t->buffered = 0;
     if (n == 0)
-        K = x;
-    n++;
-    float tmp = x - K;
-    Ex += tmp;
-    Ex2 += tmp * tmp;
+        return;
 
-    /* return sample mean computed till last sample */
-    if (mean != NULL)
-        *mean = K + Ex / n;
+    qsort(all, n, sizeof(struct centroid), cmp_centroid);
+    tdigest_fold(t, all, n);
+}
 
-    /* return data variance computed till last sample */
-    if (variance != NULL)
-        *variance = (Ex2 - (Ex * Ex) / n) / (n - 1);
+/** adds a value to a t-digest */
+void tdigest_add(struct tdigest *t, double x)
+{
+    if (t->buffered == TDIGEST_BUFFER)
+        tdigest_compress(t, NULL);
+    t->buffer[t->buffered].mean = x;
+    t->buffer[t->buffered++].weight = 1;
+    t->min = x < t->min ? x : t->min;
+    t->max = x > t->max ? x : t->max;
+}
 
-    /* return sample standard deviation computed till last sample */
-    if (std != NULL)
-        *std = sqrtf(*variance);
+/** merges b into a */
+void tdigest_merge(struct tdigest *a, const struct tdigest *b)
+{
+    tdigest_compress(a, b);
+    a->min = b->min < a->min ? b->min : a->min;
+    a->max = b->max > a->max ? b->max : a->max;
 }
 
 /**
- * continuous mean and variance computance using
- * Welford's algorithm  (very accurate)
- * \param[in] x new value added to data set
- * \param[out] mean if not NULL, mean returns mean of data set
- * \param[out] variance if not NULL, mean returns variance of data set
- * \param[out] std if not NULL, mean returns standard deviation of data set
+ * estimated quantile q of the values of t, NAN when empty
+ * \param[in,out] t t-digest; its buffered values are folded first
+ * \param[in] q quantile in [0, 1]
  */
-void stats_computer2(float x, float *mean, float *variance, float *std)
+double tdigest_quantile(struct tdigest *t, double q)
 {
-    /* following variables declared static becuase they need to be remembered
-     * when updating for next sample, when received.
-     */
-    static unsigned int n = 0;
-    static float mu = 0, M = 0;
+    tdigest_compress(t, NULL);
+    if (t->count == 0)
+        return NAN;
+    if (t->count == 1 || q <= 0)
+        return q <= 0 ? t->min : t->c[0].mean;
+    if (q >= 1)
+        return t->max;
 
-    n++;
-    float delta = x - mu;
-    mu += delta / n;
-    float delta2 = x - mu;
-    M += delta * delta2;
+    // each centroid stands at the middle of its weight; interpolate
+    // between the two around q * weight, and the extremes at the ends
+    double index = q * t->weight;
+    if (index < t->c[0].weight / 2)
+        return t->min + (t->c[0].mean - t->min) * 2 * index / t->c[0].weight;
 
-    /* return sample mean computed till last sample */
-    if (mean != NULL)
-        *mean = mu;
+    double at = t->c[0].weight / 2;
+    for (size_t i = 0; i + 1 < t->count; i++)
+    {
+        double next = at + (t->c[i].weight + t->c[i + 1].weight) / 2;
+        if (index < next)
+            return t->c[i].mean +
+                   (t->c[i + 1].mean - t->c[i].mean) * (index - at) /
+                       (next - at);
+        at = next;
+    }
+
+    const struct centroid *last = &t->c[t->count - 1];
+    return last->mean +
+           (t->max - last->mean) * (index - at) / (last->weight / 2);
+}
 
-    /* return data variance computed till last sample */
-    if (variance != NULL)
-        *variance = M / n;
+/** uniform pseudo-random number in (0, 1) */
+static double uniform(void) { return (rand() + 0.5) / (RAND_MAX + 1.0); }
 
-    /* return sample standard deviation computed till last sample */
-    if (std != NULL)
-        *std = sqrtf(*variance);
+/** standard normal pseudo-random number, by Box-Muller */
+static double normal(void)
+{
+    return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
 }
 
-/** Test the algorithm implementation
- * \param[in] test_data array of data to test the algorithms
- * \param[in] number_of_samples number of samples of data
+/**
+ * Self-test: moments against two-pass formulas, merged against
+ * sequential accumulators, and quantiles against sorted data
+ * \returns void
  */
-void test_function(const float *test_data, const int number_of_samples)
+static void test(void)
 {
-    float ref_mean = 0.f, ref_variance = 0.f;
-    float s1_mean = 0.f, s1_variance = 0.f, s1_std = 0.f;
-    float s2_mean = 0.f, s2_variance = 0.f, s2_std = 0.f;
+    const int n = 200000;
+    double *x = (double *)malloc(n * sizeof(double));
+    struct running_stats s, parts[4];
+    struct p2_quantile median, p99;
+    static struct tdigest digest, digests[4];
+    assert(x != NULL);
 
-    for (int i = 0; i < number_of_samples; i++)
+    // values far from 0, where the textbook variance in float fails
+    srand(7);
+    stats_init(&s);
+    p2_init(&median, 0.5);
+    p2_init(&p99, 0.99);
+    tdigest_init(&digest);
+    for (int i = 0; i < 4; i++)
+    {
+        stats_init(&parts[i]);
+        tdigest_init(&digests[i]);
+    }
+    for (int i = 0; i < n; i++)
     {
-        stats_computer1(test_data[i], &s1_mean, &s1_variance, &s1_std);
-        stats_computer2(test_data[i], &s2_mean, &s2_variance, &s2_std);
-        ref_mean += test_data[i];
+        x[i] = 1e6 + exp(normal());  // log-normal: skewed, long tail
+        stats_add(&s, x[i]);
+        stats_add(&parts[i % 4], x[i]);
+        p2_add(&median, x[i]);
+        p2_add(&p99, x[i]);
+        tdigest_add(&digest, x[i]);
+        tdigest_add(&digests[i * 4 / n], x[i]);
     }
-    ref_mean /= number_of_samples;
 
-    for (int i = 0; i < number_of_samples; i++)
+    double mean = 0, m2 = 0, m3 = 0, m4 = 0;
+    for (int i = 0; i < n; i++) mean += x[i];
+    mean /= n;
+    for (int i = 0; i < n; i++)
     {
-        float temp = test_data[i] - ref_mean;
-        ref_variance += temp * temp;
+        double d = x[i] - mean;
+        m2 += d * d;
+        m3 += d * d * d;
+        m4 += d * d * d * d;
     }
-    ref_variance /= number_of_samples;
+    assert(s.n == (uint64_t)n);
+    assert(fabs(stats_mean(&s) - mean) < 1e-9 * mean);
+    assert(fabs(stats_sum(&s) - mean * n) < 1e-9 * mean * n);
+    assert(fabs(stats_variance(&s) - m2 / n) < 1e-9 * m2 / n);
+    assert(fabs(stats_skewness(&s) - sqrt(n) * m3 / pow(m2, 1.5)) < 1e-6);
+    assert(fabs(stats_kurtosis(&s) - (n * m4 / (m2 * m2) - 3)) < 1e-6);
 
-    printf("<<<<<<<< Test Function >>>>>>>>\n");
-    printf("Expected: Mean: %.4f\t Variance: %.4f\n", ref_mean, ref_variance);
-    printf("\tMethod 1:\tMean: %.4f\t Variance: %.4f\t Std: %.4f\n", s1_mean,
-           s1_variance, s1_std);
-    printf("\tMethod 2:\tMean: %.4f\t Variance: %.4f\t Std: %.4f\n", s2_mean,
-           s2_variance, s2_std);
+    // merging the 4 interleaved parts gives the same moments
+    for (int i = 1; i < 4; i++) stats_merge(&parts[0], &parts[i]);
+    assert(parts[0].n == s.n && parts[0].min == s.min && parts[0].max == s.max);
+    assert(fabs(stats_mean(&parts[0]) / stats_mean(&s) - 1) < 1e-12);
+    assert(fabs(stats_variance(&parts[0]) / stats_variance(&s) - 1) < 1e-9);
+    assert(fabs(stats_skewness(&parts[0]) / stats_skewness(&s) - 1) < 1e-9);
+    assert(fabs(stats_kurtosis(&parts[0]) / stats_kurtosis(&s) - 1) < 1e-9);
 
-    assert(fabs(s1_mean - ref_mean) < 0.01);
-    assert(fabs(s2_mean - ref_mean) < 0.01);
-    assert(fabs(s2_variance - ref_variance) < 0.01);
+    // quantiles: compare ranks, as the values of a long tail spread out
+    qsort(x, n, sizeof(double), cmp_double);
+    for (int i = 1; i < 4; i++) tdigest_merge(&digests[0], &digests[i]);
+    const double qs[] = {0.001, 0.01, 0.1, 0.5, 0.9, 0.99, 0.999};
+    for (size_t i = 0; i < sizeof(qs) / sizeof(qs[0]); i++)
+    {
+        double tol = 0.01 * sqrt(qs[i] * (1 - qs[i])) + 5e-4;
+        for (int d = 0; d < 2; d++)
+        {
+            double v = tdigest_quantile(d ? &digests[0] : &digest, qs[i]);
+            double *at = x;
+            while (at < x + n && *at < v) at++;
+            assert(fabs((double)(at - x) / n - qs[i]) < tol);
+        }
+    }
+    assert(tdigest_quantile(&digest, 0) == x[0]);
+    assert(tdigest_quantile(&digest, 1) == x[n - 1]);
+    assert(fabs(p2_value(&median) - x[n / 2]) < 0.01 * (x[n / 2] - x[0]));
+    assert(fabs(p2_value(&p99) - x[n * 99 / 100]) <
+           0.02 * (x[n * 99 / 100] - x[0]));
+
+    // empty and tiny streams
+    stats_init(&s);
+    assert(stats_variance(&s) == 0 && stats_skewness(&s) == 0);
+    stats_add(&s, 3);
+    stats_add(&s, 3);
+    assert(stats_mean(&s) == 3 && stats_variance(&s) == 0);
+    p2_init(&median, 0.5);
+    assert(isnan(p2_value(&median)));
+    p2_add(&median, 5);
+    p2_add(&median, 1);
+    p2_add(&median, 3);
+    assert(p2_value(&median) == 3);
+    tdigest_init(&digest);
+    assert(isnan(tdigest_quantile(&digest, 0.5)));
+
+    free(x);
+    printf("All tests have successfully passed!\n");
+}
+
+/**
+ * Updates of many streams at once, as when following thousands of metrics,
+ * and of one stream summarised by all threads and merged
+ * \param[in] streams number of streams
+ * \param[in] values number of values
+ * \returns void
+ */
+static void benchmark(int streams, long values)
+{
+    struct running_stats *s =
+        (struct running_stats *)malloc(streams * sizeof(*s));
+    struct p2_quantile *m = (struct p2_quantile *)malloc(streams * sizeof(*m));
+    assert(s != NULL && m != NULL);
+
+    for (int i = 0; i < streams; i++)
+    {
+        stats_init(&s[i]);
+        p2_init(&m[i], 0.5);
+    }
+    clock_t start = clock();
+    unsigned r = 1;
+    for (long i = 0; i < values; i++)
+    {
+        r = r * 1103515245 + 12345;
+        int k = (int)(r >> 8) % streams;
+        stats_add(&s[k], (double)(r >> 16));
+        p2_add(&m[k], (double)(r >> 16));
+    }
+    printf("%ld values over %d streams: %.1f ns per value\n", values, streams,
+           (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / values);
+
+    // one stream split among the threads and merged
+    struct running_stats total;
+    static struct tdigest digest;
+    stats_init(&total);
+    tdigest_init(&digest);
+#ifdef _OPENMP
+    double wall = omp_get_wtime();
+#pragma omp parallel
+#endif
+    {
+        struct running_stats part;
+        struct tdigest part_digest;
+        stats_init(&part);
+        tdigest_init(&part_digest);
+#ifdef _OPENMP
+#pragma omp for
+#endif
+        for (long i = 0; i < values; i++)
+        {
+            double x = (double)((i * 2654435761u) % 1000003);
+            stats_add(&part, x);
+            tdigest_add(&part_digest, x);
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        {
+            stats_merge(&total, &part);
+            tdigest_merge(&digest, &part_digest);
+        }
+    }
+#ifdef _OPENMP
+    printf("%ld values merged from %d thread(s) in %.3f s: ", values,
+           omp_get_max_threads(), omp_get_wtime() - wall);
+#else
+    printf("%ld values: ", values);
+#endif
+    printf("mean %.1f, std %.1f, median %.1f, p99 %.1f\n", stats_mean(&total),
+           stats_std(&total), tdigest_quantile(&digest, 0.5),
+           tdigest_quantile(&digest, 0.99));
 
-    printf("(Tests passed)\n\n");
+    free(s);
+    free(m);
 }
 
 /** Main function */
 int main(int argc, char **argv)
 {
-    const float test_data1[] = {3, 4, 5, -1.4, -3.6, 1.9, 1.};
-    test_function(test_data1, sizeof(test_data1) / sizeof(test_data1[0]));
+    test();
+    benchmark(argc > 1 ? atoi(argv[1]) : 10000, 10000000);
 
-    float s1_mean = 0.f, s1_variance = 0.f, s1_std = 0.f;
-    float s2_mean = 0.f, s2_variance = 0.f, s2_std = 0.f;
+    struct running_stats s;
+    struct p2_quantile median;
+    stats_init(&s);
+    p2_init(&median, 0.5);
 
     printf("Enter data. Any non-numeric data will terminate the data input.\n");
 
     while (1)
     {
-        float val;
+        double val;
         printf("Enter number: ");
 
         // check for failure to read input. Happens for
         // non-numeric data
-        if (!scanf("%f", &val))
+        if (scanf("%lf", &val) != 1)
             break;
 
-        stats_computer1(val, &s1_mean, &s1_variance, &s1_std);
-        stats_computer2(val, &s2_mean, &s2_variance, &s2_std);
+        stats_add(&s, val);
+        p2_add(&median, val);
 
-        printf("\tMethod 1:\tMean: %.4f\t Variance: %.4f\t Std: %.4f\n",
-               s1_mean, s1_variance, s1_std);
-        printf("\tMethod 2:\tMean: %.4f\t Variance: %.4f\t Std: %.4f\n",
-               s2_mean, s2_variance, s2_std);
+        printf("\tMean: %.4f\t Variance: %.4f\t Std: %.4f\t Median: %.4f\n",
+               stats_mean(&s), stats_variance(&s), stats_std(&s),
+               p2_value(&median));
     }
 
     return 0;
@@ -0,0 +1,698 @@
+/**
+ * @file
+ * @brief Discrete-event simulator of [process
+ * scheduling](https://en.wikipedia.org/wiki/Scheduling_(computing)) policies
+ * on one processor
+ *
+ * @details
+ * non_preemptive_priority_scheduling.c rescans a linked list of all the
+ * processes to pick each next one, in O(n^2). This simulator only visits the
+ * instants where something happens: an arrival, a completion or the end of a
+ * time slice. The processes waiting to run are in a binary heap ordered by
+ * the policy, and the arrivals are the processes sorted by arrival time, so
+ * a simulation takes O(n log n) for n processes, and millions of them take
+ * seconds.
+ *
+ * A policy is a struct policy: the order of the ready queue, whether a new
+ * arrival that comes first in this order preempts the running process, and
+ * an optional time quantum. The policies given are
+ * - first come first served (FCFS),
+ * - non-preemptive and preemptive priority, lower numbers first,
+ * - shortest job first (SJF) and shortest remaining time first (SRTF),
+ * - round robin (RR) with a quantum,
+ * - a multilevel feedback queue (MLFQ) of #MLFQ_LEVELS queues: a process
+ *   that uses its whole quantum moves to the next queue, where the quantum
+ *   is twice as long, and the queues are served in order.
+ *
+ * Ties go to the process that arrived, or for RR and MLFQ that entered the
+ * queue, first; the processes that arrive when a slice ends enter the queue
+ * before the one whose slice ended.
+ *
+ * The processes come from a CSV trace of lines `id,arrival,burst[,priority]`
+ * or are drawn at random, and the result is the average completion,
+ * turnaround, waiting and response times, the makespan and the utilization.
+ * @see non_preemptive_priority_scheduling.c
+ */
+#include <assert.h>  /// for assert
+#include <math.h>    /// for `log`
+#include <stdio.h>   /// for IO operations (`printf`, `fopen`)
+#include <stdlib.h>  /// for `malloc`, `realloc`, `qsort`, `strtol`
+#include <string.h>  /// for `strcmp`
+#include <time.h>    /// for `clock`
+
+#define MLFQ_LEVELS 4 /**< queues of the multilevel feedback queue */
+
+/**
+ * @brief A process of the simulation
+ */
+struct job
+{
+    int id;           ///< ID of the process
+    long arrival;     ///< Arrival Time
+    long burst;       ///< Burst Time
+    long priority;    ///< priority, lower runs first
+    long remaining;   ///< time left to run
+    long start;       ///< first time it ran, -1 before
+    long completion;  ///< Completion Time
+    long seq;         ///< order of entry in the ready queue
+    int level;        ///< queue of MLFQ
+};
+
+/**
+ * @brief A scheduling policy
+ */
+struct policy
+{
+    const char *name;  ///< name of the policy
+    /** true if `a` runs before `b` when both are ready */
+    int (*before)(const struct job *a, const struct job *b);
+    int preemptive;  ///< true if an arrival that goes before preempts
+    long quantum;    ///< time slice, doubled at each MLFQ level; 0 for none
+    int levels;      ///< queues of MLFQ, 0 for other policies
+};
+
+/**
+ * @brief Aggregate statistics of a simulation
+ */
+struct sched_stats
+{
+    double avg_ct;     ///< average Completion Time
+    double avg_tat;    ///< average Turn Around Time
+    double avg_wt;     ///< average Waiting Time
+    double avg_rt;     ///< average response time, from arrival to first run
+    long max_wt;       ///< longest Waiting Time
+    long makespan;     ///< from the first arrival to the last completion
+    long busy;         ///< time the processor was running a process
+    long dispatches;   ///< times a process was given the processor
+};
+
+/** FCFS order: arrival, then ID */
+static int fcfs_before(const struct job *a, const struct job *b)
+{
+    if (a->arrival != b->arrival)
+        return a->arrival < b->arrival;
+    return a->id < b->id;
+}
+
+/** priority order: priority, then FCFS */
+static int priority_before(const struct job *a, const struct job *b)
+{
+    if (a->priority != b->priority)
+        return a->priority < b->priority;
+    return fcfs_before(a, b);
+}
+
+/** SJF/SRTF order: remaining time, then FCFS */
+static int shortest_before(const struct job *a, const struct job *b)
+{
+    if (a->remaining != b->remaining)
+        return a->remaining < b->remaining;
+    return fcfs_before(a, b);
+}
+
+/** round robin order: entry in the ready queue */
+static int fifo_before(const struct job *a, const struct job *b)
+{
+    return a->seq < b->seq;
+}
+
+/** MLFQ order: level, then entry in the ready queue */
+static int mlfq_before(const struct job *a, const struct job *b)
+{
+    if (a->level != b->level)
+        return a->level < b->level;
+    return a->seq < b->seq;
+}
+
+/** the policies of the simulator, with a quantum of 4 */
+static const struct policy policies[] = {
+    {"FCFS", fcfs_before, 0, 0, 0},
+    {"priority", priority_before, 0, 0, 0},
+    {"preemptive-priority", priority_before, 1, 0, 0},
+    {"SJF", shortest_before, 0, 0, 0},
+    {"SRTF", shortest_before, 1, 0, 0},
+    {"RR", fifo_before, 0, 4, 0},
+    {"MLFQ", mlfq_before, 1, 4, MLFQ_LEVELS}};
+
+/** number of ::policies */
+#define NUM_POLICIES (sizeof(policies) / sizeof(policies[0]))
+
+/**
+ * @brief Ready queue: a binary heap of indices of processes
+ */
+struct ready_queue
+{
+    int *heap;                ///< indices, the first one runs next
+    size_t size;              ///< processes in the queue
+    long seq;                 ///< entries so far
+    struct job *jobs;         ///< the processes
+    const struct policy *p;   ///< order of the heap
+};
+
+/**
+ * @brief Adds a process to the ready queue
+ * @param q ready queue
+ * @param j index of the process
+ * @returns void
+ */
+static void ready_push(struct ready_queue *q, int j)
+{
+    size_t i = q->size++;
+    q->jobs[j].seq = q->seq++;
+    // sift up
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (!q->p->before(&q->jobs[j], &q->jobs[q->heap[parent]]))
+            break;
+        q->heap[i] = q->heap[parent];
+        i = parent;
+    }
+    q->heap[i] = j;
+}
+
+/**
+ * @brief Removes the process that runs next from the ready queue
+ * @param q non-empty ready queue
+ * @returns index of the process
+ */
+static int ready_pop(struct ready_queue *q)
+{
+    int top = q->heap[0], last = q->heap[--q->size];
+    size_t i = 0, n = q->size;
+    // sift the last one down from the root
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n && q->p->before(&q->jobs[q->heap[child + 1]],
+                                          &q->jobs[q->heap[child]]))
+            child++;
+        if (!q->p->before(&q->jobs[q->heap[child]], &q->jobs[last]))
+            break;
+        q->heap[i] = q->heap[child];
+        i = child;
+    }
+    if (n > 0)
+        q->heap[i] = last;
+    return top;
+}
+
+/** processes by arrival for qsort() */
+static const struct job *sort_jobs;
+/** FCFS order of indices into ::sort_jobs for qsort() */
+static int compare_arrival(const void *a, const void *b)
+{
+    const struct job *x = &sort_jobs[*(const int *)a];
+    const struct job *y = &sort_jobs[*(const int *)b];
+    return fcfs_before(x, y) ? -1 : fcfs_before(y, x);
+}
+
+/**
+ * @brief Time slice of a process under a policy
+ * @returns the quantum, or 0 if the process runs until it completes or is
+ * preempted
+ */
+static long quantum_of(const struct policy *p, const struct job *j)
+{
+    return p->levels ? p->quantum << j->level : p->quantum;
+}
+
+/**
+ * @brief Simulates a policy and computes the statistics
+ * @param jobs processes; their `arrival`, `burst`, `priority` and `id` are
+ * read, and their `start` and `completion` set
+ * @param n number of processes, at most `INT_MAX`
+ * @param p policy
+ * @param st statistics of the run
+ * @returns 0 on success, -1 if out of memory
+ */
+int simulate(struct job *jobs, size_t n, const struct policy *p,
+             struct sched_stats *st)
+{
+    int *order = (int *)malloc(n * sizeof(int));
+    struct ready_queue q = {(int *)malloc(n * sizeof(int)), 0, 0, jobs, p};
+    size_t next = 0, done = 0;
+    long time = 0, used = 0;
+    int running = -1;
+
+    if (order == NULL || q.heap == NULL)
+    {
+        free(order);
+        free(q.heap);
+        return -1;
+    }
+    memset(st, 0, sizeof(*st));
+    for (size_t i = 0; i < n; i++)
+    {
+        order[i] = (int)i;
+        jobs[i].remaining = jobs[i].burst;
+        jobs[i].start = -1;
+        jobs[i].level = 0;
+    }
+    // the arrival events, in the order they happen
+    sort_jobs = jobs;
+    qsort(order, n, sizeof(int), compare_arrival);
+
+    while (done < n)
+    {
+        if (running < 0)
+        {
+            if (q.size == 0 && jobs[order[next]].arrival > time)
+                time = jobs[order[next]].arrival;  // idle until then
+            while (next < n && jobs[order[next]].arrival <= time)
+                ready_push(&q, order[next++]);
+            running = ready_pop(&q);
+            used = 0;
+            st->dispatches++;
+            if (jobs[running].start < 0)
+                jobs[running].start = time;
+        }
+
+        // run until the first of completion, end of the slice, and the
+        // next arrival if it may preempt
+        struct job *r = &jobs[running];
+        long quantum = quantum_of(p, r);
+        long end = time + r->remaining;
+        if (quantum > 0 && time + quantum - used < end)
+            end = time + quantum - used;
+        if (p->preemptive && next < n && jobs[order[next]].arrival < end)
+            end = jobs[order[next]].arrival;
+        r->remaining -= end - time;
+        used += end - time;
+        st->busy += end - time;
+        time = end;
+
+        while (next < n && jobs[order[next]].arrival <= time)
+            ready_push(&q, order[next++]);
+
+        if (r->remaining == 0)
+        {
+            r->completion = time;
+            done++;
+            running = -1;
+        }
+        else if (quantum > 0 && used == quantum)
+        {
+            if (r->level + 1 < p->levels)
+                r->level++;
+            ready_push(&q, running);
+            running = -1;
+        }
+        else if (p->preemptive && q.size > 0 &&
+                 p->before(&jobs[q.heap[0]], r))
+        {
+            ready_push(&q, running);
+            running = -1;
+        }
+    }
+
+    double ct = 0, tat = 0, wt = 0, rt = 0;
+    long first = n > 0 ? jobs[order[0]].arrival : 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        long w = jobs[i].completion - jobs[i].arrival - jobs[i].burst;
+        ct += jobs[i].completion;
+        tat += jobs[i].completion - jobs[i].arrival;
+        wt += w;
+        rt += jobs[i].start - jobs[i].arrival;
+        if (w > st->max_wt)
+            st->max_wt = w;
+        if (jobs[i].completion - first > st->makespan)
+            st->makespan = jobs[i].completion - first;
+    }
+    if (n > 0)
+    {
+        st->avg_ct = ct / n;
+        st->avg_tat = tat / n;
+        st->avg_wt = wt / n;
+        st->avg_rt = rt / n;
+    }
+
+    free(order);
+    free(q.heap);
+    return 0;
+}
+
+/**
+ * @brief Reads a CSV trace of lines `id,arrival,burst[,priority]`; a first
+ * line that is not a process is taken as a header, and empty lines and lines
+ * starting with `#` are skipped
+ * @param fp trace
+ * @param jobs receives the processes, to free()
+ * @returns number of processes, or -1 on a malformed line or out of memory
+ */
+long read_trace(FILE *fp, struct job **jobs)
+{
+    char line[256];
+    long n = 0, cap = 0, line_no = 0;
+    *jobs = NULL;
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        long id, arrival, burst, priority = 0;
+        int fields;
+        line_no++;
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+            continue;
+        fields = sscanf(line, "%ld,%ld,%ld,%ld", &id, &arrival, &burst,
+                        &priority);
+        if (fields < 3 && line_no == 1)
+            continue;  // header
+        if (fields < 3 || arrival < 0 || burst <= 0)
+        {
+            fprintf(stderr, "line %ld: expected id,arrival,burst[,priority]\n",
+                    line_no);
+            free(*jobs);
+            *jobs = NULL;
+            return -1;
+        }
+        if (n == cap)
+        {
+            cap = cap ? 2 * cap : 1024;
+            struct job *grown =
+                (struct job *)realloc(*jobs, cap * sizeof(struct job));
+            if (grown == NULL)
+            {
+                free(*jobs);
+                *jobs = NULL;
+                return -1;
+            }
+            *jobs = grown;
+        }
+        (*jobs)[n].id = (int)id;
+        (*jobs)[n].arrival = arrival;
+        (*jobs)[n].burst = burst;
+        (*jobs)[n].priority = priority;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief Writes the result of each process as CSV
+ * @param fp destination
+ * @param jobs simulated processes
+ * @param n number of processes
+ * @returns void
+ */
+void write_results(FILE *fp, const struct job *jobs, size_t n)
+{
+    fprintf(fp, "id,arrival,burst,priority,completion,turnaround,waiting\n");
+    for (size_t i = 0; i < n; i++)
+        fprintf(fp, "%d,%ld,%ld,%ld,%ld,%ld,%ld\n", jobs[i].id,
+                jobs[i].arrival, jobs[i].burst, jobs[i].priority,
+                jobs[i].completion, jobs[i].completion - jobs[i].arrival,
+                jobs[i].completion - jobs[i].arrival - jobs[i].burst);
+}
+
+/**
+ * @brief Draws processes with exponential inter-arrival and burst times
+ * @param jobs receives the processes
+ * @param n number of processes
+ * @param load mean burst over mean inter-arrival time
+ * @returns void
+ */
+static void random_jobs(struct job *jobs, size_t n, double load)
+{
+    unsigned long long s = 88172645463325252ULL;
+    long time = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double u[2];
+        for (int k = 0; k < 2; k++)
+        {
+            s ^= s << 13;
+            s ^= s >> 7;
+            s ^= s << 17;
+            u[k] = ((s >> 11) + 0.5) / 9007199254740992.0;
+        }
+        jobs[i].id = (int)i + 1;
+        time += (long)(-10 / load * log(u[0]));
+        jobs[i].arrival = time;
+        jobs[i].burst = 1 + (long)(-9 * log(u[1]));
+        jobs[i].priority = (long)(s >> 61);
+    }
+}
+
+/**
+ * @brief Time-stepped simulation, one unit at a time with linear scans of
+ * the ready processes, to check simulate()
+ * @returns void
+ */
+static void simulate_slowly(struct job *jobs, size_t n, const struct policy *p)
+{
+    int *ready = (int *)malloc(n * sizeof(int));
+    char *arrived = (char *)calloc(n, 1);
+    size_t count = 0, done = 0;
+    long time = 0, used = 0, seq = 0;
+    int running = -1;
+    assert(ready != NULL && arrived != NULL);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        jobs[i].remaining = jobs[i].burst;
+        jobs[i].level = 0;
+    }
+    for (; done < n; time++)
+    {
+        // arrivals of this instant in FCFS order
+        for (;;)
+        {
+            int first = -1;
+            for (size_t i = 0; i < n; i++)
+                if (!arrived[i] && jobs[i].arrival <= time &&
+                    (first < 0 || fcfs_before(&jobs[i], &jobs[first])))
+                    first = (int)i;
+            if (first < 0)
+                break;
+            arrived[first] = 1;
+            jobs[first].seq = seq++;
+            ready[count++] = first;
+        }
+
+        if (running >= 0)
+        {
+            struct job *r = &jobs[running];
+            int best = -1;
+            for (size_t i = 0; i < count; i++)
+                if (best < 0 || p->before(&jobs[ready[i]], &jobs[best]))
+                    best = ready[i];
+            if (r->remaining == 0)
+            {
+                r->completion = time;
+                done++;
+                running = -1;
+            }
+            else if (quantum_of(p, r) > 0 && used == quantum_of(p, r))
+            {
+                if (r->level + 1 < p->levels)
+                    r->level++;
+                r->seq = seq++;
+                ready[count++] = running;
+                running = -1;
+            }
+            else if (p->preemptive && best >= 0 && p->before(&jobs[best], r))
+            {
+                r->seq = seq++;
+                ready[count++] = running;
+                running = -1;
+            }
+        }
+        if (running < 0 && count > 0)
+        {
+            size_t best = 0;
+            for (size_t i = 1; i < count; i++)
+                if (p->before(&jobs[ready[i]], &jobs[ready[best]]))
+                    best = i;
+            running = ready[best];
+            ready[best] = ready[--count];
+            used = 0;
+        }
+        if (running >= 0)
+        {
+            jobs[running].remaining--;
+            used++;
+        }
+    }
+    free(ready);
+    free(arrived);
+}
+
+/**
+ * @brief Self-test implementations
+ * @returns void
+ */
+static void test(void)
+{
+    // the processes of non_preemptive_priority_scheduling.c
+    const long table[5][4] = {
+        {1, 0, 5, 1}, {2, 1, 4, 2}, {3, 2, 3, 3}, {4, 3, 2, 4}, {5, 4, 1, 5}};
+    struct job jobs[5];
+    struct sched_stats st;
+    for (int i = 0; i < 5; i++)
+    {
+        jobs[i].id = (int)table[i][0];
+        jobs[i].arrival = table[i][1];
+        jobs[i].burst = table[i][2];
+        jobs[i].priority = table[i][3];
+    }
+    assert(simulate(jobs, 5, &policies[1], &st) == 0);
+    assert(st.avg_ct == 11 && st.avg_tat == 9 && st.avg_wt == 6);
+    assert(st.makespan == 15 && st.busy == 15 && st.dispatches == 5);
+
+    // SRTF: each arrival ties with the time P1 has left, so P1 keeps the
+    // processor, and then the others run shortest first
+    assert(simulate(jobs, 5, &policies[4], &st) == 0);
+    assert(jobs[0].completion == 5 && jobs[4].completion == 6);
+    assert(jobs[1].completion == 15 && st.dispatches == 5);
+
+    // every policy against the time-stepped simulation of random traces
+    struct job fast[40], slow[40];
+    const int n = 40;
+    srand(5);
+    for (int trial = 0; trial < 300; trial++)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            fast[i].id = i;
+            fast[i].arrival = rand() % (trial % 3 ? 60 : 200);
+            fast[i].burst = 1 + rand() % 12;
+            fast[i].priority = rand() % 4;
+        }
+        for (size_t k = 0; k < NUM_POLICIES; k++)
+        {
+            struct policy p = policies[k];
+            p.quantum = p.quantum ? 1 + trial % 5 : 0;
+            memcpy(slow, fast, sizeof(fast));
+            assert(simulate(fast, n, &p, &st) == 0);
+            simulate_slowly(slow, n, &p);
+            for (int i = 0; i < n; i++)
+                assert(fast[i].completion == slow[i].completion);
+        }
+    }
+
+    printf("[+] All tests have successfully passed!\n");
+}
+
+/**
+ * @brief Runs the policies on the processes and prints their statistics
+ * @param jobs processes
+ * @param n number of processes
+ * @param only name of the policy to run, NULL for all
+ * @param quantum quantum of RR and MLFQ
+ * @param out destination of the per-process results, or NULL
+ * @returns 0 on success, -1 on error
+ */
+static int run(struct job *jobs, size_t n, const char *only, long quantum,
+               FILE *out)
+{
+    size_t k = 0;
+    while (only != NULL && k < NUM_POLICIES && strcmp(only, policies[k].name))
+        k++;
+    if (k == NUM_POLICIES)
+    {
+        fprintf(stderr, "unknown policy %s\n", only);
+        return -1;
+    }
+
+    printf("%-20s %10s %10s %10s %10s %8s %6s %10s %8s\n", "policy", "avg CT",
+           "avg TAT", "avg WT", "avg RT", "max WT", "util", "dispatches",
+           "time (s)");
+    for (k = 0; k < NUM_POLICIES; k++)
+    {
+        struct policy p = policies[k];
+        struct sched_stats st;
+        if (only != NULL && strcmp(only, p.name) != 0)
+            continue;
+        if (p.quantum)
+            p.quantum = quantum;
+
+        clock_t t = clock();
+        if (simulate(jobs, n, &p, &st) < 0)
+        {
+            perror("simulate");
+            return -1;
+        }
+        printf("%-20s %10.1f %10.1f %10.1f %10.1f %8ld %5.1f%% %10ld %8.3f\n",
+               p.name, st.avg_ct, st.avg_tat, st.avg_wt, st.avg_rt, st.max_wt,
+               st.makespan ? 100.0 * st.busy / st.makespan : 0.0,
+               st.dispatches, (double)(clock() - t) / CLOCKS_PER_SEC);
+        if (out != NULL)
+            write_results(out, jobs, n);
+    }
+    return 0;
+}
+
+/**
+ * @brief Main function
+ *
+ * Usage: `scheduling_simulator [-p policy] [-q quantum] [-o results.csv]
+ * [trace.csv | -n processes]`. Without a trace, a million random processes
+ * at 90% load are simulated.
+ * @returns 0 on exit
+ */
+int main(int argc, char *argv[])
+{
+    const char *only = NULL, *trace = NULL, *results = NULL;
+    long quantum = 4, n = 1000000;
+    struct job *jobs;
+    FILE *out = NULL;
+
+    test();  // run self-test implementations
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "-p") == 0)
+            only = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-q") == 0)
+            quantum = strtol(argv[++i], NULL, 10);
+        else if (i + 1 < argc && strcmp(argv[i], "-n") == 0)
+            n = strtol(argv[++i], NULL, 10);
+        else if (i + 1 < argc && strcmp(argv[i], "-o") == 0)
+            results = argv[++i];
+        else
+            trace = argv[i];
+    }
+    if (quantum <= 0 || n <= 0 || n > 0x7fffffff || (results && !only))
+    {
+        fprintf(stderr, "usage: %s [-p policy] [-q quantum] "
+                        "[-o results.csv (with -p)] [trace.csv | -n count]\n",
+                argv[0]);
+        return 1;
+    }
+
+    if (trace != NULL)
+    {
+        FILE *fp = fopen(trace, "r");
+        if (fp == NULL)
+        {
+            perror(trace);
+            return 1;
+        }
+        n = read_trace(fp, &jobs);
+        fclose(fp);
+        if (n < 0 || n > 0x7fffffff)
+            return 1;
+    }
+    else
+    {
+        jobs = (struct job *)malloc(n * sizeof(struct job));
+        if (jobs == NULL)
+        {
+            perror("malloc");
+            return 1;
+        }
+        random_jobs(jobs, n, 0.9);
+        printf("%ld random processes at 90%% load\n", n);
+    }
+
+    if (results != NULL && (out = fopen(results, "w")) == NULL)
+        perror(results);
+    int ret = run(jobs, n, only, quantum, out);
+    if (out != NULL)
+        fclose(out);
+    free(jobs);
+    return ret < 0;
+}
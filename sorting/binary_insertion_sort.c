@@ -19,7 +19,7 @@ int binarySearch(int *arr, int key, int low, int high)
 {
     if (low >= high)
         return (key > arr[low]) ? (low + 1) : low;
-    int mid = low + (high - 1) / 2;
+    int mid = low + (high - low) / 2;
     if (arr[mid] == key)
         return mid + 1;
     else if (arr[mid] > key)
@@ -5,9 +5,13 @@
 void sort(int *numbers, int size)
 {
     int gap = size;
-    while (gap > 1)  // gap = 1 means that the array is sorted
+    int swapped = 1;
+    while (gap > 1 || swapped)  // a pass with gap 1 and no swap: sorted
     {
         gap = gap / SHRINK;
+        if (gap < 1)
+            gap = 1;
+        swapped = 0;
         int i = 0;
         while ((i + gap) < size)
         {  // similiar to the Shell Sort
@@ -16,6 +20,7 @@ void sort(int *numbers, int size)
                 int tmp = numbers[i];
                 numbers[i] = numbers[i + gap];
                 numbers[i + gap] = tmp;
+                swapped = 1;
             }
             i++;
         }
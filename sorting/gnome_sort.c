@@ -3,7 +3,7 @@
 
 void sort(int *numbers, int size)
 {
-    int pos = 0;
+    int pos = 1;
     while (pos < size)
     {
         if (numbers[pos] >= numbers[pos - 1])
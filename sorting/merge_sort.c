@@ -2,138 +2,206 @@
  * @file
  * @brief Implementation of [merge
  * sort](https://en.wikipedia.org/wiki/Merge_sort) algorithm
+ * @details
+ * The sorts are in merge_sort.h: merge_sort(), a bottom-up merge sort of
+ * ints in memory, parallel with OpenMP, and merge_sort_file(), an external
+ * merge sort of files larger than memory.
+ *
+ * Run `./merge_sort [n]` to compare with qsort() and the previous
+ * version of this file on n random keys (default 1000000), or
+ * `./merge_sort input output [run]` to sort a file of native ints using
+ * runs of `run` keys in memory (default 2^24).
  */
-#include <stdio.h>
-#include <stdlib.h>
+#include <assert.h>  /// for assert
+#include <stdio.h>   /// for FILE, fread, fwrite, tmpfile
+#include <stdlib.h>  /// for malloc, qsort
+#include <string.h>  /// for memcpy
+#include <time.h>    /// for clock
+#ifdef _OPENMP
+#include <omp.h>  /// for omp_set_num_threads, omp_get_wtime
+#endif
 
-/**
- * @addtogroup sorting Sorting algorithms
- * @{
- */
-/** Swap two integer variables
- * @param [in,out] a pointer to first variable
- * @param [in,out] b pointer to second variable
- */
-void swap(int *a, int *b)
-{
-    int t;
-    t = *a;
-    *a = *b;
-    *b = t;
-}
+#include "merge_sort.h"  /// for merge_sort, merge_sort_file
 
-/**
- * @brief Perform merge of segments.
- *
- * @param a array to sort
- * @param l left index for merge
- * @param r right index for merge
- * @param n total number of elements in the array
- */
-void merge(int *a, int l, int r, int n)
+/** previous version of merge_sort(): recursive, allocating every merge */
+static void merge_sort_previous(int *a, int n, int l, int r)
 {
-    int *b = (int *)malloc(n * sizeof(int)); /* dynamic memory must be freed */
-    if (b == NULL)
-    {
-        printf("Can't Malloc! Please try again.");
-        exit(EXIT_FAILURE);
-    }
-    int c = l;
-    int p1, p2;
-    p1 = l;
-    p2 = ((l + r) / 2) + 1;
-    while ((p1 < ((l + r) / 2) + 1) && (p2 < r + 1))
+    if (r - l == 1)
     {
-        if (a[p1] <= a[p2])
-        {
-            b[c++] = a[p1];
-            p1++;
-        }
-        else
+        if (a[l] > a[r])
         {
-            b[c++] = a[p2];
-            p2++;
+            int t = a[l];
+            a[l] = a[r];
+            a[r] = t;
         }
     }
-
-    if (p2 == r + 1)
+    else if (l != r)
     {
-        while ((p1 < ((l + r) / 2) + 1))
-        {
-            b[c++] = a[p1];
-            p1++;
-        }
+        int m = (l + r) / 2;
+        merge_sort_previous(a, n, l, m);
+        merge_sort_previous(a, n, m + 1, r);
+
+        int *b = (int *)malloc(n * sizeof(int));
+        int c = l, p1 = l, p2 = m + 1;
+        assert(b != NULL);
+        while (p1 <= m && p2 <= r) b[c++] = a[p1] <= a[p2] ? a[p1++] : a[p2++];
+        while (p1 <= m) b[c++] = a[p1++];
+        while (p2 <= r) b[c++] = a[p2++];
+        memcpy(a + l, b + l, (r + 1 - l) * sizeof(int));
+        free(b);
     }
-    else
-    {
-        while ((p2 < r + 1))
+}
+
+/** ascending order of ints for qsort() */
+static int cmp_int(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/** fills a with n pseudo-random keys below range */
+static void fill(int *a, size_t n, int range, unsigned seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < n; i++) a[i] = rand() % range;
+}
+
+/**
+ * Self-test: in-memory sorts of many sizes and an external sort that takes
+ * two merge passes.
+ * @returns void
+ */
+static void test(void)
+{
+    static const size_t sizes[] = {0,   1,    2,    31,    32,    33,
+                                   100, 1000, 4097, 65536, 200001};
+    int *a = (int *)malloc(200001 * sizeof(int));
+    int *b = (int *)malloc(200001 * sizeof(int));
+    int status;
+    size_t count;
+    assert(a != NULL && b != NULL);
+
+#ifdef _OPENMP
+    // more threads than merges on the last passes, even on one CPU
+    omp_set_num_threads(3);
+#endif
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        for (int range = 10; range <= 1000000; range *= 1000)
         {
-            b[c++] = a[p2];
-            p2++;
+            size_t n = sizes[s];
+            fill(a, n, range, (unsigned)n);
+            memcpy(b, a, n * sizeof(int));
+            status = merge_sort(a, n);
+            assert(status == 0);
+            qsort(b, n, sizeof(int), cmp_int);
+            assert(n == 0 || memcmp(a, b, n * sizeof(int)) == 0);
         }
-    }
 
-    for (c = l; c < r + 1; c++) a[c] = b[c];
+    // 40000 keys in runs of 100: 400 runs, merged by 16 then 2 passes
+    FILE *in = tmpfile(), *out = tmpfile();
+    assert(in != NULL && out != NULL);
+    fill(a, 40000, 5000, 1);
+    memcpy(b, a, 40000 * sizeof(int));
+    qsort(b, 40000, sizeof(int), cmp_int);
+    count = fwrite(a, sizeof(int), 40000, in);
+    assert(count == 40000);
+    rewind(in);
+    status = merge_sort_file(in, out, 100);
+    assert(status == 0);
+    rewind(out);
+    count = fread(a, sizeof(int), 40001, out);
+    assert(count == 40000);
+    assert(memcmp(a, b, 40000 * sizeof(int)) == 0);
+    fclose(in);
+    fclose(out);
+    (void)status;
+    (void)count;
 
+    free(a);
     free(b);
+    printf("All tests have successfully passed!\n");
 }
 
-/** Merge sort algorithm implementation
- * @param a array to sort
- * @param n number of elements in the array
- * @param l index to sort from
- * @param r index to sort till
- */
-void merge_sort(int *a, int n, int l, int r)
+/** times the sorts on n random keys */
+static void benchmark(size_t n)
 {
-    if (r - l == 1)
-    {
-        if (a[l] > a[r])
-            swap(&a[l], &a[r]);
-    }
-    else if (l != r)
-    {
-        merge_sort(a, n, l, (l + r) / 2);
-        merge_sort(a, n, ((l + r) / 2) + 1, r);
-        merge(a, l, r, n);
-    }
+    int *input = (int *)malloc(n * sizeof(int));
+    int *a = (int *)malloc(n * sizeof(int));
+    int *expected = (int *)malloc(n * sizeof(int));
+    clock_t start;
+    int status;
+    assert(input != NULL && a != NULL && expected != NULL);
+
+    fill(input, n, RAND_MAX, 42);
+    printf("\n%zu random keys\n", n);
+
+    memcpy(expected, input, n * sizeof(int));
+    start = clock();
+    qsort(expected, n, sizeof(int), cmp_int);
+    printf("qsort:                 %8.3f s\n",
+           (double)(clock() - start) / CLOCKS_PER_SEC);
 
-    /* no change if l == r */
+    memcpy(a, input, n * sizeof(int));
+    start = clock();
+    merge_sort_previous(a, (int)n, 0, (int)n - 1);
+    printf("previous merge_sort:   %8.3f s\n",
+           (double)(clock() - start) / CLOCKS_PER_SEC);
+    assert(memcmp(a, expected, n * sizeof(int)) == 0);
+
+#ifdef _OPENMP
+    int threads = omp_get_num_procs();
+    omp_set_num_threads(1);
+#endif
+    memcpy(a, input, n * sizeof(int));
+    start = clock();
+    status = merge_sort(a, n);
+    printf("merge_sort, 1 thread:  %8.3f s\n",
+           (double)(clock() - start) / CLOCKS_PER_SEC);
+    assert(status == 0 && memcmp(a, expected, n * sizeof(int)) == 0);
+
+#ifdef _OPENMP
+    // clock() adds up the time of all threads, so time the wall clock
+    omp_set_num_threads(threads);
+    memcpy(a, input, n * sizeof(int));
+    double wall = omp_get_wtime();
+    status = merge_sort(a, n);
+    printf("merge_sort, %d thread(s): %5.3f s (wall)\n", threads,
+           omp_get_wtime() - wall);
+    assert(status == 0 && memcmp(a, expected, n * sizeof(int)) == 0);
+#endif
+    (void)status;
+
+    free(input);
+    free(a);
+    free(expected);
 }
-/** @} */
 
-/** Main function */
-int main(void)
+/**
+ * @brief Main function
+ * @param argc number of arguments
+ * @param argv `[n]` to benchmark, or `input output [run]` to sort a file
+ * @returns 0 on exit
+ */
+int main(int argc, char **argv)
 {
-    int *a, n, i;
-    printf("Enter Array size: ");
-    scanf("%d", &n);
-    if (n <= 0) /* exit program if arraysize is not greater than 0 */
-    {
-        printf("Array size must be Greater than 0!\n");
-        return 1;
-    }
-    a = (int *)malloc(n * sizeof(int));
-    if (a == NULL) /* exit program if can't malloc memory */
+    if (argc >= 3)
     {
-        printf("Can't Malloc! Please try again.");
-        return 1;
+        FILE *in = fopen(argv[1], "rb");
+        FILE *out = in ? fopen(argv[2], "wb") : NULL;
+        size_t run = argc > 3 ? strtoul(argv[3], NULL, 10) : 1 << 24;
+        int status = -1;
+        if (in && out && run > 0)
+            status = merge_sort_file(in, out, run);
+        if (in)
+            fclose(in);
+        if (out && fclose(out) != 0)
+            status = -1;
+        if (status != 0)
+            perror("merge_sort");
+        return status == 0 ? 0 : 1;
     }
-    for (i = 0; i < n; i++)
-    {
-        printf("Enter number[%d]: ", i);
-        scanf("%d", &a[i]);
-    }
-
-    merge_sort(a, n, 0, n - 1);
-    printf("Sorted Array: ");
-    for (i = 0; i < n; i++)
-    {
-        printf("%d ", a[i]);
-    }
-    printf("\n");
-
-    free(a);
 
+    test();
+    benchmark(argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000);
     return 0;
 }
@@ -0,0 +1,408 @@
+/**
+ * @file
+ * @brief [Merge sort](https://en.wikipedia.org/wiki/Merge_sort) of ints, in
+ * memory with OpenMP and of files larger than memory
+ * @details
+ * merge_sort() is a bottom-up merge sort of ints:
+ *
+ * - runs of #MERGE_RUN keys are first insertion sorted in place;
+ * - the runs are then merged pairwise into a scratch buffer of n keys
+ *   allocated once, then back, doubling the run length at every pass, so
+ *   the keys ping-pong between the two buffers;
+ * - with OpenMP and at least #MERGE_PARALLEL_MIN keys, the runs and the
+ *   merges of a pass are shared among the threads. The last passes have
+ *   fewer merges than threads; each of their merges is split into equal
+ *   slices of the output whose inputs are found by co-ranking, a binary
+ *   search for the number of keys of each run in the slice.
+ *
+ * merge_sort_file() sorts a file of ints larger than memory: it cuts the
+ * input into runs that are sorted in memory and written to temporary
+ * files, then merges up to #MERGE_FAN_IN runs at a time with a heap.
+ *
+ * Both sorts are stable: on equal keys the one from the earlier run comes
+ * first. They return -1 if memory cannot be allocated, and merge_sort_file()
+ * also on a read or write error.
+ *
+ * merge_sort.c tests and times them, and sort_benchmark.c compares them with
+ * the other sorts of this folder.
+ */
+
+#ifndef MERGE_SORT_H
+#define MERGE_SORT_H
+
+#include <stdio.h>   /// for FILE, fread, fwrite, tmpfile
+#include <stdlib.h>  /// for malloc
+#include <string.h>  /// for memcpy
+#ifdef _OPENMP
+#include <omp.h>  /// for omp_get_thread_num, omp_get_num_threads
+#endif
+
+/** runs of this many keys are insertion sorted before merging */
+#define MERGE_RUN 32
+
+/** inputs smaller than this are sorted by one thread */
+#define MERGE_PARALLEL_MIN (1 << 16)
+
+/** runs merged at once by merge_sort_file() */
+#define MERGE_FAN_IN 16
+
+/** keys read or written at once per file by merge_sort_file() */
+#define MERGE_IO_KEYS 4096
+
+/**
+ * @addtogroup sorting Sorting algorithms
+ * @{
+ */
+
+/** insertion sort of a short run */
+static void merge_insertion_sort(int *a, size_t n)
+{
+    for (size_t i = 1; i < n; i++)
+    {
+        int key = a[i];
+        size_t j = i;
+        for (; j > 0 && key < a[j - 1]; j--) a[j] = a[j - 1];
+        a[j] = key;
+    }
+}
+
+/**
+ * @brief Stable merge of two sorted runs.
+ *
+ * @param a first run, whose keys come first on ties
+ * @param na length of a
+ * @param b second run
+ * @param nb length of b
+ * @param out output of na + nb keys, not overlapping the runs
+ */
+static void merge_pair(const int *a, size_t na, const int *b, size_t nb, int *out)
+{
+    size_t i = 0, j = 0, k = 0;
+
+    // the indices move by flags rather than branches, as the comparisons
+    // of random keys are unpredictable
+    while (i < na && j < nb)
+    {
+        int x = a[i], y = b[j], take_b = y < x;
+        out[k++] = take_b ? y : x;
+        i += !take_b;
+        j += take_b;
+    }
+    memcpy(out + k, a + i, (na - i) * sizeof(int));
+    memcpy(out + k + na - i, b + j, (nb - j) * sizeof(int));
+}
+
+#ifdef _OPENMP
+/**
+ * @brief Co-ranking: how many of the first k keys of the merge of a and b
+ * come from a.
+ *
+ * The merge of a[0..i) and b[0..k-i) is then the first k keys of the
+ * stable merge, so independent slices of the output can be merged apart.
+ * @returns i
+ */
+static size_t merge_co_rank(size_t k, const int *a, size_t na, const int *b,
+                      size_t nb)
+{
+    size_t lo = k > nb ? k - nb : 0, hi = k < na ? k : na;
+
+    // smallest i such that all the b[0..k-i) are before a[i]
+    while (lo < hi)
+    {
+        size_t i = lo + (hi - lo) / 2;
+        if (b[k - i - 1] < a[i])
+            hi = i;
+        else
+            lo = i + 1;
+    }
+    return lo;
+}
+
+/** merge_pair() shared by all the threads, each one producing a slice of out */
+static void merge_parallel(const int *a, size_t na, const int *b, size_t nb,
+                           int *out)
+{
+#pragma omp parallel
+    {
+        size_t t = (size_t)omp_get_thread_num();
+        size_t threads = (size_t)omp_get_num_threads();
+        size_t n = na + nb;
+        size_t k0 = n * t / threads, k1 = n * (t + 1) / threads;
+        size_t i0 = merge_co_rank(k0, a, na, b, nb);
+        size_t i1 = merge_co_rank(k1, a, na, b, nb);
+
+        merge_pair(a + i0, i1 - i0, b + (k0 - i0), (k1 - i1) - (k0 - i0),
+              out + k0);
+    }
+}
+#endif
+
+/**
+ * @brief Merge sort algorithm implementation
+ * @param a array to sort
+ * @param n number of elements in the array
+ * @returns 0 on success, -1 if the scratch buffer cannot be allocated
+ */
+static inline int merge_sort(int *a, size_t n)
+{
+    if (n <= MERGE_RUN)
+    {
+        merge_insertion_sort(a, n);
+        return 0;
+    }
+
+    int *scratch = (int *)malloc(n * sizeof(int));
+    if (scratch == NULL)
+        return -1;
+
+#ifdef _OPENMP
+    int threads = n >= MERGE_PARALLEL_MIN ? omp_get_max_threads() : 1;
+#endif
+
+    long runs = (long)((n + MERGE_RUN - 1) / MERGE_RUN);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+    for (long r = 0; r < runs; r++)
+    {
+        size_t lo = (size_t)r * MERGE_RUN;
+        merge_insertion_sort(a + lo, n - lo < MERGE_RUN ? n - lo : MERGE_RUN);
+    }
+
+    int *src = a, *dst = scratch;
+    for (size_t width = MERGE_RUN; width < n; width *= 2)
+    {
+        long pairs = (long)((n + 2 * width - 1) / (2 * width));
+
+#ifdef _OPENMP
+        if (threads > 1 && pairs < threads)
+        {
+            for (long p = 0; p < pairs; p++)
+            {
+                size_t lo = (size_t)p * 2 * width;
+                size_t mid = n - lo < width ? n : lo + width;
+                size_t hi = n - lo < 2 * width ? n : lo + 2 * width;
+                merge_parallel(src + lo, mid - lo, src + mid, hi - mid,
+                               dst + lo);
+            }
+        }
+        else
+#pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+            for (long p = 0; p < pairs; p++)
+            {
+                size_t lo = (size_t)p * 2 * width;
+                size_t mid = n - lo < width ? n : lo + width;
+                size_t hi = n - lo < 2 * width ? n : lo + 2 * width;
+                merge_pair(src + lo, mid - lo, src + mid, hi - mid, dst + lo);
+            }
+
+        int *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != a)
+        memcpy(a, src, n * sizeof(int));
+    free(scratch);
+    return 0;
+}
+
+/** buffered reader of the keys of a run file */
+struct merge_reader
+{
+    FILE *file;
+    int *keys;   ///< #MERGE_IO_KEYS keys
+    size_t pos;  ///< next key in keys
+    size_t len;  ///< keys in keys
+};
+
+/** reads the next key of a run; @returns 0 at the end of the run */
+static int merge_reader_next(struct merge_reader *r, int *key)
+{
+    if (r->pos == r->len)
+    {
+        r->len = fread(r->keys, sizeof(int), MERGE_IO_KEYS, r->file);
+        r->pos = 0;
+        if (r->len == 0)
+            return 0;
+    }
+    *key = r->keys[r->pos++];
+    return 1;
+}
+
+/** the next key of a run in the heap of merge_runs() */
+struct merge_head
+{
+    int key;
+    size_t run;
+};
+
+/** heap order: smaller key first, then earlier run, for stability */
+static int merge_head_less(struct merge_head x, struct merge_head y)
+{
+    return x.key < y.key || (x.key == y.key && x.run < y.run);
+}
+
+/** puts h at index i of the heap of n heads, moving it down */
+static void merge_head_sift(struct merge_head *heap, size_t n, size_t i,
+                      struct merge_head h)
+{
+    for (size_t child; (child = 2 * i + 1) < n; i = child)
+    {
+        if (child + 1 < n && merge_head_less(heap[child + 1], heap[child]))
+            child++;
+        if (!merge_head_less(heap[child], h))
+            break;
+        heap[i] = heap[child];
+    }
+    heap[i] = h;
+}
+
+/**
+ * @brief k-way merge of sorted run files.
+ *
+ * @param runs the run files, rewound and read to the end
+ * @param count number of runs
+ * @param out file the merge is appended to
+ * @returns 0 on success, -1 on allocation or I/O error
+ */
+static int merge_runs(FILE **runs, size_t count, FILE *out)
+{
+    struct merge_reader *readers =
+        (struct merge_reader *)calloc(count, sizeof(*readers));
+    struct merge_head *heap = (struct merge_head *)malloc(count * sizeof(*heap));
+    int *keys = (int *)malloc((count + 1) * MERGE_IO_KEYS * sizeof(int));
+    int *written = keys + count * MERGE_IO_KEYS;
+    size_t n = 0, pending = 0;
+    int status = -1;
+
+    if (readers == NULL || heap == NULL || keys == NULL)
+        goto done;
+
+    for (size_t r = 0; r < count; r++)
+    {
+        readers[r].file = runs[r];
+        readers[r].keys = keys + r * MERGE_IO_KEYS;
+        rewind(runs[r]);
+        if (merge_reader_next(&readers[r], &heap[n].key))
+            heap[n++].run = r;
+    }
+    for (size_t i = n / 2; i-- > 0;) merge_head_sift(heap, n, i, heap[i]);
+
+    while (n > 0)
+    {
+        struct merge_head top = heap[0];
+        written[pending++] = top.key;
+        if (pending == MERGE_IO_KEYS)
+        {
+            if (fwrite(written, sizeof(int), pending, out) != pending)
+                goto done;
+            pending = 0;
+        }
+
+        if (merge_reader_next(&readers[top.run], &top.key))
+            merge_head_sift(heap, n, 0, top);
+        else if (--n > 0)
+            merge_head_sift(heap, n, 0, heap[n]);
+    }
+
+    if (fwrite(written, sizeof(int), pending, out) != pending)
+        goto done;
+    status = 0;
+    for (size_t r = 0; r < count; r++)
+        if (ferror(runs[r]))
+            status = -1;
+
+done:
+    free(readers);
+    free(heap);
+    free(keys);
+    return status;
+}
+
+/**
+ * @brief External merge sort of a file of native ints.
+ *
+ * @param in input, read from its current position to the end
+ * @param out output, written from its current position
+ * @param run_len keys sorted in memory at once, > 0
+ * @returns 0 on success, -1 on allocation or I/O error
+ */
+static inline int merge_sort_file(FILE *in, FILE *out, size_t run_len)
+{
+    FILE **runs = NULL;
+    size_t count = 0, capacity = 0;
+    int status = -1;
+
+    // sorted runs
+    int *keys = (int *)malloc(run_len * sizeof(int));
+    if (keys == NULL)
+        return -1;
+    for (;;)
+    {
+        size_t n = fread(keys, sizeof(int), run_len, in);
+        if (n == 0)
+            break;
+        if (count == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 16;
+            FILE **more = (FILE **)realloc(runs, capacity * sizeof(FILE *));
+            if (more == NULL)
+                goto done;
+            runs = more;
+        }
+        if ((runs[count] = tmpfile()) == NULL)
+            goto done;
+        count++;
+        if (merge_sort(keys, n) != 0 ||
+            fwrite(keys, sizeof(int), n, runs[count - 1]) != n)
+            goto done;
+    }
+    if (ferror(in))
+        goto done;
+    free(keys);
+    keys = NULL;
+
+    // merge consecutive groups of runs until one pass is enough
+    while (count > MERGE_FAN_IN)
+    {
+        size_t merged = 0;
+        for (size_t first = 0; first < count; first += MERGE_FAN_IN)
+        {
+            size_t group = count - first < MERGE_FAN_IN ? count - first
+                                                        : MERGE_FAN_IN;
+            FILE *run = tmpfile();
+            if (run == NULL)
+                goto done;
+            if (merge_runs(runs + first, group, run) != 0)
+            {
+                fclose(run);
+                goto done;
+            }
+            for (size_t r = first; r < first + group; r++)
+            {
+                fclose(runs[r]);
+                runs[r] = NULL;
+            }
+            // the groups are merged in order, so this slot is free by now
+            runs[merged++] = run;
+        }
+        count = merged;
+    }
+
+    status = merge_runs(runs, count, out);
+    if (fflush(out) != 0)
+        status = -1;
+
+done:
+    free(keys);
+    for (size_t r = 0; r < count; r++)
+        if (runs[r] != NULL)
+            fclose(runs[r]);
+    free(runs);
+    return status;
+}
+/** @} */
+
+#endif /* MERGE_SORT_H */
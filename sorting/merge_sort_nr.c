@@ -12,13 +12,22 @@ two at the same time. The combined-sorted arrays are again combined and sorted
 with each other until one single unit of sorted array is achieved. */
 
 #include <stdio.h>
+#include <stdlib.h>
 
 void mergesort(int x[], int n);
 void show(int x[], int n);
 
 void mergesort(int x[], int n)
 {
-    int temp[50], i, j, k, lb1, lb2, ub1, ub2, size;
+    int *temp, i, j, k, lb1, lb2, ub1, ub2, size;
+
+    /* one buffer for all the passes, as large as the input */
+    temp = (int *)malloc(n * sizeof(int));
+    if (temp == NULL)
+    {
+        printf("Can't Malloc! Please try again.");
+        exit(EXIT_FAILURE);
+    }
 
     size = 1;
     while (size < n)
@@ -39,7 +48,7 @@ void mergesort(int x[], int n)
             j = lb2;
 
             while (i <= ub1 && j <= ub2)
-                if (x[i] < x[j])
+                if (x[i] <= x[j]) /* <= keeps equal keys in order */
                     temp[k++] = x[i++];
                 else
                     temp[k++] = x[j++];
@@ -57,6 +66,8 @@ void mergesort(int x[], int n)
 
         show(x, n);
     }
+
+    free(temp);
 }
 
 // function to show each pass
@@ -69,10 +80,15 @@ void show(int x[], int n)
 
 int main()  // main function
 {
-    int i, n, x[20];
+    int i, n, *x;
 
     printf("Enter the number of elements: ");
     scanf("%d", &n);
+    if (n <= 0)
+        return 0;
+    x = (int *)malloc(n * sizeof(int));
+    if (x == NULL)
+        return 1;
     printf("Enter the elements:\n");
     for (i = 0; i < n; i++) scanf("%d", &x[i]);
 
@@ -80,6 +96,7 @@ int main()  // main function
 
     printf("Sorted array is as shown:\n");
     for (i = 0; i < n; i++) printf("%d ", x[i]);
+    free(x);
     return 0;
 }
 
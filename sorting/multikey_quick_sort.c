@@ -1,16 +1,19 @@
-/* demo.c -- Implementations of multikey quicksort and ternary search trees
+/* demo.c -- Implementation of multikey quicksort
+   Bentley & Sedgewick, "Fast Algorithms for Sorting and Searching Strings".
    Usage
-    demo                  Run basic timings on /usr/dict/words
-    demo <file>           Run basic timings on <file>
-    demo <file> trysearch Interactive pm and nn search on <file>
-    demo <file> nncost    Run near neigbhor expers on <file>
-    demo <file> pmcost    Interactive partial match expers on <file>
+    demo                  Sort a few words and run the self-test
+    demo <n>              Also time qsort, ssort2 and ssort3 on n strings
  */
 
+#include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 // MULTIKEY QUICKSORT
 
@@ -198,189 +201,264 @@ void ssort2(char **a, int n, int depth)
 
 void ssort2main(char **a, int n) { ssort2(a, n, 0); }
 
-// TERNARY SEARCH TREE ALGS
+// The ternary search tree of the original demo (insertion, search, partial
+// match and near neighbour search) lives in
+// data_structures/ternary_search_tree as a reusable module.
+
+// ssort3 -- Parallel Multikey Quicksort on Cached Key Bytes
+// ssort2 reads x[i][depth] through the string pointer at every comparison,
+// a cache miss per string per pass. ssort3 keeps the next 8 bytes of every
+// key next to its pointer, packed big-endian into an integer so that one
+// integer comparison orders 8 characters. The strings are only read again
+// when a group of keys agree on all 8 bytes, to load the next 8. Pivots
+// are pseudo-medians instead of rand(), and the three partitions of large
+// groups are sorted as parallel OpenMP tasks.
 
-typedef struct tnode *Tptr;
-typedef struct tnode
+typedef struct
 {
-    char splitchar;
-    Tptr lokid, eqkid, hikid;
-} Tnode;
-Tptr root;
+    uint64_t cache;  // key bytes depth .. depth + 7, 0 past the end
+    char *str;
+} ckey;
 
-// Insert 1 -- Simple Insertion Algorithm
+#define SSORT3_INSERTION 16  // below this, insertion sort
+#define SSORT3_TASK 20000    // above this, a group becomes a task
 
-Tptr insert1(Tptr p, char *s)
+uint64_t loadcache(const char *s)
 {
-    if (p == 0)
-    {
-        p = (Tptr)malloc(sizeof(Tnode));
-        p->splitchar = *s;
-        p->lokid = p->eqkid = p->hikid = 0;
-    }
-    if (*s < p->splitchar)
-        p->lokid = insert1(p->lokid, s);
-    else if (*s == p->splitchar)
-    {
-        if (*s != 0)
-            p->eqkid = insert1(p->eqkid, ++s);
-    }
-    else
-        p->hikid = insert1(p->hikid, s);
-    return p;
+    uint64_t c = 0;
+    for (int i = 0; i < 8 && s[i]; i++)
+        c |= (uint64_t)(unsigned char)s[i] << (56 - 8 * i);
+    return c;
 }
 
-void cleanup1(Tptr p)
+void refill(ckey *a, size_t n, size_t depth)
 {
-    if (p)
-    {
-        cleanup1(p->lokid);
-        cleanup1(p->eqkid);
-        cleanup1(p->hikid);
-        free(p);
-    }
+    for (size_t i = 0; i < n; i++) a[i].cache = loadcache(a[i].str + depth);
 }
 
-// Insert 2 -- Faster version of Insert
+// All keys of an equal group end within the cache iff its last byte is 0
+#define ended(c) (((c)&0xff) == 0)
 
-#define BUFSIZE 1000
-Tptr buffer;
-int bufn, freen;
-void *freearr[10000];
-int storestring = 0;
+void ssort3(ckey *a, size_t n, size_t depth);
 
-void insert2(char *s)
+void inssort3(ckey *a, size_t n, size_t depth)
 {
-    int d;
-    char *instr = s;
-
-    Tptr pp, *p;
-    p = &root;
-    pp = *p;
-    while (pp == *p)
+    for (size_t i = 1; i < n; i++)
     {
-        if ((d = *s - pp->splitchar) == 0)
-        {
-            if (*s++ == 0)
-                return;
-            p = &(pp->eqkid);
-        }
-        else if (d < 0)
-            p = &(pp->lokid);
-        else
-            p = &(pp->hikid);
+        ckey t = a[i];
+        size_t j = i;
+        for (; j > 0 && a[j - 1].cache > t.cache; j--) a[j] = a[j - 1];
+        a[j] = t;
     }
-    for (;;)
+    // runs of equal caches are still unsorted past them
+    for (size_t i = 0, j; i < n; i = j)
     {
-        // *p = (Tptr) malloc(sizeof(Tnode));
-        if (bufn-- == 0)
+        for (j = i + 1; j < n && a[j].cache == a[i].cache; j++)
+            ;
+        if (j - i > 1 && !ended(a[i].cache))
         {
-            buffer = (Tptr)malloc(BUFSIZE * sizeof(Tnode));
-            freearr[freen++] = (void *)buffer;
-            bufn = BUFSIZE - 1;
+            refill(a + i, j - i, depth + 8);
+            inssort3(a + i, j - i, depth + 8);
         }
-        *p = buffer++;
-        pp = *p;
-        pp->splitchar = *s;
-        pp->lokid = pp->eqkid = pp->hikid = 0;
-        if (*s++ == 0)
-        {
-            if (storestring)
-                pp->eqkid = (Tptr)instr;
-            return;
-        }
-        p = &(pp->eqkid);
     }
 }
-void cleanup2()
+
+uint64_t median3(uint64_t x, uint64_t y, uint64_t z)
 {
-    int i;
-    for (i = 0; i < freen; i++) free(freearr[i]);
+    if (x < y)
+        return y < z ? y : (x < z ? z : x);
+    return x < z ? x : (y < z ? z : y);
 }
 
-// Search Algorithms
+#define med3cache(a, i, j, k) median3(a[i].cache, a[j].cache, a[k].cache)
 
-int search1(char *s)
+void ssort3group(ckey *a, size_t n, size_t depth)
 {
-    Tptr p;
-    p = root;
-    while (p)
+    if (n <= 1)
+        return;
+    if (n > SSORT3_TASK)
     {
-        if (*s < p->splitchar)
-            p = p->lokid;
-        else if (*s == p->splitchar)
-        {
-            if (*s++ == 0)
-                return 1;
-            p = p->eqkid;
-        }
-        else
-            p = p->hikid;
+#ifdef _OPENMP
+#pragma omp task
+#endif
+        ssort3(a, n, depth);
     }
-    return 0;
+    else
+        ssort3(a, n, depth);
 }
 
-int search2(char *s)
+void ssort3(ckey *a, size_t n, size_t depth)
 {
-    int d, sc;
-    Tptr p;
-    sc = *s;
-    p = root;
-    while (p)
+    if (n < SSORT3_INSERTION)
     {
-        if ((d = sc - p->splitchar) == 0)
+        inssort3(a, n, depth);
+        return;
+    }
+
+    size_t m = n / 2, d = n / 8;
+    uint64_t v;
+    if (n > 30)
+    {  // On big arrays, pseudomedian of 9
+        uint64_t l = med3cache(a, 0, d, 2 * d);
+        uint64_t c = med3cache(a, m - d, m, m + d);
+        uint64_t r = med3cache(a, n - 1 - 2 * d, n - 1 - d, n - 1);
+        v = median3(l, c, r);
+    }
+    else
+        v = med3cache(a, 0, m, n - 1);
+
+    // [0, lt) < v, [lt, gt) == v, [gt, n) > v
+    size_t lt = 0, i = 0, gt = n;
+    while (i < gt)
+    {
+        ckey t = a[i];
+        if (t.cache < v)
+        {
+            a[i++] = a[lt];
+            a[lt++] = t;
+        }
+        else if (t.cache > v)
         {
-            if (sc == 0)
-                return 1;
-            sc = *++s;
-            p = p->eqkid;
+            a[i] = a[--gt];
+            a[gt] = t;
         }
-        else if (d < 0)
-            p = p->lokid;
         else
-            p = p->hikid;
+            i++;
+    }
+
+    ssort3group(a, lt, depth);
+    if (!ended(v) && gt - lt > 1)
+    {
+        refill(a + lt, gt - lt, depth + 8);
+        ssort3group(a + lt, gt - lt, depth + 8);
+    }
+    ssort3group(a + gt, n - gt, depth);
+}
+
+// Returns -1 if the n * 16 bytes of keys cannot be allocated
+int ssort3main(char **x, size_t n)
+{
+    ckey *a = (ckey *)malloc(n * sizeof(ckey));
+    if (a == NULL)
+        return -1;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (size_t i = 0; i < n; i++)
+    {
+        a[i].str = x[i];
+        a[i].cache = loadcache(x[i]);
     }
+
+#ifdef _OPENMP
+#pragma omp parallel
+#pragma omp single nowait
+#endif
+    ssort3(a, n, 0);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (size_t i = 0; i < n; i++) x[i] = a[i].str;
+    free(a);
     return 0;
 }
 
-// Advanced searching: Partial match, near words
+// TESTS AND TIMINGS
 
-int nodecnt;
-char *srcharr[100000];
-int srchtop;
+int cmpstr(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
 
-void pmsearch(Tptr p, char *s)
+double seconds()
 {
-    if (!p)
-        return;
-    nodecnt++;
-    if (*s == '.' || *s < p->splitchar)
-        pmsearch(p->lokid, s);
-    if (*s == '.' || *s == p->splitchar)
-        if (p->splitchar && *s)
-            pmsearch(p->eqkid, s + 1);
-    if (*s == 0 && p->splitchar == 0)
-        srcharr[srchtop++] = (char *)p->eqkid;
-    if (*s == '.' || *s > p->splitchar)
-        pmsearch(p->hikid, s);
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
 }
 
-void nearsearch(Tptr p, char *s, int d)
+// n strings stored in *block: prefix, then up to len random letters from
+// the first k of the alphabet (bytes above 127 if high is set)
+char **makestrings(size_t n, const char *prefix, int len, int k, int high,
+                   char **block)
 {
-    if (!p || d < 0)
-        return;
-    nodecnt++;
-    if (d > 0 || *s < p->splitchar)
-        nearsearch(p->lokid, s, d);
-    if (p->splitchar == 0)
+    size_t plen = strlen(prefix), size = plen + len + 1;
+    char **x = (char **)malloc((n ? n : 1) * sizeof(char *));
+    *block = (char *)malloc(n ? n * size : 1);
+    for (size_t i = 0; i < n; i++)
     {
-        if ((int)strlen(s) <= d)
-            srcharr[srchtop++] = (char *)p->eqkid;
+        x[i] = *block + i * size;
+        memcpy(x[i], prefix, plen);
+        int l = len ? rand() % (len + 1) : 0;
+        for (int j = 0; j < l; j++)
+            x[i][plen + j] = (char)((high ? 0x80 : 'a') + rand() % k);
+        x[i][plen + l] = 0;
     }
-    else
-        nearsearch(p->eqkid, *s ? s + 1 : s, (*s == p->splitchar) ? d : d - 1);
-    if (d > 0 || *s > p->splitchar)
-        nearsearch(p->hikid, s, d);
+    return x;
+}
+
+static void test()
+{
+    struct
+    {
+        size_t n;
+        const char *prefix;
+        int len, k, high;
+    } cases[] = {
+        {0, "", 0, 1, 0},        {1, "a", 0, 1, 0},
+        {100, "", 0, 1, 0},      {1000, "", 3, 2, 0},
+        {5000, "", 20, 26, 0},   {5000, "", 40, 2, 0},
+        {50000, "common/prefix/longer/than/8/", 12, 4, 0},
+        {3000, "", 10, 50, 1},   {100000, "", 5, 26, 0},
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        size_t n = cases[c].n;
+        char *block;
+        char **x = makestrings(n, cases[c].prefix, cases[c].len, cases[c].k,
+                               cases[c].high, &block);
+        char **y = (char **)malloc((n ? n : 1) * sizeof(char *));
+        memcpy(y, x, n * sizeof(char *));
+        qsort(y, n, sizeof(char *), cmpstr);
+        assert(ssort3main(x, n) == 0);
+        for (size_t i = 0; i < n; i++) assert(strcmp(x[i], y[i]) == 0);
+        free(block);
+        free(x);
+        free(y);
+    }
+    printf("All tests have successfully passed!\n");
+}
+
+void timing(size_t n, const char *name, const char *prefix, int len)
+{
+    char *block;
+    char **x = makestrings(n, prefix, len, 26, 0, &block);
+    char **y = (char **)malloc(n * sizeof(char *));
+    char **z = (char **)malloc(n * sizeof(char *));
+    memcpy(y, x, n * sizeof(char *));
+    memcpy(z, x, n * sizeof(char *));
+
+    double t = seconds();
+    qsort(x, n, sizeof(char *), cmpstr);
+    double tq = seconds() - t;
+    t = seconds();
+    ssort2main(y, (int)n);
+    double t2 = seconds() - t;
+    t = seconds();
+    ssort3main(z, n);
+    double t3 = seconds() - t;
+    for (size_t i = 0; i < n; i++)
+        assert(strcmp(x[i], y[i]) == 0 && strcmp(x[i], z[i]) == 0);
+    printf("%-24s %9.3f %9.3f %9.3f\n", name, tq, t2, t3);
+
+    free(block);
+    free(x);
+    free(y);
+    free(z);
 }
 
 #define NUMBER_OF_STRING 3
@@ -395,4 +473,17 @@ int main(int argc, char *argv[])
     {
         printf("%s ", arr[i]);
     }
+    printf("\n");
+
+    test();
+
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 0;
+    if (n > 0)
+    {
+        printf("\n%zu strings, seconds      qsort    ssort2    ssort3\n", n);
+        timing(n, "random, length 0-20", "", 20);
+        timing(n, "random, length 0-6", "", 6);
+        timing(n, "shared 24 byte prefix", "https://www.example.com/", 12);
+    }
+    return 0;
 }
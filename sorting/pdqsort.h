@@ -0,0 +1,827 @@
+/**
+ * @file
+ * @brief [Pattern-defeating
+ * quicksort](https://arxiv.org/abs/2106.05123) (pdqsort), an introsort that
+ * is linear on sorted and few-unique inputs
+ * @details
+ * Follows the algorithm of Orson Peters:
+ *
+ * - ranges of fewer than #PDQ_INSERTION_MAX elements are insertion sorted;
+ * - the pivot is the median of 3 elements, or above #PDQ_NINTHER_MIN
+ *   elements the median of the medians of 3 around the quartiles and the
+ *   middle (Tukey's ninther), as in the sort_unstable of Rust; sampling the
+ *   quartiles rather than the ends gives good pivots on organ-pipe inputs.
+ *   If every compare-exchange of the ninther swapped, the range is likely
+ *   descending and is reversed first;
+ * - partitioning works on blocks of #PDQ_BLOCK elements: the positions of
+ *   the misplaced elements of a block are first recorded without branching
+ *   on the comparisons, then swapped in one go, which avoids most of the
+ *   branch mispredictions of a classic partition on random data;
+ * - a pivot equal to the element before the range (a pivot of the parent
+ *   partition) means the range holds many equal keys: these are put on the
+ *   left and skipped in one pass, so few-unique inputs take linear time;
+ * - a partition that made no swap is checked with an insertion sort that
+ *   gives up after #PDQ_PARTIAL_LIMIT moves, which sorts ascending and
+ *   nearly sorted ranges in linear time;
+ * - a badly unbalanced partition swaps a few elements around to break the
+ *   pattern, and after log2(n) of them the range is heapsorted, which
+ *   bounds the worst case to O(n log n).
+ *
+ * The sort is not stable. Two flavours are provided:
+ *
+ * - pdqsort() has the interface of qsort();
+ * - PDQSORT_DEFINE(name, T, less) defines `void name(T *a, size_t n)` for
+ *   one element type, with `less(x, y)` a macro or function of two values
+ *   of type T. The comparisons are then inlined and compiled to conditional
+ *   moves, which makes it about twice as fast as pdqsort().
+ *
+ * sort_benchmark.c compares them with qsort() and the sorts of
+ * merge_sort.h and radix_sort.h. With glibc, whose qsort() is a merge sort,
+ * the typed sort is faster on every input; pdqsort() too, except on
+ * organ-pipe inputs, which merge in a few predictable passes.
+ */
+
+#ifndef PDQSORT_H
+#define PDQSORT_H
+
+#include <stddef.h>  /// for size_t, max_align_t
+#include <stdint.h>  /// for uint32_t, uint64_t
+#include <stdlib.h>  /// for malloc, free
+#include <string.h>  /// for memcpy
+
+/** ranges smaller than this are insertion sorted */
+#define PDQ_INSERTION_MAX 24
+/** ranges larger than this take the pivot as a ninther */
+#define PDQ_NINTHER_MIN 128
+/** most moves done by an insertion sort that checks a partition */
+#define PDQ_PARTIAL_LIMIT 8
+/** elements compared before swapping in block partitioning; at most 255 */
+#define PDQ_BLOCK 64
+/** largest element size for which pdqsort() does not allocate */
+#define PDQ_STACK_SIZE 128
+/** swaps done by the ninther on a descending range */
+#define PDQ_NINTHER_SWAPS 12
+
+/** floor of the base 2 logarithm of n, n > 0 */
+static inline int pdq_log2(size_t n)
+{
+    int log = 0;
+    while (n >>= 1) log++;
+    return log;
+}
+
+/** state shared by the functions of the generic sort */
+struct pdq_ctx
+{
+    size_t size;                            ///< size of an element
+    int (*cmp)(const void *, const void *);  ///< qsort() comparator
+    unsigned char *pivot;  ///< room for the pivot while partitioning
+    unsigned char *tmp;    ///< room for one element being moved
+};
+
+/** copies one element; the common sizes get an inlined copy */
+static inline void pdq_copy(void *dst, const void *src, size_t size)
+{
+    if (size == sizeof(uint32_t))
+        memcpy(dst, src, sizeof(uint32_t));
+    else if (size == sizeof(uint64_t))
+        memcpy(dst, src, sizeof(uint64_t));
+    else
+        memcpy(dst, src, size);
+}
+
+/** swaps two elements through a small buffer */
+static inline void pdq_swap(unsigned char *a, unsigned char *b, size_t size)
+{
+    unsigned char chunk[64];
+
+    if (size == sizeof(uint32_t) || size == sizeof(uint64_t))
+    {
+        pdq_copy(chunk, a, size);
+        pdq_copy(a, b, size);
+        pdq_copy(b, chunk, size);
+        return;
+    }
+    for (; size > sizeof(chunk); size -= sizeof(chunk))
+    {
+        memcpy(chunk, a, sizeof(chunk));
+        memcpy(a, b, sizeof(chunk));
+        memcpy(b, chunk, sizeof(chunk));
+        a += sizeof(chunk);
+        b += sizeof(chunk);
+    }
+    memcpy(chunk, a, size);
+    memcpy(a, b, size);
+    memcpy(b, chunk, size);
+}
+
+/** orders two elements, counting the swaps */
+static inline void pdq_sort2(const struct pdq_ctx *c, unsigned char *a,
+                             unsigned char *b, int *swaps)
+{
+    if (c->cmp(b, a) < 0)
+    {
+        pdq_swap(a, b, c->size);
+        (*swaps)++;
+    }
+}
+
+/** orders three elements, counting the swaps */
+static inline void pdq_sort3(const struct pdq_ctx *c, unsigned char *a,
+                             unsigned char *b, unsigned char *d, int *swaps)
+{
+    pdq_sort2(c, a, b, swaps);
+    pdq_sort2(c, b, d, swaps);
+    pdq_sort2(c, a, b, swaps);
+}
+
+/** reverses the order of the elements of [begin, end) */
+static void pdq_reverse(const struct pdq_ctx *c, unsigned char *begin,
+                        unsigned char *end)
+{
+    for (end -= c->size; begin < end; begin += c->size, end -= c->size)
+        pdq_swap(begin, end, c->size);
+}
+
+/**
+ * Insertion sort of [begin, end). Unless leftmost, the element before
+ * begin is not greater than any in the range and stops the inner loop.
+ */
+static void pdq_insertion(const struct pdq_ctx *c, unsigned char *begin,
+                          unsigned char *end, int leftmost)
+{
+    size_t s = c->size;
+
+    if (begin == end)
+        return;
+    for (unsigned char *cur = begin + s; cur != end; cur += s)
+    {
+        unsigned char *sift = cur;
+        if (c->cmp(sift, sift - s) >= 0)
+            continue;
+        pdq_copy(c->tmp, sift, s);
+        do
+        {
+            pdq_copy(sift, sift - s, s);
+            sift -= s;
+        } while ((!leftmost || sift != begin) && c->cmp(c->tmp, sift - s) < 0);
+        pdq_copy(sift, c->tmp, s);
+    }
+}
+
+/**
+ * Insertion sort of [begin, end) that stops after #PDQ_PARTIAL_LIMIT moved
+ * elements. @returns 1 if the range got sorted, 0 otherwise
+ */
+static int pdq_partial_insertion(const struct pdq_ctx *c, unsigned char *begin,
+                                 unsigned char *end)
+{
+    size_t s = c->size, moved = 0;
+
+    if (begin == end)
+        return 1;
+    for (unsigned char *cur = begin + s; cur != end; cur += s)
+    {
+        if (moved > PDQ_PARTIAL_LIMIT)
+            return 0;
+        unsigned char *sift = cur;
+        if (c->cmp(sift, sift - s) >= 0)
+            continue;
+        pdq_copy(c->tmp, sift, s);
+        do
+        {
+            pdq_copy(sift, sift - s, s);
+            sift -= s;
+        } while (sift != begin && c->cmp(c->tmp, sift - s) < 0);
+        pdq_copy(sift, c->tmp, s);
+        moved += (size_t)(cur - sift) / s;
+    }
+    return 1;
+}
+
+/** heapsort of n elements from base, the fallback for bad inputs */
+static void pdq_heapsort(const struct pdq_ctx *c, unsigned char *base,
+                         size_t n)
+{
+    size_t s = c->size;
+
+    for (size_t top = n / 2, end = n; end > 1;)
+    {
+        size_t i;
+        if (top > 0)  // build the heap
+            i = --top;
+        else  // move the largest element behind the heap
+        {
+            pdq_swap(base, base + --end * s, s);
+            i = 0;
+        }
+        for (size_t child; (child = 2 * i + 1) < end; i = child)
+        {
+            if (child + 1 < end &&
+                c->cmp(base + child * s, base + (child + 1) * s) < 0)
+                child++;
+            if (c->cmp(base + i * s, base + child * s) >= 0)
+                break;
+            pdq_swap(base + i * s, base + child * s, s);
+        }
+    }
+}
+
+/**
+ * Swaps the elements at the num recorded offsets on both sides. When the
+ * two sides do not have the same number of misplaced elements, they are
+ * moved in one cycle through c->tmp, which needs fewer copies.
+ */
+static void pdq_swap_offsets(const struct pdq_ctx *c, unsigned char *first,
+                             unsigned char *last,
+                             const unsigned char *offsets_l,
+                             const unsigned char *offsets_r, size_t num,
+                             int use_swaps)
+{
+    size_t s = c->size;
+
+    if (use_swaps)
+    {
+        for (size_t i = 0; i < num; i++)
+            pdq_swap(first + offsets_l[i] * s, last - offsets_r[i] * s, s);
+    }
+    else if (num > 0)
+    {
+        unsigned char *l = first + offsets_l[0] * s;
+        unsigned char *r = last - offsets_r[0] * s;
+        pdq_copy(c->tmp, l, s);
+        pdq_copy(l, r, s);
+        for (size_t i = 1; i < num; i++)
+        {
+            l = first + offsets_l[i] * s;
+            pdq_copy(r, l, s);
+            r = last - offsets_r[i] * s;
+            pdq_copy(l, r, s);
+        }
+        pdq_copy(r, c->tmp, s);
+    }
+}
+
+/**
+ * Partitions [begin, end) around *begin into the elements less than the
+ * pivot and those not less. The range holds at least 3 elements and the
+ * median of 3 choice guarantees an element not less than the pivot after
+ * it and one not greater before the end, which guard the first scans.
+ * @returns the final position of the pivot; *already is set when no
+ * element had to be moved
+ */
+static unsigned char *pdq_partition_right(const struct pdq_ctx *c,
+                                          unsigned char *begin,
+                                          unsigned char *end, int *already)
+{
+    size_t s = c->size;
+    unsigned char *pivot = c->pivot;
+    unsigned char *first = begin, *last = end;
+
+    pdq_copy(pivot, begin, s);
+    do first += s;
+    while (c->cmp(first, pivot) < 0);
+    if (first - s == begin)
+        while (first < last && (last -= s, c->cmp(last, pivot) >= 0)) continue;
+    else
+        do last -= s;
+        while (c->cmp(last, pivot) >= 0);
+
+    *already = first >= last;
+    if (!*already)
+    {
+        unsigned char offsets_l[PDQ_BLOCK], offsets_r[PDQ_BLOCK];
+        size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+
+        pdq_swap(first, last, s);
+        first += s;
+
+        unsigned char *base_l = first, *base_r = last;
+        while (first < last)
+        {
+            // fill the side(s) whose offsets are used up
+            size_t unknown = (size_t)(last - first) / s;
+            size_t split_l = num_l ? 0 : num_r ? unknown : unknown / 2;
+            size_t split_r = num_r ? 0 : unknown - split_l;
+            if (split_l > PDQ_BLOCK)
+                split_l = PDQ_BLOCK;
+            if (split_r > PDQ_BLOCK)
+                split_r = PDQ_BLOCK;
+
+            for (size_t i = 0; i < split_l; i++, first += s)
+            {
+                offsets_l[num_l] = (unsigned char)i;
+                num_l += c->cmp(first, pivot) >= 0;
+            }
+            for (size_t i = 0; i < split_r;)
+            {
+                offsets_r[num_r] = (unsigned char)++i;
+                last -= s;
+                num_r += c->cmp(last, pivot) < 0;
+            }
+
+            size_t num = num_l < num_r ? num_l : num_r;
+            pdq_swap_offsets(c, base_l, base_r, offsets_l + start_l,
+                             offsets_r + start_r, num, num_l == num_r);
+            num_l -= num;
+            num_r -= num;
+            start_l += num;
+            start_r += num;
+            if (num_l == 0)
+            {
+                start_l = 0;
+                base_l = first;
+            }
+            if (num_r == 0)
+            {
+                start_r = 0;
+                base_r = last;
+            }
+        }
+
+        // at most one side has misplaced elements left
+        if (num_l)
+        {
+            while (num_l--)
+            {
+                last -= s;
+                pdq_swap(base_l + offsets_l[start_l + num_l] * s, last, s);
+            }
+            first = last;
+        }
+        if (num_r)
+        {
+            while (num_r--)
+            {
+                pdq_swap(base_r - offsets_r[start_r + num_r] * s, first, s);
+                first += s;
+            }
+        }
+    }
+
+    unsigned char *pivot_pos = first - s;
+    pdq_copy(begin, pivot_pos, s);
+    pdq_copy(pivot_pos, pivot, s);
+    return pivot_pos;
+}
+
+/**
+ * Partitions [begin, end) around *begin into the elements not greater than
+ * the pivot and those greater. Used when the element before the range
+ * equals the pivot: the left part then only holds keys equal to the pivot
+ * and needs no more sorting.
+ * @returns the final position of the pivot
+ */
+static unsigned char *pdq_partition_left(const struct pdq_ctx *c,
+                                         unsigned char *begin,
+                                         unsigned char *end)
+{
+    size_t s = c->size;
+    unsigned char *pivot = c->pivot;
+    unsigned char *first = begin, *last = end;
+
+    pdq_copy(pivot, begin, s);
+    do last -= s;
+    while (c->cmp(pivot, last) < 0);
+    if (last + s == end)
+        while (first < last && (first += s, c->cmp(pivot, first) >= 0))
+            continue;
+    else
+        do first += s;
+        while (c->cmp(pivot, first) >= 0);
+
+    while (first < last)
+    {
+        pdq_swap(first, last, s);
+        do last -= s;
+        while (c->cmp(pivot, last) < 0);
+        do first += s;
+        while (c->cmp(pivot, first) >= 0);
+    }
+
+    pdq_copy(begin, last, s);
+    pdq_copy(last, pivot, s);
+    return last;
+}
+
+/** swaps a few of the n elements of [lo, hi) to break a bad pattern */
+static void pdq_break_patterns(const struct pdq_ctx *c, unsigned char *lo,
+                               unsigned char *hi, size_t n)
+{
+    size_t s = c->size, q = n / 4;
+
+    if (n < PDQ_INSERTION_MAX)
+        return;
+    pdq_swap(lo, lo + q * s, s);
+    pdq_swap(hi - s, hi - q * s, s);
+    if (n > PDQ_NINTHER_MIN)
+    {
+        pdq_swap(lo + s, lo + (q + 1) * s, s);
+        pdq_swap(lo + 2 * s, lo + (q + 2) * s, s);
+        pdq_swap(hi - 2 * s, hi - (q + 1) * s, s);
+        pdq_swap(hi - 3 * s, hi - (q + 2) * s, s);
+    }
+}
+
+/** sorts [begin, end); recurses on the left part and loops on the right */
+static void pdq_loop(const struct pdq_ctx *c, unsigned char *begin,
+                     unsigned char *end, int bad_allowed, int leftmost)
+{
+    size_t s = c->size;
+
+    for (;;)
+    {
+        size_t n = (size_t)(end - begin) / s;
+        if (n < PDQ_INSERTION_MAX)
+        {
+            pdq_insertion(c, begin, end, leftmost);
+            return;
+        }
+
+        // move the pivot to begin
+        size_t h = n / 2;
+        int swaps = 0;
+        if (n > PDQ_NINTHER_MIN)
+        {
+            size_t q = n / 4;
+            unsigned char *lo = begin + q * s, *mid = begin + h * s;
+            unsigned char *hi = end - q * s;
+            pdq_sort3(c, lo - s, lo, lo + s, &swaps);
+            pdq_sort3(c, mid - s, mid, mid + s, &swaps);
+            pdq_sort3(c, hi - s, hi, hi + s, &swaps);
+            pdq_sort3(c, lo, mid, hi, &swaps);
+            if (swaps == PDQ_NINTHER_SWAPS)
+            {
+                pdq_reverse(c, begin, end);
+                h = n - 1 - h;
+            }
+            pdq_swap(begin, begin + h * s, s);
+        }
+        else
+            pdq_sort3(c, begin + h * s, begin, end - s, &swaps);
+
+        if (!leftmost && c->cmp(begin - s, begin) >= 0)
+        {
+            begin = pdq_partition_left(c, begin, end) + s;
+            continue;
+        }
+
+        int already;
+        unsigned char *pivot = pdq_partition_right(c, begin, end, &already);
+        size_t l = (size_t)(pivot - begin) / s;
+        size_t r = n - l - 1;
+
+        if (l < n / 8 || r < n / 8)
+        {
+            if (--bad_allowed == 0)
+            {
+                pdq_heapsort(c, begin, n);
+                return;
+            }
+            pdq_break_patterns(c, begin, pivot, l);
+            pdq_break_patterns(c, pivot + s, end, r);
+        }
+        else if (already && pdq_partial_insertion(c, begin, pivot) &&
+                 pdq_partial_insertion(c, pivot + s, end))
+            return;
+
+        pdq_loop(c, begin, pivot, bad_allowed, leftmost);
+        begin = pivot + s;
+        leftmost = 0;
+    }
+}
+
+/**
+ * Sorts n elements of the given size from base in the order of cmp, like
+ * qsort(). Elements larger than #PDQ_STACK_SIZE need a small allocation;
+ * if it fails the array is heapsorted instead.
+ */
+static void pdqsort(void *base, size_t n, size_t size,
+                    int (*cmp)(const void *, const void *))
+{
+    union
+    {
+        max_align_t align;
+        unsigned char bytes[2 * PDQ_STACK_SIZE];
+    } buf;
+    struct pdq_ctx c = {size, cmp, buf.bytes, buf.bytes + PDQ_STACK_SIZE};
+    unsigned char *heap = NULL;
+
+    if (n < 2 || size == 0)
+        return;
+    if (size > PDQ_STACK_SIZE)
+    {
+        heap = (unsigned char *)malloc(2 * size);
+        if (heap == NULL)
+        {
+            pdq_heapsort(&c, (unsigned char *)base, n);
+            return;
+        }
+        c.pivot = heap;
+        c.tmp = heap + size;
+    }
+    pdq_loop(&c, (unsigned char *)base, (unsigned char *)base + n * size,
+             pdq_log2(n), 1);
+    free(heap);
+}
+
+/**
+ * Defines `static void NAME(T *a, size_t n)`, pdqsort of n values of type
+ * T in the order of LESS(x, y). The helpers are named NAME_*.
+ */
+#define PDQSORT_DEFINE(NAME, T, LESS)                                         \
+    static inline void NAME##_swap(T *a, T *b)                                \
+    {                                                                         \
+        T t = *a;                                                             \
+        *a = *b;                                                              \
+        *b = t;                                                               \
+    }                                                                         \
+                                                                              \
+    /* orders two values, counting the swaps */                               \
+    static inline void NAME##_sort2(T *a, T *b, int *swaps)                   \
+    {                                                                         \
+        if (LESS(*b, *a))                                                     \
+        {                                                                     \
+            NAME##_swap(a, b);                                                \
+            (*swaps)++;                                                       \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    static inline void NAME##_sort3(T *a, T *b, T *c, int *swaps)             \
+    {                                                                         \
+        NAME##_sort2(a, b, swaps);                                            \
+        NAME##_sort2(b, c, swaps);                                            \
+        NAME##_sort2(a, b, swaps);                                            \
+    }                                                                         \
+                                                                              \
+    static void NAME##_reverse(T *begin, T *end)                              \
+    {                                                                         \
+        while (begin < --end) NAME##_swap(begin++, end);                      \
+    }                                                                         \
+                                                                              \
+    static void NAME##_insertion(T *begin, T *end, int leftmost)              \
+    {                                                                         \
+        if (begin == end)                                                     \
+            return;                                                           \
+        for (T *cur = begin + 1; cur != end; cur++)                           \
+        {                                                                     \
+            T *sift = cur, tmp = *cur;                                        \
+            if (!LESS(tmp, sift[-1]))                                         \
+                continue;                                                     \
+            do                                                                \
+            {                                                                 \
+                *sift = sift[-1];                                             \
+                sift--;                                                       \
+            } while ((!leftmost || sift != begin) && LESS(tmp, sift[-1]));    \
+            *sift = tmp;                                                      \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    static int NAME##_partial_insertion(T *begin, T *end)                     \
+    {                                                                         \
+        size_t moved = 0;                                                     \
+        if (begin == end)                                                     \
+            return 1;                                                         \
+        for (T *cur = begin + 1; cur != end; cur++)                           \
+        {                                                                     \
+            if (moved > PDQ_PARTIAL_LIMIT)                                    \
+                return 0;                                                     \
+            T *sift = cur, tmp = *cur;                                        \
+            if (!LESS(tmp, sift[-1]))                                         \
+                continue;                                                     \
+            do                                                                \
+            {                                                                 \
+                *sift = sift[-1];                                             \
+                sift--;                                                       \
+            } while (sift != begin && LESS(tmp, sift[-1]));                   \
+            *sift = tmp;                                                      \
+            moved += (size_t)(cur - sift);                                    \
+        }                                                                     \
+        return 1;                                                             \
+    }                                                                         \
+                                                                              \
+    static void NAME##_heapsort(T *a, size_t n)                               \
+    {                                                                         \
+        for (size_t top = n / 2, end = n; end > 1;)                           \
+        {                                                                     \
+            size_t i;                                                         \
+            T x;                                                              \
+            if (top > 0)                                                      \
+                x = a[i = --top];                                             \
+            else                                                              \
+            {                                                                 \
+                x = a[--end];                                                 \
+                a[end] = a[0];                                                \
+                i = 0;                                                        \
+            }                                                                 \
+            for (size_t child; (child = 2 * i + 1) < end; i = child)          \
+            {                                                                 \
+                if (child + 1 < end && LESS(a[child], a[child + 1]))          \
+                    child++;                                                  \
+                if (!LESS(x, a[child]))                                       \
+                    break;                                                    \
+                a[i] = a[child];                                              \
+            }                                                                 \
+            a[i] = x;                                                         \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    static T *NAME##_partition_right(T *begin, T *end, int *already)          \
+    {                                                                         \
+        T pivot = *begin;                                                     \
+        T *first = begin, *last = end;                                        \
+        while (LESS(*++first, pivot)) continue;                               \
+        if (first - 1 == begin)                                               \
+            while (first < last && !LESS(*--last, pivot)) continue;           \
+        else                                                                  \
+            while (!LESS(*--last, pivot)) continue;                           \
+                                                                              \
+        *already = first >= last;                                             \
+        if (!*already)                                                        \
+        {                                                                     \
+            unsigned char offsets_l[PDQ_BLOCK], offsets_r[PDQ_BLOCK];         \
+            size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0;            \
+            NAME##_swap(first++, last);                                       \
+            T *base_l = first, *base_r = last;                                \
+            while (first < last)                                              \
+            {                                                                 \
+                size_t unknown = (size_t)(last - first);                      \
+                size_t split_l = num_l ? 0 : num_r ? unknown : unknown / 2;   \
+                size_t split_r = num_r ? 0 : unknown - split_l;               \
+                if (split_l > PDQ_BLOCK)                                      \
+                    split_l = PDQ_BLOCK;                                      \
+                if (split_r > PDQ_BLOCK)                                      \
+                    split_r = PDQ_BLOCK;                                      \
+                                                                              \
+                /* no branch depends on the comparisons */                    \
+                for (size_t i = 0; i < split_l; i++)                          \
+                {                                                             \
+                    offsets_l[num_l] = (unsigned char)i;                      \
+                    num_l += !LESS(*first, pivot);                            \
+                    first++;                                                  \
+                }                                                             \
+                for (size_t i = 0; i < split_r;)                              \
+                {                                                             \
+                    offsets_r[num_r] = (unsigned char)++i;                    \
+                    num_r += LESS(*--last, pivot);                            \
+                }                                                             \
+                                                                              \
+                size_t num = num_l < num_r ? num_l : num_r;                   \
+                const unsigned char *o_l = offsets_l + start_l;               \
+                const unsigned char *o_r = offsets_r + start_r;               \
+                if (num_l == num_r)                                           \
+                {                                                             \
+                    for (size_t i = 0; i < num; i++)                          \
+                        NAME##_swap(base_l + o_l[i], base_r - o_r[i]);        \
+                }                                                             \
+                else if (num > 0)                                             \
+                {                                                             \
+                    T *l = base_l + o_l[0], *r = base_r - o_r[0];             \
+                    T tmp = *l;                                               \
+                    *l = *r;                                                  \
+                    for (size_t i = 1; i < num; i++)                          \
+                    {                                                         \
+                        l = base_l + o_l[i];                                  \
+                        *r = *l;                                              \
+                        r = base_r - o_r[i];                                  \
+                        *l = *r;                                              \
+                    }                                                         \
+                    *r = tmp;                                                 \
+                }                                                             \
+                num_l -= num;                                                 \
+                num_r -= num;                                                 \
+                start_l += num;                                               \
+                start_r += num;                                               \
+                if (num_l == 0)                                               \
+                {                                                             \
+                    start_l = 0;                                              \
+                    base_l = first;                                           \
+                }                                                             \
+                if (num_r == 0)                                               \
+                {                                                             \
+                    start_r = 0;                                              \
+                    base_r = last;                                            \
+                }                                                             \
+            }                                                                 \
+            if (num_l)                                                        \
+            {                                                                 \
+                while (num_l--)                                               \
+                    NAME##_swap(base_l + offsets_l[start_l + num_l], --last); \
+                first = last;                                                 \
+            }                                                                 \
+            if (num_r)                                                        \
+            {                                                                 \
+                for (T *r = base_r; num_r--; first++)                         \
+                    NAME##_swap(r - offsets_r[start_r + num_r], first);       \
+            }                                                                 \
+        }                                                                     \
+                                                                              \
+        T *pivot_pos = first - 1;                                             \
+        *begin = *pivot_pos;                                                  \
+        *pivot_pos = pivot;                                                   \
+        return pivot_pos;                                                     \
+    }                                                                         \
+                                                                              \
+    static T *NAME##_partition_left(T *begin, T *end)                         \
+    {                                                                         \
+        T pivot = *begin;                                                     \
+        T *first = begin, *last = end;                                        \
+        while (LESS(pivot, *--last)) continue;                                \
+        if (last + 1 == end)                                                  \
+            while (first < last && !LESS(pivot, *++first)) continue;          \
+        else                                                                  \
+            while (!LESS(pivot, *++first)) continue;                          \
+        while (first < last)                                                  \
+        {                                                                     \
+            NAME##_swap(first, last);                                         \
+            while (LESS(pivot, *--last)) continue;                            \
+            while (!LESS(pivot, *++first)) continue;                          \
+        }                                                                     \
+        *begin = *last;                                                       \
+        *last = pivot;                                                        \
+        return last;                                                          \
+    }                                                                         \
+                                                                              \
+    static void NAME##_break_patterns(T *lo, T *hi, size_t n)                 \
+    {                                                                         \
+        size_t q = n / 4;                                                     \
+        if (n < PDQ_INSERTION_MAX)                                            \
+            return;                                                           \
+        NAME##_swap(lo, lo + q);                                              \
+        NAME##_swap(hi - 1, hi - q);                                          \
+        if (n > PDQ_NINTHER_MIN)                                              \
+        {                                                                     \
+            NAME##_swap(lo + 1, lo + q + 1);                                  \
+            NAME##_swap(lo + 2, lo + q + 2);                                  \
+            NAME##_swap(hi - 2, hi - q - 1);                                  \
+            NAME##_swap(hi - 3, hi - q - 2);                                  \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    static void NAME##_loop(T *begin, T *end, int bad_allowed, int leftmost)  \
+    {                                                                         \
+        for (;;)                                                              \
+        {                                                                     \
+            size_t n = (size_t)(end - begin);                                 \
+            if (n < PDQ_INSERTION_MAX)                                        \
+            {                                                                 \
+                NAME##_insertion(begin, end, leftmost);                       \
+                return;                                                       \
+            }                                                                 \
+                                                                              \
+            size_t h = n / 2;                                                 \
+            int swaps = 0;                                                    \
+            if (n > PDQ_NINTHER_MIN)                                          \
+            {                                                                 \
+                size_t q = n / 4;                                             \
+                T *lo = begin + q, *mid = begin + h, *hi = end - q;           \
+                NAME##_sort3(lo - 1, lo, lo + 1, &swaps);                     \
+                NAME##_sort3(mid - 1, mid, mid + 1, &swaps);                  \
+                NAME##_sort3(hi - 1, hi, hi + 1, &swaps);                     \
+                NAME##_sort3(lo, mid, hi, &swaps);                            \
+                if (swaps == PDQ_NINTHER_SWAPS)                               \
+                {                                                             \
+                    NAME##_reverse(begin, end);                               \
+                    h = n - 1 - h;                                            \
+                }                                                             \
+                NAME##_swap(begin, begin + h);                                \
+            }                                                                 \
+            else                                                              \
+                NAME##_sort3(begin + h, begin, end - 1, &swaps);              \
+                                                                              \
+            if (!leftmost && !LESS(begin[-1], *begin))                        \
+            {                                                                 \
+                begin = NAME##_partition_left(begin, end) + 1;                \
+                continue;                                                     \
+            }                                                                 \
+                                                                              \
+            int already;                                                      \
+            T *pivot = NAME##_partition_right(begin, end, &already);          \
+            size_t l = (size_t)(pivot - begin), r = n - l - 1;                \
+            if (l < n / 8 || r < n / 8)                                       \
+            {                                                                 \
+                if (--bad_allowed == 0)                                       \
+                {                                                             \
+                    NAME##_heapsort(begin, n);                                \
+                    return;                                                   \
+                }                                                             \
+                NAME##_break_patterns(begin, pivot, l);                       \
+                NAME##_break_patterns(pivot + 1, end, r);                     \
+            }                                                                 \
+            else if (already && NAME##_partial_insertion(begin, pivot) &&     \
+                     NAME##_partial_insertion(pivot + 1, end))                \
+                return;                                                       \
+                                                                              \
+            NAME##_loop(begin, pivot, bad_allowed, leftmost);                 \
+            begin = pivot + 1;                                                \
+            leftmost = 0;                                                     \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    static void NAME(T *a, size_t n)                                          \
+    {                                                                         \
+        if (n > 1)                                                            \
+            NAME##_loop(a, a + n, pdq_log2(n), 1);                            \
+    }
+
+#endif /* PDQSORT_H */
@@ -1,71 +1,263 @@
-#include <stdio.h>
+/**
+ * @file
+ * @brief Byte-wise (base 256) LSD [radix
+ * sort](https://en.wikipedia.org/wiki/Radix_sort) for 32 and 64-bit
+ * integers and floating point numbers, with optional values
+ * @details
+ * The sorts are in radix_sort.h: radix_sort_u32(), radix_sort_i32(),
+ * radix_sort_f32() and their 64-bit counterparts, each with a `_kv`
+ * variant which moves values along with the keys.
+ *
+ * Run `./radix_sort [n]` to compare with qsort() and the base-10 radix sort
+ * of radix_sort_2.c on n keys (default 1000000).
+ */
 
-int largest(int a[], int n)
+#include <assert.h>  /// for assert
+#include <stdint.h>  /// for fixed width integers
+#include <stdio.h>   /// for printf
+#include <stdlib.h>  /// for malloc, qsort
+#include <string.h>  /// for memcpy, memset
+#include <time.h>    /// for clock
+#ifdef _OPENMP
+#include <omp.h>  /// for omp_set_num_threads, omp_get_wtime
+#endif
+
+#include "radix_sort.h"  /// for radix_sort_u32 and the like
+
+/**
+ * @brief The base-10 LSD radix sort of radix_sort_2.c, for non-negative
+ * ints, kept as a baseline
+ * @param arr array to sort
+ * @param n size of the array
+ */
+static void radix_sort_base10(int *arr, int n)
 {
-    int large = a[0], i;
-    for (i = 1; i < n; i++)
+    int max = 0;
+    int *output = (int *)malloc(n * sizeof(int));
+    for (int i = 0; i < n; i++) max = arr[i] > max ? arr[i] : max;
+
+    for (long place = 1; max / place > 0; place *= 10)
     {
-        if (large < a[i])
-            large = a[i];
+        int freq[10] = {0};
+        for (int i = 0; i < n; i++) freq[(arr[i] / place) % 10]++;
+        for (int i = 1; i < 10; i++) freq[i] += freq[i - 1];
+        for (int i = n - 1; i >= 0; i--)
+            output[--freq[(arr[i] / place) % 10]] = arr[i];
+        memcpy(arr, output, n * sizeof(int));
     }
-    return large;
+    free(output);
 }
 
-void RadixSort(int a[], int n)
+/** qsort() comparators */
+#define RADIX_CMP(NAME, T)                                \
+    static int cmp_##NAME(const void *a, const void *b)   \
+    {                                                     \
+        T x = *(const T *)a, y = *(const T *)b;           \
+        return (x > y) - (x < y);                         \
+    }
+RADIX_CMP(u32, uint32_t)
+RADIX_CMP(i32, int32_t)
+RADIX_CMP(f32, float)
+RADIX_CMP(u64, uint64_t)
+RADIX_CMP(i64, int64_t)
+RADIX_CMP(f64, double)
+
+/** random 64 bits */
+static uint64_t rand64()
 {
-    int bucket[10][10], bucket_count[10];
-    int i, j, k, remainder, NOP = 0, divisor = 1, large, pass;
+    uint64_t r = 0;
+    for (int i = 0; i < 4; i++) r = (r << 16) ^ (uint64_t)(rand() & 0xffff);
+    return r;
+}
+
+/**
+ * Sorts copies of n keys of type T with radix_sort_NAME and with qsort
+ * and compares them, the keys coming from `gen`
+ */
+#define RADIX_CHECK(NAME, T, gen)                                      \
+    do                                                                 \
+    {                                                                  \
+        T *a = (T *)malloc((n + 1) * sizeof(T));                       \
+        T *b = (T *)malloc((n + 1) * sizeof(T));                       \
+        for (size_t i = 0; i < n; i++) a[i] = b[i] = (T)(gen);         \
+        int status = radix_sort_##NAME(a, n);                          \
+        assert(status == 0);                                           \
+        (void)status;                                                  \
+        qsort(b, n, sizeof(T), cmp_##NAME);                            \
+        assert(n == 0 || memcmp(a, b, n * sizeof(T)) == 0);            \
+        free(a);                                                       \
+        free(b);                                                       \
+    } while (0)
+
+/**
+ * @brief Self-test
+ * @returns void
+ */
+static void test()
+{
+    const size_t sizes[] = {0, 1, 2, 31, 33, 1000, 100000};
+
+#ifdef _OPENMP
+    // run the threaded passes even on a single core
+    if (omp_get_max_threads() < 3)
+        omp_set_num_threads(3);
+#endif
+    for (int s = 0; s < 7; s++)
+    {
+        size_t n = sizes[s];
+        RADIX_CHECK(u32, uint32_t, rand64());
+        RADIX_CHECK(i32, int32_t, rand64());
+        RADIX_CHECK(u64, uint64_t, rand64());
+        RADIX_CHECK(i64, int64_t, rand64());
+        // small ranges leave most passes trivial
+        RADIX_CHECK(u32, uint32_t, rand() % 200);
+        RADIX_CHECK(i64, int64_t, rand() % 200 - 100);
+        RADIX_CHECK(u64, uint64_t, rand64() & 0xff00000000000000ull);
+        RADIX_CHECK(i32, int32_t, 7);
+        RADIX_CHECK(f32, float, (rand() - RAND_MAX / 2) / 1024.0f);
+        RADIX_CHECK(f64, double, (rand() - RAND_MAX / 2) * 1e-300);
+        RADIX_CHECK(f64, double, (double)rand() * rand() - 1e15);
+    }
+
+    // extremes of every type, signed zeros and infinities
+    int32_t i32[] = {INT32_MAX, -1, 0, INT32_MIN, 1, INT32_MIN + 1};
+    radix_sort_i32(i32, 6);
+    assert(i32[0] == INT32_MIN && i32[2] == -1 && i32[5] == INT32_MAX);
+    int64_t i64[] = {INT64_MIN, INT64_MAX, -5, 5};
+    radix_sort_i64(i64, 4);
+    assert(i64[0] == INT64_MIN && i64[1] == -5 && i64[3] == INT64_MAX);
+    float f[] = {1.0f / 0.0f, 0.0f, -0.0f, -1.0f / 0.0f, -1.5f, 1e-40f};
+    radix_sort_f32(f, 6);
+    assert(f[0] == -1.0f / 0.0f && f[1] == -1.5f && f[5] == 1.0f / 0.0f);
+    assert(f[2] == 0.0f && 1.0f / f[2] < 0 && 1.0f / f[3] > 0);
+    assert(f[4] == 1e-40f);
 
-    large = largest(a, n);
-    printf("The large element %d\n", large);
-    while (large > 0)
+#ifdef _OPENMP
+    // in a parallel region the sort gets a team of one thread, fewer than
+    // omp_get_max_threads() says
+#pragma omp parallel num_threads(2)
+#pragma omp single
     {
-        NOP++;
-        large /= 10;
+        size_t n = 100000;
+        RADIX_CHECK(u64, uint64_t, rand64());
     }
+#endif
 
-    for (pass = 0; pass < NOP; pass++)
+    // key-value pairs, sorted stably, also across threads
+    size_t n = 200000;
+    uint32_t *keys = (uint32_t *)malloc(n * sizeof(uint32_t));
+    uint32_t *orig = (uint32_t *)malloc(n * sizeof(uint32_t));
+    uint32_t *index = (uint32_t *)malloc(n * sizeof(uint32_t));
+    for (size_t i = 0; i < n; i++)
     {
-        for (i = 0; i < 10; i++)
-        {
-            bucket_count[i] = 0;
-        }
-        for (i = 0; i < n; i++)
-        {
-            remainder = (a[i] / divisor) % 10;
-            bucket[remainder][bucket_count[remainder]] = a[i];
-            bucket_count[remainder] += 1;
-        }
-
-        i = 0;
-        for (k = 0; k < 10; k++)
-        {
-            for (j = 0; j < bucket_count[k]; j++)
-            {
-                a[i] = bucket[k][j];
-                i++;
-            }
-        }
-        divisor *= 10;
-
-        for (i = 0; i < n; i++) printf("%d  ", a[i]);
-        printf("\n");
+        keys[i] = orig[i] = (uint32_t)(rand() % 1000) << 20;
+        index[i] = (uint32_t)i;
     }
+    int status = radix_sort_u32_kv(keys, index, n);
+    assert(status == 0);
+    (void)status;
+    for (size_t i = 0; i < n; i++)
+    {
+        assert(keys[i] == orig[index[i]]);
+        if (i > 0)
+            assert(keys[i - 1] < keys[i] ||
+                   (keys[i - 1] == keys[i] && index[i - 1] < index[i]));
+    }
+    free(keys);
+    free(orig);
+    free(index);
+
+    double d[] = {3.5, -2.0, 3.5, -7.25};
+    uint64_t v[] = {0, 1, 2, 3};
+    radix_sort_f64_kv(d, v, 4);
+    assert(d[0] == -7.25 && v[0] == 3 && v[1] == 1 && v[2] == 0 && v[3] == 2);
+
+#ifdef _OPENMP
+    omp_set_num_threads(omp_get_num_procs());
+#endif
+    printf("All tests have successfully passed!\n");
 }
 
-int main()
+/** seconds since an arbitrary point */
+static double now()
 {
-    int i, n, a[10];
-    printf("Enter the number of elements :: ");
-    scanf("%d", &n);
-    printf("Enter the elements :: ");
-    for (i = 0; i < n; i++)
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/**
+ * Times radix_sort_NAME against qsort on n keys of type T from `gen`
+ */
+#define RADIX_TIME(NAME, T, gen)                                            \
+    do                                                                      \
+    {                                                                       \
+        T *a = (T *)malloc(n * sizeof(T)), *b = (T *)malloc(n * sizeof(T)); \
+        for (size_t i = 0; i < n; i++) a[i] = b[i] = (T)(gen);              \
+        double t = now();                                                   \
+        radix_sort_##NAME(a, n);                                            \
+        double radix = now() - t;                                           \
+        t = now();                                                          \
+        qsort(b, n, sizeof(T), cmp_##NAME);                                 \
+        double q = now() - t;                                               \
+        assert(memcmp(a, b, n * sizeof(T)) == 0);                           \
+        printf("%-28s %10.3f %10.3f\n", #NAME ", " #gen, radix, q);         \
+        free(a);                                                            \
+        free(b);                                                            \
+    } while (0)
+
+/**
+ * @brief Benchmark on n keys of each type
+ * @param n number of keys
+ * @returns void
+ */
+static void benchmark(size_t n)
+{
+    printf("\n%zu keys, seconds                radix      qsort\n", n);
+    RADIX_TIME(u32, uint32_t, rand64());
+    RADIX_TIME(u32, uint32_t, rand() % 60000);
+    RADIX_TIME(i32, int32_t, rand64());
+    RADIX_TIME(f32, float, rand() - RAND_MAX / 2);
+    RADIX_TIME(u64, uint64_t, rand64());
+    RADIX_TIME(i64, int64_t, rand64() >> 20);
+    RADIX_TIME(f64, double, rand64() * 1e-9);
+
+    // key-value pairs, and the base-10 sort of radix_sort_2.c
+    uint32_t *keys = (uint32_t *)malloc(n * sizeof(uint32_t));
+    uint32_t *values = (uint32_t *)malloc(n * sizeof(uint32_t));
+    int *ints = (int *)malloc(n * sizeof(int));
+    for (size_t i = 0; i < n; i++)
     {
-        scanf("%d", &a[i]);
+        keys[i] = (uint32_t)rand64() >> 1;
+        values[i] = (uint32_t)i;
+        ints[i] = (int)keys[i];
     }
-    RadixSort(a, n);
-    printf("The sorted elements are ::  ");
-    for (i = 0; i < n; i++) printf("%d  ", a[i]);
-    printf("\n");
+    double t = now();
+    radix_sort_u32_kv(keys, values, n);
+    printf("%-28s %10.3f\n", "u32 with u32 values", now() - t);
+    t = now();
+    radix_sort_base10(ints, (int)n);
+    printf("%-28s %10.3f\n", "radix_sort_2.c, base 10", now() - t);
+    for (size_t i = 0; i < n; i++) assert(ints[i] == (int)keys[i]);
+    free(keys);
+    free(values);
+    free(ints);
+}
+
+/**
+ * @brief Main function
+ * @param argc number of arguments
+ * @param argv number of keys for the benchmark, 0 to skip it
+ * @returns 0 on exit
+ */
+int main(int argc, char **argv)
+{
+    test();
+
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    if (n > 0)
+        benchmark(n);
     return 0;
 }
@@ -0,0 +1,314 @@
+/**
+ * @file
+ * @brief Byte-wise (base 256) LSD [radix
+ * sort](https://en.wikipedia.org/wiki/Radix_sort) for 32 and 64-bit
+ * integers and floating point numbers, with optional values
+ * @details
+ * The keys are sorted one byte at a time, least significant first, each
+ * pass being a stable counting sort into a scratch buffer: 4 passes for
+ * 32-bit keys, 8 for 64-bit ones.
+ *
+ * - The counts of all the bytes are gathered in a single read of the input
+ *   before the first pass. A pass in which every key has the same byte
+ *   would not move anything and is skipped, so small or clustered keys
+ *   take fewer passes.
+ * - Signed and floating point keys are mapped to unsigned integers of the
+ *   same order while counting, and mapped back at the end. Floats sort as
+ *   -NaN < -inf < ... < -0.0 < +0.0 < ... < +inf < +NaN.
+ * - The `_kv` variants move a value of the width of the key along with
+ *   every key, for example the original index of the key.
+ * - With OpenMP and large inputs the input is cut into one slice per
+ *   thread asked for, and the threads of the team count and scatter the
+ *   slices; the keys of a slice go behind those of the slices before it for
+ *   the same byte, which keeps the sort stable.
+ *
+ * The sorts return -1 if the scratch buffers cannot be allocated.
+ *
+ * radix_sort.c tests and times the sorts, and sort_benchmark.c compares
+ * radix_sort_i32() with the other sorts of this folder.
+ */
+
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <stdint.h>  /// for fixed width integers
+#include <stdlib.h>  /// for malloc
+#include <string.h>  /// for memcpy, memset
+#ifdef _OPENMP
+#include <omp.h>  /// for omp_get_max_threads
+#endif
+
+/** inputs smaller than this are sorted by one thread */
+#define RADIX_PARALLEL_MIN (1 << 16)
+
+/** inputs smaller than this are insertion sorted */
+#define RADIX_INSERTION_MAX 32
+
+/** how keys are mapped to unsigned integers of the same order */
+enum radix_mode
+{
+    RADIX_UNSIGNED,
+    RADIX_SIGNED,
+    RADIX_FLOAT
+};
+
+/**
+ * Defines `radix_coreBITS(keys, values, n, mode)`, the sort of BITS-bit
+ * keys with optional values (NULL for none) of the same width.
+ */
+#define RADIX_SORT_CORE(BITS)                                                 \
+    typedef uint##BITS##_t radix_u##BITS;                                     \
+                                                                              \
+    /* keys are read and written with memcpy, which may access the float      \
+     * arrays of the caller as integers; it compiles to plain moves */        \
+    static inline radix_u##BITS radix_load##BITS(const unsigned char *p,      \
+                                                 size_t i)                    \
+    {                                                                         \
+        radix_u##BITS x;                                                      \
+        memcpy(&x, p + i * sizeof(x), sizeof(x));                             \
+        return x;                                                             \
+    }                                                                         \
+                                                                              \
+    static inline void radix_store##BITS(unsigned char *p, size_t i,          \
+                                         radix_u##BITS x)                     \
+    {                                                                         \
+        memcpy(p + i * sizeof(x), &x, sizeof(x));                             \
+    }                                                                         \
+                                                                              \
+    /* xor mask mapping a key to an unsigned key of the same order */         \
+    static inline radix_u##BITS radix_encode##BITS(radix_u##BITS x,           \
+                                                   radix_u##BITS fmask,       \
+                                                   radix_u##BITS smask)       \
+    {                                                                         \
+        return x ^ (((0 - (x >> (BITS - 1))) & fmask) | smask);               \
+    }                                                                         \
+                                                                              \
+    static inline radix_u##BITS radix_decode##BITS(radix_u##BITS x,           \
+                                                   radix_u##BITS fmask,       \
+                                                   radix_u##BITS smask)       \
+    {                                                                         \
+        return x ^ (((0 - ((x >> (BITS - 1)) ^ 1)) & fmask) | smask);         \
+    }                                                                         \
+                                                                              \
+    static void radix_insertion##BITS(unsigned char *keys,                    \
+                                      radix_u##BITS *values, size_t n)        \
+    {                                                                         \
+        for (size_t i = 1; i < n; i++)                                        \
+        {                                                                     \
+            radix_u##BITS k = radix_load##BITS(keys, i);                      \
+            radix_u##BITS v = values ? values[i] : 0;                         \
+            size_t j = i;                                                     \
+            for (; j > 0 && radix_load##BITS(keys, j - 1) > k; j--)           \
+            {                                                                 \
+                radix_store##BITS(keys, j, radix_load##BITS(keys, j - 1));    \
+                if (values)                                                   \
+                    values[j] = values[j - 1];                                \
+            }                                                                 \
+            radix_store##BITS(keys, j, k);                                    \
+            if (values)                                                       \
+                values[j] = v;                                                \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    /* moves keys [lo, hi) of src to dst by byte `shift`, using and           \
+     * advancing the write positions in `offset` */                           \
+    static void radix_scatter##BITS(                                          \
+        const unsigned char *src, unsigned char *dst,                         \
+        const radix_u##BITS *vsrc, radix_u##BITS *vdst, size_t lo,            \
+        size_t hi, int shift, size_t *offset)                                 \
+    {                                                                         \
+        for (size_t i = lo; i < hi; i++)                                      \
+        {                                                                     \
+            radix_u##BITS k = radix_load##BITS(src, i);                       \
+            size_t o = offset[(k >> shift) & 0xff]++;                         \
+            radix_store##BITS(dst, o, k);                                     \
+            if (vsrc != NULL)                                                 \
+                vdst[o] = vsrc[i];                                            \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    static int radix_core##BITS(unsigned char *keys, radix_u##BITS *values,   \
+                                size_t n, enum radix_mode mode)               \
+    {                                                                         \
+        enum                                                                  \
+        {                                                                     \
+            PASSES = BITS / 8                                                 \
+        };                                                                    \
+        const radix_u##BITS sign = (radix_u##BITS)1 << (BITS - 1);            \
+        const radix_u##BITS fmask = mode == RADIX_FLOAT ? ~(radix_u##BITS)0   \
+                                                        : 0;                  \
+        const radix_u##BITS smask = mode == RADIX_UNSIGNED ? 0 : sign;        \
+        int threads = 1;                                                      \
+        if (n >= RADIX_PARALLEL_MIN)                                          \
+            threads = radix_threads();                                        \
+                                                                              \
+        unsigned char *tmp = NULL;                                            \
+        radix_u##BITS *vtmp = NULL;                                           \
+        size_t(*count)[PASSES][256] = calloc(threads, sizeof(*count));        \
+        if (n > RADIX_INSERTION_MAX)                                          \
+        {                                                                     \
+            tmp = malloc(n * sizeof(radix_u##BITS));                          \
+            vtmp = values ? malloc(n * sizeof(*vtmp)) : NULL;                 \
+        }                                                                     \
+        if (!count || (n > RADIX_INSERTION_MAX && !tmp) ||                    \
+            (n > RADIX_INSERTION_MAX && values && !vtmp))                     \
+        {                                                                     \
+            free(count);                                                      \
+            free(tmp);                                                        \
+            free(vtmp);                                                       \
+            return -1;                                                        \
+        }                                                                     \
+                                                                              \
+        /* map the keys and count every byte of them in one read; the         \
+           team may be smaller than asked, so a thread takes every            \
+           team-th slice */                                                   \
+        RADIX_PARALLEL(threads)                                               \
+        RADIX_SLICES(t, threads)                                              \
+        {                                                                     \
+            size_t lo = n * t / threads, hi = n * (t + 1) / threads;          \
+            for (size_t i = lo; i < hi; i++)                                  \
+            {                                                                 \
+                radix_u##BITS k = radix_encode##BITS(                         \
+                    radix_load##BITS(keys, i), fmask, smask);                 \
+                radix_store##BITS(keys, i, k);                                \
+                for (int p = 0; p < PASSES; p++)                              \
+                    count[t][p][(k >> (8 * p)) & 0xff]++;                     \
+            }                                                                 \
+        }                                                                     \
+        for (int t = 1; t < threads; t++)                                     \
+            for (int p = 0; p < PASSES; p++)                                  \
+                for (int d = 0; d < 256; d++)                                 \
+                    count[0][p][d] += count[t][p][d];                         \
+                                                                              \
+        unsigned char *src = keys, *dst = tmp;                                \
+        radix_u##BITS *vsrc = values, *vdst = vtmp;                           \
+        if (n <= RADIX_INSERTION_MAX)                                         \
+            radix_insertion##BITS(keys, values, n);                           \
+        else                                                                  \
+            for (int p = 0; p < PASSES; p++)                                  \
+            {                                                                 \
+                /* nothing moves if all keys share this byte */               \
+                radix_u##BITS first = radix_load##BITS(src, 0);               \
+                if (count[0][p][(first >> (8 * p)) & 0xff] == n)              \
+                    continue;                                                 \
+                                                                              \
+                if (threads == 1)                                             \
+                {                                                             \
+                    size_t offset[256], sum = 0;                              \
+                    for (int d = 0; d < 256; d++)                             \
+                    {                                                         \
+                        offset[d] = sum;                                      \
+                        sum += count[0][p][d];                                \
+                    }                                                         \
+                    radix_scatter##BITS(src, dst, vsrc, vdst, 0, n, 8 * p,    \
+                                        offset);                              \
+                }                                                             \
+                else                                                          \
+                {                                                             \
+                    /* the slices have changed since the first count */       \
+                    RADIX_PARALLEL(threads)                                   \
+                    {                                                         \
+                        RADIX_SLICES(t, threads)                              \
+                        {                                                     \
+                            size_t lo = n * t / threads;                      \
+                            size_t hi = n * (t + 1) / threads;                \
+                            size_t *own = count[t][0];                        \
+                            memset(own, 0, 256 * sizeof(size_t));             \
+                            for (size_t i = lo; i < hi; i++)                  \
+                                own[(radix_load##BITS(src, i) >>              \
+                                     (8 * p)) & 0xff]++;                      \
+                        }                                                     \
+                        RADIX_BARRIER                                         \
+                        RADIX_SINGLE                                          \
+                        {                                                     \
+                            size_t sum = 0;                                   \
+                            for (int d = 0; d < 256; d++)                     \
+                                for (int u = 0; u < threads; u++)             \
+                                {                                             \
+                                    size_t c = count[u][0][d];                \
+                                    count[u][0][d] = sum;                     \
+                                    sum += c;                                 \
+                                }                                             \
+                        }                                                     \
+                        RADIX_SLICES(t, threads)                              \
+                        radix_scatter##BITS(src, dst, vsrc, vdst,             \
+                                            n * t / threads,                  \
+                                            n * (t + 1) / threads, 8 * p,     \
+                                            count[t][0]);                     \
+                    }                                                         \
+                }                                                             \
+                unsigned char *t = src;                                       \
+                src = dst;                                                    \
+                dst = t;                                                      \
+                radix_u##BITS *vt = vsrc;                                     \
+                vsrc = vdst;                                                  \
+                vdst = vt;                                                    \
+            }                                                                 \
+                                                                              \
+        /* map back, into the caller's arrays after odd numbers of passes */  \
+        if (src != keys || mode != RADIX_UNSIGNED)                            \
+        {                                                                     \
+            RADIX_PARALLEL(threads)                                           \
+            RADIX_SLICES(t, threads)                                          \
+            {                                                                 \
+                size_t lo = n * t / threads, hi = n * (t + 1) / threads;      \
+                for (size_t i = lo; i < hi; i++)                              \
+                    radix_store##BITS(keys, i,                                \
+                                      radix_decode##BITS(                     \
+                                          radix_load##BITS(src, i), fmask,    \
+                                          smask));                            \
+                if (src != keys && values)                                    \
+                    memcpy(values + lo, vsrc + lo, (hi - lo) * sizeof(*vsrc)); \
+            }                                                                 \
+        }                                                                     \
+        free(count);                                                          \
+        free(tmp);                                                            \
+        free(vtmp);                                                           \
+        return 0;                                                             \
+    }
+
+#ifdef _OPENMP
+#define RADIX_PARALLEL(threads) _Pragma("omp parallel num_threads(threads)")
+#define RADIX_BARRIER _Pragma("omp barrier")
+#define RADIX_SINGLE _Pragma("omp single")
+static int radix_threads() { return omp_get_max_threads(); }
+static int radix_thread() { return omp_get_thread_num(); }
+static int radix_team() { return omp_get_num_threads(); }
+#else
+#define RADIX_PARALLEL(threads)
+#define RADIX_BARRIER
+#define RADIX_SINGLE
+static int radix_threads() { return 1; }
+static int radix_thread() { return 0; }
+static int radix_team() { return 1; }
+#endif
+/** the slices of a parallel region taken by this thread */
+#define RADIX_SLICES(t, threads) \
+    for (int t = radix_thread(); t < (threads); t += radix_team())
+
+RADIX_SORT_CORE(32)
+RADIX_SORT_CORE(64)
+
+/**
+ * Defines `radix_sort_NAME(keys, n)` and `radix_sort_NAME_kv(keys, values,
+ * n)` for keys of type T, sorted in place in ascending order.
+ */
+#define RADIX_SORT_DEFINE(NAME, T, BITS, MODE)                                \
+    static inline int radix_sort_##NAME(T *keys, size_t n)                    \
+    {                                                                         \
+        return radix_core##BITS((unsigned char *)keys, NULL, n, MODE);        \
+    }                                                                         \
+    static inline int radix_sort_##NAME##_kv(T *keys, uint##BITS##_t *values, \
+                                             size_t n)                        \
+    {                                                                         \
+        return radix_core##BITS((unsigned char *)keys, values, n, MODE);      \
+    }
+
+RADIX_SORT_DEFINE(u32, uint32_t, 32, RADIX_UNSIGNED)
+RADIX_SORT_DEFINE(i32, int32_t, 32, RADIX_SIGNED)
+RADIX_SORT_DEFINE(f32, float, 32, RADIX_FLOAT)
+RADIX_SORT_DEFINE(u64, uint64_t, 64, RADIX_UNSIGNED)
+RADIX_SORT_DEFINE(i64, int64_t, 64, RADIX_SIGNED)
+RADIX_SORT_DEFINE(f64, double, 64, RADIX_FLOAT)
+
+#endif /* RADIX_SORT_H */
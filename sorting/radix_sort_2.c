@@ -54,8 +54,9 @@ void radixsort2(int *arr, int n,
     while (max)
     {
         countSort(arr, n, mul);
-        mul *= 10;
         max /= 10;
+        if (max)  // 10^10 does not fit in an int
+            mul *= 10;
     }
 }
 
@@ -0,0 +1,326 @@
+/**
+ * @file
+ * @brief Benchmark and cross-check of the sorting algorithms of this folder
+ * on random, sorted, reversed, few-unique and organ-pipe inputs
+ * @details
+ * Every sort is registered in #algos behind the interface of qsort(),
+ * `(void *base, size_t n, size_t size, cmp)`, and/or a typed one,
+ * `(int *a, size_t n)`; those that only have one are called through it.
+ * Every result is compared with the output of qsort(), so a broken sort
+ * fails the run.
+ *
+ * The sorts compared are those of this folder which can be called from
+ * another program: qsort() and the two forms of pdqsort.h, merge_sort() of
+ * merge_sort.h and radix_sort_i32() of radix_sort.h. The other programs of
+ * this folder each have their own `main` and are run on their own.
+ *
+ * Run `./sort_benchmark [n...]` to time the sorts on arrays of n ints
+ * (default 1000, 100000 and 1000000). The times are in nanoseconds per
+ * element, averaged over enough runs to sort at least 2^21 elements.
+ */
+
+#include <assert.h>  /// for assert
+#include <stdint.h>  /// for uint32_t
+#include <stdio.h>   /// for printf
+#include <stdlib.h>  /// for malloc, qsort, strtoul
+#include <string.h>  /// for memcpy, memcmp
+#include <time.h>    /// for clock
+
+#include "merge_sort.h"  /// for merge_sort
+#include "pdqsort.h"     /// for pdqsort, PDQSORT_DEFINE
+#include "radix_sort.h"  /// for radix_sort_i32
+
+/** ascending order of ints for qsort() style sorts */
+static int cmp_int(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/** ascending order of bytes */
+static int cmp_byte(const void *a, const void *b)
+{
+    return *(const unsigned char *)a - *(const unsigned char *)b;
+}
+
+/** an element larger than #PDQ_STACK_SIZE */
+struct record
+{
+    int key;
+    int id;
+    char pad[192];
+};
+
+/** ascending order of records by key */
+static int cmp_record(const void *a, const void *b)
+{
+    return cmp_int(&((const struct record *)a)->key,
+                   &((const struct record *)b)->key);
+}
+
+/** ascending order of numbers, for PDQSORT_DEFINE */
+#define LESS_NUM(x, y) ((x) < (y))
+
+PDQSORT_DEFINE(pdqsort_int, int, LESS_NUM)
+
+/** merge_sort() with the interface of the sorts of ints */
+static void merge_sort_int(int *a, size_t n)
+{
+    if (merge_sort(a, n) != 0)
+    {
+        perror("merge_sort");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/** radix_sort_i32() with the interface of the sorts of ints */
+static void radix_sort_int(int *a, size_t n)
+{
+    if (radix_sort_i32((int32_t *)a, n) != 0)
+    {
+        perror("radix_sort_i32");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/** a sort with the interface of qsort() */
+typedef void (*sort_any_t)(void *base, size_t n, size_t size,
+                           int (*cmp)(const void *, const void *));
+
+/** a sort of ints */
+typedef void (*sort_int_t)(int *a, size_t n);
+
+/** a registered sort */
+struct sort_algo
+{
+    const char *name;
+    sort_any_t sort_any;  ///< NULL if the sort only takes ints
+    sort_int_t sort_int;  ///< NULL if the sort only has the generic form
+};
+
+/** the sorts compared */
+static const struct sort_algo algos[] = {
+    {"qsort", qsort, NULL},
+    {"pdqsort", pdqsort, NULL},
+    {"pdqsort_int", NULL, pdqsort_int},
+    {"merge_sort", NULL, merge_sort_int},
+    {"radix_sort_i32", NULL, radix_sort_int},
+};
+
+#define ALGO_COUNT (sizeof(algos) / sizeof(algos[0]))
+
+/** kinds of input */
+enum input_kind
+{
+    INPUT_RANDOM,
+    INPUT_SORTED,
+    INPUT_REVERSED,
+    INPUT_FEW_UNIQUE,  ///< 16 distinct keys
+    INPUT_ORGAN_PIPE,  ///< ascending then descending
+    INPUT_KINDS
+};
+
+static const char *const input_names[INPUT_KINDS] = {
+    "random", "sorted", "reversed", "few-unique", "organ-pipe"};
+
+/** xorshift32 generator, the same sequence on every platform */
+static uint32_t next_random(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/** fills a with n keys of the given kind */
+static void fill(int *a, size_t n, enum input_kind kind, uint32_t seed)
+{
+    uint32_t state = seed | 1;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        switch (kind)
+        {
+        case INPUT_RANDOM:
+            a[i] = (int)(next_random(&state) >> 1);
+            break;
+        case INPUT_SORTED:
+            a[i] = (int)i;
+            break;
+        case INPUT_REVERSED:
+            a[i] = (int)(n - i);
+            break;
+        case INPUT_FEW_UNIQUE:
+            a[i] = (int)(next_random(&state) % 16);
+            break;
+        default:
+            a[i] = (int)(i < n / 2 ? i : n - i);
+            break;
+        }
+    }
+}
+
+/** sorts n ints with the given sort */
+static void run(const struct sort_algo *algo, int *a, size_t n)
+{
+    if (algo->sort_int != NULL)
+        algo->sort_int(a, n);
+    else
+        algo->sort_any(a, n, sizeof(int), cmp_int);
+}
+
+/**
+ * Self-test: every sort against qsort() on small inputs of every kind,
+ * and pdqsort() on elements of other sizes, including the heapsort
+ * fallbacks that are not reached on ordinary inputs.
+ * @returns void
+ */
+static void test(void)
+{
+    static const size_t sizes[] = {0, 1, 2, 3, 5, 23, 24, 25, 100, 129, 1000,
+                                   5000};
+    int *a = (int *)malloc(5000 * sizeof(int));
+    int *b = (int *)malloc(5000 * sizeof(int));
+    assert(a != NULL && b != NULL);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        for (int kind = 0; kind < INPUT_KINDS; kind++)
+        {
+            size_t n = sizes[s];
+            fill(b, n, (enum input_kind)kind, (uint32_t)(n + kind));
+            qsort(b, n, sizeof(int), cmp_int);
+            for (size_t k = 0; k < ALGO_COUNT; k++)
+            {
+                fill(a, n, (enum input_kind)kind, (uint32_t)(n + kind));
+                run(&algos[k], a, n);
+                assert(n == 0 || memcmp(a, b, n * sizeof(int)) == 0);
+            }
+
+            // heapsort fallbacks
+            struct pdq_ctx c = {sizeof(int), cmp_int, NULL, NULL};
+            fill(a, n, (enum input_kind)kind, (uint32_t)(n + kind));
+            pdq_heapsort(&c, (unsigned char *)a, n);
+            assert(n == 0 || memcmp(a, b, n * sizeof(int)) == 0);
+            fill(a, n, (enum input_kind)kind, (uint32_t)(n + kind));
+            pdqsort_int_heapsort(a, n);
+            assert(n == 0 || memcmp(a, b, n * sizeof(int)) == 0);
+        }
+
+    // elements of 1 byte and of 200 bytes, the latter needing an allocation
+    unsigned char bytes[3000], sorted_bytes[3000];
+    uint32_t state = 7;
+    for (size_t i = 0; i < sizeof(bytes); i++)
+        bytes[i] = sorted_bytes[i] = (unsigned char)next_random(&state);
+    pdqsort(bytes, sizeof(bytes), 1, cmp_byte);
+    qsort(sorted_bytes, sizeof(sorted_bytes), 1, cmp_byte);
+    assert(memcmp(bytes, sorted_bytes, sizeof(bytes)) == 0);
+
+    struct record *records = (struct record *)calloc(500, sizeof(*records));
+    char seen[500] = {0};
+    assert(records != NULL);
+    for (int i = 0; i < 500; i++)
+    {
+        records[i].key = (int)(next_random(&state) % 50);
+        records[i].id = i;
+    }
+    pdqsort(records, 500, sizeof(*records), cmp_record);
+    for (int i = 0; i < 500; i++)
+    {
+        assert(i == 0 || records[i - 1].key <= records[i].key);
+        assert(records[i].pad[0] == 0 && !seen[records[i].id]);
+        seen[records[i].id] = 1;
+    }
+    free(records);
+
+    free(a);
+    free(b);
+    printf("All tests have successfully passed!\n");
+}
+
+/** times the sorts on n keys of every kind and prints a row per sort */
+static void benchmark(size_t n)
+{
+    int *input = (int *)malloc(n * sizeof(int));
+    int *expected = (int *)malloc(n * sizeof(int));
+    int *a = (int *)malloc(n * sizeof(int));
+    if (input == NULL || expected == NULL || a == NULL)
+    {
+        perror("benchmark");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t runs = n < (1 << 21) / 3 ? (1 << 21) / n : 3;
+
+    printf("\nn = %zu, ns per element\n%-16s", n, "");
+    for (int kind = 0; kind < INPUT_KINDS; kind++)
+        printf("%12s", input_names[kind]);
+    printf("\n");
+
+    double *times = (double *)malloc(ALGO_COUNT * INPUT_KINDS * sizeof(double));
+    assert(times != NULL);
+    for (int kind = 0; kind < INPUT_KINDS; kind++)
+    {
+        fill(input, n, (enum input_kind)kind, (uint32_t)n);
+        memcpy(expected, input, n * sizeof(int));
+        qsort(expected, n, sizeof(int), cmp_int);
+
+        for (size_t k = 0; k < ALGO_COUNT; k++)
+        {
+            double total = 0;
+            for (size_t r = 0; r < runs; r++)
+            {
+                memcpy(a, input, n * sizeof(int));
+                clock_t start = clock();
+                run(&algos[k], a, n);
+                double t = (double)(clock() - start) / CLOCKS_PER_SEC;
+                if (memcmp(a, expected, n * sizeof(int)) != 0)
+                {
+                    fprintf(stderr, "%s failed on %s input of %zu keys\n",
+                            algos[k].name, input_names[kind], n);
+                    exit(EXIT_FAILURE);
+                }
+                total += t;
+            }
+            times[k * INPUT_KINDS + kind] = total / (double)runs;
+        }
+    }
+
+    for (size_t k = 0; k < ALGO_COUNT; k++)
+    {
+        printf("%-16s", algos[k].name);
+        for (int kind = 0; kind < INPUT_KINDS; kind++)
+            printf("%12.2f", times[k * INPUT_KINDS + kind] * 1e9 / (double)n);
+        printf("\n");
+    }
+
+    free(times);
+    free(input);
+    free(expected);
+    free(a);
+}
+
+/**
+ * @brief Main function
+ * @param argc number of arguments
+ * @param argv sizes of the inputs to time
+ * @returns 0 on exit
+ */
+int main(int argc, char **argv)
+{
+    test();
+
+    if (argc < 2)
+    {
+        benchmark(1000);
+        benchmark(100000);
+        benchmark(1000000);
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        size_t n = strtoul(argv[i], NULL, 10);
+        if (n > 0)
+            benchmark(n);
+    }
+    return 0;
+}